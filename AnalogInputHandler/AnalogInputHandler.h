@@ -55,6 +55,7 @@ class AnalogInputHandler {
         void SetSaturations(float minEngineeringUnit, float maxEngineeringUnit);
 
         void UpdateInput();
+        void PresetFilter(float adcValue);
 
         String GetName();
         float GetADCValue();
@@ -225,6 +226,11 @@ void AnalogInputHandler::UpdateInput() {
 }
 
 
+void AnalogInputHandler::PresetFilter(float adcValue) {
+    InputFilter.Preset(adcValue);
+    InputFilteredADCValue = adcValue;
+}
+
 String AnalogInputHandler::GetName() {
     return Name;
 }
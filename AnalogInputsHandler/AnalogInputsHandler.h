@@ -3,11 +3,15 @@
 #define ANALOG_INPUTS_HANDLER
 
 #include <vector>
+#include <System.h>
 #include <AnalogInputHandler.h>
+#include <MetricsRegistry.h>
 #include <LoggerHandler.h>
 
 // Note: on esp32 ADC2 is shared with WiFi
 
+#define ANALOG_INPUTS_WARM_BOOT_MAX   (WARM_BOOT_SLOT_SIZE / sizeof(float))
+
 class AnalogInputsHandler {
     private:
         String LogName = "AnalogInputsHandler";
@@ -17,26 +21,50 @@ class AnalogInputsHandler {
         TaskHandle_t                     HandlerTaskPointer  = nullptr;
         int                              HandlerTaskPriority = 2;
         unsigned long                    HandlerTaskPeriod   = 200; // milliseconds
+        volatile uint32_t                ScanCount           = 0;
+        bool                             WarmBootChecked     = false;
+
+        Metric*                          ScansMetric         = nullptr;
+        std::vector<Metric*>             InputMetrics;
 
         static void HandlerTaskStatic(void *pvParameters);
         void HandlerTask();
 
         void ProcessInputs();
+        void RestoreFilters();
+        static void SaveFilters(void* Context);
 
     public:
         AnalogInputsHandler();
+        ~AnalogInputsHandler();
 
         void SetUpdatePeriod(unsigned long Period);
         void AddInput(AnalogInputHandler* AnalogInput);
 
+        size_t GetInputCount();
+        AnalogInputHandler* GetInput(size_t Index);
+        uint32_t GetScanCount();
+
 };
 
 AnalogInputsHandler::AnalogInputsHandler() {
     LOG(INFO, LogName, "Instance created.");
+    ScansMetric = MetricsRegistry::GetInstance().AddCounter("analog_scans_total", "Scans of the analog inputs");
+    WarmBootStore::GetInstance().AddSaveCallback(SaveFilters, this);
     xTaskCreatePinnedToCore(HandlerTaskStatic, "AnalogInputsHandlerTask", 8192, this, HandlerTaskPriority, &HandlerTaskPointer, 1);
+    MetricsRegistry::GetInstance().AddTask("AnalogInputsHandlerTask", HandlerTaskPointer);
     LOG(INFO, LogName, "Task created.");
 }
 
+AnalogInputsHandler::~AnalogInputsHandler() {
+    WarmBootStore::GetInstance().RemoveSaveCallback(SaveFilters, this);
+    if (HandlerTaskPointer != nullptr) {
+        MetricsRegistry::GetInstance().RemoveTask(HandlerTaskPointer);
+        vTaskDelete(HandlerTaskPointer);
+    }
+    LOG(INFO, LogName, "Instance deleted.");
+}
+
 void AnalogInputsHandler::HandlerTaskStatic(void *pvParameters) {
     AnalogInputsHandler *Instance = reinterpret_cast<AnalogInputsHandler *>(pvParameters);
     Instance->HandlerTask();
@@ -60,11 +88,44 @@ void AnalogInputsHandler::HandlerTask() {
 }
 
 void AnalogInputsHandler::ProcessInputs() {
-    for (auto input : AnalogInputs) {
-        if (input) {
-            input->UpdateInput();
-        }
+    if (!WarmBootChecked && !AnalogInputs.empty()) {
+        RestoreFilters();
+    }
+    for (size_t i = 0; i < AnalogInputs.size(); i++) {
+        AnalogInputs[i]->UpdateInput();
+        InputMetrics[i]->Set(AnalogInputs[i]->GetValue());
+    }
+    ScanCount++;
+    ScansMetric->Increment();
+}
+
+// After a warm boot the filters resume from their values before the sleep
+// instead of from the first sample, provided the inputs are the same
+void AnalogInputsHandler::RestoreFilters() {
+    WarmBootChecked = true;
+    WarmBootStore& WarmBoot = WarmBootStore::GetInstance();
+    size_t Count = min(AnalogInputs.size(), ANALOG_INPUTS_WARM_BOOT_MAX);
+    float Values[ANALOG_INPUTS_WARM_BOOT_MAX];
+    if (!WarmBoot.IsWarmBoot() || !WarmBoot.Load("analog", Values, Count * sizeof(float))) {
+        return;
     }
+    for (size_t i = 0; i < Count; i++) {
+        AnalogInputs[i]->PresetFilter(Values[i]);
+    }
+    LOG(INFO, LogName, String(Count) + " filters restored from warm boot");
+}
+
+void AnalogInputsHandler::SaveFilters(void* Context) {
+    AnalogInputsHandler* Instance = reinterpret_cast<AnalogInputsHandler*>(Context);
+    size_t Count = min(Instance->AnalogInputs.size(), ANALOG_INPUTS_WARM_BOOT_MAX);
+    if (Count == 0) {
+        return;
+    }
+    float Values[ANALOG_INPUTS_WARM_BOOT_MAX];
+    for (size_t i = 0; i < Count; i++) {
+        Values[i] = Instance->AnalogInputs[i]->GetADCValue();
+    }
+    WarmBootStore::GetInstance().Save("analog", Values, Count * sizeof(float));
 }
 
 void AnalogInputsHandler::SetUpdatePeriod(unsigned long Period) {
@@ -73,9 +134,22 @@ void AnalogInputsHandler::SetUpdatePeriod(unsigned long Period) {
 
 void AnalogInputsHandler::AddInput(AnalogInputHandler* AnalogInput) {
     if (AnalogInput) {
+        InputMetrics.push_back(MetricsRegistry::GetInstance().AddGauge("analog_input_value", "Analog input in engineering units", "input=\"" + AnalogInput->GetName() + "\""));
         AnalogInputs.push_back(AnalogInput);
         LOG(INFO, LogName, AnalogInput->GetName() + " added");
     }
 }
 
+size_t AnalogInputsHandler::GetInputCount() {
+    return AnalogInputs.size();
+}
+
+AnalogInputHandler* AnalogInputsHandler::GetInput(size_t Index) {
+    return (Index < AnalogInputs.size()) ? AnalogInputs[Index] : nullptr;
+}
+
+uint32_t AnalogInputsHandler::GetScanCount() {
+    return ScanCount;
+}
+
 #endif // ANALOG_INPUTS_HANDLER
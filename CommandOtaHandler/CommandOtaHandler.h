@@ -2,9 +2,12 @@
 #define COMMAND_OTA_HANDLER_H
 
 #include <ArduinoOTA.h>
+#include <esp_timer.h>
 #include <System.h>
 #include <LoggerHandler.h>
 
+#define COMMAND_OTA_MAX_PAUSED_TASKS  8
+
 class CommandOtaHandler {
     private:
         String LogName = "CommandOtaHandler";
@@ -15,11 +18,25 @@ class CommandOtaHandler {
         unsigned int OtaPort = 3232;
         unsigned long ClockTime = 100; // milliseconds
 
+        // Update mode
+        int UpdateTaskPriority = 10;
+        TaskHandle_t PausedTasks[COMMAND_OTA_MAX_PAUSED_TASKS];
+        uint8_t PausedTasksCount = 0;
+        bool UpdateModeActive = false;
+        int64_t UpdateStartTime = 0;   // microseconds
+        unsigned int UpdateBytes = 0;
+        int64_t LastYieldTime = 0;     // microseconds
+        int64_t YieldPeriod = 100000;  // microseconds
+
         // Private variables
         bool UploadInProgress = false;
 
         unsigned int LastUpdateProgressSent = 0;
 
+        void EnterUpdateMode();
+        void ExitUpdateMode();
+        float GetThroughput();         // KB/s
+
         // Private function: Task loop for OTA management
         void CommandOtaHandlerTask(void* pvParameters);
 
@@ -32,6 +49,8 @@ class CommandOtaHandler {
         void SetHostname(const String& hostname);
         void SetPassword(const String& password);
         void SetPort(unsigned int port);
+        void SetUpdatePriority(int priority);
+        bool AddPausedTask(TaskHandle_t task);
 
         // Public functions
         void Start();
@@ -65,6 +84,62 @@ void CommandOtaHandler::SetPort(unsigned int port) {
     LOG(INFO, LogName, "Port is " + OtaPort);
 }
 
+void CommandOtaHandler::SetUpdatePriority(int priority) {
+    UpdateTaskPriority = priority;
+    LOG(INFO, LogName, "Update priority is " + String(UpdateTaskPriority));
+}
+
+// Registered tasks are suspended for the whole upload and resumed on end or
+// error. Only register tasks that never hold a lock the upload path needs.
+bool CommandOtaHandler::AddPausedTask(TaskHandle_t task) {
+    if ((task == NULL) || (PausedTasksCount >= COMMAND_OTA_MAX_PAUSED_TASKS)) {
+        LOG(ERROR, LogName, "Cannot register task to pause during updates");
+        return false;
+    }
+    PausedTasks[PausedTasksCount++] = task;
+    return true;
+}
+
+void CommandOtaHandler::EnterUpdateMode() {
+    if (UpdateModeActive) {
+        return;
+    }
+    UpdateModeActive = true;
+    UpdateStartTime = esp_timer_get_time();
+    LastYieldTime = UpdateStartTime;
+    UpdateBytes = 0;
+
+    vTaskPrioritySet(CommandOtaHandlerTaskPointer, UpdateTaskPriority);
+    for (uint8_t i = 0; i < PausedTasksCount; i++) {
+        if (PausedTasks[i] != CommandOtaHandlerTaskPointer) {
+            vTaskSuspend(PausedTasks[i]);
+        }
+    }
+    LOG(INFO, LogName, "Update mode entered, " + String(PausedTasksCount) + " tasks paused");
+}
+
+void CommandOtaHandler::ExitUpdateMode() {
+    if (!UpdateModeActive) {
+        return;
+    }
+    for (uint8_t i = 0; i < PausedTasksCount; i++) {
+        if (PausedTasks[i] != CommandOtaHandlerTaskPointer) {
+            vTaskResume(PausedTasks[i]);
+        }
+    }
+    vTaskPrioritySet(CommandOtaHandlerTaskPointer, CommandOtaHandlerTaskPriority);
+    UpdateModeActive = false;
+    LOG(INFO, LogName, "Update mode left, " + String(UpdateBytes / 1024) + " KB at " + String(GetThroughput(), 1) + " KB/s");
+}
+
+float CommandOtaHandler::GetThroughput() {
+    int64_t Elapsed = esp_timer_get_time() - UpdateStartTime;
+    if (Elapsed <= 0) {
+        return 0;
+    }
+    return (UpdateBytes / 1024.0f) / (Elapsed / 1000000.0f);
+}
+
 bool CommandOtaHandler::IsUploadInProgress()  {
     return UploadInProgress;
 }
@@ -84,18 +159,28 @@ void CommandOtaHandler::Start() {
         LastUpdateProgressSent = 0;
         String type = (ArduinoOTA.getCommand() == U_FLASH) ? "sketch" : "filesystem";
         LOG(INFO, LogName, "Update started" + type);
+        EnterUpdateMode();
     });
 
     ArduinoOTA.onEnd([this]() {
         UploadInProgress = false;
         LOG(INFO, LogName, "Update completed");
+        ExitUpdateMode();
     });
 
+    // handle() does not return until the upload is over: the raised priority
+    // task would starve the idle task on this core, so the callback yields
     ArduinoOTA.onProgress([this](unsigned int progress, unsigned int total) {
         unsigned int CurrentProgress = (progress * 100) / total;
+        UpdateBytes = progress;
+        int64_t Now = esp_timer_get_time();
+        if ((Now - LastYieldTime) >= YieldPeriod) {
+            LastYieldTime = Now;
+            vTaskDelay(1);
+        }
         if (((CurrentProgress % 5) == 0) && (CurrentProgress > LastUpdateProgressSent)) {
             LastUpdateProgressSent = CurrentProgress;
-            LOG(INFO, LogName, "Update progress: " + String(CurrentProgress));
+            LOG(INFO, LogName, "Update progress: " + String(CurrentProgress) + " (" + String(GetThroughput(), 1) + " KB/s)");
         }
     });
 
@@ -106,6 +191,8 @@ void CommandOtaHandler::Start() {
         else if (error == OTA_CONNECT_ERROR) LOG(ERROR, LogName, "Connect Failed");
         else if (error == OTA_RECEIVE_ERROR) LOG(ERROR, LogName, "Receive Failed");
         else if (error == OTA_END_ERROR)     LOG(ERROR, LogName, "End Failed");
+        UploadInProgress = false;
+        ExitUpdateMode();
     });
 
     LOG(INFO, LogName, "Configured");
@@ -126,6 +213,7 @@ void CommandOtaHandler::Start() {
 
 // Stop OTA management
 void CommandOtaHandler::Stop() {
+    ExitUpdateMode();
     if (CommandOtaHandlerTaskPointer != NULL) {
         LOG(INFO, LogName, "Task deleted");
         vTaskDelete(CommandOtaHandlerTaskPointer);
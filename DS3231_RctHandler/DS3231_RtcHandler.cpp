@@ -2,19 +2,41 @@
 
 DS3231_RtcHandler* DS3231_RtcHandler::StaticInstance = nullptr;
 
+static uint8_t BcdToBin(uint8_t value) { return value - 6 * (value >> 4); }
+static uint8_t BinToBcd(uint8_t value) { return value + 6 * (value / 10); }
+
 DS3231_RtcHandler::DS3231_RtcHandler() {
-    Wire.begin();
-    if (!Rtc.begin()) {
+    Bus.Begin();
+    Bus.RegisterDevice(DS3231_ADDRESS, "DS3231");
+
+    // Control and status are adjacent: the bus handler reads them in one transaction
+    uint8_t control = 0;
+    uint8_t status = 0;
+    I2CTransfer transfers[] = {
+        {DS3231_REG_CONTROL, &control, 1, false},
+        {DS3231_REG_STATUS,  &status,  1, false},
+    };
+    Present = Bus.Execute(DS3231_ADDRESS, transfers, 2);
+    BusReadCount++;
+
+    if (!Present) {
         LOG(ERROR, LogName, "DS3231 not found");
     } else {
         LOG(INFO, LogName, "RTC initialized");
-        if (Rtc.lostPower()) {
+        if (status & DS3231_STATUS_OSF) {
             LOG(WARNING, LogName, "RTC lost power, setting to compile time");
-            Rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
+            WriteTime(DateTime(F(__DATE__), F(__TIME__)));
+            TimeLost = true;
         }
     }
 }
 
+DS3231_RtcHandler::~DS3231_RtcHandler() {
+    if (SquareWaveEnabled) {
+        detachInterrupt(SquareWaveGpio);
+    }
+}
+
 DS3231_RtcHandler* DS3231_RtcHandler::GetInstance() {
     if (StaticInstance == nullptr) {
         StaticInstance = new DS3231_RtcHandler();
@@ -31,6 +53,7 @@ void DS3231_RtcHandler::Destroy() {
 
 void DS3231_RtcHandler::Enable() {
     Enabled = true;
+    RefreshTimeBase(true);
     LOG(INFO, LogName, "Enabled");
 }
 
@@ -43,32 +66,247 @@ bool DS3231_RtcHandler::IsEnabled() const {
     return Enabled;
 }
 
+void DS3231_RtcHandler::SetRefreshPeriod(unsigned long period) {
+    RefreshPeriod = period;
+    LOG(INFO, LogName, "Refresh period set to " + String(period) + " ms");
+}
+
+// With the 1 Hz square wave each falling edge marks a seconds update, so the
+// time base can be realigned in the ISR without touching the bus
+void DS3231_RtcHandler::EnableSquareWaveInterrupt(int gpio) {
+    if (!UpdateRegister(DS3231_REG_CONTROL, DS3231_CONTROL_INTCN | DS3231_CONTROL_RS, 0)) {
+        LOG(ERROR, LogName, "Failed to configure SQW output");
+        return;
+    }
+
+    SquareWaveGpio = gpio;
+    pinMode(SquareWaveGpio, INPUT_PULLUP);
+    attachInterruptArg(SquareWaveGpio, SquareWaveIsr, this, FALLING);
+    SquareWaveEnabled = true;
+    LOG(INFO, LogName, "SQW 1 Hz interrupt enabled on GPIO " + String(gpio));
+}
+
+void IRAM_ATTR DS3231_RtcHandler::SquareWaveIsr(void* arg) {
+    DS3231_RtcHandler* _this = reinterpret_cast<DS3231_RtcHandler*>(arg);
+    int64_t Now = esp_timer_get_time();
+    if (_this->IsTimeValid()) {
+        int64_t Interpolated = _this->GetEpochMicroseconds();
+        int64_t Second = ((Interpolated + 500000LL) / 1000000LL) * 1000000LL;
+        if (Second >= Interpolated) {
+            _this->SetTimeBase(Second, Now);
+        } else {
+            _this->SetTimeBase(Interpolated, Now, -DS3231_SLEW_RATE);
+        }
+    }
+    _this->SquareWaveCount++;
+}
+
 void DS3231_RtcHandler::SetDateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second) {
+    SetEpochTime(DateTime(year, month, day, hour, minute, second).unixtime());
+}
+
+void DS3231_RtcHandler::SetEpochTime(uint32_t epoch) {
     if (!Enabled) return;
-    DateTime dt(year, month, day, hour, minute, second);
-    Rtc.adjust(dt);
+    DateTime dt(epoch);
+    if (!WriteTime(dt)) {
+        LOG(ERROR, LogName, "Failed to set RTC time");
+        return;
+    }
+    SetTimeBaseFrom(dt);
+    LastReadTime = esp_timer_get_time();
+    TimeLost = false;
     LOG(INFO, LogName, "RTC time set to " + GetFormattedTime());
 }
 
+bool DS3231_RtcHandler::ReadEpochTime(uint32_t& epoch) {
+    if (!Enabled || TimeLost) return false;
+
+    uint8_t status = 0;
+    if (!ReadRegister(DS3231_REG_STATUS, status)) {
+        return false;
+    }
+    if (status & DS3231_STATUS_OSF) {
+        LOG(WARNING, LogName, "RTC oscillator stopped, time not valid");
+        TimeLost = true;
+        return false;
+    }
+
+    DateTime now;
+    if (!ReadTime(now) || !now.isValid()) {
+        return false;
+    }
+    epoch = now.unixtime();
+    return true;
+}
+
 DateTime DS3231_RtcHandler::GetDateTime() {
     if (!Enabled) return DateTime(static_cast<uint32_t>(0));
-    return Rtc.now();
+    RefreshTimeBase(false);
+    return DateTime(static_cast<uint32_t>(GetEpochTime()));
 }
 
 String DS3231_RtcHandler::GetFormattedTime(const String& format) {
     if (!Enabled) return "RTC Disabled";
 
-    DateTime now = Rtc.now();
+    RefreshTimeBase(false);
+    time_t now = GetEpochTime();
     char buffer[64];
 
     struct tm timeinfo;
-    timeinfo.tm_year = now.year() - 1900;
-    timeinfo.tm_mon  = now.month() - 1;
-    timeinfo.tm_mday = now.day();
-    timeinfo.tm_hour = now.hour();
-    timeinfo.tm_min  = now.minute();
-    timeinfo.tm_sec  = now.second();
+    gmtime_r(&now, &timeinfo);
 
     strftime(buffer, sizeof(buffer), format.c_str(), &timeinfo);
     return String(buffer);
 }
+
+// Temperature MSB and LSB are read in a single burst, resolution is 0.25 degC
+float DS3231_RtcHandler::GetTemperature() {
+    uint8_t data[2];
+    if (!Bus.ReadRegisters(DS3231_ADDRESS, DS3231_REG_TEMPERATURE, data, sizeof(data))) {
+        LOG(ERROR, LogName, "Failed to read temperature");
+        return NAN;
+    }
+    BusReadCount++;
+    return static_cast<int8_t>(data[0]) + (data[1] >> 6) * 0.25f;
+}
+
+// Alarm 1 fires every day at hour:minute:second; INTCN routes it to the INT/SQW pin
+void DS3231_RtcHandler::SetAlarm1(uint8_t hour, uint8_t minute, uint8_t second) {
+    uint8_t alarm[4] = {BinToBcd(second), BinToBcd(minute), BinToBcd(hour), 0x80};
+    if (!Bus.WriteRegisters(DS3231_ADDRESS, DS3231_REG_ALARM1, alarm, sizeof(alarm))) {
+        LOG(ERROR, LogName, "Failed to set alarm 1");
+        return;
+    }
+    BusWriteCount++;
+
+    if (SquareWaveEnabled) {
+        LOG(WARNING, LogName, "Alarm 1 takes over the INT/SQW pin, SQW interrupt disabled");
+        detachInterrupt(SquareWaveGpio);
+        SquareWaveEnabled = false;
+    }
+    ClearAlarm1();
+    UpdateRegister(DS3231_REG_CONTROL, DS3231_CONTROL_INTCN | DS3231_CONTROL_A1IE, DS3231_CONTROL_INTCN | DS3231_CONTROL_A1IE);
+    LOG(INFO, LogName, "Alarm 1 set to " + String(hour) + ":" + String(minute) + ":" + String(second));
+}
+
+void DS3231_RtcHandler::DisableAlarm1() {
+    UpdateRegister(DS3231_REG_CONTROL, DS3231_CONTROL_A1IE, 0);
+}
+
+bool DS3231_RtcHandler::IsAlarm1Fired() {
+    uint8_t status = 0;
+    return ReadRegister(DS3231_REG_STATUS, status) && (status & DS3231_STATUS_A1F);
+}
+
+void DS3231_RtcHandler::ClearAlarm1() {
+    UpdateRegister(DS3231_REG_STATUS, DS3231_STATUS_A1F, 0);
+}
+
+uint32_t DS3231_RtcHandler::GetBusReadCount() const {
+    return BusReadCount;
+}
+
+uint32_t DS3231_RtcHandler::GetBusWriteCount() const {
+    return BusWriteCount;
+}
+
+uint32_t DS3231_RtcHandler::GetSquareWaveCount() const {
+    return SquareWaveCount;
+}
+
+void DS3231_RtcHandler::SetTimeBaseFrom(const DateTime& dt) {
+    SetTimeBase(static_cast<int64_t>(dt.unixtime()) * 1000000LL, esp_timer_get_time());
+    Slewing = false;
+}
+
+// The RTC only reports whole seconds: the interpolated time is moved only when it
+// falls outside the second the RTC reports, which locks it to the seconds boundary.
+// Behind that second it steps forward, ahead of it it is slewed back
+void DS3231_RtcHandler::RefreshTimeBase(bool force) {
+    int64_t Now = esp_timer_get_time();
+    if (!force && IsTimeValid() && (SquareWaveEnabled || ((Now - LastReadTime) < static_cast<int64_t>(RefreshPeriod) * 1000LL))) {
+        return;
+    }
+
+    DateTime now;
+    if (!ReadTime(now)) {
+        LOG(ERROR, LogName, "Failed to read RTC time");
+        return;
+    }
+    Now = esp_timer_get_time();
+    LastReadTime = Now;
+
+    int64_t RtcTime = static_cast<int64_t>(now.unixtime()) * 1000000LL;
+    int64_t Interpolated = GetEpochMicroseconds();
+    if (!IsTimeValid() || (Interpolated < RtcTime)) {
+        SetTimeBase(RtcTime, Now);
+        Slewing = false;
+    } else if (Interpolated >= RtcTime + 1000000LL) {
+        SetTimeBase(Interpolated, Now, -DS3231_SLEW_RATE);
+        Slewing = true;
+    } else if (Slewing) {
+        SetTimeBase(Interpolated, Now);
+        Slewing = false;
+    }
+}
+
+bool DS3231_RtcHandler::ReadTime(DateTime& dt) {
+    uint8_t data[7];
+    if (!Bus.ReadRegisters(DS3231_ADDRESS, DS3231_REG_TIME, data, sizeof(data))) {
+        return false;
+    }
+    BusReadCount++;
+
+    uint8_t hour;
+    if (data[2] & 0x40) {
+        // 12 hour mode
+        hour = BcdToBin(data[2] & 0x1F) % 12 + ((data[2] & 0x20) ? 12 : 0);
+    } else {
+        hour = BcdToBin(data[2] & 0x3F);
+    }
+    dt = DateTime(2000 + BcdToBin(data[6]), BcdToBin(data[5] & 0x1F), BcdToBin(data[4] & 0x3F), hour, BcdToBin(data[1] & 0x7F), BcdToBin(data[0] & 0x7F));
+    return true;
+}
+
+bool DS3231_RtcHandler::WriteTime(const DateTime& dt) {
+    uint8_t dayOfWeek = dt.dayOfTheWeek();
+    uint8_t data[7] = {
+        BinToBcd(dt.second()),
+        BinToBcd(dt.minute()),
+        BinToBcd(dt.hour()),
+        BinToBcd(dayOfWeek == 0 ? 7 : dayOfWeek),
+        BinToBcd(dt.day()),
+        BinToBcd(dt.month()),
+        BinToBcd(dt.year() - 2000),
+    };
+    if (!Bus.WriteRegisters(DS3231_ADDRESS, DS3231_REG_TIME, data, sizeof(data))) {
+        return false;
+    }
+    BusWriteCount++;
+    return UpdateRegister(DS3231_REG_STATUS, DS3231_STATUS_OSF, 0);
+}
+
+bool DS3231_RtcHandler::ReadRegister(uint8_t reg, uint8_t& value) {
+    if (!Bus.ReadRegister(DS3231_ADDRESS, reg, value)) {
+        return false;
+    }
+    BusReadCount++;
+    return true;
+}
+
+bool DS3231_RtcHandler::WriteRegister(uint8_t reg, uint8_t value) {
+    if (!Bus.WriteRegister(DS3231_ADDRESS, reg, value)) {
+        return false;
+    }
+    BusWriteCount++;
+    return true;
+}
+
+bool DS3231_RtcHandler::UpdateRegister(uint8_t reg, uint8_t mask, uint8_t value) {
+    if (!Bus.UpdateRegister(DS3231_ADDRESS, reg, mask, value)) {
+        return false;
+    }
+    BusReadCount++;
+    BusWriteCount++;
+    return true;
+}
@@ -1,11 +1,30 @@
 #pragma once
 
 #include <Arduino.h>
-#include <Wire.h>
 #include <RTClib.h>
+#include "I2CBusHandler.h"
 #include "LoggerHandler.h"
 #include "DateTimeProvider.h"
 
+#define DS3231_ADDRESS            0x68
+#define DS3231_REG_TIME           0x00
+#define DS3231_REG_ALARM1         0x07
+#define DS3231_REG_CONTROL        0x0E
+#define DS3231_REG_STATUS         0x0F
+#define DS3231_REG_TEMPERATURE    0x11
+
+#define DS3231_CONTROL_A1IE       0x01
+#define DS3231_CONTROL_INTCN      0x04
+#define DS3231_CONTROL_RS         0x18
+#define DS3231_STATUS_A1F         0x01
+#define DS3231_STATUS_OSF         0x80
+
+#define DS3231_SLEW_RATE          500000       // ppb, as adjtime()
+
+// The RTC is read at most once per RefreshPeriod (or never, when the SQW 1 Hz
+// output is wired to an interrupt) and the CPU clock interpolates in between.
+// The interpolated time never runs backwards: when it is ahead of the RTC it is
+// slowed down by DS3231_SLEW_RATE until the RTC catches up.
 class DS3231_RtcHandler : public DateTimeProvider {
 public:
     static DS3231_RtcHandler* GetInstance();
@@ -15,17 +34,55 @@ public:
     void Disable();
     bool IsEnabled() const;
 
+    void SetRefreshPeriod(unsigned long period);
+    void EnableSquareWaveInterrupt(int gpio);
+
     void SetDateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second);
+    void SetEpochTime(uint32_t epoch);
     DateTime GetDateTime();
+    // Reads the chip, bypassing the interpolated time base: false when the bus
+    // transfer fails or the oscillator stopped and the time was not set since
+    bool ReadEpochTime(uint32_t& epoch);
+    float GetTemperature();
+
+    void SetAlarm1(uint8_t hour, uint8_t minute, uint8_t second);
+    void DisableAlarm1();
+    bool IsAlarm1Fired();
+    void ClearAlarm1();
     String GetFormattedTime(const String& format = "%d/%m/%Y %H:%M:%S") override;
 
+    uint32_t GetBusReadCount() const;
+    uint32_t GetBusWriteCount() const;
+    uint32_t GetSquareWaveCount() const;
+
 private:
     DS3231_RtcHandler();
-    ~DS3231_RtcHandler() = default;
+    ~DS3231_RtcHandler();
+
+    void SetTimeBaseFrom(const DateTime& dt);
+    bool ReadTime(DateTime& dt);
+    bool WriteTime(const DateTime& dt);
+    bool ReadRegister(uint8_t reg, uint8_t& value);
+    bool WriteRegister(uint8_t reg, uint8_t value);
+    bool UpdateRegister(uint8_t reg, uint8_t mask, uint8_t value);
+    void RefreshTimeBase(bool force);
+    static void IRAM_ATTR SquareWaveIsr(void* arg);
 
     static DS3231_RtcHandler* StaticInstance;
 
-    RTC_DS3231 Rtc;
+    I2CBusHandler& Bus = I2CBusHandler::GetInstance();
+    bool Present = false;
     bool Enabled = false;
+    bool TimeLost = false;                      // OSF was set, the time is a placeholder
     const String LogName = "RTC";
+
+    unsigned long RefreshPeriod = 1000;         // milliseconds
+    int64_t LastReadTime = 0;                   // esp_timer_get_time(), microseconds
+    int SquareWaveGpio = -1;
+    volatile bool SquareWaveEnabled = false;
+    bool Slewing = false;                       // the time base runs slow to let the RTC catch up
+
+    volatile uint32_t BusReadCount = 0;
+    volatile uint32_t BusWriteCount = 0;
+    volatile uint32_t SquareWaveCount = 0;
 };
@@ -1 +1,31 @@
-#include "DateTimeProvider.h"
\ No newline at end of file
+#include "DateTimeProvider.h"
+
+void IRAM_ATTR DateTimeProvider::SetTimeBase(int64_t EpochMicroseconds, int64_t Monotonic, int32_t FrequencyError) {
+    portENTER_CRITICAL_SAFE(&TimeBaseLock);
+    BaseEpoch = EpochMicroseconds;
+    BaseMonotonic = Monotonic;
+    BaseFrequencyError = FrequencyError;
+    TimeBaseValid = true;
+    portEXIT_CRITICAL_SAFE(&TimeBaseLock);
+}
+
+int64_t IRAM_ATTR DateTimeProvider::GetEpochMicroseconds() {
+    int64_t Now = esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&TimeBaseLock);
+    int64_t Elapsed = Now - BaseMonotonic;
+    int64_t Epoch = BaseEpoch + Elapsed + (Elapsed * BaseFrequencyError) / 1000000000LL;
+    portEXIT_CRITICAL_SAFE(&TimeBaseLock);
+    return Epoch;
+}
+
+time_t IRAM_ATTR DateTimeProvider::GetEpochTime() {
+    return static_cast<time_t>(GetEpochMicroseconds() / 1000000LL);
+}
+
+bool IRAM_ATTR DateTimeProvider::IsTimeValid() {
+    return TimeBaseValid;
+}
+
+int64_t IRAM_ATTR DateTimeProvider::GetMonotonicMicroseconds() {
+    return esp_timer_get_time();
+}
@@ -1,11 +1,30 @@
 #pragma once
 
 #include <Arduino.h>
+#include <esp_timer.h>
 
 class DateTimeProvider {
     public:
         virtual String GetFormattedTime(const String& format) = 0;
 
+        // Numeric clock: cached time base interpolated with esp_timer_get_time().
+        // No I/O and no allocation, safe to call from tasks and ISRs.
+        int64_t GetEpochMicroseconds();            // UTC, microseconds since 1970
+        time_t GetEpochTime();                     // UTC, seconds since 1970
+        bool IsTimeValid();
+        static int64_t GetMonotonicMicroseconds(); // microseconds since boot
+
         virtual ~DateTimeProvider() {}
-};
 
+    protected:
+        // Called by the concrete provider whenever it reads or disciplines its source.
+        // FrequencyError is the rate correction applied after Monotonic, in ppb.
+        void SetTimeBase(int64_t EpochMicroseconds, int64_t Monotonic, int32_t FrequencyError = 0);
+
+    private:
+        portMUX_TYPE TimeBaseLock = portMUX_INITIALIZER_UNLOCKED;
+        int64_t BaseEpoch = 0;              // microseconds since 1970 at BaseMonotonic
+        int64_t BaseMonotonic = 0;          // microseconds since boot
+        int32_t BaseFrequencyError = 0;     // ppb
+        bool TimeBaseValid = false;
+};
@@ -0,0 +1,49 @@
+#include "DeadlineTimer.h"
+
+DeadlineTimer::DeadlineTimer() {
+}
+
+void DeadlineTimer::Start(unsigned long Timeout) {
+    StartMicroseconds(static_cast<uint64_t>(Timeout) * MILLISECONDS_TO_MICROSECONDS);
+}
+
+void DeadlineTimer::StartMicroseconds(uint64_t Timeout) {
+    StartTime = esp_timer_get_time();
+    Deadline = StartTime + static_cast<int64_t>(Timeout);
+    Armed = true;
+}
+
+void DeadlineTimer::Stop() {
+    Armed = false;
+}
+
+bool DeadlineTimer::IsRunning() const {
+    return Armed && (esp_timer_get_time() < Deadline);
+}
+
+bool DeadlineTimer::IsExpired() const {
+    return !IsRunning();
+}
+
+unsigned long DeadlineTimer::GetRemainingTime() const {
+    return static_cast<unsigned long>(GetRemainingMicroseconds() / MILLISECONDS_TO_MICROSECONDS);
+}
+
+uint64_t DeadlineTimer::GetRemainingMicroseconds() const {
+    if (!Armed) {
+        return ZERO_TIME;
+    }
+    int64_t Remaining = Deadline - esp_timer_get_time();
+    return (Remaining > 0) ? static_cast<uint64_t>(Remaining) : ZERO_TIME;
+}
+
+unsigned long DeadlineTimer::GetElapsedTime() const {
+    return static_cast<unsigned long>(GetElapsedMicroseconds() / MILLISECONDS_TO_MICROSECONDS);
+}
+
+uint64_t DeadlineTimer::GetElapsedMicroseconds() const {
+    if (!Armed) {
+        return ZERO_TIME;
+    }
+    return static_cast<uint64_t>(esp_timer_get_time() - StartTime);
+}
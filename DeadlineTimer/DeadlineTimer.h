@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <System.h>
+
+// Monotonic deadline timer: Start() stores an absolute deadline taken from
+// esp_timer_get_time(), IsExpired() compares against it. Both are O(1) and the
+// result does not depend on how often (or how late) the owner polls it.
+// A timer that has never been started, or has been stopped, reads as expired.
+class DeadlineTimer {
+    public:
+        DeadlineTimer();
+
+        void Start(unsigned long Timeout);          // milliseconds
+        void StartMicroseconds(uint64_t Timeout);   // microseconds
+        void Stop();
+
+        bool IsRunning() const;
+        bool IsExpired() const;
+
+        unsigned long GetRemainingTime() const;     // milliseconds
+        uint64_t GetRemainingMicroseconds() const;
+        unsigned long GetElapsedTime() const;       // milliseconds
+        uint64_t GetElapsedMicroseconds() const;
+
+    private:
+        bool Armed = false;
+        int64_t StartTime = ZERO_TIME;  // microseconds
+        int64_t Deadline = ZERO_TIME;   // microseconds
+};
@@ -0,0 +1,156 @@
+#include "DigitalSignalBank.h"
+#include <soc/gpio_reg.h>
+
+DigitalSignalBank::DigitalSignalBank(uint8_t ChannelCount)
+    : ChannelCount(constrain(ChannelCount, 1, DIGITAL_SIGNAL_BANK_MAX_CHANNELS)) {
+    ChannelMask = (this->ChannelCount == 64) ? UINT64_MAX : ((1ULL << this->ChannelCount) - 1);
+    LOG(INFO, LogName, "Instance created with " + String(this->ChannelCount) + " channels");
+}
+
+DigitalSignalBank::~DigitalSignalBank() {
+    LOG(INFO, LogName, "Instance deleted");
+}
+
+void DigitalSignalBank::SetName(String name) {
+    Name = name;
+    LogName = "DigitalSignalBank - " + Name;
+    LOG(INFO, LogName, "Instance active");
+}
+
+String DigitalSignalBank::GetName() const {
+    return Name;
+}
+
+void DigitalSignalBank::SetGpioSource(uint64_t PinMask, uint8_t Mode) {
+    GpioMask = PinMask & ChannelMask;
+    for (uint8_t Pin = 0; Pin < ChannelCount; Pin++) {
+        if (GpioMask & (1ULL << Pin)) {
+            pinMode(Pin, Mode);
+        }
+    }
+    Source = SOURCE_GPIO;
+    Startup = true;
+    LOG(INFO, LogName, "GPIO source, mask 0x" + String(static_cast<uint32_t>(GpioMask >> 32), HEX) + String(static_cast<uint32_t>(GpioMask), HEX));
+}
+
+void DigitalSignalBank::SetShiftRegisterSource(uint8_t loadPin, uint8_t clockPin, uint8_t dataPin) {
+    LoadPin = loadPin;
+    ClockPin = clockPin;
+    DataPin = dataPin;
+    pinMode(LoadPin, OUTPUT);
+    pinMode(ClockPin, OUTPUT);
+    pinMode(DataPin, INPUT);
+    digitalWrite(LoadPin, HIGH);
+    digitalWrite(ClockPin, LOW);
+    Source = SOURCE_SHIFT_REGISTER;
+    Startup = true;
+    LOG(INFO, LogName, "Shift register source, load " + String(LoadPin) + ", clock " + String(ClockPin) + ", data " + String(DataPin));
+}
+
+void DigitalSignalBank::SetSource(BankReadCallback Callback, void* Context) {
+    ReadCallback = Callback;
+    ReadContext = Context;
+    Source = (Callback != nullptr) ? SOURCE_CALLBACK : SOURCE_NONE;
+    Startup = true;
+}
+
+void DigitalSignalBank::SetInvertMask(uint64_t Mask) {
+    InvertMask = Mask & ChannelMask;
+}
+
+void DigitalSignalBank::OnChange(BankChangeCallback Callback, void* Context) {
+    ChangeCallback = Callback;
+    ChangeContext = Context;
+}
+
+uint64_t DigitalSignalBank::Scan() {
+    if (Source == SOURCE_NONE) {
+        return 0;
+    }
+    return Update(Read());
+}
+
+// Per channel the counter (High, Low) advances 00 -> 01 -> 10 -> 11 -> 00 while
+// the sample differs from the state and is cleared as soon as it does not;
+// wrapping back to 00 flips the state.
+uint64_t DigitalSignalBank::Update(uint64_t Sample) {
+    Raw = (Sample ^ InvertMask) & ChannelMask;
+    ScanCount++;
+
+    uint64_t Changed;
+    if (Startup) {
+        State = Raw;
+        CounterLow = 0;
+        CounterHigh = 0;
+        Changed = ChannelMask;
+        Startup = false;
+    } else {
+        uint64_t Delta = Raw ^ State;
+        CounterHigh = (CounterHigh ^ CounterLow) & Delta;
+        CounterLow = ~CounterLow & Delta;
+        Changed = Delta & ~(CounterLow | CounterHigh);
+        State ^= Changed;
+    }
+
+    if (Changed && (ChangeCallback != nullptr)) {
+        ChangeCallback(ChangeContext, Changed, State);
+    }
+    return Changed;
+}
+
+uint8_t DigitalSignalBank::GetChannelCount() const {
+    return ChannelCount;
+}
+
+uint64_t DigitalSignalBank::GetState() const {
+    return State;
+}
+
+bool DigitalSignalBank::GetChannel(uint8_t Channel) const {
+    return (Channel < ChannelCount) && ((State >> Channel) & 1);
+}
+
+uint64_t DigitalSignalBank::GetRaw() const {
+    return Raw;
+}
+
+uint32_t DigitalSignalBank::GetScanCount() const {
+    return ScanCount;
+}
+
+uint64_t DigitalSignalBank::Read() {
+    switch (Source) {
+        case SOURCE_GPIO:
+            return ReadGpio();
+        case SOURCE_SHIFT_REGISTER:
+            return ReadShiftRegister();
+        case SOURCE_CALLBACK:
+            return ReadCallback(ReadContext);
+        default:
+            return 0;
+    }
+}
+
+// Two register reads cover every GPIO of the chip
+uint64_t DigitalSignalBank::ReadGpio() {
+    uint64_t Value = REG_READ(GPIO_IN_REG);
+#ifdef GPIO_IN1_REG
+    Value |= static_cast<uint64_t>(REG_READ(GPIO_IN1_REG)) << 32;
+#endif
+    return Value & GpioMask;
+}
+
+uint64_t DigitalSignalBank::ReadShiftRegister() {
+    digitalWrite(LoadPin, LOW);     // parallel load
+    digitalWrite(LoadPin, HIGH);
+
+    uint64_t Value = 0;
+    for (uint8_t Channel = 0; Channel < ChannelCount; Channel++) {
+        if (digitalRead(DataPin)) {
+            Value |= (1ULL << Channel);
+        }
+        digitalWrite(ClockPin, HIGH);
+        digitalWrite(ClockPin, LOW);
+    }
+    return Value;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LoggerHandler.h>
+
+#define DIGITAL_SIGNAL_BANK_MAX_CHANNELS  64
+
+// Return the raw input word, bit n being channel n
+typedef uint64_t (*BankReadCallback)(void* Context);
+// Changed holds the channels whose debounced state flipped in this scan
+typedef void (*BankChangeCallback)(void* Context, uint64_t Changed, uint64_t State);
+
+// Debounces up to 64 inputs at once with a 2-bit vertical counter: every
+// channel owns one bit in each of two counter words, so a scan is a few
+// bitwise operations on the whole word whatever the number of channels.
+// A channel flips after differing from its debounced state for 4 consecutive
+// scans; any sample equal to the state resets its counter. The debounce time
+// is therefore 4 scan periods, set by how often the owner calls Scan().
+class DigitalSignalBank {
+    public:
+        DigitalSignalBank(uint8_t ChannelCount = DIGITAL_SIGNAL_BANK_MAX_CHANNELS);
+        ~DigitalSignalBank();
+
+        void SetName(String name);
+        String GetName() const;
+
+        // Channel n is GPIO n, only the pins in PinMask are used
+        void SetGpioSource(uint64_t PinMask, uint8_t Mode = INPUT);
+        // 74HC165 chain: the first bit shifted out is channel 0
+        void SetShiftRegisterSource(uint8_t LoadPin, uint8_t ClockPin, uint8_t DataPin);
+        void SetSource(BankReadCallback Callback, void* Context = nullptr);
+        void SetInvertMask(uint64_t Mask);   // e.g. contacts closing to ground
+        void OnChange(BankChangeCallback Callback, void* Context = nullptr);
+
+        // Reads the source and debounces it, returns the changed channels
+        uint64_t Scan();
+        // Debounces a raw word obtained elsewhere
+        uint64_t Update(uint64_t Raw);
+
+        uint8_t GetChannelCount() const;
+        uint64_t GetState() const;
+        bool GetChannel(uint8_t Channel) const;
+        uint64_t GetRaw() const;
+        uint32_t GetScanCount() const;
+
+    private:
+        enum BankSourceEnum {
+            SOURCE_NONE,
+            SOURCE_GPIO,
+            SOURCE_SHIFT_REGISTER,
+            SOURCE_CALLBACK
+        };
+
+        String LogName = "DigitalSignalBank";
+        String Name = "";
+
+        uint8_t ChannelCount;
+        uint64_t ChannelMask;
+        uint64_t InvertMask = 0;
+
+        BankSourceEnum Source = SOURCE_NONE;
+        uint64_t GpioMask = 0;
+        uint8_t LoadPin = 0;
+        uint8_t ClockPin = 0;
+        uint8_t DataPin = 0;
+        BankReadCallback ReadCallback = nullptr;
+        void* ReadContext = nullptr;
+
+        BankChangeCallback ChangeCallback = nullptr;
+        void* ChangeContext = nullptr;
+
+        bool Startup = true;
+        uint64_t Raw = 0;
+        uint64_t State = 0;
+        uint64_t CounterLow = 0;
+        uint64_t CounterHigh = 0;
+        uint32_t ScanCount = 0;
+
+        uint64_t Read();
+        uint64_t ReadGpio();
+        uint64_t ReadShiftRegister();
+};
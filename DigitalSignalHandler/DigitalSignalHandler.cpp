@@ -1,4 +1,10 @@
 #include "DigitalSignalHandler.h"
+#include <hal/gpio_ll.h>
+#include <MetricsRegistry.h>
+
+QueueHandle_t DigitalSignalHandler::DispatchQueue = nullptr;
+TaskHandle_t DigitalSignalHandler::DispatchTaskPointer = nullptr;
+int DigitalSignalHandler::DispatchTaskPriority = 3;
 
 DigitalSignalHandler::DigitalSignalHandler() {
     LOG(INFO, LogName, "Instance created");
@@ -9,6 +15,7 @@ DigitalSignalHandler::DigitalSignalHandler() {
 }
 
 DigitalSignalHandler::~DigitalSignalHandler() {
+    DetachInterrupt();
     LOG(INFO, LogName, "Instance deleted");
 }
 
@@ -18,6 +25,10 @@ void DigitalSignalHandler::SetName(String name) {
     LOG(INFO, LogName, "Instance active");
 }
 
+String DigitalSignalHandler::GetName() const {
+    return Name;
+}
+
 void DigitalSignalHandler::Enable() {
     LOG(INFO, LogName, "Enabled");
     Enabled = true;
@@ -30,12 +41,12 @@ void DigitalSignalHandler::Disable() {
 }
 
 void DigitalSignalHandler::SetRisingEdgeFilterTime(unsigned long filterTime) {
-    RisingEdgeFilterTime = filterTime;
+    RisingEdgeFilterTime = static_cast<uint64_t>(filterTime) * 1000;
     LOG(INFO, LogName, "Rising edge filter set to " + String(filterTime) + " ms");
 }
 
 void DigitalSignalHandler::SetFallingEdgeFilterTime(unsigned long filterTime) {
-    FallingEdgeFilterTime = filterTime;
+    FallingEdgeFilterTime = static_cast<uint64_t>(filterTime) * 1000;
     LOG(INFO, LogName, "Falling edge filter set to " + String(filterTime) + " ms");
 }
 
@@ -51,6 +62,95 @@ void DigitalSignalHandler::OnFallingEdge(EdgeCallback callback) {
     FallingEdgeCallback = callback;
 }
 
+void DigitalSignalHandler::OnRisingEdge(EdgeContextCallback callback, void* context) {
+    RisingEdgeContextCallback = callback;
+    RisingEdgeContext = context;
+}
+
+void DigitalSignalHandler::OnFallingEdge(EdgeContextCallback callback, void* context) {
+    FallingEdgeContextCallback = callback;
+    FallingEdgeContext = context;
+}
+
+bool DigitalSignalHandler::EnableDispatch() {
+    if (DispatchQueue == nullptr) {
+        DispatchQueue = xQueueCreate(DIGITAL_SIGNAL_DISPATCH_QUEUE_SIZE, sizeof(DispatchEvent));
+        if (DispatchQueue == nullptr) {
+            LOG(ERROR, LogName, "Failed to create dispatch queue");
+            return false;
+        }
+        xTaskCreatePinnedToCore(DispatchTask, "DigitalSignalDispatchTask", 4096, nullptr, DispatchTaskPriority, &DispatchTaskPointer, 1);
+        MetricsRegistry::GetInstance().AddTask("DigitalSignalDispatchTask", DispatchTaskPointer);
+    }
+    DispatchEnabled = true;
+    LOG(INFO, LogName, "Dispatch enabled");
+    return true;
+}
+
+void DigitalSignalHandler::DisableDispatch() {
+    DispatchEnabled = false;
+    LOG(INFO, LogName, "Dispatch disabled");
+}
+
+uint32_t DigitalSignalHandler::GetDroppedEventCount() const {
+    return DroppedEvents.load(std::memory_order_relaxed);
+}
+
+void DigitalSignalHandler::SetEdgeLogging(bool enabled) {
+    EdgeLogging = enabled;
+}
+
+uint32_t DigitalSignalHandler::GetRawEdgeCount() const {
+    return RawEdgeCount;
+}
+
+uint32_t DigitalSignalHandler::GetFilteredEdgeCount() const {
+    return FilteredEdgeCount;
+}
+
+void DigitalSignalHandler::DispatchTask(void* pvParameters) {
+    DispatchEvent Event;
+    while (true) {
+        if (xQueueReceive(DispatchQueue, &Event, portMAX_DELAY) == pdTRUE) {
+            Event.Signal->InvokeCallbacks(Event.Rising, Event.Timestamp);
+        }
+    }
+}
+
+// Never blocks the filter: with a full queue the event is dropped and counted
+void DigitalSignalHandler::FireEdge(bool Rising, uint64_t Timestamp) {
+    FilteredEdgeCount++;
+    if (DispatchEnabled) {
+        DispatchEvent Event = {this, Timestamp, Rising};
+        if (xQueueSend(DispatchQueue, &Event, 0) != pdTRUE) {
+            DroppedEvents.fetch_add(1, std::memory_order_relaxed);
+        }
+    } else {
+        InvokeCallbacks(Rising, Timestamp);
+    }
+}
+
+void DigitalSignalHandler::InvokeCallbacks(bool Rising, uint64_t Timestamp) {
+    if (Rising) {
+        if (RisingEdgeCallback != nullptr) {
+            RisingEdgeCallback();
+        }
+        if (RisingEdgeContextCallback != nullptr) {
+            RisingEdgeContextCallback(RisingEdgeContext, this, Timestamp);
+        }
+    } else {
+        if (FallingEdgeCallback != nullptr) {
+            FallingEdgeCallback();
+        }
+        if (FallingEdgeContextCallback != nullptr) {
+            FallingEdgeContextCallback(FallingEdgeContext, this, Timestamp);
+        }
+    }
+    if (EdgeLogging) {
+        LOG(INFO, LogName, Rising ? "OUTPUT Rising edge detected" : "OUTPUT Falling edge detected");
+    }
+}
+
 bool DigitalSignalHandler::GetSignal() const {
     return PreviousInputValue;
 }
@@ -59,59 +159,140 @@ bool DigitalSignalHandler::GetFilteredSignal() const {
     return FilteredOutputValue;
 }
 
+bool DigitalSignalHandler::AttachInterrupt(uint8_t Pin, uint8_t Mode) {
+    DetachInterrupt();
+    EdgeQueueHead.store(0);
+    EdgeQueueTail.store(0);
+    DroppedEdges.store(0);
+    ProcessedDroppedEdges = 0;
+
+    pinMode(Pin, Mode);
+    InterruptPin = Pin;
+    attachInterruptArg(digitalPinToInterrupt(Pin), EdgeIsr, this, CHANGE);
+    LOG(INFO, LogName, "Interrupt mode on pin " + String(Pin));
+    return true;
+}
+
+void DigitalSignalHandler::DetachInterrupt() {
+    if (InterruptPin < 0) {
+        return;
+    }
+    detachInterrupt(digitalPinToInterrupt(InterruptPin));
+    InterruptPin = -1;
+}
+
+void IRAM_ATTR DigitalSignalHandler::EdgeIsr(void* Arg) {
+    DigitalSignalHandler* Instance = reinterpret_cast<DigitalSignalHandler*>(Arg);
+    uint64_t Timestamp = esp_timer_get_time();
+    bool Level = gpio_ll_get_level(&GPIO, static_cast<gpio_num_t>(Instance->InterruptPin));
+
+    uint32_t Head = Instance->EdgeQueueHead.load(std::memory_order_relaxed);
+    uint32_t Tail = Instance->EdgeQueueTail.load(std::memory_order_acquire);
+    if ((Head - Tail) >= DIGITAL_SIGNAL_EDGE_QUEUE_SIZE) {
+        Instance->DroppedEdges.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    DigitalSignalEdge& Edge = Instance->EdgeQueue[Head & (DIGITAL_SIGNAL_EDGE_QUEUE_SIZE - 1)];
+    Edge.Timestamp = Timestamp;
+    Edge.Level = Level;
+    Instance->EdgeQueueHead.store(Head + 1, std::memory_order_release);
+}
+
+// Each edge is fed as two samples: the previous level, held up to the edge,
+// then the new level from the edge on. A last sample of the current level at
+// the current time lets pending filter times elapse between edges.
+void DigitalSignalHandler::Process() {
+    if (InterruptPin < 0) {
+        return;
+    }
+
+    uint64_t Now = esp_timer_get_time();
+    uint32_t Tail = EdgeQueueTail.load(std::memory_order_relaxed);
+    uint32_t Head = EdgeQueueHead.load(std::memory_order_acquire);
+
+    if (Startup) {
+        // The sampled level supersedes whatever was queued before the first run
+        EdgeQueueTail.store(Head, std::memory_order_release);
+        Update(digitalRead(InterruptPin), Now);
+        return;
+    }
+
+    while (Tail != Head) {
+        DigitalSignalEdge Edge = EdgeQueue[Tail & (DIGITAL_SIGNAL_EDGE_QUEUE_SIZE - 1)];
+        EdgeQueueTail.store(++Tail, std::memory_order_release);
+
+        if (Edge.Level != PreviousInputValue) {
+            Update(PreviousInputValue, Edge.Timestamp);
+        }
+        Update(Edge.Level, Edge.Timestamp);
+        Now = max(Now, Edge.Timestamp);
+    }
+
+    // Edges were lost while the ring was full, the last of them may have
+    // settled the input: the pin level at Now is the only reliable one left
+    uint32_t Dropped = DroppedEdges.load(std::memory_order_relaxed);
+    if (Dropped != ProcessedDroppedEdges) {
+        ProcessedDroppedEdges = Dropped;
+        bool Level = digitalRead(InterruptPin);
+        if (Level != PreviousInputValue) {
+            Update(PreviousInputValue, Now);
+        }
+        Update(Level, Now);
+        return;
+    }
+
+    Update(PreviousInputValue, Now);
+}
+
+uint32_t DigitalSignalHandler::GetDroppedEdgeCount() const {
+    return DroppedEdges.load(std::memory_order_relaxed);
+}
+
 void DigitalSignalHandler::Update(bool inputValue) {
+    Update(inputValue, esp_timer_get_time());
+}
+
+void DigitalSignalHandler::Update(bool inputValue, uint64_t currentTime) {
     if (!Enabled) {
         return;
     }
 
-    unsigned long currentTime = millis();
-
     if (Startup) {
         PreviousInputValue = inputValue;
         FilteredOutputValue = inputValue;
 
         if (inputValue) {
             LastInputValueActiveTime = currentTime;
-            if (RisingEdgeCallback != nullptr) {
-                RisingEdgeCallback();
-            }
         } else {
             LastInputValueInactiveTime = currentTime;
-            if (FallingEdgeCallback != nullptr) {
-                FallingEdgeCallback();
-            }
         }
 
         LOG(INFO, LogName, "Startup - Input: " + String(inputValue) + ", Output: " + String(FilteredOutputValue));
         Startup = false;
+        FireEdge(inputValue, currentTime);
         return;
     }
 
-    if (inputValue && !PreviousInputValue) {
-        LOG(INFO, LogName, "INPUT Rising edge detected");
-    } else if (!inputValue && PreviousInputValue) {
-        LOG(INFO, LogName, "INPUT Falling edge detected");
+    // Raw edges are only counted, logging them would cost more than the filter
+    if (inputValue != PreviousInputValue) {
+        RawEdgeCount++;
     }
 
     PreviousInputValue = inputValue;
 
+    // The filtered edge happens when the level has been held for the filter
+    // time, not when a later sample notices it
     if (inputValue) {
         LastInputValueActiveTime = currentTime;
         if (!FilteredOutputValue && ((currentTime - LastInputValueInactiveTime) >= RisingEdgeFilterTime)) {
             FilteredOutputValue = true;
-            if (RisingEdgeCallback != nullptr) {
-                RisingEdgeCallback();
-            }
-            LOG(INFO, LogName, "OUTPUT Rising edge detected");
+            FireEdge(true, LastInputValueInactiveTime + RisingEdgeFilterTime);
         }
     } else {
         LastInputValueInactiveTime = currentTime;
         if (FilteredOutputValue && ((currentTime - LastInputValueActiveTime) >= FallingEdgeFilterTime)) {
             FilteredOutputValue = false;
-            if (FallingEdgeCallback != nullptr) {
-                FallingEdgeCallback();
-            }
-            LOG(INFO, LogName, "OUTPUT Falling edge detected");
+            FireEdge(false, LastInputValueActiveTime + FallingEdgeFilterTime);
         }
     }
 }
@@ -2,9 +2,23 @@
 
 #include <Arduino.h>
 #include <functional>
+#include <atomic>
+#include <esp_timer.h>
 #include <LoggerHandler.h>
 
+#define DIGITAL_SIGNAL_EDGE_QUEUE_SIZE       32   // edges, power of two
+#define DIGITAL_SIGNAL_DISPATCH_QUEUE_SIZE   32   // events, shared by all instances
+
+class DigitalSignalHandler;
+
 typedef void (*EdgeCallback)();
+// Timestamp is the esp_timer_get_time() at which the edge passed the filter
+typedef void (*EdgeContextCallback)(void* Context, DigitalSignalHandler* Signal, uint64_t Timestamp);
+
+struct DigitalSignalEdge {
+    uint64_t Timestamp;   // microseconds, esp_timer_get_time()
+    bool Level;
+};
 
 class DigitalSignalHandler {
     public:
@@ -13,6 +27,7 @@ class DigitalSignalHandler {
         ~DigitalSignalHandler();
 
         void SetName(String name);
+        String GetName() const;
 
         void Enable();
         void Disable();
@@ -20,6 +35,19 @@ class DigitalSignalHandler {
 
         void OnRisingEdge(EdgeCallback callback);
         void OnFallingEdge(EdgeCallback callback);
+        void OnRisingEdge(EdgeContextCallback callback, void* context);
+        void OnFallingEdge(EdgeContextCallback callback, void* context);
+
+        // Callbacks run in one shared dispatch task instead of the caller of
+        // Update()/Process(), so they cannot delay the filter. The handler must
+        // outlive its queued events.
+        bool EnableDispatch();
+        void DisableDispatch();
+        uint32_t GetDroppedEventCount() const;
+
+        void SetEdgeLogging(bool enabled);
+        uint32_t GetRawEdgeCount() const;
+        uint32_t GetFilteredEdgeCount() const;
 
         void SetRisingEdgeFilterTime(unsigned long filterTime);
         void SetFallingEdgeFilterTime(unsigned long filterTime);
@@ -28,6 +56,16 @@ class DigitalSignalHandler {
         bool GetFilteredSignal() const;
 
         void Update(bool CurrentValue);
+        // Core filter, also usable with recorded or synthetic samples
+        void Update(bool CurrentValue, uint64_t Timestamp);
+
+        // Interrupt mode: the ISR only queues timestamped edges, Process() runs the
+        // filter on them in task context and must be called periodically, so that
+        // filter times elapse even when no edge comes in
+        bool AttachInterrupt(uint8_t Pin, uint8_t Mode = INPUT);
+        void DetachInterrupt();
+        void Process();
+        uint32_t GetDroppedEdgeCount() const;
 
     private:
 
@@ -43,12 +81,46 @@ class DigitalSignalHandler {
 
         EdgeCallback RisingEdgeCallback = nullptr;
         EdgeCallback FallingEdgeCallback = nullptr;
-
-        unsigned long RisingEdgeFilterTime;
-        unsigned long FallingEdgeFilterTime;
-
-        unsigned long LastInputValueActiveTime;
-        unsigned long LastInputValueInactiveTime;
+        EdgeContextCallback RisingEdgeContextCallback = nullptr;
+        EdgeContextCallback FallingEdgeContextCallback = nullptr;
+        void* RisingEdgeContext = nullptr;
+        void* FallingEdgeContext = nullptr;
+
+        bool DispatchEnabled = false;
+        bool EdgeLogging = false;
+        uint32_t RawEdgeCount = 0;
+        uint32_t FilteredEdgeCount = 0;
+        std::atomic<uint32_t> DroppedEvents{0};
+
+        uint64_t RisingEdgeFilterTime;         // microseconds
+        uint64_t FallingEdgeFilterTime;        // microseconds
+
+        uint64_t LastInputValueActiveTime;     // microseconds
+        uint64_t LastInputValueInactiveTime;   // microseconds
+
+        // Interrupt mode, single producer (ISR) single consumer (Process) ring
+        int16_t InterruptPin = -1;
+        DigitalSignalEdge EdgeQueue[DIGITAL_SIGNAL_EDGE_QUEUE_SIZE];
+        std::atomic<uint32_t> EdgeQueueHead{0};
+        std::atomic<uint32_t> EdgeQueueTail{0};
+        std::atomic<uint32_t> DroppedEdges{0};
+        uint32_t ProcessedDroppedEdges = 0;
+
+        static void IRAM_ATTR EdgeIsr(void* Arg);
+
+        struct DispatchEvent {
+            DigitalSignalHandler* Signal;
+            uint64_t Timestamp;
+            bool Rising;
+        };
+
+        static QueueHandle_t DispatchQueue;
+        static TaskHandle_t DispatchTaskPointer;
+        static int DispatchTaskPriority;
+
+        static void DispatchTask(void* pvParameters);
+        void FireEdge(bool Rising, uint64_t Timestamp);
+        void InvokeCallbacks(bool Rising, uint64_t Timestamp);
 
 };
 
@@ -0,0 +1,192 @@
+#include "FailoverTimeProvider.h"
+#include "LoggerHandler.h"
+
+FailoverTimeProvider* FailoverTimeProvider::StaticInstance = nullptr;
+
+FailoverTimeProvider::FailoverTimeProvider() {
+    LOG(INFO, LogName, "Instance created");
+    xTaskCreatePinnedToCore(HandlerTaskStatic, "Failover_TimeTask", 4096, this, HandlerTaskPriority, &HandlerTaskPointer, 1);
+    LOG(INFO, LogName, "Handler task created");
+}
+
+FailoverTimeProvider* FailoverTimeProvider::GetInstance() {
+    if (StaticInstance == nullptr) {
+        StaticInstance = new FailoverTimeProvider();
+    }
+    return StaticInstance;
+}
+
+void FailoverTimeProvider::Destroy() {
+    if (StaticInstance) {
+        if (StaticInstance->HandlerTaskPointer != nullptr) {
+            vTaskDelete(StaticInstance->HandlerTaskPointer);
+        }
+        delete StaticInstance;
+        StaticInstance = nullptr;
+    }
+}
+
+void FailoverTimeProvider::SetSources(NtpHandler* NtpSource, DS3231_RtcHandler* RtcSource) {
+    Ntp = NtpSource;
+    Rtc = RtcSource;
+}
+
+void FailoverTimeProvider::SetGmtOffset(int GmtOffsetHours) {
+    GmtOffset = GmtOffsetHours * 3600;
+    LOG(INFO, LogName, "GMT offset set to " + String(GmtOffsetHours) + " hours");
+}
+
+void FailoverTimeProvider::SetRtcWritebackPeriod(unsigned long Period) {
+    RtcWritebackPeriod = Period;
+    LOG(INFO, LogName, "RTC writeback period set to " + String(Period) + " ms");
+}
+
+void FailoverTimeProvider::Enable() {
+    Enabled = true;
+    LOG(INFO, LogName, "Enabled");
+}
+
+void FailoverTimeProvider::Disable() {
+    Enabled = false;
+    LOG(INFO, LogName, "Disabled");
+}
+
+bool FailoverTimeProvider::IsSynchronizedToNtp() {
+    return Source == NTP_SOURCE;
+}
+
+uint32_t FailoverTimeProvider::GetFailoverCount() {
+    return FailoverCount;
+}
+
+uint32_t FailoverTimeProvider::GetRtcReadCount() {
+    return RtcReadCount;
+}
+
+uint32_t FailoverTimeProvider::GetRtcWriteCount() {
+    return RtcWriteCount;
+}
+
+String FailoverTimeProvider::GetFormattedTime(const String& Format) {
+    time_t RawTime = GetEpochTime() + GmtOffset;
+    struct tm TimeInfo;
+    gmtime_r(&RawTime, &TimeInfo);
+    char Buffer[64];
+    strftime(Buffer, sizeof(Buffer), Format.c_str(), &TimeInfo);
+    return String(Buffer);
+}
+
+// Read the RTC once. Unless forced, the free running clock is kept when it agrees
+// with the RTC, so a failover does not make the time jump back to whole seconds.
+// A failed read, a stopped oscillator or an implausible time leaves the clock
+// untouched and the RTC is not adopted as source.
+bool FailoverTimeProvider::LoadFromRtc(bool Force) {
+    if ((Rtc == nullptr) || !Rtc->IsEnabled()) {
+        return false;
+    }
+
+    int64_t Now = esp_timer_get_time();
+    uint32_t RtcSeconds = 0;
+    bool Valid = Rtc->ReadEpochTime(RtcSeconds);
+    RtcReadCount++;
+    if (!Valid || (RtcSeconds < FAILOVER_MIN_VALID_EPOCH)) {
+        LOG(WARNING, LogName, "RTC time not valid, retry in " + String(RtcRetryPeriod) + " ms");
+        RtcRetryTimer.Start(RtcRetryPeriod);
+        return false;
+    }
+    int64_t RtcEpoch = static_cast<int64_t>(RtcSeconds) * SECONDS_TO_MICROSECONDS;
+
+    int64_t Deviation = RtcEpoch - GetEpochMicroseconds();
+    if (Force || !IsTimeValid() || (Deviation > RtcMaxDeviation) || (Deviation < -RtcMaxDeviation)) {
+        SetTimeBase(RtcEpoch, Now);
+        LOG(INFO, LogName, "Time loaded from RTC: " + GetFormattedTime());
+    } else {
+        LOG(INFO, LogName, "RTC agrees with the running clock (" + String(static_cast<long>(Deviation / MILLISECONDS_TO_MICROSECONDS)) + " ms), keeping it");
+    }
+    Source = RTC_SOURCE;
+    return true;
+}
+
+// The NTP frequency estimate is copied too, so the clock keeps its drift compensation after a failover
+void FailoverTimeProvider::FollowNtp() {
+    int64_t Now = esp_timer_get_time();
+    SetTimeBase(Ntp->GetEpochMicroseconds(), Now, static_cast<int32_t>(Ntp->GetFrequencyError() * 1000));
+}
+
+// The DS3231 restarts its seconds countdown when written, so write on a second boundary
+void FailoverTimeProvider::WriteBackToRtc() {
+    if ((Rtc == nullptr) || !Rtc->IsEnabled()) {
+        return;
+    }
+
+    int64_t Fraction = GetEpochMicroseconds() % SECONDS_TO_MICROSECONDS;
+    vTaskDelay(pdMS_TO_TICKS((SECONDS_TO_MICROSECONDS - Fraction) / MILLISECONDS_TO_MICROSECONDS));
+
+    Rtc->SetEpochTime(static_cast<uint32_t>((GetEpochMicroseconds() + SECONDS_TO_MICROSECONDS / 2) / SECONDS_TO_MICROSECONDS));
+    RtcWriteCount++;
+}
+
+void FailoverTimeProvider::HandlerTaskStatic(void* pvParameters) {
+    FailoverTimeProvider* instance = reinterpret_cast<FailoverTimeProvider*>(pvParameters);
+    instance->HandlerTask();
+}
+
+void FailoverTimeProvider::HandlerTask() {
+    TickType_t StartTick, ExecutionTick, TaskTickPeriod;
+    TaskTickPeriod = TaskPeriodMs / portTICK_PERIOD_MS;
+
+    while (true) {
+        StartTick = xTaskGetTickCount();
+
+        if (Enabled) {
+            bool NtpAvailable = (Ntp != nullptr) && Ntp->IsConnected() && Ntp->IsTimeValid();
+
+            switch (Source) {
+                case NO_SOURCE:
+                    if (NtpAvailable) {
+                        FollowNtp();
+                        LOG(INFO, LogName, "Time source is NTP");
+                        WriteBackToRtc();
+                        RtcWritebackTimer.Start(RtcWritebackPeriod);
+                        Source = NTP_SOURCE;
+                    } else if (RtcRetryTimer.IsExpired()) {
+                        // After a failed failover the clock keeps running from the last NTP time base
+                        LoadFromRtc(!IsTimeValid());
+                    }
+                    break;
+
+                case RTC_SOURCE:
+                    if (NtpAvailable) {
+                        int64_t Correction = Ntp->GetEpochMicroseconds() - GetEpochMicroseconds();
+                        FollowNtp();
+                        LOG(INFO, LogName, "Time source is NTP, correction " + String(static_cast<long>(Correction / MILLISECONDS_TO_MICROSECONDS)) + " ms");
+                        WriteBackToRtc();
+                        RtcWritebackTimer.Start(RtcWritebackPeriod);
+                        Source = NTP_SOURCE;
+                    }
+                    break;
+
+                case NTP_SOURCE:
+                    if (!NtpAvailable) {
+                        FailoverCount++;
+                        LOG(WARNING, LogName, "NTP lost, failing over to RTC");
+                        if (!LoadFromRtc(false)) {
+                            Source = NO_SOURCE;
+                        }
+                    } else {
+                        FollowNtp();
+                        if (RtcWritebackTimer.IsExpired()) {
+                            WriteBackToRtc();
+                            RtcWritebackTimer.Start(RtcWritebackPeriod);
+                        }
+                    }
+                    break;
+            }
+        }
+
+        ExecutionTick = xTaskGetTickCount() - StartTick;
+        if (ExecutionTick < TaskTickPeriod) {
+            vTaskDelay(TaskTickPeriod - ExecutionTick);
+        }
+    }
+}
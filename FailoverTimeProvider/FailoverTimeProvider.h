@@ -0,0 +1,68 @@
+#pragma once
+
+#include <System.h>
+#include <DeadlineTimer.h>
+#include "DateTimeProvider.h"
+#include "NTPHandler.h"
+#include "DS3231_RtcHandler.h"
+
+#define FAILOVER_MIN_VALID_EPOCH  1704067200UL  // 2024-01-01, an older RTC time is not plausible
+
+// Serves time from a single in-memory clock (the DateTimeProvider time base).
+// The clock follows NtpHandler while it is synchronized and periodically writes
+// the time back to the DS3231; the RTC is read only at startup and when NTP is lost.
+// The RTC is kept in UTC, the GMT offset is applied only when formatting.
+class FailoverTimeProvider : public DateTimeProvider {
+private:
+    String LogName = "FailoverTimeProvider";
+
+    enum TimeSourceEnum {
+        NO_SOURCE,
+        RTC_SOURCE,
+        NTP_SOURCE
+    };
+
+    NtpHandler* Ntp = nullptr;
+    DS3231_RtcHandler* Rtc = nullptr;
+
+    TaskHandle_t HandlerTaskPointer = nullptr;
+    int HandlerTaskPriority = 3;
+    unsigned long TaskPeriodMs       = 1000;     // milliseconds
+    unsigned long RtcWritebackPeriod = 3600000;  // milliseconds
+    unsigned long RtcRetryPeriod     = 60000;    // milliseconds, after a failed RTC read
+    int64_t RtcMaxDeviation = 2 * SECONDS_TO_MICROSECONDS;  // microseconds
+    long GmtOffset = 0;                          // seconds
+    bool Enabled = false;
+
+    TimeSourceEnum Source = NO_SOURCE;
+    DeadlineTimer RtcWritebackTimer;
+    DeadlineTimer RtcRetryTimer;
+    uint32_t FailoverCount = 0;
+    uint32_t RtcReadCount = 0;
+    uint32_t RtcWriteCount = 0;
+
+    static FailoverTimeProvider* StaticInstance;
+
+    FailoverTimeProvider();
+    static void HandlerTaskStatic(void *pvParameters);
+    void HandlerTask();
+    bool LoadFromRtc(bool Force);
+    void FollowNtp();
+    void WriteBackToRtc();
+
+public:
+    static FailoverTimeProvider* GetInstance();
+    static void Destroy();
+
+    void SetSources(NtpHandler* NtpSource, DS3231_RtcHandler* RtcSource);
+    void SetGmtOffset(int GmtOffsetHours);
+    void SetRtcWritebackPeriod(unsigned long Period);
+
+    void Enable();
+    void Disable();
+    bool IsSynchronizedToNtp();
+    uint32_t GetFailoverCount();
+    uint32_t GetRtcReadCount();
+    uint32_t GetRtcWriteCount();
+    String GetFormattedTime(const String& Format = "%d/%m/%Y %H:%M:%S") override;
+};
@@ -0,0 +1,278 @@
+#include "DeltaPatcher.h"
+#include <mbedtls/sha256.h>
+
+DeltaPatcher::DeltaPatcher() {
+}
+
+DeltaPatcher::~DeltaPatcher() {
+    End();
+}
+
+bool DeltaPatcher::Begin(const esp_partition_t* SourcePartition, DeltaWriteCallback Callback, void* Context) {
+    End();
+
+    Source = SourcePartition;
+    WriteCallback = Callback;
+    WriteContext = Context;
+    State = HEADER;
+    Error = nullptr;
+    HeaderLength = 0;
+    ControlLength = 0;
+    SourcePosition = 0;
+    TargetPosition = 0;
+    StreamEnded = false;
+    WindowOffset = 0;
+    OutputLength = 0;
+
+    Inflator = reinterpret_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
+    Window = reinterpret_cast<uint8_t*>(malloc(TINFL_LZ_DICT_SIZE));
+    SourceBuffer = reinterpret_cast<uint8_t*>(malloc(DELTA_SOURCE_CHUNK_SIZE));
+    OutputBuffer = reinterpret_cast<uint8_t*>(malloc(DELTA_OUTPUT_BUFFER_SIZE));
+    if ((Source == nullptr) || (Callback == nullptr) || !Inflator || !Window || !SourceBuffer || !OutputBuffer) {
+        End();
+        return Fail("Not enough memory");
+    }
+    tinfl_init(Inflator);
+    return true;
+}
+
+void DeltaPatcher::End() {
+    free(Inflator);
+    free(Window);
+    free(SourceBuffer);
+    free(OutputBuffer);
+    Inflator = nullptr;
+    Window = nullptr;
+    SourceBuffer = nullptr;
+    OutputBuffer = nullptr;
+}
+
+bool DeltaPatcher::Feed(const uint8_t* Data, size_t Length) {
+    if (State == FAILED) {
+        return false;
+    }
+    if ((State == HEADER) && !ParseHeader(Data, Length)) {
+        return false;
+    }
+    return (Length == 0) || Inflate(Data, Length);
+}
+
+bool DeltaPatcher::Finish() {
+    if (State == FAILED) {
+        return false;
+    }
+    if (!StreamEnded || (State != CONTROL) || (ControlLength != 0) || (TargetPosition != Header.TargetSize)) {
+        return Fail("Truncated patch");
+    }
+    if (!FlushOutput()) {
+        return false;
+    }
+    State = DONE;
+    return true;
+}
+
+bool DeltaPatcher::IsHeaderParsed() const {
+    return (State != HEADER) && (HeaderLength == sizeof(Header));
+}
+
+uint32_t DeltaPatcher::GetTargetSize() const {
+    return IsHeaderParsed() ? Header.TargetSize : 0;
+}
+
+uint32_t DeltaPatcher::GetTargetWritten() const {
+    return TargetPosition;
+}
+
+const char* DeltaPatcher::GetError() const {
+    return Error ? Error : "";
+}
+
+bool DeltaPatcher::Fail(const char* Message) {
+    State = FAILED;
+    Error = Message;
+    return false;
+}
+
+bool DeltaPatcher::ParseHeader(const uint8_t*& Data, size_t& Length) {
+    size_t Chunk = min(Length, sizeof(Header) - HeaderLength);
+    memcpy(reinterpret_cast<uint8_t*>(&Header) + HeaderLength, Data, Chunk);
+    HeaderLength += Chunk;
+    Data += Chunk;
+    Length -= Chunk;
+
+    if (HeaderLength < sizeof(Header)) {
+        return true;
+    }
+    if ((Header.Magic != DELTA_PATCH_MAGIC) || (Header.Version != DELTA_PATCH_VERSION)) {
+        return Fail("Not a delta patch");
+    }
+    if (Header.SourceSize > Source->size) {
+        return Fail("Source size exceeds the running partition");
+    }
+    if (!VerifySource()) {
+        return Fail("Patch does not match the running firmware");
+    }
+    State = CONTROL;
+    return true;
+}
+
+// The patch is only valid against the exact image it was built from
+bool DeltaPatcher::VerifySource() {
+    mbedtls_sha256_context Context;
+    mbedtls_sha256_init(&Context);
+    mbedtls_sha256_starts(&Context, 0);
+
+    bool Success = true;
+    for (uint32_t Offset = 0; Offset < Header.SourceSize; Offset += DELTA_SOURCE_CHUNK_SIZE) {
+        size_t Chunk = min(static_cast<uint32_t>(DELTA_SOURCE_CHUNK_SIZE), Header.SourceSize - Offset);
+        if (esp_partition_read(Source, Offset, SourceBuffer, Chunk) != ESP_OK) {
+            Success = false;
+            break;
+        }
+        mbedtls_sha256_update(&Context, SourceBuffer, Chunk);
+    }
+
+    uint8_t Digest[32];
+    mbedtls_sha256_finish(&Context, Digest);
+    mbedtls_sha256_free(&Context);
+    return Success && (memcmp(Digest, Header.SourceSha256, sizeof(Digest)) == 0);
+}
+
+// The inflate window doubles as the output buffer of tinfl, which needs the
+// last 32 KB of output to resolve back references
+bool DeltaPatcher::Inflate(const uint8_t* Data, size_t Length) {
+    while (true) {
+        if (StreamEnded) {
+            return (Length == 0) || Fail("Data after the end of the patch");
+        }
+
+        size_t InBytes = Length;
+        size_t OutBytes = TINFL_LZ_DICT_SIZE - WindowOffset;
+        tinfl_status Status = tinfl_decompress(Inflator, Data, &InBytes, Window, Window + WindowOffset, &OutBytes,
+                                               TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        Data += InBytes;
+        Length -= InBytes;
+
+        if ((OutBytes > 0) && !Apply(Window + WindowOffset, OutBytes)) {
+            return false;
+        }
+        WindowOffset = (WindowOffset + OutBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (Status < TINFL_STATUS_DONE) {
+            return Fail("Corrupted patch stream");
+        }
+        if (Status == TINFL_STATUS_DONE) {
+            StreamEnded = true;
+        } else if ((Status == TINFL_STATUS_NEEDS_MORE_INPUT) && (Length == 0)) {
+            return true;
+        }
+    }
+}
+
+bool DeltaPatcher::Apply(const uint8_t* Data, size_t Length) {
+    while (true) {
+        // Empty blocks move on without consuming data
+        if ((State == DIFF) && (DiffRemaining == 0)) {
+            State = EXTRA;
+        }
+        if ((State == EXTRA) && (ExtraRemaining == 0) && !Seek()) {
+            return false;
+        }
+        if (Length == 0) {
+            return true;
+        }
+
+        size_t Chunk;
+        switch (State) {
+            case CONTROL: {
+                Chunk = min(Length, static_cast<size_t>(DELTA_CONTROL_SIZE) - ControlLength);
+                memcpy(Control + ControlLength, Data, Chunk);
+                ControlLength += Chunk;
+                if (ControlLength == DELTA_CONTROL_SIZE) {
+                    ControlLength = 0;
+                    int32_t Diff = ReadInt32(Control);
+                    int32_t Extra = ReadInt32(Control + 4);
+                    SeekAdjust = ReadInt32(Control + 8);
+                    if ((Diff < 0) || (Extra < 0) ||
+                        (static_cast<uint64_t>(SourcePosition) + Diff > Header.SourceSize) ||
+                        (static_cast<uint64_t>(TargetPosition) + Diff + Extra > Header.TargetSize)) {
+                        return Fail("Control entry out of bounds");
+                    }
+                    DiffRemaining = Diff;
+                    ExtraRemaining = Extra;
+                    State = DIFF;
+                }
+                break;
+            }
+
+            case DIFF:
+                Chunk = min(Length, min(static_cast<size_t>(DiffRemaining), static_cast<size_t>(DELTA_SOURCE_CHUNK_SIZE)));
+                if (esp_partition_read(Source, SourcePosition, SourceBuffer, Chunk) != ESP_OK) {
+                    return Fail("Source read failed");
+                }
+                for (size_t i = 0; i < Chunk; i++) {
+                    SourceBuffer[i] += Data[i];
+                }
+                if (!Emit(SourceBuffer, Chunk)) {
+                    return false;
+                }
+                SourcePosition += Chunk;
+                DiffRemaining -= Chunk;
+                break;
+
+            case EXTRA:
+                Chunk = min(Length, static_cast<size_t>(ExtraRemaining));
+                if (!Emit(Data, Chunk)) {
+                    return false;
+                }
+                ExtraRemaining -= Chunk;
+                break;
+
+            default:
+                return Fail("Unexpected patch data");
+        }
+        Data += Chunk;
+        Length -= Chunk;
+    }
+}
+
+bool DeltaPatcher::Seek() {
+    int64_t Position = static_cast<int64_t>(SourcePosition) + SeekAdjust;
+    if ((Position < 0) || (Position > Header.SourceSize)) {
+        return Fail("Source seek out of bounds");
+    }
+    SourcePosition = Position;
+    State = CONTROL;
+    return true;
+}
+
+bool DeltaPatcher::Emit(const uint8_t* Data, size_t Length) {
+    TargetPosition += Length;
+    while (Length > 0) {
+        size_t Chunk = min(Length, static_cast<size_t>(DELTA_OUTPUT_BUFFER_SIZE) - OutputLength);
+        memcpy(OutputBuffer + OutputLength, Data, Chunk);
+        OutputLength += Chunk;
+        Data += Chunk;
+        Length -= Chunk;
+        if ((OutputLength == DELTA_OUTPUT_BUFFER_SIZE) && !FlushOutput()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaPatcher::FlushOutput() {
+    if (OutputLength == 0) {
+        return true;
+    }
+    if (!WriteCallback(WriteContext, OutputBuffer, OutputLength)) {
+        return Fail("Target write failed");
+    }
+    OutputLength = 0;
+    return true;
+}
+
+int32_t DeltaPatcher::ReadInt32(const uint8_t* Data) {
+    return static_cast<int32_t>(static_cast<uint32_t>(Data[0]) | (static_cast<uint32_t>(Data[1]) << 8) |
+                                (static_cast<uint32_t>(Data[2]) << 16) | (static_cast<uint32_t>(Data[3]) << 24));
+}
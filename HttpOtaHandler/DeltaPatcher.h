@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <rom/miniz.h>
+
+#define DELTA_PATCH_MAGIC          0x31544C44  // "DLT1"
+#define DELTA_PATCH_VERSION        1
+#define DELTA_SOURCE_CHUNK_SIZE    1024        // bytes
+#define DELTA_OUTPUT_BUFFER_SIZE   4096        // bytes
+#define DELTA_CONTROL_SIZE         12          // bytes
+
+// Patch layout: this header, uncompressed, followed by one zlib stream holding
+// bsdiff control triples in sequence, each followed by its own data:
+//     int32_t DiffLength, int32_t ExtraLength, int32_t SeekAdjust (little endian)
+//     DiffLength bytes added to the source bytes at the source cursor
+//     ExtraLength bytes copied to the target as they are
+// then the source cursor moves by DiffLength + SeekAdjust. Unlike BSDIFF40 the
+// three blocks are interleaved, so the patch is applied in a single pass.
+struct __attribute__((packed)) DeltaPatchHeader {
+    uint32_t Magic;
+    uint16_t Version;
+    uint16_t Reserved;
+    uint32_t SourceSize;
+    uint32_t TargetSize;
+    uint8_t  SourceSha256[32];
+};
+
+// Return false to abort the patch
+typedef bool (*DeltaWriteCallback)(void* Context, const uint8_t* Data, size_t Length);
+
+// Applies a patch fed in arbitrary pieces (as they come off the network)
+// against the source partition, producing the target image through the write
+// callback. RAM is bounded by the inflate window and the two small buffers,
+// allocated by Begin() and released by End().
+class DeltaPatcher {
+    public:
+        DeltaPatcher();
+        ~DeltaPatcher();
+
+        bool Begin(const esp_partition_t* Source, DeltaWriteCallback Callback, void* Context);
+        bool Feed(const uint8_t* Data, size_t Length);
+        bool Finish();
+        void End();
+
+        bool IsHeaderParsed() const;
+        uint32_t GetTargetSize() const;
+        uint32_t GetTargetWritten() const;
+        const char* GetError() const;
+
+    private:
+        enum DeltaStateEnum {
+            HEADER,
+            CONTROL,
+            DIFF,
+            EXTRA,
+            DONE,
+            FAILED
+        };
+
+        const esp_partition_t* Source = nullptr;
+        DeltaWriteCallback WriteCallback = nullptr;
+        void* WriteContext = nullptr;
+
+        DeltaStateEnum State = HEADER;
+        const char* Error = nullptr;
+        DeltaPatchHeader Header;
+        size_t HeaderLength = 0;
+        uint8_t Control[DELTA_CONTROL_SIZE];
+        size_t ControlLength = 0;
+        uint32_t DiffRemaining = 0;
+        uint32_t ExtraRemaining = 0;
+        int32_t SeekAdjust = 0;
+        uint32_t SourcePosition = 0;
+        uint32_t TargetPosition = 0;
+        bool StreamEnded = false;
+
+        tinfl_decompressor* Inflator = nullptr;
+        uint8_t* Window = nullptr;           // TINFL_LZ_DICT_SIZE, circular
+        size_t WindowOffset = 0;
+        uint8_t* SourceBuffer = nullptr;     // DELTA_SOURCE_CHUNK_SIZE
+        uint8_t* OutputBuffer = nullptr;     // DELTA_OUTPUT_BUFFER_SIZE
+        size_t OutputLength = 0;
+
+        bool Fail(const char* Message);
+        bool ParseHeader(const uint8_t*& Data, size_t& Length);
+        bool VerifySource();
+        bool Inflate(const uint8_t* Data, size_t Length);
+        bool Apply(const uint8_t* Data, size_t Length);
+        bool Seek();
+        bool Emit(const uint8_t* Data, size_t Length);
+        bool FlushOutput();
+        static int32_t ReadInt32(const uint8_t* Data);
+
+        DeltaPatcher(const DeltaPatcher&) = delete;
+        void operator=(const DeltaPatcher&) = delete;
+};
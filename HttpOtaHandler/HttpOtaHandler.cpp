@@ -0,0 +1,381 @@
+#include "HttpOtaHandler.h"
+#include "LoggerHandler.h"
+
+HttpOtaHandler::HttpOtaHandler() {
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    UpdatesMetric  = Metrics.AddCounter("ota_updates_total", "Completed pull OTA updates");
+    FailuresMetric = Metrics.AddCounter("ota_failures_total", "Failed pull OTA updates");
+    ResumesMetric  = Metrics.AddCounter("ota_resumes_total", "Pull OTA downloads resumed after a dropped link");
+    LOG(INFO, LogName, "Instance created");
+}
+
+HttpOtaHandler::~HttpOtaHandler() {
+    if (HandlerTaskPointer != nullptr) {
+        vTaskDelete(HandlerTaskPointer);
+        HandlerTaskPointer = nullptr;
+    }
+    AbortImage();
+    LOG(INFO, LogName, "Instance deleted");
+}
+
+void HttpOtaHandler::SetMaxRetries(uint8_t Retries) {
+    MaxRetries = Retries;
+}
+
+void HttpOtaHandler::SetRetryDelay(unsigned long Delay) {
+    RetryDelay = Delay;
+}
+
+void HttpOtaHandler::SetReadTimeout(unsigned long Timeout) {
+    ReadTimeout = Timeout;
+}
+
+void HttpOtaHandler::SetRebootOnSuccess(bool Reboot) {
+    RebootOnSuccess = Reboot;
+}
+
+void HttpOtaHandler::SetOnProgressCallback(OtaProgressCallback Callback) {
+    OnProgressCallback = Callback;
+}
+
+HttpOtaHandler::HttpOtaStateEnum HttpOtaHandler::GetState() {
+    return State;
+}
+
+bool HttpOtaHandler::IsUpdateInProgress() {
+    return (State == DOWNLOADING) || (State == VERIFYING);
+}
+
+uint8_t HttpOtaHandler::GetProgress() {
+    return (DownloadSize == 0) ? 0 : static_cast<uint8_t>((static_cast<uint64_t>(Received) * 100) / DownloadSize);
+}
+
+size_t HttpOtaHandler::GetBytesReceived() {
+    return Received;
+}
+
+size_t HttpOtaHandler::GetDownloadSize() {
+    return DownloadSize;
+}
+
+size_t HttpOtaHandler::GetBytesWritten() {
+    return Written;
+}
+
+bool HttpOtaHandler::IsDeltaUpdate() {
+    return Mode == MODE_DELTA;
+}
+
+uint8_t HttpOtaHandler::GetResumeCount() {
+    return ResumeCount;
+}
+
+bool HttpOtaHandler::Start(const String& Url, const String& Sha256) {
+    if (IsUpdateInProgress()) {
+        LOG(WARNING, LogName, "Update already in progress");
+        return false;
+    }
+
+    TaskUrl = Url;
+    TaskSha256 = Sha256;
+    State = DOWNLOADING;
+    BaseType_t Task = xTaskCreatePinnedToCore(HandlerTaskStatic, "HttpOta_HandlerTask", 8192, this, HandlerTaskPriority, &HandlerTaskPointer, 1);
+    if (Task != pdPASS) {
+        State = FAILED;
+        LOG(ERROR, LogName, "Failed to create task");
+        return false;
+    }
+    LOG(INFO, LogName, "Handler task created");
+    return true;
+}
+
+void HttpOtaHandler::HandlerTaskStatic(void* pvParameters) {
+    HttpOtaHandler* Instance = reinterpret_cast<HttpOtaHandler*>(pvParameters);
+    bool Success = Instance->Update(Instance->TaskUrl, Instance->TaskSha256);
+    if (Success && Instance->RebootOnSuccess) {
+        LOG(INFO, Instance->LogName, "Restarting into the new firmware");
+        vTaskDelay(1000 / portTICK_PERIOD_MS);  // let the logger drain
+        ESP.restart();
+    }
+    Instance->HandlerTaskPointer = nullptr;
+    vTaskDelete(nullptr);
+}
+
+bool HttpOtaHandler::Update(const String& Url, const String& Sha256) {
+    if (!ParseDigest(Sha256, ExpectedDigest)) {
+        LOG(ERROR, LogName, "Invalid SHA-256 digest: " + Sha256);
+        State = FAILED;
+        FailuresMetric->Increment();
+        return false;
+    }
+
+    Partition = esp_ota_get_next_update_partition(nullptr);
+    if (Partition == nullptr) {
+        LOG(ERROR, LogName, "No OTA partition available");
+        State = FAILED;
+        FailuresMetric->Increment();
+        return false;
+    }
+
+    AbortImage();
+    State = DOWNLOADING;
+    DownloadSize = 0;
+    ResumeCount = 0;
+    LOG(INFO, LogName, "Update started from " + Url + " into partition " + String(Partition->label));
+
+    DownloadResultEnum Result = DOWNLOAD_INTERRUPTED;
+    uint8_t Retries = 0;
+    while (true) {
+        Result = Download(Url);
+        if (Result != DOWNLOAD_INTERRUPTED) {
+            break;
+        }
+        if (Retries >= MaxRetries) {
+            LOG(ERROR, LogName, "Giving up after " + String(Retries) + " retries");
+            Result = DOWNLOAD_FAILED;
+            break;
+        }
+        Retries++;
+        LOG(WARNING, LogName, "Download interrupted at " + String(Received) + " bytes, retry " + String(Retries) + "/" + String(MaxRetries));
+        vTaskDelay(RetryDelay / portTICK_PERIOD_MS);
+    }
+
+    if ((Result != DOWNLOAD_COMPLETE) || !FinishImage()) {
+        AbortImage();
+        State = FAILED;
+        FailuresMetric->Increment();
+        return false;
+    }
+
+    State = SUCCEEDED;
+    UpdatesMetric->Increment();
+    LOG(INFO, LogName, "Update completed, " + String(Received) + " bytes downloaded, " + String(Written) + " bytes written" + (IsDeltaUpdate() ? " from a delta patch, " : ", ") + String(ResumeCount) + " resumes");
+    return true;
+}
+
+// One HTTP exchange. With bytes already received the request asks for the rest
+// of the download; a server ignoring the Range header restarts it from zero.
+HttpOtaHandler::DownloadResultEnum HttpOtaHandler::Download(const String& Url) {
+    HTTPClient Http;
+    Http.setTimeout(ReadTimeout);
+    Http.setReuse(false);
+    if (!Http.begin(Url)) {
+        LOG(ERROR, LogName, "Invalid URL " + Url);
+        return DOWNLOAD_FAILED;
+    }
+
+    bool Resuming = DownloadStarted && (Received > 0);
+    if (Resuming) {
+        Http.addHeader("Range", "bytes=" + String(Received) + "-");
+    }
+
+    int Code = Http.GET();
+    if (Code <= 0) {
+        LOG(WARNING, LogName, "Request failed: " + Http.errorToString(Code));
+        Http.end();
+        return DOWNLOAD_INTERRUPTED;
+    }
+
+    int Length = Http.getSize();
+    if (Resuming && (Code == HTTP_CODE_PARTIAL_CONTENT)) {
+        ResumeCount++;
+        ResumesMetric->Increment();
+        LOG(INFO, LogName, "Resuming from " + String(Received) + " bytes");
+    } else if (Code == HTTP_CODE_OK) {
+        if (Resuming) {
+            LOG(WARNING, LogName, "Server does not support ranges, restarting the image");
+        }
+        AbortImage();
+        if (Length <= 0) {
+            LOG(ERROR, LogName, "Missing download size");
+            Http.end();
+            return DOWNLOAD_FAILED;
+        }
+        DownloadSize = Length;
+        DownloadStarted = true;
+    } else {
+        LOG(ERROR, LogName, "Unexpected HTTP status " + String(Code));
+        Http.end();
+        return ((Code >= 500) || (Code == HTTP_CODE_REQUEST_TIMEOUT)) ? DOWNLOAD_INTERRUPTED : DOWNLOAD_FAILED;
+    }
+
+    WiFiClient* Stream = Http.getStreamPtr();
+    DeadlineTimer IdleTimer;
+    IdleTimer.Start(ReadTimeout);
+
+    while (Received < DownloadSize) {
+        size_t Available = Stream->available();
+        if (Available > 0) {
+            size_t Read = Stream->readBytes(Buffer, min(Available, min(sizeof(Buffer), DownloadSize - Received)));
+            if (Read > 0) {
+                if (!Process(Buffer, Read)) {
+                    Http.end();
+                    return DOWNLOAD_FAILED;
+                }
+                IdleTimer.Start(ReadTimeout);
+                ReportProgress();
+            }
+        } else if (!Stream->connected()) {
+            Http.end();
+            return DOWNLOAD_INTERRUPTED;
+        } else if (IdleTimer.IsExpired()) {
+            LOG(WARNING, LogName, "No data for " + String(ReadTimeout) + " ms");
+            Http.end();
+            return DOWNLOAD_INTERRUPTED;
+        } else {
+            vTaskDelay(1);
+        }
+    }
+
+    Http.end();
+    return DOWNLOAD_COMPLETE;
+}
+
+bool HttpOtaHandler::Process(const uint8_t* Data, size_t Length) {
+    if (Mode == MODE_UNKNOWN) {
+        if (Data[0] == ESP_IMAGE_HEADER_MAGIC) {
+            Mode = MODE_FULL;
+            if (!BeginImage(DownloadSize)) {
+                return false;
+            }
+        } else {
+            Mode = MODE_DELTA;
+            if (!Patcher.Begin(esp_ota_get_running_partition(), WritePatchedImage, this)) {
+                LOG(ERROR, LogName, "Delta patch failed: " + String(Patcher.GetError()));
+                return false;
+            }
+        }
+    }
+
+    Received += Length;
+    if (Mode == MODE_FULL) {
+        return WriteImage(Data, Length);
+    }
+    if (!Patcher.Feed(Data, Length)) {
+        LOG(ERROR, LogName, "Delta patch failed: " + String(Patcher.GetError()));
+        return false;
+    }
+    return true;
+}
+
+// The update partition is opened on the first patched bytes, once the patch
+// header has given the size of the image
+bool HttpOtaHandler::WritePatchedImage(void* Context, const uint8_t* Data, size_t Length) {
+    HttpOtaHandler* Instance = reinterpret_cast<HttpOtaHandler*>(Context);
+    if (!Instance->OtaStarted && !Instance->BeginImage(Instance->Patcher.GetTargetSize())) {
+        return false;
+    }
+    return Instance->WriteImage(Data, Length);
+}
+
+bool HttpOtaHandler::BeginImage(size_t Size) {
+    if (Size > Partition->size) {
+        LOG(ERROR, LogName, "Image of " + String(Size) + " bytes does not fit in partition of " + String(Partition->size) + " bytes");
+        return false;
+    }
+
+    esp_err_t Error = esp_ota_begin(Partition, Size, &OtaHandle);
+    if (Error != ESP_OK) {
+        LOG(ERROR, LogName, "esp_ota_begin failed: " + String(esp_err_to_name(Error)));
+        return false;
+    }
+
+    mbedtls_sha256_init(&Sha256Context);
+    mbedtls_sha256_starts(&Sha256Context, 0);
+    OtaStarted = true;
+    return true;
+}
+
+void HttpOtaHandler::AbortImage() {
+    if (OtaStarted) {
+        esp_ota_abort(OtaHandle);
+        mbedtls_sha256_free(&Sha256Context);
+        OtaStarted = false;
+    }
+    Patcher.End();
+    Mode = MODE_UNKNOWN;
+    DownloadStarted = false;
+    Received = 0;
+    Written = 0;
+    LastProgressSent = 0;
+}
+
+bool HttpOtaHandler::WriteImage(const uint8_t* Data, size_t Length) {
+    esp_err_t Error = esp_ota_write(OtaHandle, Data, Length);
+    if (Error != ESP_OK) {
+        LOG(ERROR, LogName, "esp_ota_write failed: " + String(esp_err_to_name(Error)));
+        return false;
+    }
+    mbedtls_sha256_update(&Sha256Context, Data, Length);
+    Written += Length;
+    return true;
+}
+
+bool HttpOtaHandler::FinishImage() {
+    State = VERIFYING;
+
+    if ((Mode == MODE_DELTA) && !Patcher.Finish()) {
+        LOG(ERROR, LogName, "Delta patch failed: " + String(Patcher.GetError()));
+        return false;
+    }
+    Patcher.End();
+    if (!OtaStarted) {
+        LOG(ERROR, LogName, "Empty image");
+        return false;
+    }
+
+    uint8_t Digest[HTTP_OTA_DIGEST_SIZE];
+    mbedtls_sha256_finish(&Sha256Context, Digest);
+    if (memcmp(Digest, ExpectedDigest, sizeof(Digest)) != 0) {
+        LOG(ERROR, LogName, "SHA-256 mismatch, image discarded");
+        return false;
+    }
+
+    mbedtls_sha256_free(&Sha256Context);
+    OtaStarted = false;
+    esp_err_t Error = esp_ota_end(OtaHandle);
+    if (Error != ESP_OK) {
+        LOG(ERROR, LogName, "esp_ota_end failed: " + String(esp_err_to_name(Error)));
+        return false;
+    }
+
+    Error = esp_ota_set_boot_partition(Partition);
+    if (Error != ESP_OK) {
+        LOG(ERROR, LogName, "esp_ota_set_boot_partition failed: " + String(esp_err_to_name(Error)));
+        return false;
+    }
+    return true;
+}
+
+void HttpOtaHandler::ReportProgress() {
+    uint8_t Progress = GetProgress();
+    if (((Progress % 5) == 0) && (Progress > LastProgressSent)) {
+        LastProgressSent = Progress;
+        LOG(INFO, LogName, "Update progress: " + String(Progress));
+        if (OnProgressCallback) {
+            OnProgressCallback(Progress, Received, DownloadSize);
+        }
+    }
+}
+
+bool HttpOtaHandler::ParseDigest(const String& Hex, uint8_t* Digest) {
+    if (Hex.length() != HTTP_OTA_DIGEST_SIZE * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < HTTP_OTA_DIGEST_SIZE; i++) {
+        uint8_t Byte = 0;
+        for (size_t j = 0; j < 2; j++) {
+            char Char = tolower(Hex[i * 2 + j]);
+            Byte <<= 4;
+            if ((Char >= '0') && (Char <= '9')) {
+                Byte |= Char - '0';
+            } else if ((Char >= 'a') && (Char <= 'f')) {
+                Byte |= Char - 'a' + 10;
+            } else {
+                return false;
+            }
+        }
+        Digest[i] = Byte;
+    }
+    return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <HTTPClient.h>
+#include <esp_ota_ops.h>
+#include <esp_app_format.h>
+#include <mbedtls/sha256.h>
+#include <System.h>
+#include <DeadlineTimer.h>
+#include <MetricsRegistry.h>
+#include "DeltaPatcher.h"
+
+#define HTTP_OTA_BUFFER_SIZE      4096   // bytes, one flash sector
+#define HTTP_OTA_DIGEST_SIZE      32     // bytes, SHA-256
+
+typedef void (*OtaProgressCallback)(uint8_t Percent, size_t Received, size_t Total);
+
+// Pull-mode updater: the image is streamed from an HTTP(S) server straight into
+// the next OTA partition through one fixed buffer, while its SHA-256 is computed
+// on the fly. A dropped link is resumed with a Range request from the last byte
+// written; the boot partition is switched only if the digest matches and the
+// image passes the bootloader checks of esp_ota_end().
+// The download is either a full image or a DeltaPatcher patch against the
+// running firmware, told apart by its first byte; the digest always refers to
+// the resulting image.
+class HttpOtaHandler {
+    public:
+        HttpOtaHandler();
+        ~HttpOtaHandler();
+
+        enum HttpOtaStateEnum {
+            IDLE,
+            DOWNLOADING,
+            VERIFYING,
+            SUCCEEDED,
+            FAILED
+        };
+
+        void SetMaxRetries(uint8_t Retries);
+        void SetRetryDelay(unsigned long Delay);      // milliseconds
+        void SetReadTimeout(unsigned long Timeout);   // milliseconds
+        void SetRebootOnSuccess(bool Reboot);
+        void SetOnProgressCallback(OtaProgressCallback Callback);
+
+        // Blocking update, the boot partition is switched but the device is not restarted
+        bool Update(const String& Url, const String& Sha256);
+        // Runs Update() in its own task and restarts on success if configured
+        bool Start(const String& Url, const String& Sha256);
+
+        HttpOtaStateEnum GetState();
+        bool IsUpdateInProgress();
+        uint8_t GetProgress();            // percent
+        size_t GetBytesReceived();
+        size_t GetDownloadSize();
+        size_t GetBytesWritten();        // to the update partition
+        bool IsDeltaUpdate();
+        uint8_t GetResumeCount();
+
+    private:
+        String LogName = "HttpOtaHandler";
+
+        enum ImageModeEnum {
+            MODE_UNKNOWN,
+            MODE_FULL,
+            MODE_DELTA
+        };
+
+        enum DownloadResultEnum {
+            DOWNLOAD_COMPLETE,
+            DOWNLOAD_INTERRUPTED,
+            DOWNLOAD_FAILED
+        };
+
+        TaskHandle_t HandlerTaskPointer = nullptr;
+        int HandlerTaskPriority = 2;
+        uint8_t MaxRetries = 5;
+        unsigned long RetryDelay = 2000;    // milliseconds
+        unsigned long ReadTimeout = 10000;  // milliseconds
+        bool RebootOnSuccess = true;
+        OtaProgressCallback OnProgressCallback = nullptr;
+
+        volatile HttpOtaStateEnum State = IDLE;
+        String TaskUrl;
+        String TaskSha256;
+
+        const esp_partition_t* Partition = nullptr;
+        esp_ota_handle_t OtaHandle = 0;
+        bool OtaStarted = false;
+        mbedtls_sha256_context Sha256Context;
+        uint8_t ExpectedDigest[HTTP_OTA_DIGEST_SIZE];
+        uint8_t Buffer[HTTP_OTA_BUFFER_SIZE];
+        DeltaPatcher Patcher;
+        ImageModeEnum Mode = MODE_UNKNOWN;
+        bool DownloadStarted = false;
+        volatile size_t Received = 0;       // bytes of the download
+        volatile size_t DownloadSize = 0;   // 0 until known
+        volatile size_t Written = 0;        // bytes of the image
+        volatile uint8_t ResumeCount = 0;
+        uint8_t LastProgressSent = 0;
+
+        Metric* UpdatesMetric = nullptr;
+        Metric* FailuresMetric = nullptr;
+        Metric* ResumesMetric = nullptr;
+
+        static void HandlerTaskStatic(void* pvParameters);
+        DownloadResultEnum Download(const String& Url);
+        bool Process(const uint8_t* Data, size_t Length);
+        bool BeginImage(size_t Size);
+        void AbortImage();
+        bool WriteImage(const uint8_t* Data, size_t Length);
+        static bool WritePatchedImage(void* Context, const uint8_t* Data, size_t Length);
+        bool FinishImage();
+        void ReportProgress();
+        static bool ParseDigest(const String& Hex, uint8_t* Digest);
+
+        HttpOtaHandler(const HttpOtaHandler&) = delete;
+        void operator=(const HttpOtaHandler&) = delete;
+};
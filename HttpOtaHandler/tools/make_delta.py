@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Builds a DeltaPatcher patch (see DeltaPatcher.h) turning SOURCE into TARGET.
+
+    pip install bsdiff4
+    python3 make_delta.py firmware_old.bin firmware_new.bin firmware.delta
+
+Prints the SHA-256 of TARGET, to be passed to HttpOtaHandler::Update().
+"""
+
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = 0x31544C44  # "DLT1"
+VERSION = 1
+
+
+def make_delta(source, target, differ=None):
+    """differ returns (control, diff, extra) like bsdiff4.core.diff, the default"""
+    if differ is None:
+        import bsdiff4.core
+        differ = bsdiff4.core.diff
+    control, diff, extra = differ(source, target)
+    body = bytearray()
+    diff_offset = extra_offset = 0
+    for diff_length, extra_length, seek in control:
+        body += struct.pack("<iii", diff_length, extra_length, seek)
+        body += diff[diff_offset:diff_offset + diff_length]
+        body += extra[extra_offset:extra_offset + extra_length]
+        diff_offset += diff_length
+        extra_offset += extra_length
+    header = struct.pack("<IHHII", MAGIC, VERSION, 0, len(source), len(target))
+    return header + hashlib.sha256(source).digest() + zlib.compress(bytes(body), 9)
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit(__doc__)
+    with open(sys.argv[1], "rb") as f:
+        source = f.read()
+    with open(sys.argv[2], "rb") as f:
+        target = f.read()
+    patch = make_delta(source, target)
+    with open(sys.argv[3], "wb") as f:
+        f.write(patch)
+    print("patch: %d bytes (%.1f%% of the target)" % (len(patch), 100.0 * len(patch) / len(target)))
+    print("sha256: %s" % hashlib.sha256(target).hexdigest())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""Round trip test of the delta patch format: builds a patch from SOURCE to
+TARGET, applies it with a host port of DeltaPatcher (same state machine, fed
+in network sized pieces) and compares the rebuilt image with TARGET.
+
+    python3 test_delta.py                               # synthetic images
+    python3 test_delta.py firmware_old.bin firmware_new.bin
+
+Reports the patch size and the apply throughput of the host port, which only
+compares runs with each other: the device is bound by flash, not by the CPU.
+Patches are built with bsdiff4 when installed, otherwise with a block
+matcher that emits the same format, larger but exercising every field.
+"""
+
+import hashlib
+import os
+import random
+import struct
+import sys
+import time
+import zlib
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import make_delta  # noqa: E402
+
+HEADER_FORMAT = "<IHHII"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT) + 32
+CONTROL_SIZE = 12
+FEED_SIZE = 1436       # one TCP segment
+BLOCK_SIZE = 16        # block matcher granularity
+
+
+def block_diff(source, target):
+    """Greedy matcher returning bsdiff4.core.diff style (control, diff, extra)."""
+    index = {}
+    for offset in range(0, len(source) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        index.setdefault(source[offset:offset + BLOCK_SIZE], offset)
+
+    matches = []
+    position = 0
+    while position + BLOCK_SIZE <= len(target):
+        start = index.get(target[position:position + BLOCK_SIZE])
+        if start is None:
+            position += 1
+            continue
+        length = BLOCK_SIZE
+        while (position + length < len(target)) and (start + length < len(source)) and (target[position + length] == source[start + length]):
+            length += 1
+        matches.append((position, start, length))
+        position += length
+
+    # A leading entry copies what precedes the first match and seeks to it
+    first_position, first_start = (matches[0][0], matches[0][1]) if matches else (len(target), 0)
+    control = [(0, first_position, first_start)]
+    diff = bytearray()
+    extra = bytearray(target[:first_position])
+    for number, (position, start, length) in enumerate(matches):
+        following = matches[number + 1] if number + 1 < len(matches) else (len(target), start + length, 0)
+        control.append((length, following[0] - position - length, following[1] - start - length))
+        diff += bytes(length)  # exact matches add zero to the source
+        extra += target[position + length:following[0]]
+    return control, bytes(diff), bytes(extra)
+
+
+class HostPatcher:
+    """DeltaPatcher.cpp state machine, with the partition replaced by bytes."""
+
+    def __init__(self, source):
+        self.source = source
+        self.header = b""
+        self.state = "HEADER"
+        self.inflator = zlib.decompressobj()
+        self.control = b""
+        self.diff_remaining = self.extra_remaining = self.seek_adjust = 0
+        self.source_position = 0
+        self.output = bytearray()
+
+    def feed(self, data):
+        if self.state == "HEADER":
+            needed = HEADER_SIZE - len(self.header)
+            self.header += data[:needed]
+            data = data[needed:]
+            if len(self.header) < HEADER_SIZE:
+                return
+            magic, version, _, self.source_size, self.target_size = struct.unpack_from(HEADER_FORMAT, self.header)
+            if magic != make_delta.MAGIC or version != make_delta.VERSION:
+                raise ValueError("Not a delta patch")
+            if self.source_size > len(self.source):
+                raise ValueError("Source size exceeds the running partition")
+            if hashlib.sha256(self.source[:self.source_size]).digest() != self.header[-32:]:
+                raise ValueError("Patch does not match the running firmware")
+            self.state = "CONTROL"
+        if data:
+            if self.inflator.eof:
+                raise ValueError("Data after the end of the patch")
+            self.apply(self.inflator.decompress(data))
+
+    def apply(self, data):
+        while True:
+            if self.state == "DIFF" and self.diff_remaining == 0:
+                self.state = "EXTRA"
+            if self.state == "EXTRA" and self.extra_remaining == 0:
+                position = self.source_position + self.seek_adjust
+                if position < 0 or position > self.source_size:
+                    raise ValueError("Source seek out of bounds")
+                self.source_position = position
+                self.state = "CONTROL"
+            if not data:
+                return
+            if self.state == "CONTROL":
+                chunk = CONTROL_SIZE - len(self.control)
+                self.control += data[:chunk]
+                if len(self.control) == CONTROL_SIZE:
+                    diff, extra, self.seek_adjust = struct.unpack("<iii", self.control)
+                    self.control = b""
+                    if diff < 0 or extra < 0 or self.source_position + diff > self.source_size or len(self.output) + diff + extra > self.target_size:
+                        raise ValueError("Control entry out of bounds")
+                    self.diff_remaining, self.extra_remaining = diff, extra
+                    self.state = "DIFF"
+            elif self.state == "DIFF":
+                chunk = min(len(data), self.diff_remaining)
+                base = self.source[self.source_position:self.source_position + chunk]
+                self.output += bytes((a + b) & 0xFF for a, b in zip(base, data[:chunk]))
+                self.source_position += chunk
+                self.diff_remaining -= chunk
+            else:
+                chunk = min(len(data), self.extra_remaining)
+                self.output += data[:chunk]
+                self.extra_remaining -= chunk
+            data = data[chunk:]
+
+    def finish(self):
+        if not self.inflator.eof or self.state != "CONTROL" or self.control or len(self.output) != self.target_size:
+            raise ValueError("Truncated patch")
+        return bytes(self.output)
+
+
+def synthetic_images(size=262144, seed=1):
+    """A firmware-like pair: the target moves, edits, drops and adds sections."""
+    generator = random.Random(seed)
+    words = [generator.randbytes(generator.randint(4, 24)) for _ in range(512)]
+    source = bytearray()
+    while len(source) < size:
+        source += generator.choice(words) if generator.random() < 0.8 else generator.randbytes(8)
+    source = bytes(source[:size])
+
+    target = bytearray(source)
+    for _ in range(64):
+        position = generator.randrange(len(target) - 8)
+        target[position:position + 4] = generator.randbytes(4)          # relocated addresses
+    cut = generator.randrange(len(target) // 2)
+    del target[cut:cut + 2048]                                          # removed function
+    insert = generator.randrange(len(target))
+    target[insert:insert] = generator.randbytes(4096)                   # new code
+    target += source[:8192]                                             # moved data
+    return source, bytes(target)
+
+
+def round_trip(name, source, target, differ):
+    start = time.perf_counter()
+    patch = make_delta.make_delta(source, target, differ)
+    build_time = time.perf_counter() - start
+
+    patcher = HostPatcher(source)
+    start = time.perf_counter()
+    for offset in range(0, len(patch), FEED_SIZE):
+        patcher.feed(patch[offset:offset + FEED_SIZE])
+    rebuilt = patcher.finish()
+    apply_time = time.perf_counter() - start
+
+    if rebuilt != target:
+        mismatch = next((i for i, (a, b) in enumerate(zip(rebuilt, target)) if a != b), min(len(rebuilt), len(target)))
+        print("%s: FAIL, rebuilt image differs from the target at byte %d" % (name, mismatch))
+        return False
+    print("%s: OK, source %d, target %d, patch %d bytes (%.1f%% of the target), built in %.2f s, applied at %.0f KB/s" % (
+        name, len(source), len(target), len(patch), 100.0 * len(patch) / len(target), build_time, len(target) / 1024 / apply_time))
+    return True
+
+
+def main():
+    try:
+        import bsdiff4.core
+        differ, differ_name = bsdiff4.core.diff, "bsdiff4"
+    except ImportError:
+        differ, differ_name = block_diff, "block matcher"
+    print("diff: %s" % differ_name)
+
+    if len(sys.argv) == 3:
+        with open(sys.argv[1], "rb") as f:
+            source = f.read()
+        with open(sys.argv[2], "rb") as f:
+            target = f.read()
+        cases = [(os.path.basename(sys.argv[2]), source, target)]
+    elif len(sys.argv) == 1:
+        source, target = synthetic_images()
+        cases = [
+            ("synthetic", source, target),
+            ("identical", source, source),
+            ("unrelated", source[:4096], bytes(reversed(source[:4096]))),
+            ("truncated", source, source[:len(source) // 3]),
+        ]
+    else:
+        sys.exit(__doc__)
+
+    failed = [name for name, source, target in cases if not round_trip(name, source, target, differ)]
+
+    # The patch must be refused against any other image
+    source, target = cases[0][1], cases[0][2]
+    patch = make_delta.make_delta(source, target, differ)
+    try:
+        HostPatcher(source[:-1] + bytes([source[-1] ^ 0xFF])).feed(patch)
+        print("wrong source: FAIL, patch accepted")
+        failed.append("wrong source")
+    except ValueError as error:
+        print("wrong source: OK, %s" % error)
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,209 @@
+#include "I2CBusHandler.h"
+#include "LoggerHandler.h"
+
+I2CBusHandler& I2CBusHandler::GetInstance() {
+    static I2CBusHandler Instance;
+    return Instance;
+}
+
+I2CBusHandler::I2CBusHandler() {
+    BusSemaphore = xSemaphoreCreateMutex();
+}
+
+bool I2CBusHandler::Begin(int Sda, int Scl, uint32_t Frequency) {
+    if (!Lock()) {
+        return false;
+    }
+    if (!Started) {
+        Started = Wire.begin(Sda, Scl, Frequency);
+        if (Started) {
+            LOG(INFO, LogName, "Bus started at " + String(Frequency) + " Hz");
+        } else {
+            LOG(ERROR, LogName, "Bus start failed");
+        }
+    }
+    Unlock();
+    return Started;
+}
+
+void I2CBusHandler::RegisterDevice(uint8_t Address, const char* Name) {
+    if (!Lock()) {
+        return;
+    }
+    I2CDeviceStats* Device = FindDevice(Address);
+    if (Device != nullptr) {
+        strncpy(Device->Name, Name, sizeof(Device->Name) - 1);
+    }
+    Unlock();
+    LOG(INFO, LogName, "Device " + String(Name) + " registered at 0x" + String(Address, HEX));
+}
+
+bool I2CBusHandler::ReadRegisters(uint8_t Address, uint8_t Register, uint8_t* Buffer, size_t Length) {
+    I2CTransfer Transfer = {Register, Buffer, Length, false};
+    return Execute(Address, &Transfer, 1);
+}
+
+bool I2CBusHandler::WriteRegisters(uint8_t Address, uint8_t Register, const uint8_t* Buffer, size_t Length) {
+    I2CTransfer Transfer = {Register, const_cast<uint8_t*>(Buffer), Length, true};
+    return Execute(Address, &Transfer, 1);
+}
+
+bool I2CBusHandler::ReadRegister(uint8_t Address, uint8_t Register, uint8_t& Value) {
+    return ReadRegisters(Address, Register, &Value, 1);
+}
+
+bool I2CBusHandler::WriteRegister(uint8_t Address, uint8_t Register, uint8_t Value) {
+    return WriteRegisters(Address, Register, &Value, 1);
+}
+
+// Read-modify-write of the bits in Mask under one lock, so another task cannot
+// change the register between the read and the write
+bool I2CBusHandler::UpdateRegister(uint8_t Address, uint8_t Register, uint8_t Mask, uint8_t Value) {
+    if (!Lock()) {
+        LOG(ERROR, LogName, "Failed to acquire bus semaphore for device 0x" + String(Address, HEX));
+        return false;
+    }
+
+    int64_t StartTime = esp_timer_get_time();
+    uint8_t Current;
+    bool Success = RawRead(Address, Register, &Current, 1);
+    if (Success) {
+        Current = (Current & ~Mask) | (Value & Mask);
+        Success = RawWrite(Address, Register, &Current, 1);
+    }
+
+    UpdateStats(Address, StartTime, Success);
+    Unlock();
+    return Success;
+}
+
+// Runs all transfers under one lock. Reads of adjacent registers are merged into
+// a single burst read and scattered back into the callers' buffers.
+bool I2CBusHandler::Execute(uint8_t Address, I2CTransfer* Transfers, size_t Count) {
+    if (!Lock()) {
+        LOG(ERROR, LogName, "Failed to acquire bus semaphore for device 0x" + String(Address, HEX));
+        return false;
+    }
+
+    int64_t StartTime = esp_timer_get_time();
+    bool Success = true;
+    size_t i = 0;
+
+    while (Success && (i < Count)) {
+        if (Transfers[i].Write) {
+            Success = RawWrite(Address, Transfers[i].Register, Transfers[i].Buffer, Transfers[i].Length);
+            i++;
+            continue;
+        }
+
+        size_t Last = i;
+        size_t BurstLength = Transfers[i].Length;
+        while ((Last + 1 < Count) &&
+               !Transfers[Last + 1].Write &&
+               (Transfers[Last + 1].Register == Transfers[Last].Register + Transfers[Last].Length) &&
+               (BurstLength + Transfers[Last + 1].Length <= I2C_MAX_BURST_LENGTH)) {
+            Last++;
+            BurstLength += Transfers[Last].Length;
+        }
+
+        if (Last == i) {
+            Success = RawRead(Address, Transfers[i].Register, Transfers[i].Buffer, Transfers[i].Length);
+        } else {
+            uint8_t Burst[I2C_MAX_BURST_LENGTH];
+            Success = RawRead(Address, Transfers[i].Register, Burst, BurstLength);
+            size_t Offset = 0;
+            for (size_t j = i; Success && (j <= Last); j++) {
+                memcpy(Transfers[j].Buffer, &Burst[Offset], Transfers[j].Length);
+                Offset += Transfers[j].Length;
+            }
+        }
+        i = Last + 1;
+    }
+
+    UpdateStats(Address, StartTime, Success);
+    Unlock();
+    return Success;
+}
+
+bool I2CBusHandler::GetStats(uint8_t Address, I2CDeviceStats& Stats) {
+    bool Found = false;
+    if (!Lock()) {
+        return false;
+    }
+    for (uint8_t i = 0; i < DevicesCount; i++) {
+        if (Devices[i].Address == Address) {
+            Stats = Devices[i];
+            Found = true;
+            break;
+        }
+    }
+    Unlock();
+    return Found;
+}
+
+void I2CBusHandler::LogStats() {
+    for (uint8_t i = 0; i < DevicesCount; i++) {
+        const I2CDeviceStats& Device = Devices[i];
+        uint32_t AverageLatency = Device.Transactions ? static_cast<uint32_t>(Device.TotalLatency / Device.Transactions) : 0;
+        LOG(INFO, LogName, String(Device.Name) + " (0x" + String(Device.Address, HEX) + "): " + String(Device.Transactions) + " transactions, " + String(Device.Errors) + " errors, latency avg " + String(AverageLatency) + " us, max " + String(Device.MaxLatency) + " us");
+    }
+}
+
+bool I2CBusHandler::Lock() {
+    return xSemaphoreTake(BusSemaphore, pdMS_TO_TICKS(BusSemaphoreMaxTime)) == pdTRUE;
+}
+
+void I2CBusHandler::Unlock() {
+    xSemaphoreGive(BusSemaphore);
+}
+
+// Must be called with the bus locked
+I2CDeviceStats* I2CBusHandler::FindDevice(uint8_t Address) {
+    for (uint8_t i = 0; i < DevicesCount; i++) {
+        if (Devices[i].Address == Address) {
+            return &Devices[i];
+        }
+    }
+    if (DevicesCount < I2C_MAX_DEVICES) {
+        I2CDeviceStats* Device = &Devices[DevicesCount++];
+        Device->Address = Address;
+        snprintf(Device->Name, sizeof(Device->Name), "0x%02X", Address);
+        return Device;
+    }
+    return nullptr;
+}
+
+void I2CBusHandler::UpdateStats(uint8_t Address, int64_t StartTime, bool Success) {
+    I2CDeviceStats* Device = FindDevice(Address);
+    if (Device == nullptr) {
+        return;
+    }
+    uint32_t Latency = static_cast<uint32_t>(esp_timer_get_time() - StartTime);
+    Device->Transactions++;
+    Device->TotalLatency += Latency;
+    if (Latency > Device->MaxLatency) {
+        Device->MaxLatency = Latency;
+    }
+    if (!Success) {
+        Device->Errors++;
+    }
+}
+
+bool I2CBusHandler::RawRead(uint8_t Address, uint8_t Register, uint8_t* Buffer, size_t Length) {
+    Wire.beginTransmission(Address);
+    Wire.write(Register);
+    if (Wire.endTransmission(false) != 0) {
+        return false;
+    }
+    if (Wire.requestFrom(static_cast<uint16_t>(Address), Length, true) != Length) {
+        return false;
+    }
+    return Wire.readBytes(Buffer, Length) == Length;
+}
+
+bool I2CBusHandler::RawWrite(uint8_t Address, uint8_t Register, const uint8_t* Buffer, size_t Length) {
+    Wire.beginTransmission(Address);
+    Wire.write(Register);
+    Wire.write(Buffer, Length);
+    return Wire.endTransmission() == 0;
+}
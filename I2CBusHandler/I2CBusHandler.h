@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define I2C_MAX_DEVICES          8
+#define I2C_MAX_BURST_LENGTH     32    // bytes
+
+// One register access of a batch executed by I2CBusHandler::Execute()
+struct I2CTransfer {
+    uint8_t Register;
+    uint8_t* Buffer;
+    size_t Length;
+    bool Write;
+};
+
+struct I2CDeviceStats {
+    uint8_t Address;
+    char Name[16];
+    uint32_t Transactions;
+    uint32_t Errors;
+    uint64_t TotalLatency;   // microseconds
+    uint32_t MaxLatency;     // microseconds
+};
+
+// Owner of the Wire bus: every device handler goes through it, so transactions
+// from different tasks never interleave
+class I2CBusHandler {
+    public:
+        static I2CBusHandler& GetInstance();
+
+        bool Begin(int Sda = -1, int Scl = -1, uint32_t Frequency = 400000);
+        void RegisterDevice(uint8_t Address, const char* Name);
+
+        bool ReadRegisters(uint8_t Address, uint8_t Register, uint8_t* Buffer, size_t Length);
+        bool WriteRegisters(uint8_t Address, uint8_t Register, const uint8_t* Buffer, size_t Length);
+        bool ReadRegister(uint8_t Address, uint8_t Register, uint8_t& Value);
+        bool WriteRegister(uint8_t Address, uint8_t Register, uint8_t Value);
+        bool UpdateRegister(uint8_t Address, uint8_t Register, uint8_t Mask, uint8_t Value);
+        bool Execute(uint8_t Address, I2CTransfer* Transfers, size_t Count);
+
+        bool GetStats(uint8_t Address, I2CDeviceStats& Stats);
+        void LogStats();
+
+    private:
+        I2CBusHandler();
+        I2CBusHandler(const I2CBusHandler&) = delete;
+        void operator=(const I2CBusHandler&) = delete;
+
+        String LogName = "I2CBusHandler";
+
+        SemaphoreHandle_t BusSemaphore;
+        unsigned long BusSemaphoreMaxTime = 100;  // milliseconds
+        bool Started = false;
+
+        I2CDeviceStats Devices[I2C_MAX_DEVICES] = {};
+        uint8_t DevicesCount = 0;
+
+        bool Lock();
+        void Unlock();
+        I2CDeviceStats* FindDevice(uint8_t Address);
+        void UpdateStats(uint8_t Address, int64_t StartTime, bool Success);
+        bool RawRead(uint8_t Address, uint8_t Register, uint8_t* Buffer, size_t Length);
+        bool RawWrite(uint8_t Address, uint8_t Register, const uint8_t* Buffer, size_t Length);
+};
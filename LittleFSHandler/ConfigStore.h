@@ -0,0 +1,438 @@
+#ifndef CONFIG_STORE
+#define CONFIG_STORE
+
+#include <LittleFSHandler.h>
+
+#define CONFIG_STORE_MAX_KEYS             64
+#define CONFIG_STORE_TABLE_SIZE           128          // power of two, at least twice CONFIG_STORE_MAX_KEYS
+#define CONFIG_STORE_ARENA_SIZE           4096         // bytes
+#define CONFIG_STORE_MAX_KEY_LENGTH       32
+#define CONFIG_STORE_MAX_VALUE_LENGTH     128
+#define CONFIG_STORE_COMPACTION_THRESHOLD 4096         // bytes
+#define CONFIG_STORE_RECORD_MAGIC         0xC5
+
+enum ConfigTypeEnum : uint8_t {
+    CONFIG_DELETED,
+    CONFIG_INT,
+    CONFIG_UINT,
+    CONFIG_FLOAT,
+    CONFIG_BOOL,
+    CONFIG_STRING
+};
+
+// Persistent key-value store kept in a single log file. Every Set*() appends one
+// record (header + key + value); at boot the log is replayed with one sequential
+// read into a fixed-size RAM cache (open addressing hash table + key/value arena),
+// so getters never touch the file system nor allocate. When the log grows past
+// twice the live data it is rewritten atomically with only the live records.
+// A removed key keeps its entry and arena bytes until the cache is rebuilt from
+// the live entries, after every rewrite or when a new key does not fit.
+class ConfigStore {
+    public:
+        static ConfigStore& GetInstance() {
+            static ConfigStore Instance;
+            return Instance;
+        }
+
+        bool Begin(const String& Path = "/config.kv") {
+            xSemaphoreTake(Mutex, portMAX_DELAY);
+            LogPath = Path;
+            Clear();
+            bool Result = Load();
+            xSemaphoreGive(Mutex);
+            LOG(INFO, LogName, "Loaded " + String(GetKeyCount()) + " keys from " + LogPath + " (" + String(LogSize) + " bytes)");
+            return Result;
+        }
+
+        bool Contains(const char* Key) {
+            xSemaphoreTake(Mutex, portMAX_DELAY);
+            int Index = Find(Key, strlen(Key), Hash(Key, strlen(Key)));
+            bool Result = (Index >= 0) && (Entries[Index].Type != CONFIG_DELETED);
+            xSemaphoreGive(Mutex);
+            return Result;
+        }
+
+        bool GetInt(const char* Key, int32_t& Value)   { return Get(Key, CONFIG_INT, &Value, sizeof(Value)); }
+        bool GetUInt(const char* Key, uint32_t& Value) { return Get(Key, CONFIG_UINT, &Value, sizeof(Value)); }
+        bool GetFloat(const char* Key, float& Value)   { return Get(Key, CONFIG_FLOAT, &Value, sizeof(Value)); }
+        bool GetBool(const char* Key, bool& Value)     { return Get(Key, CONFIG_BOOL, &Value, sizeof(Value)); }
+
+        int32_t GetIntOr(const char* Key, int32_t Default)    { GetInt(Key, Default); return Default; }
+        uint32_t GetUIntOr(const char* Key, uint32_t Default) { GetUInt(Key, Default); return Default; }
+        float GetFloatOr(const char* Key, float Default)      { GetFloat(Key, Default); return Default; }
+        bool GetBoolOr(const char* Key, bool Default)         { GetBool(Key, Default); return Default; }
+
+        // Copies the value NUL terminated, fails if Buffer is too small
+        bool GetString(const char* Key, char* Buffer, size_t Size) {
+            xSemaphoreTake(Mutex, portMAX_DELAY);
+            int Index = Find(Key, strlen(Key), Hash(Key, strlen(Key)));
+            bool Result = (Index >= 0) && (Entries[Index].Type == CONFIG_STRING) && (Entries[Index].ValueLength < Size);
+            if (Result) {
+                const ConfigEntry& Entry = Entries[Index];
+                memcpy(Buffer, Arena + Entry.Offset + Entry.KeyLength, Entry.ValueLength);
+                Buffer[Entry.ValueLength] = '\0';
+            }
+            xSemaphoreGive(Mutex);
+            return Result;
+        }
+
+        bool SetInt(const char* Key, int32_t Value)   { return Set(Key, CONFIG_INT, &Value, sizeof(Value)); }
+        bool SetUInt(const char* Key, uint32_t Value) { return Set(Key, CONFIG_UINT, &Value, sizeof(Value)); }
+        bool SetFloat(const char* Key, float Value)   { return Set(Key, CONFIG_FLOAT, &Value, sizeof(Value)); }
+        bool SetBool(const char* Key, bool Value)     { return Set(Key, CONFIG_BOOL, &Value, sizeof(Value)); }
+        bool SetString(const char* Key, const char* Value) { return Set(Key, CONFIG_STRING, Value, strlen(Value)); }
+
+        bool Remove(const char* Key) {
+            return Set(Key, CONFIG_DELETED, "", 0);
+        }
+
+        bool Compact() {
+            xSemaphoreTake(Mutex, portMAX_DELAY);
+            bool Result = RewriteLog();
+            xSemaphoreGive(Mutex);
+            return Result;
+        }
+
+        uint32_t GetKeyCount() {
+            uint32_t Count = 0;
+            xSemaphoreTake(Mutex, portMAX_DELAY);
+            for (uint16_t i = 0; i < EntryCount; i++) {
+                if (Entries[i].Type != CONFIG_DELETED) {
+                    Count++;
+                }
+            }
+            xSemaphoreGive(Mutex);
+            return Count;
+        }
+
+        size_t GetLogSize() const {
+            return LogSize;
+        }
+
+        uint32_t GetCompactionCount() const {
+            return CompactionCount;
+        }
+
+    private:
+        struct __attribute__((packed)) RecordHeader {
+            uint8_t  Magic;
+            uint8_t  Type;
+            uint8_t  KeyLength;
+            uint8_t  ValueLength;
+            uint32_t Crc;          // over header (with Crc = 0), key and value
+        };
+
+        struct ConfigEntry {
+            uint32_t Hash;
+            uint16_t Offset;       // key followed by value in Arena
+            uint8_t  KeyLength;
+            uint8_t  ValueLength;
+            uint8_t  Capacity;     // bytes reserved for the value
+            uint8_t  Type;
+        };
+
+        String LogName = "ConfigStore";
+        String LogPath;
+        SemaphoreHandle_t Mutex = nullptr;
+
+        int16_t Table[CONFIG_STORE_TABLE_SIZE];
+        ConfigEntry Entries[CONFIG_STORE_MAX_KEYS];
+        uint16_t EntryCount = 0;
+        uint8_t Arena[CONFIG_STORE_ARENA_SIZE];
+        uint16_t ArenaUsed = 0;
+
+        size_t LogSize = 0;
+        uint32_t CompactionCount = 0;
+
+        ConfigStore() {
+            Mutex = xSemaphoreCreateMutex();
+            Clear();
+        }
+
+        ConfigStore(const ConfigStore&) = delete;
+        void operator=(const ConfigStore&) = delete;
+
+        static uint32_t Hash(const char* Key, size_t Length) {
+            uint32_t Value = 2166136261UL;  // FNV-1a
+            for (size_t i = 0; i < Length; i++) {
+                Value = (Value ^ static_cast<uint8_t>(Key[i])) * 16777619UL;
+            }
+            return Value;
+        }
+
+        static size_t RecordSize(const ConfigEntry& Entry) {
+            return sizeof(RecordHeader) + Entry.KeyLength + Entry.ValueLength;
+        }
+
+        void Clear() {
+            memset(Table, 0xFF, sizeof(Table));
+            EntryCount = 0;
+            ArenaUsed = 0;
+            LogSize = 0;
+        }
+
+        int Find(const char* Key, size_t KeyLength, uint32_t KeyHash) {
+            for (uint16_t Slot = KeyHash & (CONFIG_STORE_TABLE_SIZE - 1); Table[Slot] >= 0; Slot = (Slot + 1) & (CONFIG_STORE_TABLE_SIZE - 1)) {
+                const ConfigEntry& Entry = Entries[Table[Slot]];
+                if ((Entry.Hash == KeyHash) && (Entry.KeyLength == KeyLength) && (memcmp(Arena + Entry.Offset, Key, KeyLength) == 0)) {
+                    return Table[Slot];
+                }
+            }
+            return -1;
+        }
+
+        bool Get(const char* Key, uint8_t Type, void* Value, size_t Length) {
+            xSemaphoreTake(Mutex, portMAX_DELAY);
+            int Index = Find(Key, strlen(Key), Hash(Key, strlen(Key)));
+            bool Result = (Index >= 0) && (Entries[Index].Type == Type) && (Entries[Index].ValueLength == Length);
+            if (Result) {
+                memcpy(Value, Arena + Entries[Index].Offset + Entries[Index].KeyLength, Length);
+            }
+            xSemaphoreGive(Mutex);
+            return Result;
+        }
+
+        bool Set(const char* Key, uint8_t Type, const void* Value, size_t Length) {
+            size_t KeyLength = strlen(Key);
+            if ((KeyLength == 0) || (KeyLength > CONFIG_STORE_MAX_KEY_LENGTH) || (Length > CONFIG_STORE_MAX_VALUE_LENGTH)) {
+                LOG(ERROR, LogName, "Invalid key or value length for " + String(Key));
+                return false;
+            }
+
+            xSemaphoreTake(Mutex, portMAX_DELAY);
+            bool Result = Apply(Key, KeyLength, Type, reinterpret_cast<const uint8_t*>(Value), Length, true);
+            if (Result && (LogSize > CONFIG_STORE_COMPACTION_THRESHOLD) && (LogSize > 2 * LiveSize())) {
+                RewriteLog();
+            }
+            xSemaphoreGive(Mutex);
+            return Result;
+        }
+
+        // Updates the RAM cache, appending the record to the log first when Persist is set
+        bool Apply(const char* Key, size_t KeyLength, uint8_t Type, const uint8_t* Value, size_t Length, bool Persist) {
+            uint32_t KeyHash = Hash(Key, KeyLength);
+            int Index = Find(Key, KeyLength, KeyHash);
+
+            if (Index >= 0) {
+                const ConfigEntry& Entry = Entries[Index];
+                if ((Entry.Type == Type) && (Entry.ValueLength == Length) && (memcmp(Arena + Entry.Offset + KeyLength, Value, Length) == 0)) {
+                    return true;
+                }
+            } else if (Type == CONFIG_DELETED) {
+                return true;
+            }
+
+            int Offset = -1;
+            for (bool Rebuilt = false; ; Rebuilt = true) {
+                bool Fits = (Index >= 0) && (Length <= Entries[Index].Capacity);
+                bool TooManyKeys = (Index < 0) && (EntryCount >= CONFIG_STORE_MAX_KEYS);
+                if (!Fits && !TooManyKeys) {
+                    Offset = Allocate(KeyLength + Length);
+                    Fits = (Offset >= 0);
+                }
+                if (Fits) {
+                    break;
+                }
+                if (Rebuilt) {
+                    LOG(ERROR, LogName, String(TooManyKeys ? "Too many keys, " : "Cache full, ") + Key + " not stored");
+                    return false;
+                }
+                RebuildCache();
+                Index = Find(Key, KeyLength, KeyHash);
+            }
+
+            if (Persist && !AppendRecord(Key, KeyLength, Type, Value, Length)) {
+                return false;
+            }
+
+            if (Index < 0) {
+                Index = EntryCount++;
+                uint16_t Slot = KeyHash & (CONFIG_STORE_TABLE_SIZE - 1);
+                while (Table[Slot] >= 0) {
+                    Slot = (Slot + 1) & (CONFIG_STORE_TABLE_SIZE - 1);
+                }
+                Table[Slot] = Index;
+                Entries[Index].Hash = KeyHash;
+                Entries[Index].KeyLength = KeyLength;
+            }
+
+            ConfigEntry& Entry = Entries[Index];
+            if (Offset >= 0) {
+                memcpy(Arena + Offset, Key, KeyLength);
+                Entry.Offset = Offset;
+                Entry.Capacity = Length;
+            }
+            memcpy(Arena + Entry.Offset + KeyLength, Value, Length);
+            Entry.ValueLength = Length;
+            Entry.Type = Type;
+            return true;
+        }
+
+        // Reserves Size bytes at the end of the arena, packing it first if needed
+        int Allocate(size_t Size) {
+            if (ArenaUsed + Size > CONFIG_STORE_ARENA_SIZE) {
+                PackArena();
+            }
+            if (ArenaUsed + Size > CONFIG_STORE_ARENA_SIZE) {
+                return -1;
+            }
+            int Offset = ArenaUsed;
+            ArenaUsed += Size;
+            return Offset;
+        }
+
+        // Moves the entries down in offset order, dropping the space left by reallocated values
+        void PackArena() {
+            uint16_t Cursor = 0;
+            int32_t Last = -1;
+            for (uint16_t Moved = 0; Moved < EntryCount; Moved++) {
+                int Next = -1;
+                for (uint16_t i = 0; i < EntryCount; i++) {
+                    if ((Entries[i].Offset > Last) && ((Next < 0) || (Entries[i].Offset < Entries[Next].Offset))) {
+                        Next = i;
+                    }
+                }
+                ConfigEntry& Entry = Entries[Next];
+                Last = Entry.Offset;
+                memmove(Arena + Cursor, Arena + Entry.Offset, Entry.KeyLength + Entry.Capacity);
+                Entry.Offset = Cursor;
+                Cursor += Entry.KeyLength + Entry.Capacity;
+            }
+            ArenaUsed = Cursor;
+        }
+
+        // Drops the removed entries, then packs the arena and fills the table
+        // again from the entries left
+        void RebuildCache() {
+            uint16_t Kept = 0;
+            for (uint16_t i = 0; i < EntryCount; i++) {
+                if (Entries[i].Type != CONFIG_DELETED) {
+                    Entries[Kept++] = Entries[i];
+                }
+            }
+            EntryCount = Kept;
+            PackArena();
+
+            memset(Table, 0xFF, sizeof(Table));
+            for (uint16_t i = 0; i < EntryCount; i++) {
+                uint16_t Slot = Entries[i].Hash & (CONFIG_STORE_TABLE_SIZE - 1);
+                while (Table[Slot] >= 0) {
+                    Slot = (Slot + 1) & (CONFIG_STORE_TABLE_SIZE - 1);
+                }
+                Table[Slot] = i;
+            }
+        }
+
+        size_t LiveSize() {
+            size_t Size = 0;
+            for (uint16_t i = 0; i < EntryCount; i++) {
+                if (Entries[i].Type != CONFIG_DELETED) {
+                    Size += RecordSize(Entries[i]);
+                }
+            }
+            return Size;
+        }
+
+        static size_t EncodeRecord(uint8_t* Buffer, const char* Key, size_t KeyLength, uint8_t Type, const uint8_t* Value, size_t Length) {
+            RecordHeader Header = {CONFIG_STORE_RECORD_MAGIC, Type, static_cast<uint8_t>(KeyLength), static_cast<uint8_t>(Length), 0};
+            memcpy(Buffer, &Header, sizeof(Header));
+            memcpy(Buffer + sizeof(Header), Key, KeyLength);
+            memcpy(Buffer + sizeof(Header) + KeyLength, Value, Length);
+            Header.Crc = esp_rom_crc32_le(0, Buffer, sizeof(Header) + KeyLength + Length);
+            memcpy(Buffer, &Header, sizeof(Header));
+            return sizeof(Header) + KeyLength + Length;
+        }
+
+        bool AppendRecord(const char* Key, size_t KeyLength, uint8_t Type, const uint8_t* Value, size_t Length) {
+            uint8_t Record[sizeof(RecordHeader) + CONFIG_STORE_MAX_KEY_LENGTH + CONFIG_STORE_MAX_VALUE_LENGTH];
+            size_t Size = EncodeRecord(Record, Key, KeyLength, Type, Value, Length);
+
+            File LogFile = LittleFSHandler::GetInstance().OpenFile(LogPath, "a");
+            if (!LogFile) {
+                LOG(ERROR, LogName, "Failed to open " + LogPath);
+                return false;
+            }
+            size_t Written = LogFile.write(Record, Size);
+            LogFile.close();
+
+            LogSize += Written;
+            if (Written != Size) {
+                // A torn record is discarded at the next Load(), rewrite now to keep appending on a clean tail
+                LOG(ERROR, LogName, "Failed to append to " + LogPath);
+                RewriteLog();
+                return false;
+            }
+            return true;
+        }
+
+        bool Load() {
+            File LogFile = LittleFSHandler::GetInstance().OpenFile(LogPath, "r");
+            if (!LogFile) {
+                return true;
+            }
+
+            size_t FileSize = LogFile.size();
+            size_t ValidSize = 0;
+            uint8_t Record[sizeof(RecordHeader) + 255 + 255];
+            RecordHeader Header;
+
+            while (LogFile.read(Record, sizeof(Header)) == sizeof(Header)) {
+                memcpy(&Header, Record, sizeof(Header));
+                size_t Payload = Header.KeyLength + Header.ValueLength;
+                if ((Header.Magic != CONFIG_STORE_RECORD_MAGIC) || (LogFile.read(Record + sizeof(Header), Payload) != Payload)) {
+                    break;
+                }
+
+                uint32_t Crc = Header.Crc;
+                memset(Record + offsetof(RecordHeader, Crc), 0, sizeof(uint32_t));
+                if (esp_rom_crc32_le(0, Record, sizeof(Header) + Payload) != Crc) {
+                    break;
+                }
+
+                if ((Header.KeyLength > 0) && (Header.KeyLength <= CONFIG_STORE_MAX_KEY_LENGTH) && (Header.ValueLength <= CONFIG_STORE_MAX_VALUE_LENGTH)) {
+                    const char* Key = reinterpret_cast<const char*>(Record + sizeof(Header));
+                    Apply(Key, Header.KeyLength, Header.Type, Record + sizeof(Header) + Header.KeyLength, Header.ValueLength, false);
+                }
+                ValidSize += sizeof(Header) + Payload;
+            }
+            LogFile.close();
+
+            LogSize = ValidSize;
+            if (ValidSize != FileSize) {
+                LOG(WARNING, LogName, "Discarding " + String(FileSize - ValidSize) + " bytes of torn records in " + LogPath);
+                return RewriteLog();
+            }
+            return true;
+        }
+
+        // Writes only the live records to a new log through the atomic WriteFile()
+        bool RewriteLog() {
+            size_t Size = LiveSize();
+            uint8_t* Buffer = static_cast<uint8_t*>(malloc(Size > 0 ? Size : 1));
+            if (Buffer == nullptr) {
+                LOG(ERROR, LogName, "Not enough memory to compact " + LogPath);
+                return false;
+            }
+
+            size_t Length = 0;
+            for (uint16_t i = 0; i < EntryCount; i++) {
+                const ConfigEntry& Entry = Entries[i];
+                if (Entry.Type != CONFIG_DELETED) {
+                    const char* Key = reinterpret_cast<const char*>(Arena + Entry.Offset);
+                    Length += EncodeRecord(Buffer + Length, Key, Entry.KeyLength, Entry.Type, Arena + Entry.Offset + Entry.KeyLength, Entry.ValueLength);
+                }
+            }
+
+            bool Result = LittleFSHandler::GetInstance().WriteFile(LogPath, Buffer, Length);
+            free(Buffer);
+
+            if (Result) {
+                LogSize = Length;
+                CompactionCount++;
+                RebuildCache();
+            }
+            return Result;
+        }
+};
+
+#endif // CONFIG_STORE
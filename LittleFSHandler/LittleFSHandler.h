@@ -2,8 +2,16 @@
 #define LITTLE_FS_HANDLER
 
 #include <LittleFS.h>
+#include <esp_rom_crc.h>
 #include <LoggerHandler.h>
 
+#define LITTLE_FS_CHUNK_SIZE        4096         // bytes
+#define LITTLE_FS_TEMP_EXTENSION    ".tmp"
+#define LITTLE_FS_CHECKSUM_MAGIC    0x31435243   // "CRC1"
+
+// Return false to stop the walk
+typedef bool (*DirectoryEntryCallback)(void* Context, const char* Path, const char* Name, bool IsDirectory, size_t Size);
+
 class LittleFSHandler {
     public:
 
@@ -44,21 +52,118 @@ class LittleFSHandler {
             }
         }
 
-        bool WriteFile(const String& Path, const String& Content) {
-            LittleFS.remove(Path);
+        // The content is written to Path + ".tmp" and renamed over the target only
+        // once it is complete on flash, so a reset leaves either the old or the new
+        // file. With Checksum a CRC32 footer is appended, checked by ReadFile().
+        bool WriteFile(const String& Path, const String& Content, bool Checksum = false) {
+            return WriteFile(Path, reinterpret_cast<const uint8_t*>(Content.c_str()), Content.length(), Checksum);
+        }
+
+        bool WriteFile(const String& Path, const uint8_t* Data, size_t Length, bool Checksum = false) {
+            String TempPath = Path + LITTLE_FS_TEMP_EXTENSION;
+
+            File File = LittleFS.open(TempPath, "w");
+            if (!File) {
+                LOG(ERROR, LogName, "Failed to open file " + TempPath + " for writing");
+                return false;
+            }
+
+            size_t Written = 0;
+            while (Written < Length) {
+                size_t Chunk = min(Length - Written, static_cast<size_t>(LITTLE_FS_CHUNK_SIZE));
+                if (File.write(Data + Written, Chunk) != Chunk) {
+                    break;
+                }
+                Written += Chunk;
+            }
+
+            bool Success = (Written == Length);
+            if (Success && Checksum) {
+                uint32_t Footer[2] = {esp_rom_crc32_le(0, Data, Length), LITTLE_FS_CHECKSUM_MAGIC};
+                Success = (File.write(reinterpret_cast<const uint8_t*>(Footer), sizeof(Footer)) == sizeof(Footer));
+            }
+
+            File.flush();
+            File.close();
+
+            if (!Success) {
+                LOG(ERROR, LogName, "Failed to write file " + TempPath);
+                LittleFS.remove(TempPath);
+                return false;
+            }
+
+            if (!LittleFS.rename(TempPath, Path)) {
+                LOG(ERROR, LogName, "Failed to rename " + TempPath + " to " + Path);
+                LittleFS.remove(TempPath);
+                return false;
+            }
+
+            return true;
+        }
 
-            File File = LittleFS.open(Path, "w+");
+        bool ReadFile(const String& Path, String& Content, bool Checksum = false) {
+            File File = LittleFS.open(Path, "r");
             if (!File) {
-                LOG(ERROR, LogName, "Failed to open file " + Path + " for writing");
+                LOG(ERROR, LogName, "Failed to open file " + Path + " for reading");
+                return false;
+            }
+
+            size_t Length = File.size();
+            uint32_t Footer[2] = {0, 0};
+            if (Checksum) {
+                if (Length < sizeof(Footer)) {
+                    LOG(ERROR, LogName, "Missing checksum in file " + Path);
+                    File.close();
+                    return false;
+                }
+                Length -= sizeof(Footer);
+            }
+
+            Content = "";
+            if (!Content.reserve(Length)) {
+                LOG(ERROR, LogName, "Not enough memory to read file " + Path);
+                File.close();
                 return false;
             }
 
-            File.print(Content);
+            uint8_t Buffer[LITTLE_FS_CHUNK_SIZE / 8];
+            uint32_t Crc = 0;
+            size_t Read = 0;
+            while (Read < Length) {
+                size_t Chunk = File.read(Buffer, min(Length - Read, sizeof(Buffer)));
+                if (Chunk == 0) {
+                    break;
+                }
+                Crc = esp_rom_crc32_le(Crc, Buffer, Chunk);
+                Content.concat(reinterpret_cast<const char*>(Buffer), Chunk);
+                Read += Chunk;
+            }
+
+            if (Checksum) {
+                File.read(reinterpret_cast<uint8_t*>(Footer), sizeof(Footer));
+            }
             File.close();
 
+            if (Read != Length) {
+                LOG(ERROR, LogName, "Failed to read file " + Path);
+                return false;
+            }
+
+            if (Checksum && ((Footer[1] != LITTLE_FS_CHECKSUM_MAGIC) || (Footer[0] != Crc))) {
+                LOG(ERROR, LogName, "Checksum mismatch in file " + Path);
+                return false;
+            }
+
             return true;
         }
 
+        bool CreateDirectory(const String& Path) {
+            if (LittleFS.exists(Path)) {
+                return true;
+            }
+            return LittleFS.mkdir(Path);
+        }
+
         bool DeleteFile(const String& Path) {
             if (LittleFS.remove(Path)) {
                 return true;
@@ -75,36 +180,130 @@ class LittleFSHandler {
             return LittleFS.usedBytes();
         }
 
-        void PrintFilesAndDirectories(const String& Path = "/") {
-            Serial.println("Listing files in: " + Path);
-            File dir = LittleFS.open(Path);
-            if (!dir) {
-                Serial.println("Failed to open directory");
-                return;
+        // Calls Callback for every entry of Path (and of its subdirectories when
+        // Recursive is set) until it returns false; returns the number of entries
+        // visited. Path and Name are only valid during the call.
+        size_t ForEachEntry(const char* Path, DirectoryEntryCallback Callback, void* Context = nullptr, bool Recursive = false) {
+            size_t Count = 0;
+            if (Callback) {
+                WalkDirectory(Path, Callback, Context, Recursive, Count);
+            }
+            return Count;
+        }
+
+        size_t ForEachEntry(const String& Path, DirectoryEntryCallback Callback, void* Context = nullptr, bool Recursive = false) {
+            return ForEachEntry(Path.c_str(), Callback, Context, Recursive);
+        }
+
+        // Stateless chunk read for callers that track the offset themselves
+        // (e.g. the index of an AsyncWebServer chunked response)
+        size_t ReadChunk(const String& Path, size_t Offset, uint8_t* Buffer, size_t Length) {
+            File File = LittleFS.open(Path, "r");
+            if (!File) {
+                return 0;
+            }
+            size_t Read = 0;
+            if (File.seek(Offset)) {
+                Read = File.read(Buffer, Length);
             }
+            File.close();
+            return Read;
+        }
 
-            File entry = dir.openNextFile();
-            while (entry) {
-                if (entry.isDirectory()) {
-                    Serial.println("[DIR] " + String(entry.name()));
+        void PrintFilesAndDirectories(const String& Path = "/") {
+            Serial.println("Listing files in: " + Path);
+            size_t Count = ForEachEntry(Path, [](void*, const char*, const char* Name, bool IsDirectory, size_t Size) {
+                if (IsDirectory) {
+                    Serial.printf("[DIR] %s\n", Name);
                 } else {
-                    Serial.print("[FILE] " + String(entry.name()));
-                    Serial.print(" (Size: ");
-                    Serial.print(entry.size());
-                    Serial.println(" bytes)");
+                    Serial.printf("[FILE] %s (Size: %u bytes)\n", Name, static_cast<unsigned int>(Size));
                 }
-                entry = dir.openNextFile();
-                delay(10);
+                return true;
+            });
+            if (Count == 0) {
+                Serial.println("Empty or missing directory");
             }
         }
 
-
-
     private:
         String LogName = "LittleFSHandler";
+
+        bool WalkDirectory(const char* Path, DirectoryEntryCallback Callback, void* Context, bool Recursive, size_t& Count) {
+            File Directory = LittleFS.open(Path);
+            if (!Directory || !Directory.isDirectory()) {
+                return true;
+            }
+
+            bool Continue = true;
+            File Entry = Directory.openNextFile();
+            while (Entry && Continue) {
+                bool IsDirectory = Entry.isDirectory();
+                Count++;
+                Continue = Callback(Context, Entry.path(), Entry.name(), IsDirectory, IsDirectory ? 0 : Entry.size());
+                if (Continue && Recursive && IsDirectory) {
+                    Continue = WalkDirectory(Entry.path(), Callback, Context, Recursive, Count);
+                }
+                Entry.close();
+                if (Continue) {
+                    Entry = Directory.openNextFile();
+                }
+            }
+            Directory.close();
+            return Continue;
+        }
+
         LittleFSHandler(const LittleFSHandler&) = delete;
         void operator=(const LittleFSHandler&) = delete;
 
 };
 
+// Sequential reader over an open file that fills caller provided buffers, for
+// streaming files over HTTP or MQTT without building a String
+class LittleFSReader {
+    public:
+        LittleFSReader() {}
+        ~LittleFSReader() { Close(); }
+
+        bool Open(const String& Path) {
+            Close();
+            Handle = LittleFS.open(Path, "r");
+            return static_cast<bool>(Handle);
+        }
+
+        void Close() {
+            if (Handle) {
+                Handle.close();
+            }
+        }
+
+        bool IsOpen() {
+            return static_cast<bool>(Handle);
+        }
+
+        size_t Read(uint8_t* Buffer, size_t MaxLength) {
+            if (!Handle) {
+                return 0;
+            }
+            return Handle.read(Buffer, MaxLength);
+        }
+
+        bool Seek(size_t Position) {
+            return Handle && Handle.seek(Position);
+        }
+
+        size_t GetPosition() {
+            return Handle ? Handle.position() : 0;
+        }
+
+        size_t GetSize() {
+            return Handle ? Handle.size() : 0;
+        }
+
+    private:
+        File Handle;
+
+        LittleFSReader(const LittleFSReader&) = delete;
+        void operator=(const LittleFSReader&) = delete;
+};
+
 #endif // LITTLE_FS_HANDLER
\ No newline at end of file
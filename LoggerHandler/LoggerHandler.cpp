@@ -17,6 +17,19 @@ LoggerHandler::LoggerHandler()
     LogQueue = xQueueCreate(LoggerQueueSize, sizeof(LogEntry));
     xTaskCreatePinnedToCore(LoggerTask,           "LoggerTask",    4096, this, LoggerTaskPriority,           &LoggerTaskHandle,           0);
     xTaskCreatePinnedToCore(WebSerialServiceTask, "WebSerialTask", 4096, this, WebSerialServiceTaskPriority, &WebSerialServiceTaskHandle, 0);
+
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    MessagesMetric   = Metrics.AddCounter("logger_messages_total", "Log messages queued");
+    DroppedMetric    = Metrics.AddCounter("logger_dropped_total", "Log messages dropped because the queue was full");
+    QueueDepthMetric = Metrics.AddGauge("logger_queue_depth", "Log messages waiting to be written");
+    Metrics.AddCollector(CollectMetrics, this);
+    Metrics.AddTask("LoggerTask", LoggerTaskHandle);
+    Metrics.AddTask("WebSerialTask", WebSerialServiceTaskHandle);
+}
+
+void LoggerHandler::CollectMetrics(void* Context) {
+    LoggerHandler* self = reinterpret_cast<LoggerHandler*>(Context);
+    self->QueueDepthMetric->Set(uxQueueMessagesWaiting(self->LogQueue));
 }
 
 void LoggerHandler::SetWebServer(AsyncWebServer* server) {
@@ -42,6 +55,9 @@ void LoggerHandler::Log(LogType type, const String& functionName, const String&
 
     if (xQueueSend(LogQueue, &entry, 0) != pdTRUE) {
         delete entry; // queue full
+        DroppedMetric->Increment();
+    } else {
+        MessagesMetric->Increment();
     }
 }
 
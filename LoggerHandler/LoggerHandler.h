@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include <ESPAsyncWebServer.h>
+#include <MetricsRegistry.h>
 #include "DateTimeProvider.h"
 
 enum class LogTarget { SerialOnly, WebSerialOnly, Both };
@@ -62,6 +63,11 @@ class LoggerHandler {
         bool LogEnabled;
 
         QueueHandle_t LogQueue;
+
+        Metric* MessagesMetric;
+        Metric* DroppedMetric;
+        Metric* QueueDepthMetric;
+        static void CollectMetrics(void* Context);
         TaskHandle_t LoggerTaskHandle;
         TaskHandle_t WebSerialServiceTaskHandle;
 };
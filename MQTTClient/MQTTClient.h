@@ -3,6 +3,9 @@
 
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
+#include <System.h>
+#include <DeadlineTimer.h>
+#include <MetricsRegistry.h>
 #include <LoggerHandler.h>
 
 
@@ -55,6 +58,7 @@ class MQTTClient {
         unsigned long PostConnectionDelay = 5000; // milliseconds
         unsigned long PreSubscriptionDelay = 1000; // milliseconds
         bool Enabled = false;
+        DeadlineTimer StateTimer;
         uint8_t MaxTopics = 10;
         TopicCallbackPair* TopicCallbacks;
         int TopicsCallbackTasksPriority = 2;
@@ -68,6 +72,16 @@ class MQTTClient {
         ConnectionCallback OnConnectedCallback = nullptr;
         DisconnectionCallback OnDisconnectedCallback = nullptr;
 
+        // Metrics
+        Metric* ConnectionsMetric = nullptr;
+        Metric* PublishMetric = nullptr;
+        Metric* PublishFailuresMetric = nullptr;
+        Metric* ReceivedMetric = nullptr;
+        Metric* ConnectedMetric = nullptr;
+        Metric* FirstPublishMetric = nullptr;
+
+        int64_t FirstPublishTime = 0;  // microseconds since boot, 0 until the first publish
+
         void MqttCallback(char* Topic, byte* Payload, unsigned int Length);
         void SubscribeTopics();
         void UnsubscribeTopics();
@@ -99,6 +113,14 @@ MQTTClient::MQTTClient() : Client(EspClient), TopicCallbacks(new TopicCallbackPa
     KeepAliveSemaphore = xSemaphoreCreateBinary();
     xSemaphoreGive(KeepAliveSemaphore);
 
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    ConnectionsMetric     = Metrics.AddCounter("mqtt_connections_total", "Successful connections to the broker");
+    PublishMetric         = Metrics.AddCounter("mqtt_publish_total", "Messages published");
+    PublishFailuresMetric = Metrics.AddCounter("mqtt_publish_failures_total", "Messages that could not be published");
+    ReceivedMetric        = Metrics.AddCounter("mqtt_messages_received_total", "Messages received on subscribed topics");
+    ConnectedMetric       = Metrics.AddGauge("mqtt_connected", "1 when connected to the broker");
+    FirstPublishMetric    = Metrics.AddGauge("mqtt_boot_to_first_publish_milliseconds", "Time from boot, or wake-up, to the first successful publish");
+
     Client.setCallback([this](char* Topic, byte* Payload, unsigned int Length) {
         this->MqttCallback(Topic, Payload, Length);
     });
@@ -115,6 +137,7 @@ MQTTClient::MQTTClient() : Client(EspClient), TopicCallbacks(new TopicCallbackPa
 
     if (Task == pdPASS) {
         LOG(INFO, LogName, "Task created");
+        Metrics.AddTask("MQTT_HandlerTask", HandlerTaskPointer);
     } else {
         LOG(FATAL_ERROR, LogName, "Failed to create task");
     }
@@ -122,14 +145,17 @@ MQTTClient::MQTTClient() : Client(EspClient), TopicCallbacks(new TopicCallbackPa
 }
 
 MQTTClient::~MQTTClient() {
-    delete[] TopicCallbacks;
-    vSemaphoreDelete(KeepAliveSemaphore);
     LOG(INFO, LogName, "Instance deleted");
 
+    // The task uses the callbacks and the semaphore, it goes first
     if (HandlerTaskPointer != NULL) {
+        MetricsRegistry::GetInstance().RemoveTask(HandlerTaskPointer);
         LOG(INFO, LogName, "Task deleted");
         vTaskDelete(HandlerTaskPointer);
     }
+
+    delete[] TopicCallbacks;
+    vSemaphoreDelete(KeepAliveSemaphore);
 }
 
 void MQTTClient::Enable() {
@@ -188,15 +214,22 @@ bool MQTTClient::Subscribe(const String& Topic, void (*Callback)(char*, byte*, u
 bool MQTTClient::PublishString(const String& Topic, const String& Message) {
     bool Result = false;
     if (xSemaphoreTake(KeepAliveSemaphore, KeepAliveSemaphoreMaxTime / portTICK_PERIOD_MS)) {
-        bool Result = Client.publish(Topic.c_str(), Message.c_str(), 1);
+        Result = Client.publish(Topic.c_str(), Message.c_str(), 1);
         xSemaphoreGive(KeepAliveSemaphore);
     } else {
         LOG(FATAL_ERROR, LogName, "Failed to acquire KeepAliveSemaphore semaphore in PublishString");
     }
 
     if (Result) {
+        PublishMetric->Increment();
+        if (FirstPublishTime == 0) {
+            FirstPublishTime = esp_timer_get_time();
+            FirstPublishMetric->Set(FirstPublishTime / 1000.0f);
+            LOG(INFO, LogName, "First publish " + String(static_cast<long>(FirstPublishTime / 1000)) + " ms after " + (WarmBootStore::GetInstance().IsWarmBoot() ? "warm" : "cold") + " boot");
+        }
         LOG(INFO, LogName, "Data successfully sent to topic <<" + Topic + ">> with value = " + Message);
     } else {
+        PublishFailuresMetric->Increment();
         LOG(ERROR, LogName, "Failed to send data to topic <<" + Topic + ">>. Data = " + Message);
     }
     return Result;
@@ -209,6 +242,7 @@ bool MQTTClient::PublishJSON(const String& Topic, JsonDocument& Doc) {
 }
 
 void MQTTClient::MqttCallback(char* Topic, byte* Payload, unsigned int Length) {
+    ReceivedMetric->Increment();
     LOG(INFO, LogName, "Data successfully received from topic <<" + String(Topic) + ">>");
     for (int i = 0; i < TopicsCount; ++i) {
         if (strcmp(Topic, TopicCallbacks[i].Topic) == 0) {
@@ -272,24 +306,17 @@ void MQTTClient::UnsubscribeTopics() {
 
 void MQTTClient::HandlerTask(void *pvParameters) {
     MQTTClient *_this = reinterpret_cast<MQTTClient*>(pvParameters);
-    static unsigned long Timer = ZERO_TIME;
-    static unsigned long ClockTime = _this->ClockTime;
     MQTTClientStateEnum State = NOT_CONNECTED;
     bool Timeout;
 
     TickType_t StartTick, ExecutionTick, TaskTickPeriod;
-    TaskTickPeriod = ClockTime / portTICK_PERIOD_MS;
+    TaskTickPeriod = _this->ClockTime / portTICK_PERIOD_MS;
 
     while (true) {
 
         StartTick = xTaskGetTickCount();
 
-        if ((Timer - ClockTime) < ClockTime) {
-          Timer = ZERO_TIME;
-        } else {
-          Timer = Timer - ClockTime;
-        }
-        Timeout = (Timer == ZERO_TIME);
+        Timeout = _this->StateTimer.IsExpired();
 
         switch (State) {
             case NOT_CONNECTED:
@@ -306,7 +333,7 @@ void MQTTClient::HandlerTask(void *pvParameters) {
                     } else {
                         LOG(ERROR, LogName, "Failed to acquire KeepAliveSemaphore semaphore for Client.connect()");
                     }
-                    Timer = _this->ConnectionMaxTime;
+                    _this->StateTimer.Start(_this->ConnectionMaxTime);
                     State = CONNECTION_IN_PROGRESS;
                 }
                 break;
@@ -323,7 +350,8 @@ void MQTTClient::HandlerTask(void *pvParameters) {
                     State = NOT_CONNECTED;
                 } else if (Client.connected()) {
                     LOG(INFO, LogName, "Successfully connected to " + String(ServerAddress) + ":" + String(ServerPort));
-                    Timer = _this->PostConnectionDelay;
+                    ConnectionsMetric->Increment();
+                    _this->StateTimer.Start(_this->PostConnectionDelay);
                     State = POST_CONNECTION_DELAY;
                 }
                 break;
@@ -342,7 +370,7 @@ void MQTTClient::HandlerTask(void *pvParameters) {
                     if (_this->OnConnectedCallback) {
                         _this->OnConnectedCallback();
                     }
-                    Timer = _this->PreSubscriptionDelay;
+                    _this->StateTimer.Start(_this->PreSubscriptionDelay);
                     State = PRE_SUBSCRIPTION_DELAY;
                 }
                 break;
@@ -392,6 +420,8 @@ void MQTTClient::HandlerTask(void *pvParameters) {
             LOG(ERROR, LogName, "Failed to acquire KeepAliveSemaphore semaphore for Client.loop()");
         }
 
+        ConnectedMetric->Set(State == CONNECTED ? 1 : 0);
+
         ExecutionTick = xTaskGetTickCount() - StartTick;
 
         if (ExecutionTick < TaskTickPeriod) {
@@ -0,0 +1,221 @@
+#include "MetricsRegistry.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+Metric::Metric(const char* Name, const char* Help, MetricTypeEnum Type, const String& Labels)
+    : Name(Name), Help(Help), Type(Type), Labels(Labels), Value(0) {
+}
+
+void Metric::Increment(uint32_t Amount) {
+    Value.fetch_add(Amount, std::memory_order_relaxed);
+}
+
+void Metric::Set(float NewValue) {
+    uint32_t Bits;
+    memcpy(&Bits, &NewValue, sizeof(Bits));
+    Value.store(Bits, std::memory_order_relaxed);
+}
+
+uint32_t Metric::GetCount() const {
+    return Value.load(std::memory_order_relaxed);
+}
+
+float Metric::GetValue() const {
+    uint32_t Bits = Value.load(std::memory_order_relaxed);
+    float Result;
+    memcpy(&Result, &Bits, sizeof(Result));
+    return Result;
+}
+
+const char* Metric::GetName() const {
+    return Name;
+}
+
+const char* Metric::GetHelp() const {
+    return Help;
+}
+
+MetricTypeEnum Metric::GetType() const {
+    return Type;
+}
+
+const String& Metric::GetLabels() const {
+    return Labels;
+}
+
+MetricsRegistry& MetricsRegistry::GetInstance() {
+    static MetricsRegistry Instance;
+    return Instance;
+}
+
+MetricsRegistry::MetricsRegistry() {
+    Mutex = xSemaphoreCreateMutex();
+    HeapFree         = AddGauge("heap_free_bytes", "Free heap");
+    HeapMinimumFree  = AddGauge("heap_minimum_free_bytes", "Lowest free heap since boot");
+    HeapLargestBlock = AddGauge("heap_largest_free_block_bytes", "Largest allocatable heap block");
+    Uptime           = AddGauge("uptime_seconds", "Time since boot");
+}
+
+Metric* MetricsRegistry::AddCounter(const char* Name, const char* Help, const String& Labels) {
+    return Add(Name, Help, METRIC_COUNTER, Labels);
+}
+
+Metric* MetricsRegistry::AddGauge(const char* Name, const char* Help, const String& Labels) {
+    return Add(Name, Help, METRIC_GAUGE, Labels);
+}
+
+void MetricsRegistry::AddTask(const char* Name, TaskHandle_t Task) {
+    if (Task == nullptr) return;
+    Metric* StackFree = AddGauge("task_stack_free_bytes", "Minimum free stack of the task since it started", "task=\"" + String(Name) + "\"");
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    Tasks.push_back({Task, StackFree});
+    xSemaphoreGive(Mutex);
+}
+
+void MetricsRegistry::AddCollector(MetricsCollector Callback, void* Context) {
+    if (Callback == nullptr) return;
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    Collectors.push_back({Callback, Context});
+    xSemaphoreGive(Mutex);
+}
+
+void MetricsRegistry::RemoveTask(TaskHandle_t Task) {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    for (auto Iterator = Tasks.begin(); Iterator != Tasks.end(); ) {
+        Iterator = (Iterator->Task == Task) ? Tasks.erase(Iterator) : Iterator + 1;
+    }
+    xSemaphoreGive(Mutex);
+}
+
+void MetricsRegistry::RemoveCollector(MetricsCollector Callback, void* Context) {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    for (auto Iterator = Collectors.begin(); Iterator != Collectors.end(); ) {
+        Iterator = ((Iterator->Callback == Callback) && (Iterator->Context == Context)) ? Collectors.erase(Iterator) : Iterator + 1;
+    }
+    xSemaphoreGive(Mutex);
+}
+
+size_t MetricsRegistry::GetMetricCount() {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    size_t Count = Metrics.size();
+    xSemaphoreGive(Mutex);
+    return Count;
+}
+
+String MetricsRegistry::EscapeLabelValue(const String& Value) {
+    String Result;
+    Result.reserve(Value.length());
+    for (size_t i = 0; i < Value.length(); i++) {
+        char Character = Value[i];
+        if ((Character == '\\') || (Character == '"')) {
+            Result += '\\';
+            Result += Character;
+        } else if (Character == '\n') {
+            Result += "\\n";
+        } else {
+            Result += Character;
+        }
+    }
+    return Result;
+}
+
+// Returns 0 once every metric has been written, and only then
+size_t MetricsRegistry::Render(MetricsCursor& Cursor, uint8_t* Buffer, size_t MaxLength) {
+    size_t Written = 0;
+
+    if (!Cursor.Collected) {
+        Collect();
+        xSemaphoreTake(Mutex, portMAX_DELAY);
+        Cursor.Snapshot = Metrics;
+        xSemaphoreGive(Mutex);
+        Cursor.Collected = true;
+    }
+
+    // Metrics are never freed, the snapshot can be read without the mutex
+    while (Written < MaxLength) {
+        if (Cursor.LineOffset == Cursor.LineLength) {
+            if (Cursor.Index >= Cursor.Snapshot.size()) {
+                break;
+            }
+            int Length = FormatMetric(Cursor.Snapshot, Cursor.Index++, Cursor.Line, sizeof(Cursor.Line));
+            Cursor.LineLength = (Length < 0) ? 0 : Length;
+            Cursor.LineOffset = 0;
+            continue;
+        }
+        size_t Chunk = min(MaxLength - Written, Cursor.LineLength - Cursor.LineOffset);
+        memcpy(Buffer + Written, Cursor.Line + Cursor.LineOffset, Chunk);
+        Written += Chunk;
+        Cursor.LineOffset += Chunk;
+    }
+
+    return Written;
+}
+
+Metric* MetricsRegistry::Add(const char* Name, const char* Help, MetricTypeEnum Type, const String& Labels) {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+
+    for (Metric* Existing : Metrics) {
+        if ((strcmp(Existing->GetName(), Name) == 0) && (Existing->GetLabels() == Labels)) {
+            xSemaphoreGive(Mutex);
+            return Existing;
+        }
+    }
+
+    // Keep the series of one name next to each other, HELP and TYPE are written once per group
+    auto Position = Metrics.end();
+    for (auto Iterator = Metrics.begin(); Iterator != Metrics.end(); ++Iterator) {
+        if (strcmp((*Iterator)->GetName(), Name) == 0) {
+            Position = Iterator + 1;
+        }
+    }
+
+    Metric* NewMetric = new Metric(Name, Help, Type, Labels);
+    Metrics.insert(Position, NewMetric);
+
+    xSemaphoreGive(Mutex);
+    return NewMetric;
+}
+
+void MetricsRegistry::Collect() {
+    HeapFree->Set(heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+    HeapMinimumFree->Set(heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+    HeapLargestBlock->Set(heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+    Uptime->Set(esp_timer_get_time() / 1000000LL);
+
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    std::vector<CollectorEntry> Callbacks = Collectors;
+    for (const TaskEntry& Entry : Tasks) {
+        // On ESP-IDF the high water mark is already in bytes
+        Entry.StackFree->Set(uxTaskGetStackHighWaterMark(Entry.Task));
+    }
+    xSemaphoreGive(Mutex);
+
+    for (const CollectorEntry& Entry : Callbacks) {
+        Entry.Callback(Entry.Context);
+    }
+}
+
+int MetricsRegistry::FormatMetric(const std::vector<Metric*>& List, size_t Index, char* Line, size_t Size) {
+    const Metric* Current = List[Index];
+    int Length = 0;
+
+    if ((Index == 0) || (strcmp(List[Index - 1]->GetName(), Current->GetName()) != 0)) {
+        Length = snprintf(Line, Size, "# HELP %s %s\n# TYPE %s %s\n", Current->GetName(), Current->GetHelp(), Current->GetName(), (Current->GetType() == METRIC_COUNTER) ? "counter" : "gauge");
+        if ((Length < 0) || (static_cast<size_t>(Length) >= Size)) {
+            return -1;
+        }
+    }
+
+    const char* Open = (Current->GetLabels().length() > 0) ? "{" : "";
+    const char* Close = (Current->GetLabels().length() > 0) ? "}" : "";
+    int Sample;
+    if (Current->GetType() == METRIC_COUNTER) {
+        Sample = snprintf(Line + Length, Size - Length, "%s%s%s%s %lu\n", Current->GetName(), Open, Current->GetLabels().c_str(), Close, static_cast<unsigned long>(Current->GetCount()));
+    } else {
+        Sample = snprintf(Line + Length, Size - Length, "%s%s%s%s %g\n", Current->GetName(), Open, Current->GetLabels().c_str(), Close, static_cast<double>(Current->GetValue()));
+    }
+    if ((Sample < 0) || (static_cast<size_t>(Sample) >= (Size - Length))) {
+        return -1;
+    }
+    return Length + Sample;
+}
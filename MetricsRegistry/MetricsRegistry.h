@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <Arduino.h>
+
+#define METRICS_MAX_LINE_LENGTH  320  // char, HELP + TYPE + sample of one metric
+
+enum MetricTypeEnum {
+    METRIC_COUNTER,
+    METRIC_GAUGE
+};
+
+// A single time series. Updates are one relaxed atomic operation, so handlers
+// can call them from any task on the hot path; gauges hold a float.
+class Metric {
+    public:
+        Metric(const char* Name, const char* Help, MetricTypeEnum Type, const String& Labels);
+
+        void Increment(uint32_t Amount = 1);
+        void Set(float Value);
+
+        uint32_t GetCount() const;
+        float GetValue() const;
+
+        const char* GetName() const;
+        const char* GetHelp() const;
+        MetricTypeEnum GetType() const;
+        const String& GetLabels() const;
+
+    private:
+        const char* Name;
+        const char* Help;
+        MetricTypeEnum Type;
+        String Labels;
+        std::atomic<uint32_t> Value;  // count, or float bits for gauges
+};
+
+// Scrape state. The metric list is copied on the first Render() call, so
+// metrics registered while a response is streamed cannot shift the index.
+// A line that does not fit the buffer is kept here and continued in the next one.
+struct MetricsCursor {
+    size_t Index = 0;
+    bool Collected = false;
+    std::vector<Metric*> Snapshot;
+    char Line[METRICS_MAX_LINE_LENGTH];
+    size_t LineLength = 0;
+    size_t LineOffset = 0;
+};
+
+// Called before every scrape to refresh gauges that are cheaper to sample than to track
+typedef void (*MetricsCollector)(void* Context);
+
+// Process-wide registry rendered in the Prometheus text format. Metrics are
+// registered once (Name and Help must be string literals) and never removed,
+// so the returned pointers stay valid; registering the same name and labels
+// again returns the existing metric. Render() fills the caller buffer,
+// splitting lines where needed, and resumes from the cursor, to fill a
+// chunked HTTP response.
+class MetricsRegistry {
+    public:
+        static MetricsRegistry& GetInstance();
+
+        Metric* AddCounter(const char* Name, const char* Help, const String& Labels = "");
+        Metric* AddGauge(const char* Name, const char* Help, const String& Labels = "");
+        void AddTask(const char* Name, TaskHandle_t Task);
+        void AddCollector(MetricsCollector Callback, void* Context = nullptr);
+        // Call before the task is deleted, or the next scrape reads a freed TCB
+        void RemoveTask(TaskHandle_t Task);
+        void RemoveCollector(MetricsCollector Callback, void* Context = nullptr);
+
+        size_t Render(MetricsCursor& Cursor, uint8_t* Buffer, size_t MaxLength);
+        size_t GetMetricCount();
+
+        // Escapes backslash, double quote and newline for use inside a label value
+        static String EscapeLabelValue(const String& Value);
+
+    private:
+        struct TaskEntry {
+            TaskHandle_t Task;
+            Metric* StackFree;
+        };
+
+        struct CollectorEntry {
+            MetricsCollector Callback;
+            void* Context;
+        };
+
+        SemaphoreHandle_t Mutex = nullptr;
+        std::vector<Metric*> Metrics;
+        std::vector<TaskEntry> Tasks;
+        std::vector<CollectorEntry> Collectors;
+
+        Metric* HeapFree = nullptr;
+        Metric* HeapMinimumFree = nullptr;
+        Metric* HeapLargestBlock = nullptr;
+        Metric* Uptime = nullptr;
+
+        MetricsRegistry();
+        MetricsRegistry(const MetricsRegistry&) = delete;
+        void operator=(const MetricsRegistry&) = delete;
+
+        Metric* Add(const char* Name, const char* Help, MetricTypeEnum Type, const String& Labels);
+        void Collect();
+        static int FormatMetric(const std::vector<Metric*>& List, size_t Index, char* Line, size_t Size);
+};
@@ -3,13 +3,43 @@
 
 NtpHandler* NtpHandler::StaticInstance = nullptr;
 
-NtpHandler::NtpHandler()
-    : NtpClient(Udp, "pool.ntp.org", 0, 60000) {
+NtpHandler::NtpHandler() {
     LOG(INFO, LogName, "Instance created");
+
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    SyncMetric         = Metrics.AddCounter("ntp_syncs_total", "SNTP bursts that disciplined the clock");
+    SynchronizedMetric = Metrics.AddGauge("ntp_synchronized", "1 while the time is synchronized to the server");
+    SyncAgeMetric      = Metrics.AddGauge("ntp_last_sync_age_seconds", "Time since the last successful synchronization, -1 if never");
+    OffsetMetric       = Metrics.AddGauge("ntp_offset_microseconds", "Clock offset measured by the last synchronization");
+    DelayMetric        = Metrics.AddGauge("ntp_delay_microseconds", "Round trip delay of the last synchronization");
+    Metrics.AddCollector(CollectMetrics, this);
+
+    RestoreWarmTime();
+    WarmBootStore::GetInstance().AddSaveCallback(SaveWarmTime, this);
+
     xTaskCreatePinnedToCore(HandlerTaskStatic, "Ntp_HandlerTask", 8192, this, HandlerTaskPriority, &HandlerTaskPointer, 1);
+    Metrics.AddTask("Ntp_HandlerTask", HandlerTaskPointer);
     LOG(INFO, LogName, "Handler task created");
 }
 
+NtpHandler::~NtpHandler() {
+    WarmBootStore::GetInstance().RemoveSaveCallback(SaveWarmTime, this);
+    MetricsRegistry::GetInstance().RemoveCollector(CollectMetrics, this);
+    if (HandlerTaskPointer != nullptr) {
+        MetricsRegistry::GetInstance().RemoveTask(HandlerTaskPointer);
+        vTaskDelete(HandlerTaskPointer);
+    }
+    LOG(INFO, LogName, "Instance deleted");
+}
+
+void NtpHandler::CollectMetrics(void* Context) {
+    NtpHandler* Instance = reinterpret_cast<NtpHandler*>(Context);
+    Instance->SynchronizedMetric->Set(Instance->Connected ? 1 : 0);
+    Instance->SyncAgeMetric->Set((Instance->LastSyncTime == 0) ? -1 : (esp_timer_get_time() - Instance->LastSyncTime) / SECONDS_TO_MICROSECONDS);
+    Instance->OffsetMetric->Set(Instance->Sntp.GetLastOffset());
+    Instance->DelayMetric->Set(Instance->Sntp.GetLastDelay());
+}
+
 NtpHandler* NtpHandler::GetInstance() {
     if (StaticInstance == nullptr) {
         StaticInstance = new NtpHandler();
@@ -39,10 +69,33 @@ bool NtpHandler::IsConnected() {
 }
 
 void NtpHandler::SetGmtOffset(int GmtOffsetHours) {
-    NtpClient.setTimeOffset(GmtOffsetHours * 3600);
+    GmtOffset = GmtOffsetHours * 3600;
     LOG(INFO, LogName, "GMT offset set to " + String(GmtOffsetHours) + " hours");
 }
 
+void NtpHandler::SetServer(const String& Server, uint16_t Port) {
+    Sntp.SetServer(Server, Port);
+    LOG(INFO, LogName, "Server set to " + Server + ":" + String(Port));
+}
+
+void NtpHandler::SetUpdateInterval(unsigned long Interval) {
+    UpdateInterval = Interval;
+    Sntp.SetResolveRetryInterval(Interval);
+    LOG(INFO, LogName, "Update interval set to " + String(Interval) + " ms");
+}
+
+int64_t NtpHandler::GetLastOffset() {
+    return Sntp.GetLastOffset();
+}
+
+int64_t NtpHandler::GetLastDelay() {
+    return Sntp.GetLastDelay();
+}
+
+float NtpHandler::GetFrequencyError() {
+    return Sntp.GetFrequencyError();
+}
+
 void NtpHandler::SetOnSyncCallback(TimeSyncCallback Callback) {
     OnSyncCallback = Callback;
 }
@@ -52,13 +105,50 @@ void NtpHandler::SetOnDesyncCallback(TimeSyncCallback Callback) {
 }
 
 String NtpHandler::GetFormattedTime(const String& Format) {
-    unsigned long RawTime = NtpClient.getEpochTime();
-    struct tm* TimeInfo = localtime(reinterpret_cast<time_t*>(&RawTime));
+    time_t RawTime = GetEpochTime() + GmtOffset;
+    struct tm* TimeInfo = localtime(&RawTime);
     char Buffer[64];
     strftime(Buffer, sizeof(Buffer), Format.c_str(), TimeInfo);
     return String(Buffer);
 }
 
+void NtpHandler::SaveWarmTime(void* Context) {
+    NtpHandler* Instance = reinterpret_cast<NtpHandler*>(Context);
+    if (!Instance->IsTimeValid()) {
+        return;
+    }
+    WarmTimeStruct WarmTime;
+    WarmTime.Clock = WarmBootStore::GetPersistentClock();
+    WarmTime.Epoch = Instance->GetEpochMicroseconds();
+    WarmTime.FrequencyError = static_cast<int32_t>(Instance->Sntp.GetFrequencyError() * 1000);
+    WarmBootStore::GetInstance().Save("ntp", &WarmTime, sizeof(WarmTime));
+}
+
+// The time slept is measured by the RTC timer, whose RC oscillator is far less
+// accurate than the disciplined clock: the restored time is valid from boot but
+// only until the first synchronization replaces it
+void NtpHandler::RestoreWarmTime() {
+    WarmBootStore& WarmBoot = WarmBootStore::GetInstance();
+    WarmTimeStruct WarmTime;
+    if (!WarmBoot.IsWarmBoot() || !WarmBoot.Load("ntp", &WarmTime, sizeof(WarmTime))) {
+        return;
+    }
+    int64_t Elapsed = WarmBootStore::GetPersistentClock() - WarmTime.Clock;
+    SetTimeBase(WarmTime.Epoch + Elapsed, esp_timer_get_time(), WarmTime.FrequencyError);
+    // The crystal has not changed, the next bursts refine the estimate instead of starting from zero
+    Sntp.SetFrequencyError(WarmTime.FrequencyError / 1000.0f);
+    LOG(INFO, LogName, "Time base restored from warm boot: " + GetFormattedTime("%d/%m/%Y %H:%M:%S"));
+}
+
+// Hand the current linear segment of the SNTP clock to the DateTimeProvider time base
+void NtpHandler::PublishTimeBase() {
+    int64_t Now = esp_timer_get_time();
+    int64_t Epoch;
+    int32_t Rate;
+    TimeBaseRefreshTime = Sntp.GetTimeBase(Now, Epoch, Rate);
+    SetTimeBase(Epoch, Now, Rate);
+}
+
 void NtpHandler::HandlerTaskStatic(void* pvParameters) {
     NtpHandler* instance = reinterpret_cast<NtpHandler*>(pvParameters);
     instance->HandlerTask();
@@ -66,71 +156,84 @@ void NtpHandler::HandlerTaskStatic(void* pvParameters) {
 
 void NtpHandler::HandlerTask() {
     TickType_t StartTick, ExecutionTick, TaskTickPeriod;
-    TaskTickPeriod = TaskPeriodMs / portTICK_PERIOD_MS;
 
-    static unsigned long Timer = ZERO_TIME;
-    static unsigned long ClockTime = TaskPeriodMs;
     bool Timeout;
+    bool Synchronized;
 
     NtpStateEnum State = NOT_CONNECTED;
 
     while (true) {
         StartTick = xTaskGetTickCount();
 
-        if ((Timer - ClockTime) < ClockTime) {
-            Timer = ZERO_TIME;
-        } else {
-            Timer -= ClockTime;
+        Timeout = StateTimer.IsExpired();
+        Synchronized = Sntp.Process();
+        if (Synchronized || ((TimeBaseRefreshTime != 0) && (esp_timer_get_time() >= TimeBaseRefreshTime))) {
+            PublishTimeBase();
+        }
+        if (Synchronized) {
+            LastSyncTime = esp_timer_get_time();
+            SyncMetric->Increment();
         }
-        Timeout = (Timer == ZERO_TIME);
 
         switch (State) {
             case NOT_CONNECTED:
                 if (Enabled) {
-                    NtpClient.setUpdateInterval(UpdateInterval);
-                    NtpClient.begin();
+                    Sntp.Begin();
+                    Sntp.StartBurst();
                     LOG(INFO, LogName, "Time sync starting");
-                    Timer = ConnectionMaxTime;
+                    StateTimer.Start(ConnectionMaxTime);
                     State = CONNECTION_IN_PROGRESS;
                 }
                 break;
 
             case CONNECTION_IN_PROGRESS:
-                if (Timeout) {
-                    LOG(WARNING, LogName, "Time sync timeout");
-                    NtpClient.end();
-                    State = NOT_CONNECTED;
-                } else if (!Enabled) {
+                if (!Enabled) {
                     LOG(INFO, LogName, "Time sync stopping");
-                    NtpClient.end();
+                    Sntp.End();
                     State = NOT_CONNECTED;
-                } else if (NtpClient.forceUpdate()) {
-                    LOG(INFO, LogName, "Time synchronized: current date and time is " + GetFormattedTime("%d/%m/%Y %H:%M:%S"));
+                } else if (Synchronized) {
+                    LOG(INFO, LogName, "Time synchronized: current date and time is " + GetFormattedTime("%d/%m/%Y %H:%M:%S") + " - offset " + String(static_cast<long>(Sntp.GetLastOffset())) + " us, delay " + String(static_cast<long>(Sntp.GetLastDelay())) + " us");
                     if (OnSyncCallback) OnSyncCallback();
-                    Timer = UpdateInterval + FiveSeconds;
+                    UpdateTimer.Start(UpdateInterval);
+                    StateTimer.Start(UpdateInterval + ConnectionMaxTime);
                     State = CONNECTED;
+                } else if (Timeout) {
+                    LOG(WARNING, LogName, "Time sync timeout");
+                    Sntp.End();
+                    State = NOT_CONNECTED;
+                } else if (!Sntp.IsBurstActive()) {
+                    Sntp.StartBurst();
                 }
                 break;
 
             case CONNECTED:
                 if (!Enabled) {
                     if (OnDesyncCallback) OnDesyncCallback();
-                    NtpClient.end();
+                    Sntp.End();
                     LOG(INFO, LogName, "Time sync stopped");
                     State = NOT_CONNECTED;
+                } else if (Synchronized) {
+                    StateTimer.Start(UpdateInterval + ConnectionMaxTime);
                 } else if (Timeout) {
                     LOG(WARNING, LogName, "Time synchronization lost");
                     if (OnDesyncCallback) OnDesyncCallback();
-                    NtpClient.end();
+                    Sntp.End();
                     State = NOT_CONNECTED;
-                } else if (NtpClient.update()) {
-                    Timer = UpdateInterval + FiveSeconds;
+                } else if (UpdateTimer.IsExpired() && !Sntp.IsBurstActive()) {
+                    Sntp.StartBurst();
+                    UpdateTimer.Start(UpdateInterval);
                 }
                 break;
         }
 
         Connected = (State == CONNECTED);
 
+        // Poll the socket quickly while a reply is expected, so the arrival timestamp stays accurate
+        TaskTickPeriod = (Sntp.IsRequestPending() ? FastTaskPeriodMs : TaskPeriodMs) / portTICK_PERIOD_MS;
+        if (TaskTickPeriod == 0) {
+            TaskTickPeriod = 1;
+        }
+
         ExecutionTick = xTaskGetTickCount() - StartTick;
         if (ExecutionTick < TaskTickPeriod) {
             vTaskDelay(TaskTickPeriod - ExecutionTick);
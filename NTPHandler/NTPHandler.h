@@ -1,8 +1,9 @@
 #pragma once
 
-#include <NTPClient.h>
-#include <WiFiUdp.h>
 #include <System.h>
+#include <DeadlineTimer.h>
+#include <MetricsRegistry.h>
+#include "SntpClient.h"
 #include "DateTimeProvider.h"
 
 typedef void (*TimeSyncCallback)();
@@ -17,25 +18,47 @@ private:
         CONNECTED
     };
 
-    WiFiUDP Udp;
-    NTPClient NtpClient;
+    SntpClient Sntp;
     TaskHandle_t HandlerTaskPointer = nullptr;
     int HandlerTaskPriority = 4;
     unsigned long TaskPeriodMs      = 100;   // milliseconds
+    unsigned long FastTaskPeriodMs  = 2;     // milliseconds, while waiting for a reply
     unsigned long ConnectionMaxTime = 10000; // milliseconds
     unsigned long UpdateInterval    = 60000; // milliseconds
-    unsigned long FiveSeconds       = 5000;  // milliseconds
+    long GmtOffset = 0;                      // seconds
     bool Enabled = false;
     bool Connected = false;
+    DeadlineTimer StateTimer;
+    DeadlineTimer UpdateTimer;
+    int64_t TimeBaseRefreshTime = 0;         // esp_timer_get_time() at which the slew ends, microseconds
+    int64_t LastSyncTime = 0;                // esp_timer_get_time() of the last disciplined sample, microseconds
+
+    Metric* SyncMetric = nullptr;
+    Metric* SynchronizedMetric = nullptr;
+    Metric* SyncAgeMetric = nullptr;
+    Metric* OffsetMetric = nullptr;
+    Metric* DelayMetric = nullptr;
 
     TimeSyncCallback OnSyncCallback = nullptr;
     TimeSyncCallback OnDesyncCallback = nullptr;
 
+    // Time base carried across a retained hibernation
+    struct WarmTimeStruct {
+        int64_t Epoch;          // microseconds since 1970
+        int64_t Clock;          // WarmBootStore::GetPersistentClock() at the same instant
+        int32_t FrequencyError; // ppb
+    };
+
     static NtpHandler* StaticInstance;
 
     NtpHandler();
+    ~NtpHandler();
     static void HandlerTaskStatic(void *pvParameters);
     void HandlerTask();
+    void PublishTimeBase();
+    static void CollectMetrics(void* Context);
+    static void SaveWarmTime(void* Context);
+    void RestoreWarmTime();
 
 public:
     static NtpHandler* GetInstance();
@@ -44,8 +67,13 @@ public:
     void Enable();
     void Disable();
     void SetGmtOffset(int GmtOffsetHours);
+    void SetServer(const String& Server, uint16_t Port = 123);
+    void SetUpdateInterval(unsigned long Interval);
     void SetOnSyncCallback(TimeSyncCallback Callback);
     void SetOnDesyncCallback(TimeSyncCallback Callback);
     bool IsConnected();
+    int64_t GetLastOffset();      // microseconds
+    int64_t GetLastDelay();       // microseconds
+    float GetFrequencyError();    // ppm
     String GetFormattedTime(const String& Format = "%H:%M:%S") override;
 };
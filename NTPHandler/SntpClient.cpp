@@ -0,0 +1,305 @@
+#include "SntpClient.h"
+#include "LoggerHandler.h"
+
+SntpClient::SntpClient() {
+    BaseMonotonic = esp_timer_get_time();
+}
+
+void SntpClient::SetServer(const String& Server, uint16_t Port) {
+    ServerName = Server;
+    ServerPort = Port;
+    ServerResolved = false;
+    ResolveTimer.Stop();
+}
+
+void SntpClient::SetResolveRetryInterval(unsigned long Interval) {
+    ResolveRetryInterval = Interval;
+}
+
+void SntpClient::Begin() {
+    if (!Started) {
+        Udp.begin(LocalPort);
+        Started = true;
+    }
+}
+
+void SntpClient::End() {
+    if (Started) {
+        Udp.stop();
+        Started = false;
+    }
+    BurstActive = false;
+    RequestPending = false;
+}
+
+void SntpClient::StartBurst() {
+    BurstActive = true;
+    RequestPending = false;
+    RequestsSent = 0;
+    SamplesCount = 0;
+    SpacingTimer.Stop();
+
+    if (!ResolveServer()) {
+        BurstActive = false;
+    }
+}
+
+// Name resolution is the only blocking step: the address is kept until a burst
+// gets no reply, and a failed lookup is not retried before the retry interval
+bool SntpClient::ResolveServer() {
+    if (ServerResolved) {
+        return true;
+    }
+    if (ServerAddress.fromString(ServerName)) {
+        ServerResolved = true;
+        return true;
+    }
+    if (!ResolveTimer.IsExpired()) {
+        return false;
+    }
+    if (WiFi.hostByName(ServerName.c_str(), ServerAddress) != 1) {
+        LOG(WARNING, LogName, "Unable to resolve " + ServerName + ", retry in " + String(ResolveRetryInterval) + " ms");
+        ResolveTimer.Start(ResolveRetryInterval);
+        return false;
+    }
+    ServerResolved = true;
+    return true;
+}
+
+bool SntpClient::IsRequestPending() const {
+    return RequestPending;
+}
+
+bool SntpClient::IsBurstActive() const {
+    return BurstActive;
+}
+
+bool SntpClient::IsSynchronized() const {
+    return Synchronized;
+}
+
+int64_t SntpClient::GetLastOffset() const {
+    return LastOffset;
+}
+
+int64_t SntpClient::GetLastDelay() const {
+    return LastDelay;
+}
+
+float SntpClient::GetFrequencyError() const {
+    return FrequencyError / 1000.0;
+}
+
+// The current segment is closed first, so the new rate only applies from now on
+void SntpClient::SetFrequencyError(float Error) {
+    int64_t NewFrequencyError = static_cast<int64_t>(Error * 1000);
+    if (NewFrequencyError > MaxFrequencyError) {
+        NewFrequencyError = MaxFrequencyError;
+    } else if (NewFrequencyError < -MaxFrequencyError) {
+        NewFrequencyError = -MaxFrequencyError;
+    }
+
+    int64_t Now = esp_timer_get_time();
+    int64_t Current = ClockAt(Now);
+
+    portENTER_CRITICAL(&ClockLock);
+    int64_t Elapsed = Now - BaseMonotonic;
+    int64_t Slewed = Current - (BaseEpoch + Elapsed + (Elapsed * FrequencyError) / 1000000000LL);
+    SlewRemaining -= Slewed;
+    BaseEpoch = Current;
+    BaseMonotonic = Now;
+    FrequencyError = static_cast<int32_t>(NewFrequencyError);
+    portEXIT_CRITICAL(&ClockLock);
+}
+
+int64_t SntpClient::GetEpochMicroseconds() {
+    return ClockAt(esp_timer_get_time());
+}
+
+int64_t SntpClient::ClockAt(int64_t Monotonic) {
+    portENTER_CRITICAL(&ClockLock);
+    int64_t Elapsed = Monotonic - BaseMonotonic;
+    int64_t MaxSlew = Elapsed * SlewRate / SECONDS_TO_MICROSECONDS;
+    int64_t Slew = SlewRemaining;
+    if (Slew > MaxSlew) {
+        Slew = MaxSlew;
+    } else if (Slew < -MaxSlew) {
+        Slew = -MaxSlew;
+    }
+    int64_t Time = BaseEpoch + Elapsed + (Elapsed * FrequencyError) / 1000000000LL + Slew;
+    portEXIT_CRITICAL(&ClockLock);
+    return Time;
+}
+
+// The disciplined clock is piecewise linear: this returns the segment that starts at
+// Monotonic (epoch and rate correction in ppb) and the monotonic time at which the
+// running slew ends and a new segment begins, or 0 when no slew is in progress
+int64_t SntpClient::GetTimeBase(int64_t Monotonic, int64_t& Epoch, int32_t& Rate) {
+    Epoch = ClockAt(Monotonic);
+
+    portENTER_CRITICAL(&ClockLock);
+    int64_t Elapsed = Monotonic - BaseMonotonic;
+    int64_t MaxSlew = Elapsed * SlewRate / SECONDS_TO_MICROSECONDS;
+    int64_t Pending = 0;
+    if (SlewRemaining > MaxSlew) {
+        Pending = SlewRemaining - MaxSlew;
+    } else if (SlewRemaining < -MaxSlew) {
+        Pending = SlewRemaining + MaxSlew;
+    }
+    int32_t Frequency = FrequencyError;
+    portEXIT_CRITICAL(&ClockLock);
+
+    if (Pending == 0) {
+        Rate = Frequency;
+        return 0;
+    }
+
+    Rate = Frequency + ((Pending > 0) ? SlewRate : -SlewRate) * 1000;
+    return Monotonic + ((Pending > 0) ? Pending : -Pending) * SECONDS_TO_MICROSECONDS / SlewRate;
+}
+
+bool SntpClient::Process() {
+    if (!BurstActive) {
+        return false;
+    }
+
+    if (RequestPending) {
+        if (ReadReply()) {
+            RequestPending = false;
+            SpacingTimer.Start(RequestSpacing);
+        } else if (RequestTimer.IsExpired()) {
+            RequestPending = false;
+        }
+    }
+
+    if (!RequestPending) {
+        if ((SamplesCount >= BurstSize) || (RequestsSent >= BurstMaxRequests)) {
+            BurstActive = false;
+            if (SamplesCount == 0) {
+                // The pool may have moved, resolve the name again for the next burst
+                ServerResolved = false;
+                return false;
+            }
+
+            // Clock filter: the sample with the shortest round trip has the smallest error
+            uint8_t Best = 0;
+            for (uint8_t i = 1; i < SamplesCount; i++) {
+                if (Samples[i].Delay < Samples[Best].Delay) {
+                    Best = i;
+                }
+            }
+            Discipline(Samples[Best]);
+            return true;
+        }
+
+        if (SpacingTimer.IsExpired()) {
+            SendRequest();
+        }
+    }
+
+    return false;
+}
+
+bool SntpClient::SendRequest() {
+    uint8_t Packet[NTP_PACKET_SIZE] = {0};
+    Packet[0] = 0x23;    // LI = 0, VN = 4, Mode = 3 (client)
+
+    // The transmit timestamp is echoed back by the server as originate timestamp
+    RequestTransmitTime = GetEpochMicroseconds();
+    MicrosecondsToNtp(RequestTransmitTime, RequestTransmitStamp);
+    memcpy(&Packet[40], RequestTransmitStamp, sizeof(RequestTransmitStamp));
+
+    // Drop stale replies of previous requests
+    while (Udp.parsePacket() > 0) {
+        Udp.flush();
+    }
+
+    RequestsSent++;
+    RequestTimer.Start(RequestMaxTime);
+    SpacingTimer.Start(RequestSpacing);
+
+    if (!Udp.beginPacket(ServerAddress, ServerPort)) {
+        return false;
+    }
+    Udp.write(Packet, NTP_PACKET_SIZE);
+    RequestPending = (Udp.endPacket() == 1);
+    return RequestPending;
+}
+
+bool SntpClient::ReadReply() {
+    if (Udp.parsePacket() < NTP_PACKET_SIZE) {
+        return false;
+    }
+
+    int64_t DestinationTime = GetEpochMicroseconds();
+    uint8_t Packet[NTP_PACKET_SIZE];
+    Udp.read(Packet, NTP_PACKET_SIZE);
+    Udp.flush();
+
+    uint8_t Mode = Packet[0] & 0x07;
+    uint8_t Stratum = Packet[1];
+    if ((Mode != 4) || (Stratum == 0) || (memcmp(&Packet[24], RequestTransmitStamp, sizeof(RequestTransmitStamp)) != 0)) {
+        return false;
+    }
+
+    int64_t ReceiveTime = NtpToMicroseconds(&Packet[32]);
+    int64_t TransmitTime = NtpToMicroseconds(&Packet[40]);
+
+    SampleStruct& Sample = Samples[SamplesCount++];
+    Sample.Offset = ((ReceiveTime - RequestTransmitTime) + (TransmitTime - DestinationTime)) / 2;
+    Sample.Delay = (DestinationTime - RequestTransmitTime) - (TransmitTime - ReceiveTime);
+    if (Sample.Delay < 0) {
+        Sample.Delay = 0;
+    }
+    return true;
+}
+
+void SntpClient::Discipline(const SampleStruct& Sample) {
+    int64_t Now = esp_timer_get_time();
+    int64_t Current = ClockAt(Now);
+
+    LastOffset = Sample.Offset;
+    LastDelay = Sample.Delay;
+
+    portENTER_CRITICAL(&ClockLock);
+    BaseEpoch = Current;
+    BaseMonotonic = Now;
+
+    if (!Synchronized || (Sample.Offset > StepThreshold) || (Sample.Offset < -StepThreshold)) {
+        BaseEpoch += Sample.Offset;
+        SlewRemaining = 0;
+    } else {
+        // Frequency lock: the residual offset over the interval is the frequency error
+        int64_t Interval = Now - LastDisciplineTime;
+        if (Interval >= MinFrequencyInterval) {
+            int64_t Correction = static_cast<int64_t>(FrequencyGain * Sample.Offset * 1000000000LL / Interval);
+            int64_t NewFrequencyError = FrequencyError + Correction;
+            if (NewFrequencyError > MaxFrequencyError) {
+                NewFrequencyError = MaxFrequencyError;
+            } else if (NewFrequencyError < -MaxFrequencyError) {
+                NewFrequencyError = -MaxFrequencyError;
+            }
+            FrequencyError = static_cast<int32_t>(NewFrequencyError);
+        }
+        SlewRemaining = Sample.Offset;
+    }
+    portEXIT_CRITICAL(&ClockLock);
+
+    LastDisciplineTime = Now;
+    Synchronized = true;
+}
+
+int64_t SntpClient::NtpToMicroseconds(const uint8_t* Stamp) {
+    uint32_t Seconds  = (uint32_t(Stamp[0]) << 24) | (uint32_t(Stamp[1]) << 16) | (uint32_t(Stamp[2]) << 8) | uint32_t(Stamp[3]);
+    uint32_t Fraction = (uint32_t(Stamp[4]) << 24) | (uint32_t(Stamp[5]) << 16) | (uint32_t(Stamp[6]) << 8) | uint32_t(Stamp[7]);
+    return (static_cast<int64_t>(Seconds) - NTP_UNIX_EPOCH_OFFSET) * SECONDS_TO_MICROSECONDS + ((static_cast<uint64_t>(Fraction) * SECONDS_TO_MICROSECONDS) >> 32);
+}
+
+void SntpClient::MicrosecondsToNtp(int64_t Microseconds, uint8_t* Stamp) {
+    uint32_t Seconds  = static_cast<uint32_t>(Microseconds / SECONDS_TO_MICROSECONDS + NTP_UNIX_EPOCH_OFFSET);
+    uint32_t Fraction = static_cast<uint32_t>(((static_cast<uint64_t>(Microseconds % SECONDS_TO_MICROSECONDS)) << 32) / SECONDS_TO_MICROSECONDS);
+    for (int i = 0; i < 4; i++) {
+        Stamp[i]     = (Seconds  >> (24 - 8 * i)) & 0xFF;
+        Stamp[4 + i] = (Fraction >> (24 - 8 * i)) & 0xFF;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <System.h>
+#include <DeadlineTimer.h>
+
+#define NTP_PACKET_SIZE            48
+#define NTP_UNIX_EPOCH_OFFSET      2208988800UL  // seconds between 1900 and 1970
+#define SNTP_MAX_BURST_SAMPLES     8
+
+// Non-blocking SNTP client with a disciplined local clock.
+// A sync is a burst of requests: Process() sends them, polls the socket without
+// waiting and, when the burst is over, disciplines the clock with the sample that
+// had the shortest round trip. Small offsets are slewed, large ones are stepped and
+// the frequency error of the CPU clock is estimated between bursts.
+class SntpClient {
+    public:
+        SntpClient();
+
+        void SetServer(const String& Server, uint16_t Port = 123);
+        void SetResolveRetryInterval(unsigned long Interval);   // milliseconds
+        void Begin();
+        void End();
+
+        void StartBurst();
+        bool Process();                           // true when a burst has just updated the clock
+        bool IsRequestPending() const;
+        bool IsBurstActive() const;
+        bool IsSynchronized() const;
+
+        int64_t GetEpochMicroseconds();           // UTC, microseconds since 1970
+        int64_t GetTimeBase(int64_t Monotonic, int64_t& Epoch, int32_t& Rate);
+        int64_t GetLastOffset() const;            // microseconds
+        int64_t GetLastDelay() const;             // microseconds
+        float GetFrequencyError() const;          // ppm
+        void SetFrequencyError(float Error);      // ppm, seeds the estimate, e.g. after a warm boot
+
+    private:
+        String LogName = "SntpClient";
+
+        struct SampleStruct {
+            int64_t Offset;   // microseconds
+            int64_t Delay;    // microseconds
+        };
+
+        WiFiUDP Udp;
+        String ServerName = "pool.ntp.org";
+        IPAddress ServerAddress;
+        bool ServerResolved = false;
+        unsigned long ResolveRetryInterval = 60000;   // milliseconds
+        DeadlineTimer ResolveTimer;
+        uint16_t ServerPort = 123;
+        uint16_t LocalPort = 1337;
+        bool Started = false;
+
+        // Burst configuration
+        uint8_t BurstSize = 4;
+        uint8_t BurstMaxRequests = SNTP_MAX_BURST_SAMPLES;
+        unsigned long RequestSpacing = 1000;   // milliseconds
+        unsigned long RequestMaxTime = 1000;   // milliseconds
+
+        // Burst state
+        bool BurstActive = false;
+        bool RequestPending = false;
+        uint8_t RequestsSent = 0;
+        uint8_t SamplesCount = 0;
+        SampleStruct Samples[SNTP_MAX_BURST_SAMPLES];
+        int64_t RequestTransmitTime = 0;       // local clock, microseconds since 1970
+        uint8_t RequestTransmitStamp[8];
+        DeadlineTimer RequestTimer;
+        DeadlineTimer SpacingTimer;
+
+        // Clock discipline
+        int64_t StepThreshold = 128000;        // microseconds
+        int32_t MaxFrequencyError = 500000;    // ppb
+        int32_t SlewRate = 500;                // ppm
+        float FrequencyGain = 0.25;
+        int64_t MinFrequencyInterval = 16 * SECONDS_TO_MICROSECONDS;
+
+        portMUX_TYPE ClockLock = portMUX_INITIALIZER_UNLOCKED;
+        int64_t BaseEpoch = 0;                 // microseconds since 1970 at BaseMonotonic
+        int64_t BaseMonotonic = 0;             // esp_timer_get_time() at the last update
+        int64_t SlewRemaining = 0;             // microseconds still to be amortized
+        int32_t FrequencyError = 0;            // ppb
+        int64_t LastDisciplineTime = 0;        // esp_timer_get_time(), microseconds
+        bool Synchronized = false;
+        int64_t LastOffset = 0;
+        int64_t LastDelay = 0;
+
+        int64_t ClockAt(int64_t Monotonic);
+        bool ResolveServer();
+        bool SendRequest();
+        bool ReadReply();
+        void Discipline(const SampleStruct& Sample);
+
+        static int64_t NtpToMicroseconds(const uint8_t* Stamp);
+        static void MicrosecondsToNtp(int64_t Microseconds, uint8_t* Stamp);
+};
@@ -0,0 +1,289 @@
+#include "PulseCounterHandler.h"
+#include "LoggerHandler.h"
+
+PulseCounterHandler::PulseCounterHandler() {
+    WarmBootStore::GetInstance().AddSaveCallback(SaveWarmTotal, this);
+    LOG(INFO, LogName, "Instance created");
+}
+
+PulseCounterHandler::~PulseCounterHandler() {
+    WarmBootStore::GetInstance().RemoveSaveCallback(SaveWarmTotal, this);
+    Disable();
+    LOG(INFO, LogName, "Instance deleted");
+}
+
+void PulseCounterHandler::SetName(String name) {
+    Name = name;
+    LogName = "PulseCounterHandler - " + Name;
+    PersistKey = "pulses." + Name;
+    LOG(INFO, LogName, "Instance active");
+}
+
+String PulseCounterHandler::GetName() const {
+    return Name;
+}
+
+void PulseCounterHandler::SetSource(PulseSource* source) {
+    if (Enabled) {
+        LOG(ERROR, LogName, "Source cannot be changed while enabled");
+        return;
+    }
+    Source = source;
+}
+
+void PulseCounterHandler::SetSamplePeriod(unsigned long Period) {
+    SamplePeriod = max(Period, 1UL);
+    UpdateWindowSlots();
+}
+
+void PulseCounterHandler::SetRateWindow(unsigned long Window) {
+    RateWindow = Window;
+    UpdateWindowSlots();
+}
+
+void PulseCounterHandler::SetPersistInterval(unsigned long Interval) {
+    PersistInterval = Interval;
+}
+
+void PulseCounterHandler::SetPulsesPerUnit(float Pulses) {
+    if (Pulses > 0) {
+        PulsesPerUnit = Pulses;
+    }
+}
+
+// One slot more than the window, the oldest sample marks its start
+void PulseCounterHandler::UpdateWindowSlots() {
+    portENTER_CRITICAL(&Lock);
+    WindowSlots = constrain(RateWindow / SamplePeriod + 1, static_cast<unsigned long>(2), static_cast<unsigned long>(PULSE_COUNTER_MAX_WINDOW_SLOTS));
+    WindowHead = 0;
+    WindowFilled = 0;
+    portEXIT_CRITICAL(&Lock);
+}
+
+bool PulseCounterHandler::Enable() {
+    if (Enabled) {
+        return true;
+    }
+    if (Source == nullptr) {
+        LOG(ERROR, LogName, "No pulse source");
+        return false;
+    }
+    if (!Source->Begin()) {
+        LOG(ERROR, LogName, "Pulse source failed to start");
+        return false;
+    }
+
+    LoadTotal();
+    LastSourceCount = 0;
+    LastPulseTime = 0;
+    LastPulseCount = 0;
+    Rate = 0;
+    Period = 0;
+    UpdateWindowSlots();
+
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    String Labels = "counter=\"" + Name + "\"";
+    PulsesMetric = Metrics.AddCounter("pulses_total", "Pulses counted since boot", Labels);
+    RateMetric = Metrics.AddGauge("pulse_rate_per_second", "Pulse rate over the sliding window", Labels);
+
+    Enabled = true;
+    StopRequested = false;
+    PersistTimer.Start(PersistInterval);
+    xTaskCreatePinnedToCore(HandlerTaskStatic, "PulseCounterTask", 4096, this, HandlerTaskPriority, &HandlerTaskPointer, 1);
+    Metrics.AddTask("PulseCounterTask", HandlerTaskPointer);
+    LOG(INFO, LogName, "Enabled, total " + String(static_cast<double>(Total), 0) + " pulses");
+    return true;
+}
+
+void PulseCounterHandler::Disable() {
+    if (!Enabled) {
+        return;
+    }
+    // The task may be inside a critical section or a ConfigStore write, it
+    // is asked to stop and deletes itself between two samples
+    if (HandlerTaskPointer != nullptr) {
+        MetricsRegistry::GetInstance().RemoveTask(HandlerTaskPointer);
+        StopRequested = true;
+        while (HandlerTaskPointer != nullptr) {
+            vTaskDelay(1);
+        }
+    }
+    Sample();
+    SaveTotal();
+    Source->End();
+    Enabled = false;
+    LOG(INFO, LogName, "Disabled");
+}
+
+bool PulseCounterHandler::IsEnabled() const {
+    return Enabled;
+}
+
+uint64_t PulseCounterHandler::GetCount() {
+    portENTER_CRITICAL(&Lock);
+    uint64_t Result = Total;
+    portEXIT_CRITICAL(&Lock);
+    return Result;
+}
+
+void PulseCounterHandler::SetCount(uint64_t Count) {
+    portENTER_CRITICAL(&Lock);
+    Total = Count;
+    WindowHead = 0;
+    WindowFilled = 0;
+    portEXIT_CRITICAL(&Lock);
+    SaveTotal();
+    LOG(INFO, LogName, "Total set to " + String(static_cast<double>(Count), 0));
+}
+
+float PulseCounterHandler::GetTotal() {
+    return GetCount() / PulsesPerUnit;
+}
+
+float PulseCounterHandler::GetRate() {
+    return Rate;
+}
+
+float PulseCounterHandler::GetUnitRate() {
+    return Rate / PulsesPerUnit;
+}
+
+// Once pulses stop the time since the last one bounds the period, so the
+// frequency decays instead of holding the last value
+uint32_t PulseCounterHandler::GetPeriod() {
+    portENTER_CRITICAL(&Lock);
+    uint32_t Result = Period;
+    uint64_t Last = LastPulseTime;
+    portEXIT_CRITICAL(&Lock);
+    if ((Result > 0) && (Last > 0)) {
+        uint64_t Elapsed = esp_timer_get_time() - Last;
+        if (Elapsed > Result) {
+            Result = min(Elapsed, static_cast<uint64_t>(UINT32_MAX));
+        }
+    }
+    return Result;
+}
+
+float PulseCounterHandler::GetFrequency() {
+    uint32_t Current = GetPeriod();
+    return (Current == 0) ? 0 : 1000000.0f / Current;
+}
+
+void PulseCounterHandler::HandlerTaskStatic(void* pvParameters) {
+    PulseCounterHandler* Instance = reinterpret_cast<PulseCounterHandler*>(pvParameters);
+    Instance->HandlerTask();
+}
+
+void PulseCounterHandler::HandlerTask() {
+    TickType_t StartTick, ExecutionTick, TaskTickPeriod;
+
+    while (!StopRequested) {
+        StartTick = xTaskGetTickCount();
+        TaskTickPeriod = SamplePeriod / portTICK_PERIOD_MS;
+
+        Sample();
+        if (PersistTimer.IsExpired()) {
+            SaveTotal();
+            PersistTimer.Start(PersistInterval);
+        }
+
+        ExecutionTick = xTaskGetTickCount() - StartTick;
+        if (ExecutionTick < TaskTickPeriod) {
+            vTaskDelay(TaskTickPeriod - ExecutionTick);
+        }
+    }
+
+    HandlerTaskPointer = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void PulseCounterHandler::Sample() {
+    uint64_t Now = esp_timer_get_time();
+    uint64_t SourceCount = Source->GetCount();
+    uint64_t Delta = (SourceCount > LastSourceCount) ? (SourceCount - LastSourceCount) : 0;  // a wrap read late never counts back
+    LastSourceCount = max(LastSourceCount, SourceCount);
+
+    portENTER_CRITICAL(&Lock);
+    Total += Delta;
+    Window[WindowHead] = {Now, Total};
+    WindowHead = (WindowHead + 1) % WindowSlots;
+    WindowFilled = min(WindowFilled + 1, WindowSlots);
+    const WindowSample& Oldest = Window[(WindowFilled < WindowSlots) ? 0 : WindowHead];
+    float NewRate = (Now > Oldest.Time) ? (Total - Oldest.Count) * 1000000.0f / (Now - Oldest.Time) : 0;
+    portEXIT_CRITICAL(&Lock);
+
+    Rate = NewRate;
+    UpdatePeriod(Now);
+
+    if (Delta > 0) {
+        PulsesMetric->Increment(Delta);
+    }
+    RateMetric->Set(NewRate);
+}
+
+void PulseCounterHandler::UpdatePeriod(uint64_t Now) {
+    uint64_t PulseTime, PulseCount;
+    if (!Source->GetLastPulse(PulseTime, PulseCount)) {
+        // Without timestamps the pulse is placed at the sample that saw it
+        PulseTime = Now;
+        PulseCount = LastSourceCount;
+    }
+
+    portENTER_CRITICAL(&Lock);
+    if (PulseCount > LastPulseCount) {
+        if (LastPulseTime > 0) {
+            Period = min((PulseTime - LastPulseTime) / (PulseCount - LastPulseCount), static_cast<uint64_t>(UINT32_MAX));
+        }
+        LastPulseTime = PulseTime;
+        LastPulseCount = PulseCount;
+    }
+    portEXIT_CRITICAL(&Lock);
+}
+
+bool PulseCounterHandler::LoadTotal() {
+    char Buffer[24];
+    uint64_t Value = 0;
+    if (ConfigStore::GetInstance().GetString(PersistKey.c_str(), Buffer, sizeof(Buffer))) {
+        Value = strtoull(Buffer, nullptr, 10);
+    }
+    portENTER_CRITICAL(&Lock);
+    Total = Value;
+    portEXIT_CRITICAL(&Lock);
+    PersistedTotal = Value;
+
+    // The RTC copy is newer than the last periodic save
+    uint64_t WarmValue;
+    WarmBootStore& WarmBoot = WarmBootStore::GetInstance();
+    if (WarmBoot.IsWarmBoot() && WarmBoot.Load(PersistKey.c_str(), &WarmValue, sizeof(WarmValue)) && (WarmValue > Value)) {
+        Value = WarmValue;
+        portENTER_CRITICAL(&Lock);
+        Total = Value;
+        portEXIT_CRITICAL(&Lock);
+        LOG(INFO, LogName, "Total restored from warm boot");
+    }
+    return Value > 0;
+}
+
+void PulseCounterHandler::SaveWarmTotal(void* Context) {
+    PulseCounterHandler* Instance = reinterpret_cast<PulseCounterHandler*>(Context);
+    if (Instance->Enabled) {
+        uint64_t Value = Instance->GetCount();
+        WarmBootStore::GetInstance().Save(Instance->PersistKey.c_str(), &Value, sizeof(Value));
+    }
+}
+
+// Stored as a decimal string, the store has no 64-bit type and one record
+// keeps the update atomic
+void PulseCounterHandler::SaveTotal() {
+    uint64_t Value = GetCount();
+    if (Value == PersistedTotal) {
+        return;
+    }
+    char Buffer[24];
+    snprintf(Buffer, sizeof(Buffer), "%llu", static_cast<unsigned long long>(Value));
+    if (ConfigStore::GetInstance().SetString(PersistKey.c_str(), Buffer)) {
+        PersistedTotal = Value;
+    } else {
+        LOG(ERROR, LogName, "Failed to save the total");
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <System.h>
+#include <DeadlineTimer.h>
+#include <ConfigStore.h>
+#include <MetricsRegistry.h>
+#include "PulseSource.h"
+
+#define PULSE_COUNTER_MAX_WINDOW_SLOTS  64
+
+// Totalizer and rate meter over a PulseSource. A task samples the source
+// every SamplePeriod, so its cost does not depend on the pulse frequency:
+//  - the total is kept across reboots in ConfigStore, saved every
+//    PersistInterval when it changed and on Disable()
+//  - the rate is the count difference over a sliding window of samples
+//  - the period is measured between pulses, exactly with a timestamping
+//    source and to the sample period otherwise, for frequencies too low for
+//    the window to see more than a few pulses
+class PulseCounterHandler {
+    public:
+        PulseCounterHandler();
+        ~PulseCounterHandler();
+
+        void SetName(String name);
+        String GetName() const;
+
+        void SetSource(PulseSource* Source);
+        void SetSamplePeriod(unsigned long Period);      // milliseconds
+        void SetRateWindow(unsigned long Window);        // milliseconds
+        void SetPersistInterval(unsigned long Interval); // milliseconds
+        void SetPulsesPerUnit(float Pulses);             // e.g. 1000 imp/kWh
+
+        bool Enable();
+        void Disable();
+        bool IsEnabled() const;
+
+        uint64_t GetCount();
+        void SetCount(uint64_t Count);
+        float GetTotal();             // units
+        float GetRate();              // pulses per second, over the window
+        float GetUnitRate();          // units per second
+        uint32_t GetPeriod();         // microseconds, 0 until two pulses were seen
+        float GetFrequency();         // Hz, from the period
+
+    private:
+        String LogName = "PulseCounterHandler";
+        String Name = "";
+        String PersistKey = "";
+
+        struct WindowSample {
+            uint64_t Time;    // microseconds
+            uint64_t Count;
+        };
+
+        PulseSource* Source = nullptr;
+        bool Enabled = false;
+        TaskHandle_t HandlerTaskPointer = nullptr;
+        volatile bool StopRequested = false;
+        int HandlerTaskPriority = 3;
+        unsigned long SamplePeriod = 100;         // milliseconds
+        unsigned long RateWindow = 1000;          // milliseconds
+        unsigned long PersistInterval = 60000;    // milliseconds
+        float PulsesPerUnit = 1;
+        DeadlineTimer PersistTimer;
+
+        portMUX_TYPE Lock = portMUX_INITIALIZER_UNLOCKED;
+        uint64_t Total = 0;
+        uint64_t PersistedTotal = 0;
+        uint64_t LastSourceCount = 0;
+        float Rate = 0;
+        uint32_t Period = 0;                      // microseconds
+        uint64_t LastPulseTime = 0;               // microseconds
+        uint64_t LastPulseCount = 0;
+
+        WindowSample Window[PULSE_COUNTER_MAX_WINDOW_SLOTS];
+        size_t WindowSlots = 10;
+        size_t WindowHead = 0;
+        size_t WindowFilled = 0;
+
+        Metric* PulsesMetric = nullptr;
+        Metric* RateMetric = nullptr;
+
+        static void HandlerTaskStatic(void* pvParameters);
+        void HandlerTask();
+        void Sample();
+        void UpdatePeriod(uint64_t Now);
+        bool LoadTotal();
+        void SaveTotal();
+        static void SaveWarmTotal(void* Context);
+        void UpdateWindowSlots();
+};
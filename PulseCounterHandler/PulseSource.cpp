@@ -0,0 +1,126 @@
+#include "PulseSource.h"
+
+PcntPulseSource::PcntPulseSource(uint8_t Pin, pcnt_unit_t Unit, uint16_t FilterTicks)
+    : Pin(Pin), Unit(Unit), FilterTicks(min(FilterTicks, static_cast<uint16_t>(1023))) {
+}
+
+bool PcntPulseSource::Begin() {
+    if (Started) {
+        return true;
+    }
+
+    pcnt_config_t Config = {};
+    Config.pulse_gpio_num = Pin;
+    Config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    Config.channel = PCNT_CHANNEL_0;
+    Config.unit = Unit;
+    Config.pos_mode = PCNT_COUNT_INC;
+    Config.neg_mode = PCNT_COUNT_DIS;
+    Config.lctrl_mode = PCNT_MODE_KEEP;
+    Config.hctrl_mode = PCNT_MODE_KEEP;
+    Config.counter_h_lim = PULSE_PCNT_HIGH_LIMIT;
+    Config.counter_l_lim = 0;
+    if (pcnt_unit_config(&Config) != ESP_OK) {
+        return false;
+    }
+
+    if (FilterTicks > 0) {
+        pcnt_set_filter_value(Unit, FilterTicks);
+        pcnt_filter_enable(Unit);
+    }
+
+    // The service may already be installed by another unit
+    esp_err_t Error = pcnt_isr_service_install(0);
+    if ((Error != ESP_OK) && (Error != ESP_ERR_INVALID_STATE)) {
+        return false;
+    }
+    pcnt_event_enable(Unit, PCNT_EVT_H_LIM);
+    pcnt_isr_handler_add(Unit, OverflowIsr, this);
+
+    Overflows.store(0);
+    pcnt_counter_pause(Unit);
+    pcnt_counter_clear(Unit);
+    pcnt_counter_resume(Unit);
+    Started = true;
+    return true;
+}
+
+void PcntPulseSource::End() {
+    if (!Started) {
+        return;
+    }
+    pcnt_counter_pause(Unit);
+    pcnt_event_disable(Unit, PCNT_EVT_H_LIM);
+    pcnt_isr_handler_remove(Unit);
+    Started = false;
+}
+
+// Retried if the wrap interrupt lands between the two reads
+uint64_t PcntPulseSource::GetCount() {
+    uint32_t Before, After;
+    int16_t Value = 0;
+    do {
+        Before = Overflows.load(std::memory_order_acquire);
+        pcnt_get_counter_value(Unit, &Value);
+        After = Overflows.load(std::memory_order_acquire);
+    } while (Before != After);
+    return static_cast<uint64_t>(Before) * PULSE_PCNT_HIGH_LIMIT + Value;
+}
+
+void IRAM_ATTR PcntPulseSource::OverflowIsr(void* Arg) {
+    PcntPulseSource* Instance = reinterpret_cast<PcntPulseSource*>(Arg);
+    Instance->Overflows.fetch_add(1, std::memory_order_release);
+}
+
+IsrPulseSource::IsrPulseSource(uint8_t Pin, uint8_t Mode, int Edge, uint32_t MinimumInterval)
+    : Pin(Pin), Mode(Mode), Edge(Edge), MinimumInterval(MinimumInterval) {
+}
+
+bool IsrPulseSource::Begin() {
+    if (Started) {
+        return true;
+    }
+    portENTER_CRITICAL(&Lock);
+    Count = 0;
+    LastPulseTime = 0;
+    portEXIT_CRITICAL(&Lock);
+
+    pinMode(Pin, Mode);
+    attachInterruptArg(digitalPinToInterrupt(Pin), PulseIsr, this, Edge);
+    Started = true;
+    return true;
+}
+
+void IsrPulseSource::End() {
+    if (!Started) {
+        return;
+    }
+    detachInterrupt(digitalPinToInterrupt(Pin));
+    Started = false;
+}
+
+uint64_t IsrPulseSource::GetCount() {
+    portENTER_CRITICAL(&Lock);
+    uint64_t Result = Count;
+    portEXIT_CRITICAL(&Lock);
+    return Result;
+}
+
+bool IsrPulseSource::GetLastPulse(uint64_t& Time, uint64_t& PulseCount) {
+    portENTER_CRITICAL(&Lock);
+    Time = LastPulseTime;
+    PulseCount = Count;
+    portEXIT_CRITICAL(&Lock);
+    return PulseCount > 0;
+}
+
+void IRAM_ATTR IsrPulseSource::PulseIsr(void* Arg) {
+    IsrPulseSource* Instance = reinterpret_cast<IsrPulseSource*>(Arg);
+    uint64_t Now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&Instance->Lock);
+    if ((Instance->Count == 0) || ((Now - Instance->LastPulseTime) >= Instance->MinimumInterval)) {
+        Instance->Count = Instance->Count + 1;
+        Instance->LastPulseTime = Now;
+    }
+    portEXIT_CRITICAL_ISR(&Instance->Lock);
+}
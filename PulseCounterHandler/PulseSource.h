@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <driver/pcnt.h>
+#include <esp_timer.h>
+
+#define PULSE_PCNT_HIGH_LIMIT  32767
+
+// Hardware layer of PulseCounterHandler. Sources count pulses on their own
+// (peripheral or ISR) and are only read from the sampling task.
+class PulseSource {
+    public:
+        virtual ~PulseSource() {}
+
+        virtual bool Begin() = 0;
+        virtual void End() = 0;
+        // Pulses since Begin()
+        virtual uint64_t GetCount() = 0;
+        // esp_timer_get_time() of the latest pulse and the count including it,
+        // false for sources that do not timestamp pulses
+        virtual bool GetLastPulse(uint64_t& Time, uint64_t& Count) { return false; }
+};
+
+// PCNT unit counting rising edges, with the peripheral glitch filter. The 16-bit
+// counter wraps at PULSE_PCNT_HIGH_LIMIT, the only interrupt is on that wrap.
+class PcntPulseSource : public PulseSource {
+    public:
+        PcntPulseSource(uint8_t Pin, pcnt_unit_t Unit = PCNT_UNIT_0, uint16_t FilterTicks = 1023);  // APB cycles, 12.5 ns each
+
+        bool Begin() override;
+        void End() override;
+        uint64_t GetCount() override;
+
+    private:
+        uint8_t Pin;
+        pcnt_unit_t Unit;
+        uint16_t FilterTicks;
+        bool Started = false;
+        std::atomic<uint32_t> Overflows{0};
+
+        static void IRAM_ATTR OverflowIsr(void* Arg);
+};
+
+// GPIO interrupt per pulse, timestamped, with a minimum interval rejecting
+// contact bounce. Costs one short ISR per pulse but no task wakeup.
+class IsrPulseSource : public PulseSource {
+    public:
+        IsrPulseSource(uint8_t Pin, uint8_t Mode = INPUT, int Edge = RISING, uint32_t MinimumInterval = 0);  // microseconds
+
+        bool Begin() override;
+        void End() override;
+        uint64_t GetCount() override;
+        bool GetLastPulse(uint64_t& Time, uint64_t& PulseCount) override;
+
+    private:
+        uint8_t Pin;
+        uint8_t Mode;
+        int Edge;
+        uint32_t MinimumInterval;
+        bool Started = false;
+
+        portMUX_TYPE Lock = portMUX_INITIALIZER_UNLOCKED;
+        volatile uint64_t Count = 0;
+        volatile uint64_t LastPulseTime = 0;
+
+        static void IRAM_ATTR PulseIsr(void* Arg);
+};
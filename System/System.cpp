@@ -5,13 +5,17 @@ String GetLibrariesVersion() {
     return String(LIBRARIES_VERSION_1) + "." + String(LIBRARIES_VERSION_2) + "." + String(LIBRARIES_VERSION_3);
 }
 
-void Hibernate(unsigned long long int HibernationTime) {
-    LOG(INFO, "Hibernate", "Going in hybernation for " + String(HibernationTime) + " seconds");
+void Hibernate(unsigned long long int HibernationTime, bool RetainMemory) {
+    LOG(INFO, "Hibernate", "Going in hybernation for " + String(HibernationTime) + " seconds" + (RetainMemory ? " with RTC memory retained" : ""));
+
+    if (RetainMemory) {
+        WarmBootStore::GetInstance().PrepareSleep();
+    }
 
     esp_sleep_enable_timer_wakeup(HibernationTime * SECONDS_TO_MICROSECONDS);
     esp_sleep_pd_config(ESP_PD_DOMAIN_MAX, ESP_PD_OPTION_OFF);
     esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_OFF);
-    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_SLOW_MEM, ESP_PD_OPTION_OFF);
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_SLOW_MEM, RetainMemory ? ESP_PD_OPTION_ON : ESP_PD_OPTION_OFF);
     esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_FAST_MEM, ESP_PD_OPTION_OFF);
 
     esp_deep_sleep_start();
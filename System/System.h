@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include "WarmBootStore.h"
 
 // ----------------------------
 //    Global constant
@@ -21,7 +22,9 @@
 // ----------------------------
 
 String GetLibrariesVersion();
-void Hibernate(unsigned long long int HibernationTime);
+// With RetainMemory the RTC slow memory stays powered and WarmBootStore
+// records survive, for a warm boot
+void Hibernate(unsigned long long int HibernationTime, bool RetainMemory = false);
 String GetWakeUpReason();
 void SetCpuFrequency(unsigned int CpuFrequency);
 unsigned int GetCpuFrequency();
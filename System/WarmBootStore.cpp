@@ -0,0 +1,166 @@
+#include "WarmBootStore.h"
+#include <sys/time.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <esp_rom_crc.h>
+#include <LoggerHandler.h>
+
+RTC_DATA_ATTR static WarmBootMemory Memory;
+
+WarmBootStore& WarmBootStore::GetInstance() {
+    static WarmBootStore Instance;
+    return Instance;
+}
+
+WarmBootStore::WarmBootStore() {
+    // RTC memory also survives a software or watchdog reset, whose records
+    // would describe a run that did not end in a hibernation
+    if ((esp_reset_reason() != ESP_RST_DEEPSLEEP) || (Memory.Magic != WARM_BOOT_MAGIC)) {
+        memset(&Memory, 0, sizeof(Memory));
+        Memory.Magic = WARM_BOOT_MAGIC;
+    }
+
+    if ((Memory.SleepClock != 0) && (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED)) {
+        WarmBoot = true;
+        SleepDuration = max(GetPersistentClock() - Memory.SleepClock, static_cast<int64_t>(0));
+    } else {
+        // A deep sleep entered without Hibernate() left records nobody refreshed
+        memset(Memory.Slots, 0, sizeof(Memory.Slots));
+    }
+    Memory.SleepClock = 0;
+
+    if (WarmBoot) {
+        LOG(INFO, LogName, "Warm boot after " + String(static_cast<long>(SleepDuration / 1000)) + " ms of sleep");
+    }
+}
+
+bool WarmBootStore::IsWarmBoot() const {
+    return WarmBoot;
+}
+
+uint32_t WarmBootStore::GetSleepCount() const {
+    return Memory.SleepCount;
+}
+
+int64_t WarmBootStore::GetSleepDuration() const {
+    return SleepDuration;
+}
+
+bool WarmBootStore::Save(const char* Key, const void* Data, size_t Length) {
+    if (Length > WARM_BOOT_SLOT_SIZE) {
+        LOG(ERROR, LogName, "Record " + String(Key) + " too large");
+        return false;
+    }
+
+    uint32_t KeyHash = Hash(Key);
+    portENTER_CRITICAL(&Lock);
+    int Index = FindSlot(KeyHash);
+    if (Index < 0) {
+        Index = FindSlot(0);
+    }
+    if (Index >= 0) {
+        WarmBootSlot& Slot = Memory.Slots[Index];
+        Slot.Key = KeyHash;
+        Slot.Length = Length;
+        memcpy(Slot.Data, Data, Length);
+        Slot.Crc = esp_rom_crc32_le(KeyHash, Slot.Data, Length);
+    }
+    portEXIT_CRITICAL(&Lock);
+
+    if (Index < 0) {
+        LOG(ERROR, LogName, "No free slot for " + String(Key));
+        return false;
+    }
+    return true;
+}
+
+bool WarmBootStore::Load(const char* Key, void* Data, size_t Length) {
+    uint32_t KeyHash = Hash(Key);
+    bool Result = false;
+    portENTER_CRITICAL(&Lock);
+    int Index = FindSlot(KeyHash);
+    if (Index >= 0) {
+        WarmBootSlot& Slot = Memory.Slots[Index];
+        if ((Slot.Length == Length) && (esp_rom_crc32_le(KeyHash, Slot.Data, Length) == Slot.Crc)) {
+            memcpy(Data, Slot.Data, Length);
+            Result = true;
+        } else {
+            Slot.Key = 0;
+        }
+    }
+    portEXIT_CRITICAL(&Lock);
+    return Result;
+}
+
+void WarmBootStore::Remove(const char* Key) {
+    portENTER_CRITICAL(&Lock);
+    int Index = FindSlot(Hash(Key));
+    if (Index >= 0) {
+        Memory.Slots[Index].Key = 0;
+    }
+    portEXIT_CRITICAL(&Lock);
+}
+
+void WarmBootStore::Clear() {
+    portENTER_CRITICAL(&Lock);
+    memset(Memory.Slots, 0, sizeof(Memory.Slots));
+    portEXIT_CRITICAL(&Lock);
+}
+
+bool WarmBootStore::AddSaveCallback(WarmBootSaveCallback Callback, void* Context) {
+    bool Added = false;
+    portENTER_CRITICAL(&Lock);
+    if ((Callback != nullptr) && (CallbackCount < WARM_BOOT_MAX_CALLBACKS)) {
+        Callbacks[CallbackCount++] = {Callback, Context};
+        Added = true;
+    }
+    portEXIT_CRITICAL(&Lock);
+
+    if (!Added) {
+        LOG(ERROR, LogName, "Cannot register save callback");
+    }
+    return Added;
+}
+
+void WarmBootStore::RemoveSaveCallback(WarmBootSaveCallback Callback, void* Context) {
+    portENTER_CRITICAL(&Lock);
+    uint8_t Kept = 0;
+    for (uint8_t i = 0; i < CallbackCount; i++) {
+        if ((Callbacks[i].Callback != Callback) || (Callbacks[i].Context != Context)) {
+            Callbacks[Kept++] = Callbacks[i];
+        }
+    }
+    CallbackCount = Kept;
+    portEXIT_CRITICAL(&Lock);
+}
+
+void WarmBootStore::PrepareSleep() {
+    for (uint8_t i = 0; i < CallbackCount; i++) {
+        Callbacks[i].Callback(Callbacks[i].Context);
+    }
+    Memory.SleepCount++;
+    Memory.SleepClock = GetPersistentClock();
+}
+
+int64_t WarmBootStore::GetPersistentClock() {
+    struct timeval Now;
+    gettimeofday(&Now, nullptr);
+    return static_cast<int64_t>(Now.tv_sec) * 1000000LL + Now.tv_usec;
+}
+
+uint32_t WarmBootStore::Hash(const char* Key) {
+    uint32_t Result = 2166136261UL;
+    while (*Key) {
+        Result = (Result ^ static_cast<uint8_t>(*Key++)) * 16777619UL;
+    }
+    return (Result == 0) ? 1 : Result;
+}
+
+int WarmBootStore::FindSlot(uint32_t KeyHash) {
+    for (int i = 0; i < WARM_BOOT_MAX_SLOTS; i++) {
+        if (Memory.Slots[i].Key == KeyHash) {
+            return i;
+        }
+    }
+    return -1;
+}
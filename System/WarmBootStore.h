@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define WARM_BOOT_MAGIC           0x544F4257   // "WBOT"
+#define WARM_BOOT_MAX_SLOTS       8
+#define WARM_BOOT_SLOT_SIZE       96           // bytes
+#define WARM_BOOT_MAX_CALLBACKS   8
+
+// Called right before a retained hibernation, to store state with Save()
+typedef void (*WarmBootSaveCallback)(void* Context);
+
+struct WarmBootSlot {
+    uint32_t Key;       // FNV-1a of the key name, 0 when free
+    uint16_t Length;
+    uint16_t Reserved;
+    uint32_t Crc;
+    uint8_t  Data[WARM_BOOT_SLOT_SIZE];
+};
+
+struct WarmBootMemory {
+    uint32_t Magic;
+    uint32_t SleepCount;
+    int64_t  SleepClock;   // GetPersistentClock() when the sleep started, 0 if not sleeping
+    WarmBootSlot Slots[WARM_BOOT_MAX_SLOTS];
+};
+
+// Small named records kept in RTC slow memory, which survives deep sleep when
+// Hibernate() is asked to retain it; any other reset, and a deep sleep not
+// entered through Hibernate(), starts from an empty store, so Load() only
+// returns records of a warm boot. Every record has its own CRC and is dropped on mismatch.
+// Handlers store what lets them resume without a cold start (WiFi channel and
+// BSSID, time base, filter states, counters) and read it back at start-up.
+class WarmBootStore {
+    public:
+        static WarmBootStore& GetInstance();
+
+        bool IsWarmBoot() const;               // woken from a retained hibernation
+        uint32_t GetSleepCount() const;
+        int64_t GetSleepDuration() const;      // microseconds, 0 when not a warm boot
+
+        bool Save(const char* Key, const void* Data, size_t Length);
+        bool Load(const char* Key, void* Data, size_t Length);
+        void Remove(const char* Key);
+        void Clear();
+
+        bool AddSaveCallback(WarmBootSaveCallback Callback, void* Context = nullptr);
+        // Call from the destructor of every object that registered itself
+        void RemoveSaveCallback(WarmBootSaveCallback Callback, void* Context = nullptr);
+        // Runs the save callbacks and marks the sleep start, called by Hibernate()
+        void PrepareSleep();
+
+        // Microseconds from the RTC timer, which keeps counting in deep sleep
+        static int64_t GetPersistentClock();
+
+    private:
+        String LogName = "WarmBootStore";
+
+        struct CallbackEntry {
+            WarmBootSaveCallback Callback;
+            void* Context;
+        };
+
+        CallbackEntry Callbacks[WARM_BOOT_MAX_CALLBACKS];
+        uint8_t CallbackCount = 0;
+        bool WarmBoot = false;
+        int64_t SleepDuration = 0;
+        portMUX_TYPE Lock = portMUX_INITIALIZER_UNLOCKED;
+
+        WarmBootStore();
+        static uint32_t Hash(const char* Key);
+        int FindSlot(uint32_t KeyHash);
+
+        WarmBootStore(const WarmBootStore&) = delete;
+        void operator=(const WarmBootStore&) = delete;
+};
@@ -36,6 +36,7 @@ public:
 
       void SetClockTime (unsigned long _ClockTime);
       void Reset ();
+      void Preset (float _Value);
       void UpdateFilterTimeConstant (unsigned long _FilterTimeConstant);
       float Filter (int _Value);
 };
@@ -66,6 +67,12 @@ void TimeDiscreteFilter::Reset () {
     ResetRequest = true;
 }
 
+// Starts the filter from a known output instead of the next input
+void TimeDiscreteFilter::Preset (float _Value) {
+    FilteredValue = _Value;
+    ResetRequest = false;
+}
+
 void TimeDiscreteFilter::UpdateFilterTimeConstant (unsigned long _FilterTimeConstant) {
     FilterTimeConstant = _FilterTimeConstant;
     Alpha = (float) ClockTime / (ClockTime + FilterTimeConstant);
@@ -0,0 +1,568 @@
+#include "TimeSeriesStore.h"
+#include <algorithm>
+#include "LoggerHandler.h"
+
+TimeSeriesStore::TimeSeriesStore(const String& Path, uint8_t ValueCount, uint32_t SegmentRecords, uint16_t MaxSegments)
+    : Path(Path),
+      ValueCount(constrain(ValueCount, 1, TIME_SERIES_MAX_VALUES)),
+      SegmentRecords(max(SegmentRecords, static_cast<uint32_t>(1))),
+      MaxSegments(max(MaxSegments, static_cast<uint16_t>(2))) {
+    RecordSize = sizeof(uint32_t) + this->ValueCount * sizeof(float);
+    Mutex = xSemaphoreCreateMutex();
+    LOG(INFO, LogName, "Instance created for " + Path);
+}
+
+TimeSeriesStore::~TimeSeriesStore() {
+    End();
+    vSemaphoreDelete(Mutex);
+}
+
+bool TimeSeriesStore::Begin() {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+
+    if (Started) {
+        xSemaphoreGive(Mutex);
+        return true;
+    }
+
+    if (!FileSystem.CreateDirectory(Path)) {
+        LOG(ERROR, LogName, "Failed to create directory " + Path);
+        xSemaphoreGive(Mutex);
+        return false;
+    }
+
+    Segments.clear();
+    InvalidSegments.clear();
+    LastTorn = false;
+    FileSystem.ForEachEntry(Path, ScanEntry, this);
+
+    // Deleting is deferred until the directory walk is over
+    for (const String& Name : InvalidSegments) {
+        LOG(WARNING, LogName, "Removing invalid segment " + Name);
+        FileSystem.DeleteFile(Path + "/" + Name);
+    }
+    InvalidSegments.clear();
+
+    std::sort(Segments.begin(), Segments.end(), [](const TimeSeriesSegment& A, const TimeSeriesSegment& B) {
+        return A.Sequence < B.Sequence;
+    });
+
+    while (Segments.size() > MaxSegments) {
+        FileSystem.DeleteFile(SegmentPath(Segments.front().Sequence));
+        Segments.erase(Segments.begin());
+    }
+
+    // Keep appending to the last segment only if it ends on a record boundary,
+    // otherwise the next Append() starts a new one
+    if (!Segments.empty() && !LastTorn && (Segments.back().RecordCount < SegmentRecords)) {
+        ActiveFile = FileSystem.OpenFile(SegmentPath(Segments.back().Sequence), "a");
+        ActiveFileSize = sizeof(TimeSeriesHeader) + Segments.back().RecordCount * RecordSize;
+    }
+
+    BufferLength = 0;
+    Started = true;
+    xSemaphoreGive(Mutex);
+
+    LOG(INFO, LogName, Path + " opened with " + String(Segments.size()) + " segments, " + String(GetRecordCount()) + " records");
+    return true;
+}
+
+void TimeSeriesStore::End() {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    if (Started) {
+        FlushBuffer();
+        if (ActiveFile) {
+            ActiveFile.close();
+        }
+        Started = false;
+    }
+    xSemaphoreGive(Mutex);
+}
+
+void TimeSeriesStore::Clear() {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    if (ActiveFile) {
+        ActiveFile.close();
+    }
+    for (const TimeSeriesSegment& Segment : Segments) {
+        FileSystem.DeleteFile(SegmentPath(Segment.Sequence));
+    }
+    Segments.clear();
+    BufferLength = 0;
+    FlushTimer.Stop();
+    xSemaphoreGive(Mutex);
+    LOG(INFO, LogName, Path + " cleared");
+}
+
+bool TimeSeriesStore::Append(uint32_t Timestamp, float Value) {
+    return Append(Timestamp, &Value);
+}
+
+bool TimeSeriesStore::Append(uint32_t Timestamp, const float* Values) {
+    uint8_t Record[sizeof(uint32_t) + TIME_SERIES_MAX_VALUES * sizeof(float)];
+    memcpy(Record, &Timestamp, sizeof(uint32_t));
+    memcpy(Record + sizeof(uint32_t), Values, ValueCount * sizeof(float));
+
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+
+    if (!Started || (!Segments.empty() && (Timestamp < Segments.back().LastTimestamp))) {
+        xSemaphoreGive(Mutex);
+        return false;
+    }
+
+    if (!ActiveFile || (Segments.back().RecordCount >= SegmentRecords)) {
+        if (!Rotate(Timestamp)) {
+            xSemaphoreGive(Mutex);
+            return false;
+        }
+    }
+
+    bool WasEmpty = (BufferLength == 0);
+    Buffered(Record, RecordSize);
+    Segments.back().RecordCount++;
+    Segments.back().LastTimestamp = Timestamp;
+
+    // Bound the data lost on a reset while a page is still filling up
+    if (BufferLength > 0) {
+        if (WasEmpty) {
+            FlushTimer.Start(FlushInterval);
+        } else if (FlushTimer.IsExpired()) {
+            FlushBuffer();
+        }
+    }
+
+    xSemaphoreGive(Mutex);
+    return true;
+}
+
+bool TimeSeriesStore::Flush() {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    bool Result = FlushBuffer();
+    xSemaphoreGive(Mutex);
+    return Result;
+}
+
+void TimeSeriesStore::SetFlushInterval(unsigned long Interval) {
+    FlushInterval = Interval;
+    LOG(INFO, LogName, "Flush interval set to " + String(Interval) + " ms");
+}
+
+// The callback runs with the store locked: keep it short
+size_t TimeSeriesStore::Query(uint32_t From, uint32_t To, TimeSeriesCallback Callback, void* Context) {
+    uint8_t Block[TIME_SERIES_PAGE_SIZE];
+    float Values[TIME_SERIES_MAX_VALUES];
+    size_t BlockRecords = sizeof(Block) / RecordSize;
+    size_t Count = 0;
+    bool Stop = false;
+
+    if (!Callback || (From > To)) {
+        return 0;
+    }
+
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    FlushBuffer();
+
+    for (size_t Index = FindSegment(From); (Index < Segments.size()) && !Stop; Index++) {
+        const TimeSeriesSegment& Segment = Segments[Index];
+        if (Segment.FirstTimestamp > To) {
+            break;
+        }
+        if ((Segment.RecordCount == 0) || (Segment.LastTimestamp < From)) {
+            continue;
+        }
+
+        File SegmentFile = FileSystem.OpenFile(SegmentPath(Segment.Sequence), "r");
+        if (!SegmentFile) {
+            continue;
+        }
+
+        uint32_t Record = FindRecord(SegmentFile, Segment, From);
+        SegmentFile.seek(sizeof(TimeSeriesHeader) + Record * RecordSize);
+
+        while ((Record < Segment.RecordCount) && !Stop) {
+            size_t Records = min(static_cast<size_t>(Segment.RecordCount - Record), BlockRecords);
+            size_t Read = SegmentFile.read(Block, Records * RecordSize) / RecordSize;
+            if (Read == 0) {
+                break;
+            }
+
+            for (size_t i = 0; i < Read; i++) {
+                uint32_t Timestamp;
+                memcpy(&Timestamp, Block + i * RecordSize, sizeof(uint32_t));
+                if (Timestamp > To) {
+                    Stop = true;
+                    break;
+                }
+                memcpy(Values, Block + i * RecordSize + sizeof(uint32_t), ValueCount * sizeof(float));
+                Count++;
+                if (!Callback(Context, Timestamp, Values, ValueCount)) {
+                    Stop = true;
+                    break;
+                }
+            }
+            Record += Read;
+        }
+        SegmentFile.close();
+    }
+
+    xSemaphoreGive(Mutex);
+    return Count;
+}
+
+// A stream covers the records on flash when it is opened, plus anything flushed
+// while it is being read; rotated away segments are skipped.
+bool TimeSeriesStore::OpenStream(uint32_t From, uint32_t To, TimeSeriesCursor& Cursor) {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+
+    if (!Started) {
+        xSemaphoreGive(Mutex);
+        return false;
+    }
+
+    FlushBuffer();
+
+    Cursor.From = From;
+    Cursor.To = To;
+    Cursor.HeaderSent = false;
+    Cursor.Done = false;
+    Cursor.Sequence = Segments.empty() ? 0 : Segments.back().Sequence + 1;
+    Cursor.Record = 0;
+
+    for (size_t Index = FindSegment(From); Index < Segments.size(); Index++) {
+        const TimeSeriesSegment& Segment = Segments[Index];
+        if ((Segment.FirstTimestamp > To) || (From > To)) {
+            break;
+        }
+        if ((Segment.RecordCount == 0) || (Segment.LastTimestamp < From)) {
+            continue;
+        }
+        File SegmentFile = FileSystem.OpenFile(SegmentPath(Segment.Sequence), "r");
+        if (SegmentFile) {
+            Cursor.Sequence = Segment.Sequence;
+            Cursor.Record = FindRecord(SegmentFile, Segment, From);
+            SegmentFile.close();
+        }
+        break;
+    }
+
+    xSemaphoreGive(Mutex);
+    return true;
+}
+
+// Fills Buffer with the stream header followed by raw records, returns 0 at the
+// end of the stream; suitable as the filler of a chunked HTTP response
+size_t TimeSeriesStore::ReadStream(TimeSeriesCursor& Cursor, uint8_t* Buffer, size_t MaxLength) {
+    size_t Written = 0;
+
+    if (Cursor.Done) {
+        return 0;
+    }
+
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+
+    if (!Cursor.HeaderSent) {
+        if (MaxLength < sizeof(TimeSeriesHeader)) {
+            xSemaphoreGive(Mutex);
+            return 0;
+        }
+        TimeSeriesHeader Header;
+        FillHeader(Header, 0, Cursor.From);
+        memcpy(Buffer, &Header, sizeof(Header));
+        Written += sizeof(Header);
+        Cursor.HeaderSent = true;
+    }
+
+    while (!Cursor.Done && ((Written + RecordSize) <= MaxLength)) {
+        if (Segments.empty() || (Cursor.Sequence > Segments.back().Sequence)) {
+            Cursor.Done = true;
+            break;
+        }
+        // A segment lost to a failed write or removed by retention leaves a
+        // gap, the cursor moves on to the next sequence that exists
+        auto Iterator = std::lower_bound(Segments.begin(), Segments.end(), Cursor.Sequence, [](const TimeSeriesSegment& Segment, uint32_t Value) {
+            return Segment.Sequence < Value;
+        });
+        if (Iterator->Sequence != Cursor.Sequence) {
+            Cursor.Sequence = Iterator->Sequence;
+            Cursor.Record = 0;
+        }
+
+        size_t Index = Iterator - Segments.begin();
+        const TimeSeriesSegment& Segment = *Iterator;
+        bool IsActive = (Index == Segments.size() - 1) && ActiveFile;
+        uint32_t Available = IsActive ? (ActiveFileSize - sizeof(TimeSeriesHeader)) / RecordSize : Segment.RecordCount;
+
+        if (Cursor.Record >= Available) {
+            if (Index == Segments.size() - 1) {
+                Cursor.Done = true;
+            } else {
+                Cursor.Sequence++;
+                Cursor.Record = 0;
+            }
+            continue;
+        }
+
+        size_t Records = min(static_cast<size_t>(Available - Cursor.Record), (MaxLength - Written) / RecordSize);
+        File SegmentFile = FileSystem.OpenFile(SegmentPath(Segment.Sequence), "r");
+        if (!SegmentFile) {
+            Cursor.Sequence++;
+            Cursor.Record = 0;
+            continue;
+        }
+        SegmentFile.seek(sizeof(TimeSeriesHeader) + Cursor.Record * RecordSize);
+        Records = SegmentFile.read(Buffer + Written, Records * RecordSize) / RecordSize;
+        SegmentFile.close();
+        if (Records == 0) {
+            Cursor.Done = true;
+            break;
+        }
+
+        for (size_t i = 0; i < Records; i++) {
+            uint32_t Timestamp;
+            memcpy(&Timestamp, Buffer + Written + i * RecordSize, sizeof(uint32_t));
+            if (Timestamp > Cursor.To) {
+                Records = i;
+                Cursor.Done = true;
+                break;
+            }
+        }
+
+        Written += Records * RecordSize;
+        Cursor.Record += Records;
+    }
+
+    xSemaphoreGive(Mutex);
+    return Written;
+}
+
+uint8_t TimeSeriesStore::GetValueCount() const {
+    return ValueCount;
+}
+
+uint8_t TimeSeriesStore::GetRecordSize() const {
+    return RecordSize;
+}
+
+uint32_t TimeSeriesStore::GetRecordCount() {
+    uint32_t Count = 0;
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    for (const TimeSeriesSegment& Segment : Segments) {
+        Count += Segment.RecordCount;
+    }
+    xSemaphoreGive(Mutex);
+    return Count;
+}
+
+uint32_t TimeSeriesStore::GetSegmentCount() {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    uint32_t Count = Segments.size();
+    xSemaphoreGive(Mutex);
+    return Count;
+}
+
+uint32_t TimeSeriesStore::GetFirstTimestamp() {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    uint32_t Timestamp = Segments.empty() ? 0 : Segments.front().FirstTimestamp;
+    xSemaphoreGive(Mutex);
+    return Timestamp;
+}
+
+uint32_t TimeSeriesStore::GetLastTimestamp() {
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    uint32_t Timestamp = Segments.empty() ? 0 : Segments.back().LastTimestamp;
+    xSemaphoreGive(Mutex);
+    return Timestamp;
+}
+
+uint32_t TimeSeriesStore::GetFlushCount() const {
+    return FlushCount;
+}
+
+uint32_t TimeSeriesStore::GetRotationCount() const {
+    return RotationCount;
+}
+
+bool TimeSeriesStore::ScanEntry(void* Context, const char* EntryPath, const char* Name, bool IsDirectory, size_t Size) {
+    TimeSeriesStore* Instance = reinterpret_cast<TimeSeriesStore*>(Context);
+    size_t Length = strlen(Name);
+    size_t ExtensionLength = strlen(TIME_SERIES_EXTENSION);
+
+    if (IsDirectory || (Length <= ExtensionLength) || (strcmp(Name + Length - ExtensionLength, TIME_SERIES_EXTENSION) != 0)) {
+        return true;
+    }
+
+    TimeSeriesSegment Segment;
+    bool Torn = false;
+    if (Instance->LoadSegment(Name, Segment, Torn)) {
+        if (Instance->Segments.empty() || (Segment.Sequence > Instance->LastSequence)) {
+            Instance->LastSequence = Segment.Sequence;
+            Instance->LastTorn = Torn;
+        }
+        Instance->Segments.push_back(Segment);
+    } else {
+        Instance->InvalidSegments.push_back(Name);
+    }
+    return true;
+}
+
+String TimeSeriesStore::SegmentPath(uint32_t Sequence) const {
+    char Name[16];
+    snprintf(Name, sizeof(Name), "%08lX", static_cast<unsigned long>(Sequence));
+    return Path + "/" + Name + TIME_SERIES_EXTENSION;
+}
+
+bool TimeSeriesStore::LoadSegment(const String& Name, TimeSeriesSegment& Segment, bool& Torn) {
+    File SegmentFile = FileSystem.OpenFile(Path + "/" + Name, "r");
+    if (!SegmentFile) {
+        return false;
+    }
+
+    TimeSeriesHeader Header;
+    size_t Size = SegmentFile.size();
+    if ((Size < sizeof(Header)) || (SegmentFile.read(reinterpret_cast<uint8_t*>(&Header), sizeof(Header)) != sizeof(Header))) {
+        SegmentFile.close();
+        return false;
+    }
+
+    uint32_t Sequence = strtoul(Name.c_str(), nullptr, 16);
+    if ((Header.Magic != TIME_SERIES_MAGIC) || (Header.Version != TIME_SERIES_VERSION) || (Header.ValueCount != ValueCount) ||
+        (Header.RecordSize != RecordSize) || (Header.Sequence != Sequence)) {
+        SegmentFile.close();
+        return false;
+    }
+
+    Segment.Sequence = Sequence;
+    Segment.RecordCount = (Size - sizeof(Header)) / RecordSize;
+    Segment.FirstTimestamp = Header.FirstTimestamp;
+    Segment.LastTimestamp = Header.FirstTimestamp;
+    Torn = ((Size - sizeof(Header)) % RecordSize) != 0;
+
+    if (Segment.RecordCount > 0) {
+        SegmentFile.seek(sizeof(Header) + (Segment.RecordCount - 1) * RecordSize);
+        SegmentFile.read(reinterpret_cast<uint8_t*>(&Segment.LastTimestamp), sizeof(uint32_t));
+    }
+
+    SegmentFile.close();
+    return Segment.RecordCount > 0;
+}
+
+bool TimeSeriesStore::StartSegment(uint32_t Sequence, uint32_t FirstTimestamp) {
+    ActiveFile = FileSystem.OpenFile(SegmentPath(Sequence), "w");
+    if (!ActiveFile) {
+        LOG(ERROR, LogName, "Failed to create segment " + SegmentPath(Sequence));
+        return false;
+    }
+
+    TimeSeriesHeader Header;
+    FillHeader(Header, Sequence, FirstTimestamp);
+    if (ActiveFile.write(reinterpret_cast<const uint8_t*>(&Header), sizeof(Header)) != sizeof(Header)) {
+        LOG(ERROR, LogName, "Failed to write segment header " + SegmentPath(Sequence));
+        ActiveFile.close();
+        FileSystem.DeleteFile(SegmentPath(Sequence));
+        return false;
+    }
+    ActiveFile.flush();
+    ActiveFileSize = sizeof(Header);
+
+    Segments.push_back({Sequence, FirstTimestamp, FirstTimestamp, 0});
+    return true;
+}
+
+bool TimeSeriesStore::Rotate(uint32_t FirstTimestamp) {
+    FlushBuffer();
+    if (ActiveFile) {
+        ActiveFile.close();
+        RotationCount++;
+    }
+
+    uint32_t Sequence = Segments.empty() ? 0 : Segments.back().Sequence + 1;
+    if (!StartSegment(Sequence, FirstTimestamp)) {
+        return false;
+    }
+
+    while (Segments.size() > MaxSegments) {
+        FileSystem.DeleteFile(SegmentPath(Segments.front().Sequence));
+        Segments.erase(Segments.begin());
+    }
+    return true;
+}
+
+bool TimeSeriesStore::FlushBuffer() {
+    if (BufferLength == 0) {
+        return true;
+    }
+
+    size_t Written = ActiveFile.write(Buffer, BufferLength);
+    ActiveFile.flush();
+    ActiveFileSize += Written;
+    FlushCount++;
+    FlushTimer.Stop();
+
+    if (Written != BufferLength) {
+        // Drop the partial write and continue in a fresh segment
+        LOG(ERROR, LogName, "Write failed on " + SegmentPath(Segments.back().Sequence));
+        ActiveFile.close();
+        Segments.back().RecordCount = (ActiveFileSize - sizeof(TimeSeriesHeader)) / RecordSize;
+        BufferLength = 0;
+        return false;
+    }
+
+    BufferLength = 0;
+    return true;
+}
+
+// Records are copied into the page buffer, which is written out as soon as the
+// file reaches a page boundary: every flash write but the first of a segment
+// (after the header) and the timed ones starts and ends on a page boundary
+void TimeSeriesStore::Buffered(const uint8_t* Data, size_t Length) {
+    while (Length > 0) {
+        size_t Space = TIME_SERIES_PAGE_SIZE - ((ActiveFileSize + BufferLength) % TIME_SERIES_PAGE_SIZE);
+        size_t Chunk = min(Space, Length);
+
+        memcpy(Buffer + BufferLength, Data, Chunk);
+        BufferLength += Chunk;
+        Data += Chunk;
+        Length -= Chunk;
+
+        if (((ActiveFileSize + BufferLength) % TIME_SERIES_PAGE_SIZE) == 0) {
+            FlushBuffer();
+        }
+    }
+}
+
+// Index of the first segment that can hold records at or after Timestamp
+size_t TimeSeriesStore::FindSegment(uint32_t Timestamp) {
+    auto Iterator = std::lower_bound(Segments.begin(), Segments.end(), Timestamp, [](const TimeSeriesSegment& Segment, uint32_t Value) {
+        return Segment.FirstTimestamp < Value;
+    });
+    size_t Index = Iterator - Segments.begin();
+    return (Index > 0) ? Index - 1 : 0;
+}
+
+// Index of the first record with a timestamp not before Timestamp
+uint32_t TimeSeriesStore::FindRecord(File& SegmentFile, const TimeSeriesSegment& Segment, uint32_t Timestamp) {
+    uint32_t Low = 0;
+    uint32_t High = Segment.RecordCount;
+
+    while (Low < High) {
+        uint32_t Middle = Low + (High - Low) / 2;
+        uint32_t Value = 0;
+        SegmentFile.seek(sizeof(TimeSeriesHeader) + Middle * RecordSize);
+        SegmentFile.read(reinterpret_cast<uint8_t*>(&Value), sizeof(uint32_t));
+        if (Value < Timestamp) {
+            Low = Middle + 1;
+        } else {
+            High = Middle;
+        }
+    }
+    return Low;
+}
+
+void TimeSeriesStore::FillHeader(TimeSeriesHeader& Header, uint32_t Sequence, uint32_t FirstTimestamp) const {
+    Header.Magic = TIME_SERIES_MAGIC;
+    Header.Version = TIME_SERIES_VERSION;
+    Header.ValueCount = ValueCount;
+    Header.RecordSize = RecordSize;
+    Header.Sequence = Sequence;
+    Header.FirstTimestamp = FirstTimestamp;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+#include <System.h>
+#include <DeadlineTimer.h>
+#include <LittleFSHandler.h>
+
+#define TIME_SERIES_MAGIC             0x31535354  // "TSS1"
+#define TIME_SERIES_VERSION           1
+#define TIME_SERIES_MAX_VALUES        8
+#define TIME_SERIES_PAGE_SIZE         256         // bytes, flash program page
+#define TIME_SERIES_EXTENSION         ".tss"
+
+// Every segment file, and every stream produced by ReadStream(), starts with this
+// header followed by fixed-size little endian records:
+//     uint32_t Timestamp (epoch seconds) + float Values[ValueCount]
+// A client can decode a stream without any other information.
+struct __attribute__((packed)) TimeSeriesHeader {
+    uint32_t Magic;
+    uint16_t Version;
+    uint8_t  ValueCount;
+    uint8_t  RecordSize;
+    uint32_t Sequence;
+    uint32_t FirstTimestamp;
+};
+
+struct TimeSeriesSegment {
+    uint32_t Sequence;
+    uint32_t FirstTimestamp;
+    uint32_t LastTimestamp;
+    uint32_t RecordCount;
+};
+
+struct TimeSeriesCursor {
+    uint32_t From = 0;
+    uint32_t To = 0;
+    uint32_t Sequence = 0;
+    uint32_t Record = 0;
+    bool HeaderSent = false;
+    bool Done = true;
+};
+
+// Return false to stop the query
+typedef bool (*TimeSeriesCallback)(void* Context, uint32_t Timestamp, const float* Values, uint8_t ValueCount);
+
+// Append-only store of fixed-size records split in segment files under one
+// directory. Writes are buffered and issued up to the next flash page boundary;
+// a full segment is closed and a new one started, the oldest segment is deleted
+// once MaxSegments is exceeded. Timestamps must be non-decreasing, so the
+// in-memory segment table (first/last timestamp of every segment) is a sparse
+// index: a range lookup is a binary search on the table followed by a binary
+// search on the records of one segment file.
+class TimeSeriesStore {
+    public:
+        TimeSeriesStore(const String& Path, uint8_t ValueCount = 1, uint32_t SegmentRecords = 21600, uint16_t MaxSegments = 16);
+        ~TimeSeriesStore();
+
+        bool Begin();
+        void End();
+        void Clear();
+
+        bool Append(uint32_t Timestamp, float Value);
+        bool Append(uint32_t Timestamp, const float* Values);
+        bool Flush();
+        void SetFlushInterval(unsigned long Interval);  // milliseconds
+
+        size_t Query(uint32_t From, uint32_t To, TimeSeriesCallback Callback, void* Context = nullptr);
+
+        bool OpenStream(uint32_t From, uint32_t To, TimeSeriesCursor& Cursor);
+        size_t ReadStream(TimeSeriesCursor& Cursor, uint8_t* Buffer, size_t MaxLength);
+
+        uint8_t GetValueCount() const;
+        uint8_t GetRecordSize() const;
+        uint32_t GetRecordCount();
+        uint32_t GetSegmentCount();
+        uint32_t GetFirstTimestamp();
+        uint32_t GetLastTimestamp();
+        uint32_t GetFlushCount() const;
+        uint32_t GetRotationCount() const;
+
+    private:
+        String LogName = "TimeSeriesStore";
+        LittleFSHandler& FileSystem = LittleFSHandler::GetInstance();
+
+        String Path;
+        uint8_t ValueCount;
+        uint8_t RecordSize;
+        uint32_t SegmentRecords;
+        uint16_t MaxSegments;
+        bool Started = false;
+
+        SemaphoreHandle_t Mutex = nullptr;
+        std::vector<TimeSeriesSegment> Segments;
+        std::vector<String> InvalidSegments;  // found while scanning the directory
+        uint32_t LastSequence = 0;
+        bool LastTorn = false;                // the newest segment ends with a partial record
+        File ActiveFile;
+        size_t ActiveFileSize = 0;          // bytes written to the active segment file
+
+        uint8_t Buffer[TIME_SERIES_PAGE_SIZE];
+        size_t BufferLength = 0;
+        unsigned long FlushInterval = 60000; // milliseconds
+        DeadlineTimer FlushTimer;
+
+        uint32_t FlushCount = 0;
+        uint32_t RotationCount = 0;
+
+        String SegmentPath(uint32_t Sequence) const;
+        static bool ScanEntry(void* Context, const char* EntryPath, const char* Name, bool IsDirectory, size_t Size);
+        bool LoadSegment(const String& Name, TimeSeriesSegment& Segment, bool& Torn);
+        bool StartSegment(uint32_t Sequence, uint32_t FirstTimestamp);
+        bool Rotate(uint32_t FirstTimestamp);
+        bool FlushBuffer();
+        void Buffered(const uint8_t* Data, size_t Length);
+        size_t FindSegment(uint32_t Timestamp);
+        uint32_t FindRecord(File& SegmentFile, const TimeSeriesSegment& Segment, uint32_t Timestamp);
+        void FillHeader(TimeSeriesHeader& Header, uint32_t Sequence, uint32_t FirstTimestamp) const;
+};
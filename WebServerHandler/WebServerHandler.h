@@ -1,14 +1,349 @@
 #ifndef WEB_SERVER_HANDLER_H
 #define WEB_SERVER_HANDLER_H
 
+#include <vector>
+#include <memory>
 #include <ESPAsyncWebServer.h>
+#include <AnalogInputsHandler.h>
+#include <DigitalSignalHandler.h>
+#include <LittleFSHandler.h>
+#include <MetricsRegistry.h>
+#include <LoggerHandler.h>
 
+#define STATIC_ASSET_GZIP_EXTENSION   ".gz"
+#define STATIC_ASSET_ETAG_EXTENSION   ".etag"
+
+#define WEB_SERVER_MAX_ROUTES         16    // route patterns, the first slot collects unmatched URLs
+#define WEB_SERVER_ROUTE_MAX_LENGTH   48    // char
+#define WEB_SERVER_LATENCY_BUCKETS    16    // bucket i counts requests below 2^i ms
+
+struct WebServerRouteStats {
+    char Route[WEB_SERVER_ROUTE_MAX_LENGTH];
+    uint32_t Count;
+    uint64_t TotalTime;                                // microseconds
+    uint32_t MaxTime;                                  // microseconds
+    uint32_t Histogram[WEB_SERVER_LATENCY_BUCKETS];
+    Metric* AverageMetric;
+    Metric* P99Metric;
+};
+
+// Claims every request whose declared body exceeds the limit, before any other
+// handler can start buffering it, and answers 413
+class BodySizeGuardHandler : public AsyncWebHandler {
+    public:
+        BodySizeGuardHandler(const size_t& MaxBodySize, Metric* RejectedMetric)
+            : MaxBodySize(MaxBodySize), RejectedMetric(RejectedMetric) {}
+
+        bool canHandle(AsyncWebServerRequest* Request) const override {
+            return Request->contentLength() > MaxBodySize;
+        }
+
+        void handleRequest(AsyncWebServerRequest* Request) override {
+            RejectedMetric->Increment();
+            Request->send(413, "text/plain", "Payload Too Large");
+        }
+
+    private:
+        const size_t& MaxBodySize;
+        Metric* RejectedMetric;
+};
+
+// Serves the files of a LittleFS directory, preferring the precompressed
+// "<name>.gz" variant. The ETag of every asset is read from "<file>.etag" when
+// the build or upload step provides it, otherwise computed once (CRC32 + size)
+// when the directory is indexed, so a request never hashes a file. The gzip
+// and plain responses are different representations: the gzip one carries
+// the ETag with a "-gzip" suffix, so a cache never swaps them.
+// HTML is revalidated on every load (a 304 when unchanged), the other assets
+// are cached for five minutes and then revalidated the same way. Only a name
+// that carries a content hash, which changes with every build, is cached for
+// a year: a segment of the file name of at least 8 letters, digits or '_'
+// with at least one digit, as in "app.3f2a9c1b.js" or "index-BxT5aK3d.css".
+class StaticAssetHandler : public AsyncWebHandler {
+    public:
+        StaticAssetHandler(const String& UriPrefix, const String& Directory)
+            : UriPrefix(UriPrefix), Directory(Directory) {
+            if (this->UriPrefix.endsWith("/")) {
+                this->UriPrefix.remove(this->UriPrefix.length() - 1);
+            }
+            if (this->Directory.endsWith("/")) {
+                this->Directory.remove(this->Directory.length() - 1);
+            }
+        }
+
+        void SetCacheControl(const String& Html, const String& Assets, const String& HashedAssets) {
+            HtmlCacheControl = Html;
+            AssetCacheControl = Assets;
+            HashedAssetCacheControl = HashedAssets;
+        }
+
+        size_t BuildIndex() {
+            Assets.clear();
+            LittleFSHandler::GetInstance().ForEachEntry(Directory, IndexEntry, this, true);
+            return Assets.size();
+        }
+
+        bool canHandle(AsyncWebServerRequest* Request) const override {
+            return (Request->method() & (HTTP_GET | HTTP_HEAD)) && (Find(Request->url()) != nullptr);
+        }
+
+        void handleRequest(AsyncWebServerRequest* Request) override {
+            const StaticAsset* Asset = Find(Request->url());
+            if (Asset == nullptr) {
+                Request->send(404);
+                return;
+            }
+
+            const String& CacheControl = Asset->ContentType.startsWith("text/html") ? HtmlCacheControl : (Asset->Hashed ? HashedAssetCacheControl : AssetCacheControl);
+
+            // Browsers always accept gzip: the plain file is only a fallback for other clients
+            bool Gzip = Asset->Gzip;
+            if (Gzip && Asset->HasPlain && (!Request->hasHeader("Accept-Encoding") || (Request->header("Accept-Encoding").indexOf("gzip") < 0))) {
+                Gzip = false;
+            }
+            const String& ETag = Gzip ? Asset->GzipETag : Asset->ETag;
+
+            if (Request->hasHeader("If-None-Match") && (Request->header("If-None-Match") == ETag)) {
+                AsyncWebServerResponse* Response = Request->beginResponse(304);
+                Response->addHeader("ETag", ETag);
+                Response->addHeader("Vary", "Accept-Encoding");
+                Response->addHeader("Cache-Control", CacheControl);
+                Request->send(Response);
+                NotModifiedCount++;
+                return;
+            }
+
+            String FilePath = Directory + Asset->Path + (Gzip ? STATIC_ASSET_GZIP_EXTENSION : "");
+            AsyncWebServerResponse* Response = Request->beginResponse(LittleFS, FilePath, Asset->ContentType);
+            if (Gzip) {
+                Response->addHeader("Content-Encoding", "gzip");
+            }
+            Response->addHeader("Vary", "Accept-Encoding");
+            Response->addHeader("ETag", ETag);
+            Response->addHeader("Cache-Control", CacheControl);
+            Request->send(Response);
+            ServedCount++;
+        }
+
+        uint32_t GetServedCount() const {
+            return ServedCount;
+        }
+
+        uint32_t GetNotModifiedCount() const {
+            return NotModifiedCount;
+        }
+
+    private:
+        struct StaticAsset {
+            String Path;          // relative to Directory, without ".gz"
+            String ContentType;
+            String ETag;
+            String GzipETag;      // ETag with the "-gzip" suffix
+            bool Gzip;
+            bool HasPlain;
+            bool Hashed;          // the name carries a content hash
+        };
+
+        String UriPrefix;
+        String Directory;
+        String HtmlCacheControl = "no-cache";
+        String AssetCacheControl = "public, max-age=300";
+        String HashedAssetCacheControl = "public, max-age=31536000, immutable";
+        std::vector<StaticAsset> Assets;
+        uint32_t ServedCount = 0;
+        uint32_t NotModifiedCount = 0;
+
+        const StaticAsset* Find(const String& Url) const {
+            if (!Url.startsWith(UriPrefix)) {
+                return nullptr;
+            }
+            String Path = Url.substring(UriPrefix.length());
+            if ((Path.length() == 0) || Path.endsWith("/")) {
+                Path += "index.html";
+            }
+            for (const StaticAsset& Asset : Assets) {
+                if (Asset.Path == Path) {
+                    return &Asset;
+                }
+            }
+            return nullptr;
+        }
+
+        static bool IndexEntry(void* Context, const char* EntryPath, const char* Name, bool IsDirectory, size_t Size) {
+            StaticAssetHandler* Instance = reinterpret_cast<StaticAssetHandler*>(Context);
+            if (IsDirectory) {
+                return true;
+            }
+
+            String Path = String(EntryPath).substring(Instance->Directory.length());
+            if (Path.endsWith(STATIC_ASSET_ETAG_EXTENSION)) {
+                return true;
+            }
+
+            bool Gzip = Path.endsWith(STATIC_ASSET_GZIP_EXTENSION);
+            if (Gzip) {
+                Path.remove(Path.length() - strlen(STATIC_ASSET_GZIP_EXTENSION));
+            }
+
+            for (StaticAsset& Asset : Instance->Assets) {
+                if (Asset.Path == Path) {
+                    // Prefer the gzip variant, remember that a plain one exists too
+                    if (Gzip) {
+                        Asset.Gzip = true;
+                        Asset.ETag = Instance->ReadETag(EntryPath, Size);
+                        Asset.GzipETag = GzipETagOf(Asset.ETag);
+                    } else {
+                        Asset.HasPlain = true;
+                    }
+                    return true;
+                }
+            }
+
+            String ETag = Instance->ReadETag(EntryPath, Size);
+            Instance->Assets.push_back({Path, ContentTypeOf(Path), ETag, GzipETagOf(ETag), Gzip, !Gzip, HasContentHash(Path)});
+            return true;
+        }
+
+        // Looks for the hash segment in the file name, between '.' or '-' separators
+        static bool HasContentHash(const String& Path) {
+            int Start = Path.lastIndexOf('/') + 1;
+            int End = Path.lastIndexOf('.');
+            size_t Length = 0;
+            bool Digit = false;
+            for (int i = Start; i <= End; i++) {
+                char Character = (i < End) ? Path.charAt(i) : '.';
+                if (isalnum(Character) || (Character == '_')) {
+                    Length++;
+                    Digit = Digit || isdigit(Character);
+                } else {
+                    if ((Length >= 8) && Digit) {
+                        return true;
+                    }
+                    Length = 0;
+                    Digit = false;
+                }
+            }
+            return false;
+        }
+
+        static String GzipETagOf(const String& ETag) {
+            return ETag.substring(0, ETag.length() - 1) + "-gzip\"";
+        }
+
+        String ReadETag(const char* FilePath, size_t Size) {
+            String ETag;
+            String ETagPath = String(FilePath) + STATIC_ASSET_ETAG_EXTENSION;
+            if (LittleFSHandler::GetInstance().FileExists(ETagPath) && LittleFSHandler::GetInstance().ReadFile(ETagPath, ETag)) {
+                ETag.trim();
+                if (!ETag.startsWith("\"")) {
+                    ETag = "\"" + ETag + "\"";
+                }
+                return ETag;
+            }
+
+            uint8_t Buffer[512];
+            uint32_t Crc = 0;
+            LittleFSReader Reader;
+            if (Reader.Open(FilePath)) {
+                size_t Read;
+                while ((Read = Reader.Read(Buffer, sizeof(Buffer))) > 0) {
+                    Crc = esp_rom_crc32_le(Crc, Buffer, Read);
+                }
+            }
+
+            char Value[24];
+            snprintf(Value, sizeof(Value), "\"%08lx-%x\"", static_cast<unsigned long>(Crc), static_cast<unsigned int>(Size));
+            return String(Value);
+        }
+
+        static String ContentTypeOf(const String& Path) {
+            if (Path.endsWith(".html") || Path.endsWith(".htm")) return "text/html";
+            if (Path.endsWith(".css"))   return "text/css";
+            if (Path.endsWith(".js"))    return "application/javascript";
+            if (Path.endsWith(".json"))  return "application/json";
+            if (Path.endsWith(".svg"))   return "image/svg+xml";
+            if (Path.endsWith(".png"))   return "image/png";
+            if (Path.endsWith(".jpg"))   return "image/jpeg";
+            if (Path.endsWith(".ico"))   return "image/x-icon";
+            if (Path.endsWith(".woff2")) return "font/woff2";
+            if (Path.endsWith(".txt"))   return "text/plain";
+            return "application/octet-stream";
+        }
+};
+
+// Live data is pushed as server-sent events. Every period the task sends one
+// "analog" event with a snapshot of all the inputs and, if any signal changed,
+// one "digital" event with the changed signals: each event supersedes the
+// previous one, so a client whose queue is still backed up is simply skipped.
 class WebServerHandler {
     private:
         String LogName = "WebServerHandler";
         AsyncWebServer* Server = nullptr;
         bool IsStarted = false;
 
+        struct LiveSignal {
+            DigitalSignalHandler* Signal;
+            bool LastSentValue;
+        };
+
+        AsyncEventSource* LiveEvents = nullptr;
+        std::vector<AsyncEventSourceClient*> LiveClients;
+        SemaphoreHandle_t LiveClientsSemaphore = nullptr;
+        std::vector<AnalogInputsHandler*> LiveAnalogSources;
+        std::vector<LiveSignal> LiveSignals;
+
+        StaticAssetHandler* StaticAssets = nullptr;
+
+        // Request limits. The slots are only touched by the async_tcp task
+        struct InFlightRequest {
+            AsyncWebServerRequest* Request;
+            int64_t StartTime;                // microseconds
+            WebServerRouteStats* Route;
+            std::function<void()> OnDisconnect;
+        };
+
+        size_t MaxConcurrentRequests = 6;
+        size_t MaxBodySize = 16384;           // bytes
+        unsigned long RequestSlotTimeout = 60000; // milliseconds
+        std::vector<InFlightRequest> InFlight;
+        volatile size_t InFlightRequests = 0;
+        String LivePath = "";
+        BodySizeGuardHandler* BodySizeGuard = nullptr;
+        AsyncMiddlewareFunction* LimitsMiddleware = nullptr;
+        WebServerRouteStats Routes[WEB_SERVER_MAX_ROUTES];
+        size_t RouteCount = 0;
+        portMUX_TYPE RoutesLock = portMUX_INITIALIZER_UNLOCKED;
+        Metric* RequestsMetric = nullptr;
+        Metric* BusyMetric = nullptr;
+        Metric* TooLargeMetric = nullptr;
+        Metric* InFlightMetric = nullptr;
+        Metric* ReclaimedMetric = nullptr;
+
+        void ApplyLimits(AsyncWebServerRequest* Request, ArMiddlewareNext Next);
+        void ReleaseRequest(AsyncWebServerRequest* Request);
+        void ReclaimRequestSlots();
+        WebServerRouteStats* FindRoute(const String& Url);
+        static bool MatchRoute(const char* Pattern, const String& Url);
+        void RecordLatency(WebServerRouteStats* Route, uint32_t Time);
+        static uint32_t Percentile(const WebServerRouteStats& Route, float Fraction);
+        static void CollectMetrics(void* Context);
+
+        TaskHandle_t LiveTaskPointer = nullptr;
+        int LiveTaskPriority = 1;
+        volatile bool LiveStopRequested = false;
+        unsigned long LivePeriod = 250;       // milliseconds
+        size_t LiveMaxBacklog = 4;            // packets waiting before a client is skipped
+        volatile bool LiveFullSnapshot = true;
+        uint32_t LiveEventId = 0;
+        uint32_t LiveSkippedCount = 0;
+
+        static void LiveTaskStatic(void *pvParameters);
+        void LiveTask();
+        void PublishLiveData();
+        String BuildAnalogEvent();
+        String BuildDigitalEvent(bool Full);
+        bool SendLiveEvent(const String& Data, const char* Event);
+
     public:
         WebServerHandler();
         ~WebServerHandler();
@@ -18,17 +353,75 @@ class WebServerHandler {
 
         AsyncWebServer* GetServer();
         bool IsRunning();
+
+        void ServeStaticAssets(const String& UriPrefix = "/", const String& Directory = "/www");
+        StaticAssetHandler* GetStaticAssets();
+
+        void EnableMetrics(const String& Path = "/metrics");
+
+        void SetMaxConcurrentRequests(size_t Requests);
+        void SetMaxBodySize(size_t Size);
+        void SetRequestSlotTimeout(unsigned long Timeout);
+        size_t GetInFlightRequests();
+        // Handlers must register their disconnect callback here, not with
+        // Request->onDisconnect(): that replaces the one releasing the request
+        // slot, which is then only reclaimed after the slot timeout
+        void OnRequestDisconnect(AsyncWebServerRequest* Request, std::function<void()> Callback);
+        void AddRoutePattern(const String& Pattern);
+        size_t GetRouteCount();
+        bool GetRouteStats(size_t Index, WebServerRouteStats& Stats);
+        void LogRouteStats();
+
+        void EnableLiveData(const String& Path = "/live", unsigned long Period = 250);
+        void AddLiveSource(AnalogInputsHandler* Source);
+        void AddLiveSource(DigitalSignalHandler* Source);
+        void SetLiveMaxBacklog(size_t Packets);
+
+        size_t GetLiveClientCount();
+        uint32_t GetLiveEventCount();
+        uint32_t GetLiveSkippedCount();
 };
 
 WebServerHandler::WebServerHandler() {
     Server = new AsyncWebServer(80);
+    LiveClientsSemaphore = xSemaphoreCreateMutex();
+
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    RequestsMetric = Metrics.AddCounter("http_requests_total", "HTTP requests accepted");
+    BusyMetric     = Metrics.AddCounter("http_rejected_total", "HTTP requests rejected", "reason=\"busy\"");
+    TooLargeMetric = Metrics.AddCounter("http_rejected_total", "HTTP requests rejected", "reason=\"too_large\"");
+    InFlightMetric = Metrics.AddGauge("http_in_flight_requests", "HTTP requests being served");
+    ReclaimedMetric = Metrics.AddCounter("http_request_slots_reclaimed_total", "Request slots never released by the server, reclaimed after the timeout");
+    Metrics.AddCollector(CollectMetrics, this);
+    AddRoutePattern("*");
+
+    // The guard must be the first handler, the middleware runs before every handler
+    BodySizeGuard = new BodySizeGuardHandler(MaxBodySize, TooLargeMetric);
+    Server->addHandler(BodySizeGuard);
+    LimitsMiddleware = new AsyncMiddlewareFunction([this](AsyncWebServerRequest* Request, ArMiddlewareNext Next) {
+        ApplyLimits(Request, Next);
+    });
+    Server->addMiddleware(LimitsMiddleware);
+
     LOG(INFO, LogName, "Instance created");
 }
 
 WebServerHandler::~WebServerHandler() {
     Stop();
-    delete Server;
+    MetricsRegistry::GetInstance().RemoveCollector(CollectMetrics, this);
+    // The live task may be holding LiveClientsSemaphore, it is asked to stop
+    // and deletes itself at the end of its period
+    if (LiveTaskPointer != nullptr) {
+        LiveStopRequested = true;
+        while (LiveTaskPointer != nullptr) {
+            vTaskDelay(1);
+        }
+    }
+    delete Server;             // also deletes its handlers, LiveEvents included
     Server = nullptr;
+    LiveEvents = nullptr;
+    delete LimitsMiddleware;   // middlewares are not owned by the server
+    vSemaphoreDelete(LiveClientsSemaphore);
     LOG(INFO, LogName, "Instance destroyed");
 }
 
@@ -56,4 +449,405 @@ bool WebServerHandler::IsRunning() {
     return IsStarted;
 }
 
+// Must be called after LittleFS has been mounted; call it again after an upload
+// to rebuild the asset index
+void WebServerHandler::ServeStaticAssets(const String& UriPrefix, const String& Directory) {
+    if (StaticAssets == nullptr) {
+        StaticAssets = new StaticAssetHandler(UriPrefix, Directory);
+        Server->addHandler(StaticAssets);
+        AddRoutePattern(UriPrefix + (UriPrefix.endsWith("/") ? "*" : "/*"));
+    }
+    size_t Count = StaticAssets->BuildIndex();
+    LOG(INFO, LogName, "Serving " + String(Count) + " static assets from " + Directory + " on " + UriPrefix);
+}
+
+StaticAssetHandler* WebServerHandler::GetStaticAssets() {
+    return StaticAssets;
+}
+
+void WebServerHandler::SetMaxConcurrentRequests(size_t Requests) {
+    MaxConcurrentRequests = Requests;
+    LOG(INFO, LogName, "Max concurrent requests set to " + String(Requests));
+}
+
+void WebServerHandler::SetMaxBodySize(size_t Size) {
+    MaxBodySize = Size;
+    LOG(INFO, LogName, "Max request body size set to " + String(Size) + " bytes");
+}
+
+void WebServerHandler::SetRequestSlotTimeout(unsigned long Timeout) {
+    RequestSlotTimeout = Timeout;
+    LOG(INFO, LogName, "Request slot timeout set to " + String(Timeout) + " ms");
+}
+
+size_t WebServerHandler::GetInFlightRequests() {
+    return InFlightRequests;
+}
+
+size_t WebServerHandler::GetRouteCount() {
+    return RouteCount;
+}
+
+bool WebServerHandler::GetRouteStats(size_t Index, WebServerRouteStats& Stats) {
+    if (Index >= RouteCount) return false;
+    portENTER_CRITICAL(&RoutesLock);
+    Stats = Routes[Index];
+    portEXIT_CRITICAL(&RoutesLock);
+    return true;
+}
+
+void WebServerHandler::LogRouteStats() {
+    WebServerRouteStats Stats;
+    for (size_t i = 0; i < RouteCount; i++) {
+        GetRouteStats(i, Stats);
+        if (Stats.Count == 0) continue;
+        LOG(INFO, LogName, String(Stats.Route) + " - requests: " + String(Stats.Count) + ", avg: " + String(static_cast<unsigned long>(Stats.TotalTime / Stats.Count / 1000)) + " ms, p99: " + String(Percentile(Stats, 0.99f)) + " ms, max: " + String(Stats.MaxTime / 1000) + " ms");
+    }
+}
+
+// Long-lived event streams are neither limited nor timed. Latency runs from the
+// handler call to the release of the request, so it includes the response transfer.
+void WebServerHandler::ApplyLimits(AsyncWebServerRequest* Request, ArMiddlewareNext Next) {
+    if ((LivePath.length() > 0) && (Request->url() == LivePath)) {
+        Next();
+        return;
+    }
+
+    if (InFlight.size() >= MaxConcurrentRequests) {
+        ReclaimRequestSlots();
+    }
+    if (InFlight.size() >= MaxConcurrentRequests) {
+        BusyMetric->Increment();
+        AsyncWebServerResponse* Response = Request->beginResponse(503, "text/plain", "Service Unavailable");
+        Response->addHeader("Retry-After", "1");
+        Request->send(Response);
+        return;
+    }
+
+    // A slot with the same address belongs to a request already freed
+    for (auto Iterator = InFlight.begin(); Iterator != InFlight.end(); ++Iterator) {
+        if (Iterator->Request == Request) {
+            InFlight.erase(Iterator);
+            break;
+        }
+    }
+
+    InFlight.push_back({Request, esp_timer_get_time(), FindRoute(Request->url()), nullptr});
+    InFlightRequests = InFlight.size();
+    InFlightMetric->Set(InFlightRequests);
+    RequestsMetric->Increment();
+
+    Request->onDisconnect([this, Request]() {
+        ReleaseRequest(Request);
+    });
+
+    Next();
+}
+
+void WebServerHandler::OnRequestDisconnect(AsyncWebServerRequest* Request, std::function<void()> Callback) {
+    for (InFlightRequest& Slot : InFlight) {
+        if (Slot.Request == Request) {
+            Slot.OnDisconnect = Callback;
+            return;
+        }
+    }
+    // Not limited, as the live event stream
+    Request->onDisconnect(Callback);
+}
+
+void WebServerHandler::ReleaseRequest(AsyncWebServerRequest* Request) {
+    for (auto Iterator = InFlight.begin(); Iterator != InFlight.end(); ++Iterator) {
+        if (Iterator->Request == Request) {
+            std::function<void()> Callback = Iterator->OnDisconnect;
+            RecordLatency(Iterator->Route, static_cast<uint32_t>(esp_timer_get_time() - Iterator->StartTime));
+            InFlight.erase(Iterator);
+            InFlightRequests = InFlight.size();
+            InFlightMetric->Set(InFlightRequests);
+            if (Callback) {
+                Callback();
+            }
+            return;
+        }
+    }
+}
+
+// Only reached when every slot is taken: a handler that replaced the
+// disconnect callback would otherwise leave the server answering 503 forever
+void WebServerHandler::ReclaimRequestSlots() {
+    int64_t Now = esp_timer_get_time();
+    for (auto Iterator = InFlight.begin(); Iterator != InFlight.end(); ) {
+        if ((Now - Iterator->StartTime) < static_cast<int64_t>(RequestSlotTimeout) * 1000) {
+            ++Iterator;
+            continue;
+        }
+        LOG(WARNING, LogName, "Request slot of " + String(Iterator->Route->Route) + " reclaimed, was onDisconnect() replaced?");
+        ReclaimedMetric->Increment();
+        Iterator = InFlight.erase(Iterator);
+    }
+    InFlightRequests = InFlight.size();
+    InFlightMetric->Set(InFlightRequests);
+}
+
+// Latency is kept per registered pattern, not per URL: a client walking
+// arbitrary paths only adds to the unmatched slot. Patterns match like the
+// handlers of the server ("/a" also covers "/a/...", "/a*" is a prefix) and
+// the longest match wins. Declare here the handlers added through GetServer().
+void WebServerHandler::AddRoutePattern(const String& Pattern) {
+    for (size_t i = 0; i < RouteCount; i++) {
+        if (strncmp(Routes[i].Route, Pattern.c_str(), WEB_SERVER_ROUTE_MAX_LENGTH - 1) == 0) {
+            return;
+        }
+    }
+    if (RouteCount == WEB_SERVER_MAX_ROUTES) {
+        LOG(WARNING, LogName, "Route " + Pattern + " not timed, too many routes");
+        return;
+    }
+
+    WebServerRouteStats& Route = Routes[RouteCount];
+    memset(&Route, 0, sizeof(Route));
+    strlcpy(Route.Route, Pattern.c_str(), sizeof(Route.Route));
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    String Labels = "route=\"" + MetricsRegistry::EscapeLabelValue(Route.Route) + "\"";
+    Route.AverageMetric = Metrics.AddGauge("http_request_latency_average_ms", "Average request latency", Labels);
+    Route.P99Metric = Metrics.AddGauge("http_request_latency_p99_ms", "99th percentile of the request latency, upper bound of its histogram bucket", Labels);
+    RouteCount++;
+}
+
+WebServerRouteStats* WebServerHandler::FindRoute(const String& Url) {
+    WebServerRouteStats* Best = &Routes[0];
+    size_t BestLength = 0;
+    for (size_t i = 1; i < RouteCount; i++) {
+        size_t Length = strlen(Routes[i].Route);
+        if ((Length > BestLength) && MatchRoute(Routes[i].Route, Url)) {
+            Best = &Routes[i];
+            BestLength = Length;
+        }
+    }
+    return Best;
+}
+
+bool WebServerHandler::MatchRoute(const char* Pattern, const String& Url) {
+    size_t Length = strlen(Pattern);
+    if ((Length > 0) && (Pattern[Length - 1] == '*')) {
+        return strncmp(Url.c_str(), Pattern, Length - 1) == 0;
+    }
+    if (strncmp(Url.c_str(), Pattern, Length) != 0) {
+        return false;
+    }
+    return (Url.length() == Length) || (Url[Length] == '/');
+}
+
+void WebServerHandler::RecordLatency(WebServerRouteStats* Route, uint32_t Time) {
+    uint32_t Milliseconds = Time / 1000;
+    size_t Bucket = 0;
+    while ((Bucket < WEB_SERVER_LATENCY_BUCKETS - 1) && (Milliseconds >= (1UL << Bucket))) {
+        Bucket++;
+    }
+
+    portENTER_CRITICAL(&RoutesLock);
+    Route->Count++;
+    Route->TotalTime += Time;
+    Route->MaxTime = max(Route->MaxTime, Time);
+    Route->Histogram[Bucket]++;
+    portEXIT_CRITICAL(&RoutesLock);
+}
+
+// Upper bound in milliseconds of the histogram bucket holding the percentile
+uint32_t WebServerHandler::Percentile(const WebServerRouteStats& Route, float Fraction) {
+    uint32_t Target = static_cast<uint32_t>(ceilf(Route.Count * Fraction));
+    uint32_t Cumulative = 0;
+    for (size_t Bucket = 0; Bucket < WEB_SERVER_LATENCY_BUCKETS; Bucket++) {
+        Cumulative += Route.Histogram[Bucket];
+        if (Cumulative >= Target) {
+            return 1UL << Bucket;
+        }
+    }
+    return Route.MaxTime / 1000;
+}
+
+void WebServerHandler::CollectMetrics(void* Context) {
+    WebServerHandler* Instance = reinterpret_cast<WebServerHandler*>(Context);
+    WebServerRouteStats Stats;
+    for (size_t i = 0; i < Instance->RouteCount; i++) {
+        Instance->GetRouteStats(i, Stats);
+        if (Stats.Count == 0) continue;
+        Stats.AverageMetric->Set(static_cast<float>(Stats.TotalTime) / Stats.Count / 1000.0f);
+        Stats.P99Metric->Set(Percentile(Stats, 0.99f));
+    }
+}
+
+// The registry is rendered straight into the chunk buffers of the response,
+// a few lines at a time
+void WebServerHandler::EnableMetrics(const String& Path) {
+    Server->on(Path.c_str(), HTTP_GET, [](AsyncWebServerRequest* Request) {
+        std::shared_ptr<MetricsCursor> Cursor = std::make_shared<MetricsCursor>();
+        AsyncWebServerResponse* Response = Request->beginChunkedResponse("text/plain; version=0.0.4", [Cursor](uint8_t* Buffer, size_t MaxLength, size_t Index) -> size_t {
+            return MetricsRegistry::GetInstance().Render(*Cursor, Buffer, MaxLength);
+        });
+        Response->addHeader("Cache-Control", "no-store");
+        Request->send(Response);
+    });
+    AddRoutePattern(Path);
+    LOG(INFO, LogName, "Metrics enabled on " + Path);
+}
+
+void WebServerHandler::EnableLiveData(const String& Path, unsigned long Period) {
+    if (LiveEvents != nullptr) return;
+
+    LivePeriod = Period;
+    LivePath = Path;
+    LiveEvents = new AsyncEventSource(Path);
+
+    LiveEvents->onConnect([this](AsyncEventSourceClient* Client) {
+        xSemaphoreTake(LiveClientsSemaphore, portMAX_DELAY);
+        LiveClients.push_back(Client);
+        xSemaphoreGive(LiveClientsSemaphore);
+        LiveFullSnapshot = true;
+    });
+
+    // Clients are removed under the same lock used while sending, so a pointer
+    // is never used after the library has released it
+    LiveEvents->onDisconnect([this](AsyncEventSourceClient* Client) {
+        xSemaphoreTake(LiveClientsSemaphore, portMAX_DELAY);
+        for (auto Iterator = LiveClients.begin(); Iterator != LiveClients.end(); ++Iterator) {
+            if (*Iterator == Client) {
+                LiveClients.erase(Iterator);
+                break;
+            }
+        }
+        xSemaphoreGive(LiveClientsSemaphore);
+    });
+
+    Server->addHandler(LiveEvents);
+    xTaskCreatePinnedToCore(LiveTaskStatic, "WebServer_LiveTask", 4096, this, LiveTaskPriority, &LiveTaskPointer, 1);
+    LOG(INFO, LogName, "Live data enabled on " + Path + " every " + String(Period) + " ms");
+}
+
+void WebServerHandler::AddLiveSource(AnalogInputsHandler* Source) {
+    if (Source) {
+        LiveAnalogSources.push_back(Source);
+    }
+}
+
+void WebServerHandler::AddLiveSource(DigitalSignalHandler* Source) {
+    if (Source) {
+        LiveSignals.push_back({Source, Source->GetFilteredSignal()});
+        LOG(INFO, LogName, "Live signal " + Source->GetName() + " added");
+    }
+}
+
+void WebServerHandler::SetLiveMaxBacklog(size_t Packets) {
+    LiveMaxBacklog = Packets;
+}
+
+size_t WebServerHandler::GetLiveClientCount() {
+    xSemaphoreTake(LiveClientsSemaphore, portMAX_DELAY);
+    size_t Count = LiveClients.size();
+    xSemaphoreGive(LiveClientsSemaphore);
+    return Count;
+}
+
+uint32_t WebServerHandler::GetLiveEventCount() {
+    return LiveEventId;
+}
+
+uint32_t WebServerHandler::GetLiveSkippedCount() {
+    return LiveSkippedCount;
+}
+
+void WebServerHandler::LiveTaskStatic(void *pvParameters) {
+    WebServerHandler* Instance = reinterpret_cast<WebServerHandler*>(pvParameters);
+    Instance->LiveTask();
+}
+
+void WebServerHandler::LiveTask() {
+    TickType_t StartTick, ExecutionTick, TaskTickPeriod;
+
+    while (!LiveStopRequested) {
+        StartTick = xTaskGetTickCount();
+        TaskTickPeriod = LivePeriod / portTICK_PERIOD_MS;
+
+        if (IsStarted && (GetLiveClientCount() > 0)) {
+            PublishLiveData();
+        }
+
+        ExecutionTick = xTaskGetTickCount() - StartTick;
+        if (ExecutionTick < TaskTickPeriod) {
+            vTaskDelay(TaskTickPeriod - ExecutionTick);
+        }
+    }
+
+    LiveTaskPointer = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void WebServerHandler::PublishLiveData() {
+    bool Full = LiveFullSnapshot;
+    LiveFullSnapshot = false;
+
+    if (!LiveAnalogSources.empty()) {
+        SendLiveEvent(BuildAnalogEvent(), "analog");
+    }
+
+    // A client that misses a change set gets every signal on the next period
+    String Digital = BuildDigitalEvent(Full);
+    if ((Digital.length() > 0) && !SendLiveEvent(Digital, "digital")) {
+        LiveFullSnapshot = true;
+    }
+}
+
+String WebServerHandler::BuildAnalogEvent() {
+    String Data;
+    Data.reserve(64 + 48 * LiveAnalogSources.size() * 4);
+    Data = "{\"time\":" + String(millis()) + ",\"inputs\":[";
+
+    bool First = true;
+    for (auto Source : LiveAnalogSources) {
+        for (size_t i = 0; i < Source->GetInputCount(); i++) {
+            AnalogInputHandler* Input = Source->GetInput(i);
+            if (!First) Data += ",";
+            Data += "{\"name\":\"" + Input->GetName() + "\",\"value\":" + String(Input->GetValue(), 3) + ",\"voltage\":" + String(Input->GetVoltage(), 3) + "}";
+            First = false;
+        }
+    }
+    Data += "]}";
+    return Data;
+}
+
+// Only the signals whose filtered value differs from the last one sent, all of them on Full
+String WebServerHandler::BuildDigitalEvent(bool Full) {
+    String Signals;
+    for (auto& Signal : LiveSignals) {
+        bool Value = Signal.Signal->GetFilteredSignal();
+        if (Full || (Value != Signal.LastSentValue)) {
+            if (Signals.length() > 0) Signals += ",";
+            Signals += "{\"name\":\"" + Signal.Signal->GetName() + "\",\"value\":" + String(Value ? 1 : 0) + "}";
+            Signal.LastSentValue = Value;
+        }
+    }
+
+    if (Signals.length() == 0) {
+        return Signals;
+    }
+    return "{\"time\":" + String(millis()) + ",\"signals\":[" + Signals + "]}";
+}
+
+// Returns false if at least one client was skipped
+bool WebServerHandler::SendLiveEvent(const String& Data, const char* Event) {
+    bool AllSent = true;
+    LiveEventId++;
+
+    xSemaphoreTake(LiveClientsSemaphore, portMAX_DELAY);
+    for (auto Client : LiveClients) {
+        if (Client->packetsWaiting() >= LiveMaxBacklog) {
+            LiveSkippedCount++;
+            AllSent = false;
+            continue;
+        }
+        Client->send(Data.c_str(), Event, LiveEventId);
+    }
+    xSemaphoreGive(LiveClientsSemaphore);
+    return AllSent;
+}
+
 #endif // WEB_SERVER_HANDLER_H
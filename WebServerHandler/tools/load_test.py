@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Load test for WebServerHandler: N clients request a URL back to back for a
+fixed time, at every concurrency level, and the throughput and latency seen
+by the clients are reported.
+
+    python3 load_test.py http://192.168.1.50/metrics
+    python3 load_test.py --clients 1,4,16 --duration 5 http://esp32.local/
+    python3 load_test.py --loopback build/host/WebServerLoopback
+
+--loopback starts the host build of WebServerHandler (the WebServerLoopback
+target of test/host) on 127.0.0.1 and loads it: the requests go through the
+real limits middleware, so the 503s and the route latency come from the
+library code, while the transport and the service time are the host ones.
+It checks the harness and the limits, not the device throughput.
+
+    cmake -S test/host -B build/host && cmake --build build/host --target WebServerLoopback
+"""
+
+import argparse
+import http.client
+import math
+import subprocess
+import threading
+import time
+import urllib.parse
+
+
+def start_loopback(binary, max_concurrent, service_time):
+    process = subprocess.Popen([binary, "--max-concurrent", str(max_concurrent), "--service-time", str(service_time)],
+                               stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+    line = process.stdout.readline()
+    if not line.startswith("Listening on "):
+        process.kill()
+        raise SystemExit("%s did not start" % binary)
+    return process, "http://%s/" % line.split()[-1]
+
+
+def percentile(values, fraction):
+    if not values:
+        return 0.0
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, max(0, math.ceil(fraction * len(ordered)) - 1))  # nearest rank
+    return ordered[index]
+
+
+def client(url, deadline, keep_alive, timeout, result):
+    connection = None
+    while time.monotonic() < deadline:
+        start = time.monotonic()
+        try:
+            if connection is None:
+                connection = http.client.HTTPConnection(url.hostname, url.port or 80, timeout=timeout)
+            path = url.path or "/"
+            if url.query:
+                path += "?" + url.query
+            connection.request("GET", path, headers={} if keep_alive else {"Connection": "close"})
+            response = connection.getresponse()
+            response.read()
+            status = response.status
+            if not keep_alive or response.will_close:
+                connection.close()
+                connection = None
+        except (OSError, http.client.HTTPException):
+            status = None
+            if connection is not None:
+                connection.close()
+                connection = None
+        elapsed = (time.monotonic() - start) * 1000
+        if status == 200 or status == 304:
+            result["latency"].append(elapsed)
+        elif status == 503:
+            result["busy"] += 1
+        else:
+            result["errors"] += 1
+    if connection is not None:
+        connection.close()
+
+
+def run_level(url, clients, duration, keep_alive, timeout):
+    results = [{"latency": [], "busy": 0, "errors": 0} for _ in range(clients)]
+    deadline = time.monotonic() + duration
+    threads = [threading.Thread(target=client, args=(url, deadline, keep_alive, timeout, result)) for result in results]
+    start = time.monotonic()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.monotonic() - start
+
+    latency = [value for result in results for value in result["latency"]]
+    return {
+        "clients": clients,
+        "ok": len(latency),
+        "rate": len(latency) / elapsed,
+        "p50": percentile(latency, 0.50),
+        "p99": percentile(latency, 0.99),
+        "busy": sum(result["busy"] for result in results),
+        "errors": sum(result["errors"] for result in results),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("url", nargs="?", help="URL to request, e.g. http://192.168.1.50/metrics")
+    parser.add_argument("--clients", default="1,2,4,8,16,32", help="comma separated concurrency levels")
+    parser.add_argument("--duration", type=float, default=10, help="seconds per level")
+    parser.add_argument("--timeout", type=float, default=5, help="seconds per request")
+    parser.add_argument("--keep-alive", action="store_true", help="reuse connections instead of one per request")
+    parser.add_argument("--loopback", metavar="BINARY", help="start and test the host build of WebServerHandler")
+    parser.add_argument("--max-concurrent", type=int, default=6, help="loopback concurrency limit")
+    parser.add_argument("--service-time", type=float, default=5, help="loopback milliseconds per request")
+    args = parser.parse_args()
+
+    server = None
+    if args.loopback:
+        server, args.url = start_loopback(args.loopback, args.max_concurrent, args.service_time)
+    elif not args.url:
+        parser.error("a URL or --loopback is required")
+
+    url = urllib.parse.urlsplit(args.url)
+    print("%s, %g s per level, %s" % (args.url, args.duration, "keep-alive" if args.keep_alive else "one connection per request"))
+    print("%7s %8s %9s %9s %9s %7s %7s" % ("clients", "ok", "req/s", "p50 ms", "p99 ms", "503", "errors"))
+    for clients in (int(value) for value in args.clients.split(",")):
+        level = run_level(url, clients, args.duration, args.keep_alive, args.timeout)
+        print("%7d %8d %9.1f %9.1f %9.1f %7d %7d" % (level["clients"], level["ok"], level["rate"], level["p50"], level["p99"], level["busy"], level["errors"]))
+
+    if server is not None:
+        server.terminate()
+        server.wait()
+
+
+if __name__ == "__main__":
+    main()
@@ -1,8 +1,14 @@
 #ifndef WIFI_HANDLER_H
 #define WIFI_HANDLER_H
 
+#include <vector>
 #include <WiFi.h>
+#include <esp_netif.h>
+#include <lwip/dhcp.h>
+#include <Preferences.h>
 #include <System.h>
+#include <DeadlineTimer.h>
+#include <MetricsRegistry.h>
 #include <LoggerHandler.h>
 
 typedef void (*ConnectionCallback)();
@@ -19,9 +25,44 @@ class WifiHandler {
             CONNECTION_IN_PROGRESS,
             POST_CONNECTION_DELAY,
             CONNECTED,
+            ROAMING_SCAN,
+            ROAMING_IN_PROGRESS,
             DISCONNECTION_IN_PROGRESS,
         };
 
+        enum WifiEventEnum {
+            COMMAND_EVENT,
+            GOT_IP_EVENT,
+            DISCONNECTED_EVENT,
+            SCAN_DONE_EVENT,
+        };
+
+        struct WifiEventMessage {
+            WifiEventEnum Type;
+            uint8_t Reason;
+        };
+
+        struct WifiNetworkStruct {
+            String SSID;
+            String Password;
+        };
+
+        // Last good association, persisted in NVS and used for a directed fast connection.
+        // The address is reused only while its DHCP lease runs: the expiry is on the
+        // persistent clock, which keeps counting only through a warm boot, so the NVS
+        // copy stores none and a cold boot always asks DHCP
+        struct ConnectionCacheStruct {
+            bool Valid;
+            char SSID[33];
+            uint8_t BSSID[6];
+            int32_t Channel;
+            uint32_t LocalIP;
+            uint32_t Gateway;
+            uint32_t Subnet;
+            uint32_t Dns;
+            int64_t LeaseExpiry;    // WarmBootStore::GetPersistentClock() microseconds, 0 when unknown
+        };
+
         // Private variables
         int HandlerTaskPriority = 3;
         TaskHandle_t HandlerTaskPointer = NULL;
@@ -29,11 +70,65 @@ class WifiHandler {
         String WifiHostname = "UndefinedHostname";
         String WifiSSID = "";
         String WifiPassword = "";
-        unsigned long ClockTime = 100; // milliseconds
         unsigned long PostConnectionDelay = 5000; // milliseconds
         unsigned long ConnectionMaxTime = 20000; // milliseconds
         unsigned long DisconnectionMaxTime = 20000; // milliseconds
+        unsigned long FastConnectionMaxTime = 3000; // milliseconds
         bool Enabled = false;
+        DeadlineTimer StateTimer;
+
+        // Networks in priority order, WifiSSID and WifiPassword hold the selected one
+        std::vector<WifiNetworkStruct> Networks;
+        size_t SelectedNetwork = 0;
+        uint32_t ConnectionAttempts = 0;
+        uint32_t ConnectionFailures = 0;
+
+        // Roaming
+        bool RoamingEnabled = false;
+        int RoamingRssiThreshold = -70; // dBm, scan for a better access point below this level
+        int RoamingHysteresis = 8; // dB, a candidate must be stronger than the current access point by this margin
+        unsigned long RoamingCheckPeriod = 10000; // milliseconds
+        unsigned long RoamingScanMaxTime = 5000; // milliseconds
+        bool ScanDone = false;
+        uint8_t RoamingTargetBSSID[6] = {0};
+        int64_t RoamingStartTime = ZERO_TIME; // microseconds
+        uint32_t RoamingCount = 0;
+        uint32_t RoamingFailures = 0;
+        uint32_t RoamingScans = 0;
+
+        // Fast reconnection
+        Preferences CachePreferences;
+        const char* CachePreferencesNamespace = "WifiHandler";
+        const char* CachePreferencesKey = "Connection";
+        const char* WarmBootKey = "wifi";
+        ConnectionCacheStruct ConnectionCache = {};
+        bool ConnectionCacheLoaded = false;
+        bool FastReconnectEnabled = false;
+        bool FastConnectionAttempt = false;
+        bool CachedAddressUsed = false;             // the fast connection reused the leased address
+        bool DhcpRenewalPending = false;            // back to DHCP after a cached address, waiting for the lease
+        int64_t ConnectionStartTime = ZERO_TIME;    // microseconds
+        unsigned long LastConnectionTime = 0;       // milliseconds, from WiFi.begin() to IP address
+
+        // Event handling: WiFi events are forwarded to the handler task through EventQueue
+        QueueHandle_t EventQueue = NULL;
+        int EventQueueSize = 16;
+        wifi_event_id_t WifiEventId = 0;
+        bool LinkUp = false;
+        volatile bool EventsLost = false;
+
+        // Disconnection statistics (reason codes are wifi_err_reason_t values)
+        uint32_t DisconnectionCount = 0;
+        uint8_t LastDisconnectionReason = 0;
+        uint16_t DisconnectionReasonCounters[256] = {0};
+
+        // Metrics
+        Metric* ConnectionAttemptsMetric = nullptr;
+        Metric* ConnectionFailuresMetric = nullptr;
+        Metric* DisconnectionsMetric = nullptr;
+        Metric* RoamingMetric = nullptr;
+        Metric* ConnectedMetric = nullptr;
+        Metric* RssiMetric = nullptr;
 
         ConnectionCallback OnConnectedCallback = nullptr;
         DisconnectionCallback OnDisconnectedCallback = nullptr;
@@ -43,6 +138,17 @@ class WifiHandler {
 
         // Private functions
         void HandlerTask(void *pvParameters);
+        void OnWifiEvent(arduino_event_id_t Event, arduino_event_info_t Info);
+        void NotifyTask();
+        void ProcessEvent(const WifiEventMessage& Message);
+        void StartConnection();
+        void LoadConnectionCache();
+        void UpdateConnectionCache();
+        void InvalidateConnectionCache();
+        uint32_t GetLeaseTime();
+        static void CollectMetrics(void* Context);
+        void SelectNetwork(size_t Index);
+        bool StartRoaming();
 
     public:
         // Constructor and distructor
@@ -52,8 +158,12 @@ class WifiHandler {
         // Public configuration functions
         void SetHostname(const String& hostname);
         void SetSSIDAndPassword(const String& ssid, const String& password);
+        void AddNetwork(const String& ssid, const String& password);
+        void SetRoaming(bool Enable, int RssiThreshold = -70, int Hysteresis = 8);
         void SetEncryptionKey(const byte* key);
         void SetEncryptionIV(const byte* iv);
+        void SetFastReconnect(bool Enable);
+        void SetPostConnectionDelay(unsigned long Delay);
 
         // Public functions
         void Enable();
@@ -63,12 +173,35 @@ class WifiHandler {
         bool IsConnected();
         int GetSignalStrength();
         String GetIPAddress();
+        uint32_t GetDisconnectionCount();
+        uint8_t GetLastDisconnectionReason();
+        uint16_t GetDisconnectionReasonCount(uint8_t Reason);
+        unsigned long GetLastConnectionTime();
+        uint32_t GetConnectionAttemptCount();
+        uint32_t GetConnectionFailureCount();
+        uint32_t GetRoamingCount();
+        uint32_t GetRoamingFailureCount();
+        uint32_t GetRoamingScanCount();
 };
 
 // Costruttore
 WifiHandler::WifiHandler() {
     LOG(INFO, LogName, "Instance created");
 
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    ConnectionAttemptsMetric = Metrics.AddCounter("wifi_connection_attempts_total", "WiFi connection attempts");
+    ConnectionFailuresMetric = Metrics.AddCounter("wifi_connection_failures_total", "WiFi connection attempts that timed out");
+    DisconnectionsMetric     = Metrics.AddCounter("wifi_disconnections_total", "WiFi disconnection events");
+    RoamingMetric            = Metrics.AddCounter("wifi_roaming_total", "Successful roamings to another access point");
+    ConnectedMetric          = Metrics.AddGauge("wifi_connected", "1 when connected to an access point");
+    RssiMetric               = Metrics.AddGauge("wifi_rssi_dbm", "Signal strength of the current access point");
+    Metrics.AddCollector(CollectMetrics, this);
+
+    EventQueue = xQueueCreate(EventQueueSize, sizeof(WifiEventMessage));
+    WifiEventId = WiFi.onEvent([this](arduino_event_id_t Event, arduino_event_info_t Info) {
+        this->OnWifiEvent(Event, Info);
+    });
+
     BaseType_t Task;
     Task = xTaskCreatePinnedToCore([](void* pvParameters) {
         WifiHandler* _this = reinterpret_cast<WifiHandler*>(pvParameters);
@@ -77,29 +210,47 @@ WifiHandler::WifiHandler() {
 
     if (Task == pdPASS) {
         LOG(INFO, LogName, "Task created");
+        Metrics.AddTask("WiFi_HandlerTask", HandlerTaskPointer);
     } else {
         LOG(INFO, LogName, "Failed to create task");
     }
 }
 
+// RSSI is sampled only when metrics are scraped
+void WifiHandler::CollectMetrics(void* Context) {
+    WifiHandler* _this = reinterpret_cast<WifiHandler*>(Context);
+    _this->ConnectedMetric->Set(_this->WifiConnected ? 1 : 0);
+    _this->RssiMetric->Set(_this->WifiConnected ? WiFi.RSSI() : 0);
+}
+
 // Distruttore
 WifiHandler::~WifiHandler() {
     LOG(INFO, LogName, "Instance deleted");
 
+    MetricsRegistry::GetInstance().RemoveCollector(CollectMetrics, this);
+    WiFi.removeEvent(WifiEventId);
+
     if (HandlerTaskPointer != NULL) {
+        MetricsRegistry::GetInstance().RemoveTask(HandlerTaskPointer);
         LOG(INFO, LogName, "Task deleted");
         vTaskDelete(HandlerTaskPointer);
     }
+
+    if (EventQueue != NULL) {
+        vQueueDelete(EventQueue);
+    }
 }
 
 // Metodo per avviare la gestione WiFi
 void WifiHandler::Enable() {
     Enabled = true;
+    NotifyTask();
     LOG(INFO, LogName, "Enabled");
 }
 
 void WifiHandler::Disable() {
     Enabled = false;
+    NotifyTask();
     LOG(INFO, LogName, "Disabled");
 }
 
@@ -128,16 +279,85 @@ String WifiHandler::GetIPAddress() {
     return WiFi.localIP().toString();
 }
 
+unsigned long WifiHandler::GetLastConnectionTime() {
+    return LastConnectionTime;
+}
+
+uint32_t WifiHandler::GetConnectionAttemptCount() {
+    return ConnectionAttempts;
+}
+
+uint32_t WifiHandler::GetConnectionFailureCount() {
+    return ConnectionFailures;
+}
+
+uint32_t WifiHandler::GetRoamingCount() {
+    return RoamingCount;
+}
+
+uint32_t WifiHandler::GetRoamingFailureCount() {
+    return RoamingFailures;
+}
+
+uint32_t WifiHandler::GetRoamingScanCount() {
+    return RoamingScans;
+}
+
+uint32_t WifiHandler::GetDisconnectionCount() {
+    return DisconnectionCount;
+}
+
+uint8_t WifiHandler::GetLastDisconnectionReason() {
+    return LastDisconnectionReason;
+}
+
+uint16_t WifiHandler::GetDisconnectionReasonCount(uint8_t Reason) {
+    return DisconnectionReasonCounters[Reason];
+}
+
 void WifiHandler::SetHostname(const String& hostname) {
     WifiHostname = hostname;
     LOG(INFO, LogName, "Hostname is " + WifiHostname);
 }
 
 void WifiHandler::SetSSIDAndPassword(const String& ssid, const String& password) {
-    WifiSSID = ssid;
-    WifiPassword = password;
-    LOG(INFO, LogName, "SSID is " + WifiSSID);
-    LOG(INFO, LogName, "Password is " + WifiPassword);
+    Networks.clear();
+    AddNetwork(ssid, password);
+}
+
+// Networks are tried in the order they are added
+void WifiHandler::AddNetwork(const String& ssid, const String& password) {
+    Networks.push_back({ssid, password});
+    if (Networks.size() == 1) {
+        SelectNetwork(0);
+    }
+    LOG(INFO, LogName, "SSID is " + ssid + " (priority " + String(Networks.size()) + ")");
+    LOG(INFO, LogName, "Password is " + password);
+}
+
+void WifiHandler::SetRoaming(bool Enable, int RssiThreshold, int Hysteresis) {
+    RoamingEnabled = Enable;
+    RoamingRssiThreshold = RssiThreshold;
+    RoamingHysteresis = Hysteresis;
+    LOG(INFO, LogName, "Roaming " + String(Enable ? "enabled" : "disabled") + " - threshold " + String(RssiThreshold) + " dBm, hysteresis " + String(Hysteresis) + " dB");
+}
+
+void WifiHandler::SelectNetwork(size_t Index) {
+    if (Index < Networks.size()) {
+        SelectedNetwork = Index;
+        WifiSSID = Networks[Index].SSID;
+        WifiPassword = Networks[Index].Password;
+    }
+}
+
+void WifiHandler::SetFastReconnect(bool Enable) {
+    FastReconnectEnabled = Enable;
+    LOG(INFO, LogName, "Fast reconnect " + String(Enable ? "enabled" : "disabled"));
+}
+
+void WifiHandler::SetPostConnectionDelay(unsigned long Delay) {
+    PostConnectionDelay = Delay;
+    LOG(INFO, LogName, "Post connection delay set to " + String(Delay) + " ms");
 }
 
 void WifiHandler::SetEncryptionKey(const byte* Key) {
@@ -150,112 +370,405 @@ void WifiHandler::SetEncryptionIV(const byte* IV) {
     LOG(INFO, LogName, "Encryption IV updated");
 }
 
+// Runs in the WiFi event task: only translate the event and wake the handler task
+void WifiHandler::OnWifiEvent(arduino_event_id_t Event, arduino_event_info_t Info) {
+    WifiEventMessage Message;
+    switch (Event) {
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            Message.Type = GOT_IP_EVENT;
+            Message.Reason = 0;
+            break;
+
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+            Message.Type = DISCONNECTED_EVENT;
+            Message.Reason = Info.wifi_sta_disconnected.reason;
+            break;
+
+        case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+            Message.Type = DISCONNECTED_EVENT;
+            Message.Reason = 0;
+            break;
+
+        case ARDUINO_EVENT_WIFI_SCAN_DONE:
+            Message.Type = SCAN_DONE_EVENT;
+            Message.Reason = 0;
+            break;
+
+        default:
+            return;
+    }
+
+    if (xQueueSend(EventQueue, &Message, 0) != pdTRUE) {
+        EventsLost = true;
+    }
+}
+
+void WifiHandler::NotifyTask() {
+    WifiEventMessage Message = {COMMAND_EVENT, 0};
+    if (xQueueSend(EventQueue, &Message, 0) != pdTRUE) {
+        EventsLost = true;
+    }
+}
+
+void WifiHandler::ProcessEvent(const WifiEventMessage& Message) {
+    switch (Message.Type) {
+        case GOT_IP_EVENT:
+            LinkUp = true;
+            if (DhcpRenewalPending) {
+                DhcpRenewalPending = false;
+                LOG(INFO, LogName, "DHCP lease obtained, IP Address: " + GetIPAddress());
+                if (FastReconnectEnabled) {
+                    UpdateConnectionCache();
+                }
+            }
+            break;
+
+        case DISCONNECTED_EVENT:
+            LinkUp = false;
+            DisconnectionCount++;
+            DisconnectionsMetric->Increment();
+            LastDisconnectionReason = Message.Reason;
+            DisconnectionReasonCounters[Message.Reason]++;
+            break;
+
+        case SCAN_DONE_EVENT:
+            ScanDone = true;
+            break;
+
+        case COMMAND_EVENT:
+            break;
+    }
+}
+
+// The RTC copy spares the NVS read after a warm boot
+void WifiHandler::LoadConnectionCache() {
+    ConnectionCacheLoaded = true;
+    if (WarmBootStore::GetInstance().Load(WarmBootKey, &ConnectionCache, sizeof(ConnectionCache))) {
+        return;
+    }
+    if (CachePreferences.begin(CachePreferencesNamespace, true)) {
+        if (CachePreferences.getBytes(CachePreferencesKey, &ConnectionCache, sizeof(ConnectionCache)) != sizeof(ConnectionCache)) {
+            ConnectionCache.Valid = false;
+        }
+        CachePreferences.end();
+    }
+}
+
+// Store the current association; NVS is written only when something changed
+void WifiHandler::UpdateConnectionCache() {
+    ConnectionCacheStruct NewCache = {};
+    NewCache.Valid = true;
+    strncpy(NewCache.SSID, WifiSSID.c_str(), sizeof(NewCache.SSID) - 1);
+    memcpy(NewCache.BSSID, WiFi.BSSID(), sizeof(NewCache.BSSID));
+    NewCache.Channel = WiFi.channel();
+    NewCache.LocalIP = static_cast<uint32_t>(WiFi.localIP());
+    NewCache.Gateway = static_cast<uint32_t>(WiFi.gatewayIP());
+    NewCache.Subnet  = static_cast<uint32_t>(WiFi.subnetMask());
+    NewCache.Dns     = static_cast<uint32_t>(WiFi.dnsIP());
+
+    uint32_t LeaseTime = GetLeaseTime();
+    if (LeaseTime > 0) {
+        NewCache.LeaseExpiry = WarmBootStore::GetPersistentClock() + static_cast<int64_t>(LeaseTime) * SECONDS_TO_MICROSECONDS;
+    }
+    WarmBootStore::GetInstance().Save(WarmBootKey, &NewCache, sizeof(NewCache));
+
+    NewCache.LeaseExpiry = 0;
+    ConnectionCacheStruct StoredCache = ConnectionCache;
+    StoredCache.LeaseExpiry = 0;
+    if (memcmp(&NewCache, &StoredCache, sizeof(NewCache)) != 0) {
+        ConnectionCache = NewCache;
+        if (CachePreferences.begin(CachePreferencesNamespace, false)) {
+            CachePreferences.putBytes(CachePreferencesKey, &ConnectionCache, sizeof(ConnectionCache));
+            CachePreferences.end();
+            LOG(INFO, LogName, "Connection cache updated (channel " + String(ConnectionCache.Channel) + ")");
+        }
+    }
+}
+
+// Seconds left on the DHCP lease, 0 when the address is not leased
+uint32_t WifiHandler::GetLeaseTime() {
+    esp_netif_t* Interface = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (Interface == nullptr) {
+        return 0;
+    }
+    struct netif* LwipInterface = reinterpret_cast<struct netif*>(esp_netif_get_netif_impl(Interface));
+    struct dhcp* Dhcp = (LwipInterface != nullptr) ? netif_dhcp_data(LwipInterface) : nullptr;
+    if ((Dhcp == nullptr) || (Dhcp->t0_timeout <= Dhcp->lease_used)) {
+        return 0;
+    }
+    return static_cast<uint32_t>(Dhcp->t0_timeout - Dhcp->lease_used) * DHCP_COARSE_TIMER_SECS;
+}
+
+void WifiHandler::InvalidateConnectionCache() {
+    ConnectionCache.Valid = false;
+    WarmBootStore::GetInstance().Remove(WarmBootKey);
+    if (CachePreferences.begin(CachePreferencesNamespace, false)) {
+        CachePreferences.remove(CachePreferencesKey);
+        CachePreferences.end();
+    }
+}
+
+void WifiHandler::StartConnection() {
+    if (!ConnectionCacheLoaded) {
+        LoadConnectionCache();
+    }
+
+    WiFi.setHostname(WifiHostname.c_str());
+    WiFi.setSleep(WIFI_PS_NONE);
+    WiFi.useStaticBuffers(true);
+    WiFi.mode(WIFI_STA);
+    LinkUp = false;
+    ConnectionStartTime = esp_timer_get_time();
+    DhcpRenewalPending = false;
+
+    FastConnectionAttempt = FastReconnectEnabled && ConnectionCache.Valid && (WifiSSID == ConnectionCache.SSID);
+    CachedAddressUsed = FastConnectionAttempt && (ConnectionCache.LeaseExpiry > WarmBootStore::GetPersistentClock());
+    if (FastConnectionAttempt) {
+        // Directed connection: no scan, and no DHCP while the cached lease runs
+        if (CachedAddressUsed) {
+            WiFi.config(IPAddress(ConnectionCache.LocalIP), IPAddress(ConnectionCache.Gateway), IPAddress(ConnectionCache.Subnet), IPAddress(ConnectionCache.Dns));
+        } else {
+            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+        }
+        WiFi.begin(WifiSSID.c_str(), WifiPassword.c_str(), ConnectionCache.Channel, ConnectionCache.BSSID);
+        LOG(INFO, LogName, "Attempting fast connection to " + WifiSSID + " on channel " + String(ConnectionCache.Channel));
+        StateTimer.Start(FastConnectionMaxTime);
+    } else {
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+        WiFi.begin(WifiSSID.c_str(), WifiPassword.c_str());
+        LOG(INFO, LogName, "Attempting to connect to " + WifiSSID);
+        StateTimer.Start(ConnectionMaxTime);
+    }
+}
+
+// Pick the strongest access point of the current SSID from the last scan and associate to it
+bool WifiHandler::StartRoaming() {
+    int ScanResults = WiFi.scanComplete();
+    int CurrentRssi = WiFi.RSSI();
+    int BestRssi = CurrentRssi + RoamingHysteresis;
+    int BestIndex = -1;
+
+    for (int i = 0; i < ScanResults; i++) {
+        if ((WiFi.SSID(i) == WifiSSID) && (memcmp(WiFi.BSSID(i), WiFi.BSSID(), sizeof(RoamingTargetBSSID)) != 0) && (WiFi.RSSI(i) >= BestRssi)) {
+            BestRssi = WiFi.RSSI(i);
+            BestIndex = i;
+        }
+    }
+
+    if (BestIndex < 0) {
+        WiFi.scanDelete();
+        return false;
+    }
+
+    int32_t Channel = WiFi.channel(BestIndex);
+    memcpy(RoamingTargetBSSID, WiFi.BSSID(BestIndex), sizeof(RoamingTargetBSSID));
+    LOG(INFO, LogName, "Roaming from " + WiFi.BSSIDstr() + " (" + String(CurrentRssi) + " dBm) to " + WiFi.BSSIDstr(BestIndex) + " (" + String(BestRssi) + " dBm)");
+    WiFi.scanDelete();
+
+    RoamingStartTime = esp_timer_get_time();
+    LinkUp = false;
+    WiFi.disconnect();
+    WiFi.begin(WifiSSID.c_str(), WifiPassword.c_str(), Channel, RoamingTargetBSSID);
+    return true;
+}
+
 void WifiHandler::HandlerTask(void *pvParameters) {
     WifiHandler *_this = reinterpret_cast<WifiHandler*>(pvParameters);
-    static unsigned long Timer = ZERO_TIME;
-    static unsigned long ClockTime = _this->ClockTime;
     WifiStateEnum State = NOT_CONNECTED;
+    WifiStateEnum PreviousState;
+    WifiEventMessage Message;
+    TickType_t WaitTicks;
     bool Timeout;
 
-    TickType_t StartTick, ExecutionTick, TaskTickPeriod;
-    TaskTickPeriod = ClockTime / portTICK_PERIOD_MS;
-
     while (true) {
 
-        StartTick = xTaskGetTickCount();
+        // Sleep until a WiFi event, an Enable/Disable request or the state timer deadline
+        WaitTicks = portMAX_DELAY;
+        if (_this->StateTimer.IsRunning()) {
+            WaitTicks = pdMS_TO_TICKS(_this->StateTimer.GetRemainingTime()) + 1;
+        }
 
-        if ((Timer - ClockTime) < ClockTime) {
-            Timer = ZERO_TIME;
-        } else {
-            Timer = Timer - ClockTime;
+        if (xQueueReceive(_this->EventQueue, &Message, WaitTicks) == pdTRUE) {
+            do {
+                _this->ProcessEvent(Message);
+            } while (xQueueReceive(_this->EventQueue, &Message, 0) == pdTRUE);
         }
-        Timeout = (Timer == ZERO_TIME);
-
-        int WifiStatus = WiFi.status();
-        switch (State) {
-            case NOT_CONNECTED:
-                if (_this->Enabled) {
-                    WiFi.setHostname(_this->WifiHostname.c_str());
-                    WiFi.setSleep(WIFI_PS_NONE);
-                    WiFi.useStaticBuffers(true);
-                    WiFi.mode(WIFI_STA);
-                    WiFi.begin(_this->WifiSSID.c_str(), _this->WifiPassword.c_str());
-                    LOG(INFO, LogName, "Attempting to connect to " + _this->WifiSSID);
-                    Timer = _this->ConnectionMaxTime;
-                    State = CONNECTION_IN_PROGRESS;
-                }
-                break;
-
-            case CONNECTION_IN_PROGRESS:
-                if (Timeout) {
-                    LOG(WARNING, LogName, "Connection timeout");
-                    WiFi.disconnect();
-                    Timer = _this->DisconnectionMaxTime;
-                    State = DISCONNECTION_IN_PROGRESS;
-                } else if (WifiStatus == WL_CONNECTED) {
-                    LOG(INFO, LogName, "Successfully connected to " + _this->WifiSSID + " - Signal Strength: " + String(WiFi.RSSI()) + "% - IP Address: " + _this->GetIPAddress());
-                    Timer = _this->PostConnectionDelay;
-                    State = POST_CONNECTION_DELAY;
-                } else if (!_this->Enabled) {
-                    LOG(INFO, LogName, "Disconnection in progress");
-                    WiFi.disconnect();
-                    Timer = _this->DisconnectionMaxTime;
-                    State = DISCONNECTION_IN_PROGRESS;
-                }
-                break;
-
-            case POST_CONNECTION_DELAY:
-                if (!_this->Enabled) {
-                    LOG(INFO, LogName, "Disconnection in progress");
-                    WiFi.disconnect();
-                    Timer = _this->DisconnectionMaxTime;
-                    State = DISCONNECTION_IN_PROGRESS;
-                } if (WifiStatus != WL_CONNECTED) {
-                    LOG(WARNING, LogName, "Connection lost, WiFi status is " + String(WiFi.status()));
-                    WiFi.disconnect();
-                    Timer = _this->DisconnectionMaxTime;
-                    State = DISCONNECTION_IN_PROGRESS;
-                } else if (Timeout) {
-                    if (_this->OnConnectedCallback) {
-                        _this->OnConnectedCallback();
+
+        if (_this->EventsLost) {
+            LOG(WARNING, LogName, "Event queue overflow, resynchronizing link status");
+            _this->EventsLost = false;
+            _this->LinkUp = (WiFi.status() == WL_CONNECTED);
+        }
+
+        // Evaluate the state machine until it settles, so chained transitions do not wait for another event
+        do {
+            PreviousState = State;
+            Timeout = _this->StateTimer.IsExpired();
+
+            switch (State) {
+                case NOT_CONNECTED:
+                    if (_this->Enabled) {
+                        _this->ConnectionAttempts++;
+                        _this->ConnectionAttemptsMetric->Increment();
+                        _this->StartConnection();
+                        State = CONNECTION_IN_PROGRESS;
                     }
-                    State = CONNECTED;
-                }
-                break;
-
-            case CONNECTED:
-                if (!_this->Enabled) {
-                    LOG(INFO, LogName, "Disconnection in progress");
-                    WiFi.disconnect();
-                    Timer = _this->DisconnectionMaxTime;
-                    State = DISCONNECTION_IN_PROGRESS;
-                } if (WifiStatus != WL_CONNECTED) {
-                    LOG(WARNING, LogName, "Connection lost, WiFi status is " + String(WiFi.status()));
-                    if (_this->OnDisconnectedCallback) {
-                        _this->OnDisconnectedCallback();
+                    break;
+
+                case CONNECTION_IN_PROGRESS:
+                    if (Timeout) {
+                        if (_this->FastConnectionAttempt) {
+                            LOG(WARNING, LogName, "Fast connection failed, falling back to full scan");
+                            _this->InvalidateConnectionCache();
+                        } else {
+                            LOG(WARNING, LogName, "Connection timeout, last disconnection reason is " + String(_this->LastDisconnectionReason));
+                            _this->ConnectionFailures++;
+                            _this->ConnectionFailuresMetric->Increment();
+                            if (_this->Networks.size() > 1) {
+                                _this->SelectNetwork((_this->SelectedNetwork + 1) % _this->Networks.size());
+                            }
+                        }
+                        WiFi.disconnect();
+                        _this->StateTimer.Start(_this->DisconnectionMaxTime);
+                        State = DISCONNECTION_IN_PROGRESS;
+                    } else if (_this->LinkUp) {
+                        _this->LastConnectionTime = (esp_timer_get_time() - _this->ConnectionStartTime) / MILLISECONDS_TO_MICROSECONDS;
+                        LOG(INFO, LogName, "Successfully connected to " + _this->WifiSSID + " - Signal Strength: " + String(WiFi.RSSI()) + "% - IP Address: " + _this->GetIPAddress() + " - Connection time: " + String(_this->LastConnectionTime) + " ms" + (_this->FastConnectionAttempt ? " (fast)" : ""));
+                        if (_this->CachedAddressUsed) {
+                            // The cached address only bridges the association, the DHCP
+                            // client takes over to renew the lease with the server
+                            _this->DhcpRenewalPending = true;
+                            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+                        } else if (_this->FastReconnectEnabled) {
+                            _this->UpdateConnectionCache();
+                        }
+                        _this->StateTimer.Start(_this->PostConnectionDelay);
+                        State = POST_CONNECTION_DELAY;
+                    } else if (!_this->Enabled) {
+                        LOG(INFO, LogName, "Disconnection in progress");
+                        WiFi.disconnect();
+                        _this->StateTimer.Start(_this->DisconnectionMaxTime);
+                        State = DISCONNECTION_IN_PROGRESS;
                     }
-                    WiFi.disconnect();
-                    Timer = _this->DisconnectionMaxTime;
-                    State = DISCONNECTION_IN_PROGRESS;
-                }
-                break;
-
-            case DISCONNECTION_IN_PROGRESS:
-                if (Timeout) {
-                    LOG(WARNING, LogName, "Disconnection timeout");
-                    State = NOT_CONNECTED;
-                } else if (WifiStatus != WL_CONNECTED) {
-                    LOG(INFO, LogName, "Disconnected");
-                    State = NOT_CONNECTED;
-                }
-                break;
-        }
-        _this->WifiConnected = (State == CONNECTED);
+                    break;
+
+                case POST_CONNECTION_DELAY:
+                    if (!_this->Enabled) {
+                        LOG(INFO, LogName, "Disconnection in progress");
+                        WiFi.disconnect();
+                        _this->StateTimer.Start(_this->DisconnectionMaxTime);
+                        State = DISCONNECTION_IN_PROGRESS;
+                    } else if (!_this->LinkUp) {
+                        LOG(WARNING, LogName, "Connection lost, disconnection reason is " + String(_this->LastDisconnectionReason));
+                        WiFi.disconnect();
+                        _this->StateTimer.Start(_this->DisconnectionMaxTime);
+                        State = DISCONNECTION_IN_PROGRESS;
+                    } else if (Timeout) {
+                        LOG(INFO, LogName, "Connected, time to connected is " + String(static_cast<unsigned long>((esp_timer_get_time() - _this->ConnectionStartTime) / MILLISECONDS_TO_MICROSECONDS)) + " ms");
+                        if (_this->OnConnectedCallback) {
+                            _this->OnConnectedCallback();
+                        }
+                        if (_this->RoamingEnabled) {
+                            _this->StateTimer.Start(_this->RoamingCheckPeriod);
+                        } else {
+                            _this->StateTimer.Stop();
+                        }
+                        State = CONNECTED;
+                    }
+                    break;
+
+                case CONNECTED:
+                    if (!_this->Enabled) {
+                        LOG(INFO, LogName, "Disconnection in progress");
+                        WiFi.disconnect();
+                        _this->StateTimer.Start(_this->DisconnectionMaxTime);
+                        State = DISCONNECTION_IN_PROGRESS;
+                    } else if (!_this->LinkUp) {
+                        LOG(WARNING, LogName, "Connection lost, disconnection reason is " + String(_this->LastDisconnectionReason));
+                        if (_this->OnDisconnectedCallback) {
+                            _this->OnDisconnectedCallback();
+                        }
+                        WiFi.disconnect();
+                        _this->SelectNetwork(0);
+                        _this->StateTimer.Start(_this->DisconnectionMaxTime);
+                        State = DISCONNECTION_IN_PROGRESS;
+                    } else if (_this->RoamingEnabled && Timeout) {
+                        if (WiFi.RSSI() < _this->RoamingRssiThreshold) {
+                            _this->ScanDone = false;
+                            _this->RoamingScans++;
+                            WiFi.scanNetworks(true, false, false, 120, 0, _this->WifiSSID.c_str());
+                            _this->StateTimer.Start(_this->RoamingScanMaxTime);
+                            State = ROAMING_SCAN;
+                        } else {
+                            _this->StateTimer.Start(_this->RoamingCheckPeriod);
+                        }
+                    }
+                    break;
+
+                case ROAMING_SCAN:
+                    if (!_this->Enabled || !_this->LinkUp) {
+                        WiFi.scanDelete();
+                        _this->StateTimer.Start(_this->RoamingCheckPeriod);
+                        State = CONNECTED;
+                    } else if (_this->ScanDone) {
+                        if (_this->StartRoaming()) {
+                            _this->StateTimer.Start(_this->ConnectionMaxTime);
+                            State = ROAMING_IN_PROGRESS;
+                        } else {
+                            _this->StateTimer.Start(_this->RoamingCheckPeriod);
+                            State = CONNECTED;
+                        }
+                    } else if (Timeout) {
+                        LOG(WARNING, LogName, "Roaming scan timeout");
+                        WiFi.scanDelete();
+                        _this->StateTimer.Start(_this->RoamingCheckPeriod);
+                        State = CONNECTED;
+                    }
+                    break;
+
+                case ROAMING_IN_PROGRESS:
+                    if (!_this->Enabled) {
+                        LOG(INFO, LogName, "Disconnection in progress");
+                        if (_this->OnDisconnectedCallback) {
+                            _this->OnDisconnectedCallback();
+                        }
+                        WiFi.disconnect();
+                        _this->StateTimer.Start(_this->DisconnectionMaxTime);
+                        State = DISCONNECTION_IN_PROGRESS;
+                    } else if (_this->LinkUp) {
+                        _this->RoamingCount++;
+                        _this->RoamingMetric->Increment();
+                        LOG(INFO, LogName, "Roamed to " + WiFi.BSSIDstr() + " - Signal Strength: " + String(WiFi.RSSI()) + " dBm - Downtime: " + String(static_cast<unsigned long>((esp_timer_get_time() - _this->RoamingStartTime) / MILLISECONDS_TO_MICROSECONDS)) + " ms");
+                        if (_this->FastReconnectEnabled) {
+                            _this->UpdateConnectionCache();
+                        }
+                        _this->StateTimer.Start(_this->RoamingCheckPeriod);
+                        State = CONNECTED;
+                    } else if (Timeout) {
+                        LOG(WARNING, LogName, "Roaming failed, disconnection reason is " + String(_this->LastDisconnectionReason));
+                        _this->RoamingFailures++;
+                        if (_this->OnDisconnectedCallback) {
+                            _this->OnDisconnectedCallback();
+                        }
+                        WiFi.disconnect();
+                        _this->StateTimer.Start(_this->DisconnectionMaxTime);
+                        State = DISCONNECTION_IN_PROGRESS;
+                    }
+                    break;
+
+                case DISCONNECTION_IN_PROGRESS:
+                    if (Timeout) {
+                        LOG(WARNING, LogName, "Disconnection timeout");
+                        State = NOT_CONNECTED;
+                    } else if (!_this->LinkUp) {
+                        LOG(INFO, LogName, "Disconnected");
+                        State = NOT_CONNECTED;
+                    }
+                    break;
+            }
+        } while (State != PreviousState);
 
-        ExecutionTick = xTaskGetTickCount() - StartTick;
-        if (ExecutionTick < TaskTickPeriod) {
-          vTaskDelay(TaskTickPeriod - ExecutionTick);
-        }
+        _this->WifiConnected = (State == CONNECTED) || (State == ROAMING_SCAN);
     }
 }
 
@@ -0,0 +1,18 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <CommandOtaHandler.h>
+
+TEST(CommandOtaHandlerTest, UploadRaisesAndRestoresUpdateMode) {
+    CommandOtaHandler* Ota = new CommandOtaHandler();
+    Ota->Start();
+
+    ArduinoOTA.Start();
+    EXPECT_TRUE(Ota->IsUploadInProgress());
+    EXPECT_TRUE(Host::Logged("Update mode entered"));
+
+    ArduinoOTA.Progress(50, 100);
+    ArduinoOTA.End();
+    EXPECT_FALSE(Ota->IsUploadInProgress());
+    EXPECT_TRUE(Host::Logged("Update mode left"));
+    delete Ota;
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <ConfigStore.h>
+
+class ConfigStoreTest : public ::testing::Test {
+    protected:
+        ConfigStore& Store = ConfigStore::GetInstance();
+
+        void SetUp() override {
+            Host::ResetFileSystem();
+            ASSERT_TRUE(LittleFSHandler::GetInstance().Init());
+            ASSERT_TRUE(Store.Begin("/config.kv"));
+        }
+
+        static String Key(int Number) {
+            return "key" + String(Number);
+        }
+
+        static size_t RecordSize(const char* Key, size_t ValueLength) {
+            return 8 + strlen(Key) + ValueLength;
+        }
+};
+
+TEST_F(ConfigStoreTest, ValuesAreReplayedAfterBegin) {
+    ASSERT_TRUE(Store.SetInt("int", -42));
+    ASSERT_TRUE(Store.SetUInt("uint", 42));
+    ASSERT_TRUE(Store.SetFloat("float", 1.5f));
+    ASSERT_TRUE(Store.SetBool("bool", true));
+    ASSERT_TRUE(Store.SetString("name", "sensor"));
+    ASSERT_TRUE(Store.SetInt("int", 7));
+
+    ASSERT_TRUE(Store.Begin("/config.kv"));
+
+    EXPECT_EQ(Store.GetKeyCount(), 5u);
+    EXPECT_EQ(Store.GetIntOr("int", 0), 7);
+    EXPECT_EQ(Store.GetUIntOr("uint", 0), 42u);
+    EXPECT_EQ(Store.GetFloatOr("float", 0), 1.5f);
+    EXPECT_TRUE(Store.GetBoolOr("bool", false));
+    char Name[16];
+    ASSERT_TRUE(Store.GetString("name", Name, sizeof(Name)));
+    EXPECT_STREQ(Name, "sensor");
+}
+
+TEST_F(ConfigStoreTest, TornTailIsDiscarded) {
+    ASSERT_TRUE(Store.SetInt("first", 1));
+    ASSERT_TRUE(Store.SetInt("second", 2));
+    size_t ValidSize = RecordSize("first", 4);
+    ASSERT_EQ(Host::Files["/config.kv"].size(), ValidSize + RecordSize("second", 4));
+
+    // Power lost in the middle of the second record
+    Host::Files["/config.kv"].resize(ValidSize + 5);
+    ASSERT_TRUE(Store.Begin("/config.kv"));
+
+    EXPECT_EQ(Store.GetIntOr("first", 0), 1);
+    EXPECT_FALSE(Store.Contains("second"));
+    EXPECT_EQ(Store.GetLogSize(), ValidSize);
+    EXPECT_EQ(Host::Files["/config.kv"].size(), ValidSize);
+
+    // New records follow the valid ones
+    ASSERT_TRUE(Store.SetInt("second", 3));
+    ASSERT_TRUE(Store.Begin("/config.kv"));
+    EXPECT_EQ(Store.GetIntOr("second", 0), 3);
+}
+
+TEST_F(ConfigStoreTest, CorruptedRecordStopsReplay) {
+    ASSERT_TRUE(Store.SetInt("first", 1));
+    ASSERT_TRUE(Store.SetInt("second", 2));
+    ASSERT_TRUE(Store.SetInt("third", 3));
+
+    Host::Files["/config.kv"][RecordSize("first", 4) + 8] ^= 0xFF;
+    ASSERT_TRUE(Store.Begin("/config.kv"));
+
+    EXPECT_EQ(Store.GetKeyCount(), 1u);
+    EXPECT_EQ(Store.GetIntOr("first", 0), 1);
+    EXPECT_FALSE(Store.Contains("third"));
+}
+
+TEST_F(ConfigStoreTest, CompactionKeepsOnlyLiveRecords) {
+    ASSERT_TRUE(Store.SetInt("counter", 0));
+    ASSERT_TRUE(Store.SetString("removed", "value"));
+    ASSERT_TRUE(Store.Remove("removed"));
+    for (int i = 1; i <= 400; i++) {
+        ASSERT_TRUE(Store.SetInt("counter", i));
+    }
+
+    EXPECT_GT(Store.GetCompactionCount(), 0u);
+    EXPECT_LE(Store.GetLogSize(), size_t(CONFIG_STORE_COMPACTION_THRESHOLD));
+
+    ASSERT_TRUE(Store.Compact());
+    EXPECT_EQ(Store.GetLogSize(), RecordSize("counter", 4));
+
+    ASSERT_TRUE(Store.Begin("/config.kv"));
+    EXPECT_EQ(Store.GetKeyCount(), 1u);
+    EXPECT_EQ(Store.GetIntOr("counter", 0), 400);
+    EXPECT_FALSE(Store.Contains("removed"));
+}
+
+TEST_F(ConfigStoreTest, RemovedKeyCanBeAddedAgain) {
+    ASSERT_TRUE(Store.SetString("name", "first"));
+    ASSERT_TRUE(Store.Remove("name"));
+    EXPECT_FALSE(Store.Contains("name"));
+    EXPECT_EQ(Store.GetKeyCount(), 0u);
+
+    ASSERT_TRUE(Store.SetString("name", "second value"));
+    ASSERT_TRUE(Store.Compact());
+    ASSERT_TRUE(Store.Remove("name"));
+    ASSERT_TRUE(Store.SetString("name", "third"));
+
+    ASSERT_TRUE(Store.Begin("/config.kv"));
+    char Name[16];
+    ASSERT_TRUE(Store.GetString("name", Name, sizeof(Name)));
+    EXPECT_STREQ(Name, "third");
+    EXPECT_EQ(Store.GetKeyCount(), 1u);
+}
+
+TEST_F(ConfigStoreTest, RemovedKeysFreeTheirSlots) {
+    for (int i = 0; i < CONFIG_STORE_MAX_KEYS; i++) {
+        ASSERT_TRUE(Store.SetInt(Key(i).c_str(), i));
+    }
+    EXPECT_FALSE(Store.SetInt("extra", 0));
+
+    for (int i = 0; i < CONFIG_STORE_MAX_KEYS; i += 2) {
+        ASSERT_TRUE(Store.Remove(Key(i).c_str()));
+    }
+    ASSERT_TRUE(Store.Compact());
+    for (int i = 0; i < CONFIG_STORE_MAX_KEYS / 2; i++) {
+        ASSERT_TRUE(Store.SetInt(("new" + String(i)).c_str(), i));
+    }
+    EXPECT_EQ(Store.GetKeyCount(), uint32_t(CONFIG_STORE_MAX_KEYS));
+
+    // Without a compaction a new key takes the slot of a removed one
+    ASSERT_TRUE(Store.Remove(Key(1).c_str()));
+    ASSERT_TRUE(Store.SetInt("late", 1));
+
+    ASSERT_TRUE(Store.Begin("/config.kv"));
+    EXPECT_EQ(Store.GetKeyCount(), uint32_t(CONFIG_STORE_MAX_KEYS));
+    EXPECT_EQ(Store.GetIntOr(Key(3).c_str(), -1), 3);
+    EXPECT_EQ(Store.GetIntOr("new31", -1), 31);
+    EXPECT_EQ(Store.GetIntOr("late", -1), 1);
+    EXPECT_FALSE(Store.Contains(Key(0).c_str()));
+    EXPECT_FALSE(Store.Contains(Key(1).c_str()));
+}
+
+TEST_F(ConfigStoreTest, RemovedValuesFreeTheirArenaBytes) {
+    std::string Value(CONFIG_STORE_MAX_VALUE_LENGTH, 'x');
+    int Stored = 0;
+    while (Store.SetString(Key(Stored).c_str(), Value.c_str())) {
+        Stored++;
+    }
+    ASSERT_GT(Stored, 0);
+    ASSERT_LT(Stored, CONFIG_STORE_MAX_KEYS);
+
+    for (int i = 0; i < Stored; i++) {
+        ASSERT_TRUE(Store.Remove(Key(i).c_str()));
+    }
+    for (int i = 0; i < Stored; i++) {
+        ASSERT_TRUE(Store.SetString(("new" + String(i)).c_str(), Value.c_str()));
+    }
+    EXPECT_EQ(Store.GetKeyCount(), uint32_t(Stored));
+}
@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <DeltaPatcher.h>
+#include <mbedtls/sha256.h>
+#include <chrono>
+#include <random>
+
+// Patches are built here from explicit control triples, and the expected
+// target is computed from the same triples, the way make_delta.py lays them out
+class DeltaPatcherTest : public ::testing::Test {
+    protected:
+        struct Triple {
+            int32_t Diff;
+            int32_t Extra;
+            int32_t Seek;
+        };
+
+        std::vector<uint8_t> Source;
+        std::vector<uint8_t> Target;
+        esp_partition_t Partition = {};
+        DeltaPatcher Patcher;
+        bool RefuseWrites = false;
+
+        void SetUp() override {
+            // Firmware-like: repeated structures with some noise
+            std::mt19937 Random(1);
+            Source.resize(256 * 1024);
+            for (size_t i = 0; i < Source.size(); i++) {
+                Source[i] = ((i % 64) < 48) ? static_cast<uint8_t>(i / 64) : static_cast<uint8_t>(Random());
+            }
+            Partition.size = 1024 * 1024;
+            Partition.HostContent = nullptr;
+        }
+
+        // The partition is larger than the image it holds
+        void MapSource() {
+            static std::vector<uint8_t> Flash;
+            Flash = Source;
+            Flash.resize(Partition.size, 0xFF);
+            Partition.HostContent = Flash.data();
+        }
+
+        static void Put32(std::vector<uint8_t>& Data, int32_t Value) {
+            for (int i = 0; i < 4; i++) {
+                Data.push_back(static_cast<uint32_t>(Value) >> (8 * i));
+            }
+        }
+
+        // Diff bytes are mostly zero, as for recompiled code that moved a little
+        std::vector<uint8_t> Stream(const std::vector<Triple>& Triples, uint32_t& TargetSize) {
+            std::mt19937 Random(2);
+            std::vector<uint8_t> Raw;
+            Target.clear();
+            int64_t Position = 0;
+            for (const Triple& Entry : Triples) {
+                Put32(Raw, Entry.Diff);
+                Put32(Raw, Entry.Extra);
+                Put32(Raw, Entry.Seek);
+                for (int32_t i = 0; i < Entry.Diff; i++) {
+                    uint8_t Delta = ((Random() % 97) == 0) ? static_cast<uint8_t>(Random()) : 0;
+                    Raw.push_back(Delta);
+                    uint8_t SourceByte = ((Position + i) < static_cast<int64_t>(Source.size())) ? Source[Position + i] : 0;
+                    Target.push_back(SourceByte + Delta);
+                }
+                for (int32_t i = 0; i < Entry.Extra; i++) {
+                    uint8_t Byte = static_cast<uint8_t>(Random() % 16);
+                    Raw.push_back(Byte);
+                    Target.push_back(Byte);
+                }
+                Position += static_cast<int64_t>(Entry.Diff) + Entry.Seek;
+            }
+            TargetSize = Target.size();
+            return Raw;
+        }
+
+        std::vector<uint8_t> Patch(const std::vector<uint8_t>& Raw, uint32_t TargetSize, uint32_t SourceSize = 0) {
+            DeltaPatchHeader Header = {};
+            Header.Magic = DELTA_PATCH_MAGIC;
+            Header.Version = DELTA_PATCH_VERSION;
+            Header.SourceSize = SourceSize ? SourceSize : Source.size();
+            Header.TargetSize = TargetSize;
+            mbedtls_sha256_context Context;
+            mbedtls_sha256_init(&Context);
+            mbedtls_sha256_starts(&Context, 0);
+            mbedtls_sha256_update(&Context, Source.data(), Header.SourceSize);
+            mbedtls_sha256_finish(&Context, Header.SourceSha256);
+            mbedtls_sha256_free(&Context);
+
+            uLongf Length = compressBound(Raw.size());
+            std::vector<uint8_t> Result(sizeof(Header) + Length);
+            memcpy(Result.data(), &Header, sizeof(Header));
+            compress2(Result.data() + sizeof(Header), &Length, Raw.data(), Raw.size(), 9);
+            Result.resize(sizeof(Header) + Length);
+            return Result;
+        }
+
+        std::vector<uint8_t> Patch(const std::vector<Triple>& Triples) {
+            uint32_t TargetSize;
+            std::vector<uint8_t> Raw = Stream(Triples, TargetSize);
+            return Patch(Raw, TargetSize);
+        }
+
+        // A firmware update: code moved, a block inserted, a table dropped
+        std::vector<Triple> Update() {
+            return {
+                {40000, 300, 0},
+                {70000, 0, 1200},
+                {50000, 5000, -30000},
+                {60000, 17, 0},
+                {Static(Source.size()) - 191200, 2000, 0},
+            };
+        }
+
+        static int32_t Static(size_t Value) {
+            return static_cast<int32_t>(Value);
+        }
+
+        std::vector<uint8_t> Output;
+
+        static bool Write(void* Context, const uint8_t* Data, size_t Length) {
+            DeltaPatcherTest* Test = reinterpret_cast<DeltaPatcherTest*>(Context);
+            Test->Output.insert(Test->Output.end(), Data, Data + Length);
+            return !Test->RefuseWrites;
+        }
+
+        // Feeds the patch in pieces cycling through the given sizes
+        bool Apply(const std::vector<uint8_t>& Data, std::vector<size_t> Pieces) {
+            Output.clear();
+            MapSource();
+            EXPECT_TRUE(Patcher.Begin(&Partition, Write, this));
+            size_t Offset = 0;
+            for (size_t i = 0; Offset < Data.size(); i++) {
+                size_t Length = std::min(Pieces[i % Pieces.size()], Data.size() - Offset);
+                if (!Patcher.Feed(Data.data() + Offset, Length)) {
+                    return false;
+                }
+                Offset += Length;
+            }
+            return Patcher.Finish();
+        }
+};
+
+TEST_F(DeltaPatcherTest, RebuildsTheTargetFromOddSizedPieces) {
+    std::vector<uint8_t> Data = Patch(Update());
+    ASSERT_GT(Target.size(), 4u * TINFL_LZ_DICT_SIZE);   // the window wraps
+
+    for (std::vector<size_t> Pieces : std::vector<std::vector<size_t>>{{1}, {7, 13}, {333}, {1460}, {4097, 3}, {Data.size()}}) {
+        auto Start = std::chrono::steady_clock::now();
+        ASSERT_TRUE(Apply(Data, Pieces)) << Patcher.GetError();
+        double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+        EXPECT_EQ(Output, Target) << "pieces of " << Pieces[0] << " bytes";
+        EXPECT_EQ(Patcher.GetTargetWritten(), Target.size());
+        printf("[ patch    ] %zu byte pieces: %zu byte patch for a %zu byte image (%.1f%%), %.1f MB/s\n",
+               Pieces[0], Data.size(), Target.size(), 100.0 * Data.size() / Target.size(), Target.size() / Seconds / 1e6);
+    }
+}
+
+TEST_F(DeltaPatcherTest, HeaderIsParsedAcrossPieces) {
+    std::vector<uint8_t> Data = Patch(Update());
+    MapSource();
+    ASSERT_TRUE(Patcher.Begin(&Partition, Write, this));
+
+    ASSERT_TRUE(Patcher.Feed(Data.data(), sizeof(DeltaPatchHeader) - 1));
+    EXPECT_FALSE(Patcher.IsHeaderParsed());
+    EXPECT_EQ(Patcher.GetTargetSize(), 0u);
+    ASSERT_TRUE(Patcher.Feed(Data.data() + sizeof(DeltaPatchHeader) - 1, 1));
+    EXPECT_TRUE(Patcher.IsHeaderParsed());
+    EXPECT_EQ(Patcher.GetTargetSize(), Target.size());
+}
+
+TEST_F(DeltaPatcherTest, PatchForAnotherFirmwareIsRejected) {
+    std::vector<uint8_t> Data = Patch(Update());
+    Source[1000] ^= 1;
+    EXPECT_FALSE(Apply(Data, {512}));
+    EXPECT_STREQ(Patcher.GetError(), "Patch does not match the running firmware");
+    EXPECT_TRUE(Output.empty());
+}
+
+TEST_F(DeltaPatcherTest, WrongMagicIsRejected) {
+    std::vector<uint8_t> Data = Patch(Update());
+    Data[0] ^= 1;
+    EXPECT_FALSE(Apply(Data, {512}));
+    EXPECT_STREQ(Patcher.GetError(), "Not a delta patch");
+}
+
+TEST_F(DeltaPatcherTest, SourceLargerThanThePartitionIsRejected) {
+    uint32_t TargetSize;
+    std::vector<uint8_t> Raw = Stream({{10, 0, 0}}, TargetSize);
+    Source.resize(Partition.size + 1);
+    EXPECT_FALSE(Apply(Patch(Raw, TargetSize), {512}));
+    EXPECT_STREQ(Patcher.GetError(), "Source size exceeds the running partition");
+}
+
+TEST_F(DeltaPatcherTest, DiffPastTheSourceIsRejected) {
+    EXPECT_FALSE(Apply(Patch({{100, 0, Static(Source.size()) - 150}, {100, 0, 0}}), {333}));
+    EXPECT_STREQ(Patcher.GetError(), "Control entry out of bounds");
+}
+
+TEST_F(DeltaPatcherTest, NegativeLengthIsRejected) {
+    uint32_t TargetSize;
+    std::vector<uint8_t> Raw = Stream({{100, 0, 0}}, TargetSize);
+    Raw.resize(Raw.size() + 12);
+    int32_t Entry[3] = {10, -1, 0};
+    memcpy(Raw.data() + Raw.size() - 12, Entry, sizeof(Entry));
+    EXPECT_FALSE(Apply(Patch(Raw, TargetSize + 10), {333}));
+    EXPECT_STREQ(Patcher.GetError(), "Control entry out of bounds");
+}
+
+TEST_F(DeltaPatcherTest, OutputPastTheTargetSizeIsRejected) {
+    uint32_t TargetSize;
+    std::vector<uint8_t> Raw = Stream({{100, 50, 0}}, TargetSize);
+    EXPECT_FALSE(Apply(Patch(Raw, TargetSize - 1), {333}));
+    EXPECT_STREQ(Patcher.GetError(), "Control entry out of bounds");
+}
+
+TEST_F(DeltaPatcherTest, SeekMovesTheSourceCursorWithinBounds) {
+    // Back to the start, then forward to the very end of the source
+    int32_t End = Static(Source.size());
+    ASSERT_TRUE(Apply(Patch({{1000, 10, -1000}, {1000, 0, End - 1000}, {0, 20, -End}, {500, 0, 0}}), {97})) << Patcher.GetError();
+    EXPECT_EQ(Output, Target);
+}
+
+TEST_F(DeltaPatcherTest, SeekBeforeTheSourceIsRejected) {
+    EXPECT_FALSE(Apply(Patch({{1000, 0, -1001}, {10, 0, 0}}), {97}));
+    EXPECT_STREQ(Patcher.GetError(), "Source seek out of bounds");
+}
+
+TEST_F(DeltaPatcherTest, SeekPastTheSourceIsRejected) {
+    EXPECT_FALSE(Apply(Patch({{1000, 0, Static(Source.size()) - 999}, {0, 10, 0}}), {97}));
+    EXPECT_STREQ(Patcher.GetError(), "Source seek out of bounds");
+}
+
+TEST_F(DeltaPatcherTest, TruncatedStreamFailsOnFinish) {
+    std::vector<uint8_t> Data = Patch(Update());
+    Data.resize(Data.size() - 10);
+    EXPECT_FALSE(Apply(Data, {1460}));
+    EXPECT_STREQ(Patcher.GetError(), "Truncated patch");
+}
+
+TEST_F(DeltaPatcherTest, ShortTargetFailsOnFinish) {
+    uint32_t TargetSize;
+    std::vector<uint8_t> Raw = Stream({{100, 50, 0}}, TargetSize);
+    EXPECT_FALSE(Apply(Patch(Raw, TargetSize + 1), {333}));
+    EXPECT_STREQ(Patcher.GetError(), "Truncated patch");
+}
+
+TEST_F(DeltaPatcherTest, PartialControlEntryFailsOnFinish) {
+    uint32_t TargetSize;
+    std::vector<uint8_t> Raw = Stream({{100, 50, 0}}, TargetSize);
+    Raw.resize(Raw.size() + 6);
+    EXPECT_FALSE(Apply(Patch(Raw, TargetSize), {333}));
+    EXPECT_STREQ(Patcher.GetError(), "Truncated patch");
+}
+
+TEST_F(DeltaPatcherTest, UnfinishedBlockFailsOnFinish) {
+    uint32_t TargetSize;
+    std::vector<uint8_t> Raw = Stream({{100, 50, 0}}, TargetSize);
+    Raw.resize(Raw.size() - 20);
+    EXPECT_FALSE(Apply(Patch(Raw, TargetSize), {333}));
+    EXPECT_STREQ(Patcher.GetError(), "Truncated patch");
+}
+
+TEST_F(DeltaPatcherTest, DataAfterTheStreamIsRejected) {
+    std::vector<uint8_t> Data = Patch(Update());
+    Data.push_back(0);
+    EXPECT_FALSE(Apply(Data, {1460}));
+    EXPECT_STREQ(Patcher.GetError(), "Data after the end of the patch");
+}
+
+TEST_F(DeltaPatcherTest, CorruptedStreamIsRejected) {
+    std::vector<uint8_t> Data = Patch(Update());
+    Data[sizeof(DeltaPatchHeader) + 1] ^= 0xFF;   // zlib header check bits
+    EXPECT_FALSE(Apply(Data, {1460}));
+    EXPECT_STREQ(Patcher.GetError(), "Corrupted patch stream");
+}
+
+TEST_F(DeltaPatcherTest, RefusedWriteAbortsThePatch) {
+    RefuseWrites = true;
+    EXPECT_FALSE(Apply(Patch(Update()), {1460}));
+    EXPECT_STREQ(Patcher.GetError(), "Target write failed");
+    EXPECT_EQ(Output.size(), static_cast<size_t>(DELTA_OUTPUT_BUFFER_SIZE));
+}
+
+TEST_F(DeltaPatcherTest, FailedPatcherIgnoresFurtherData) {
+    std::vector<uint8_t> Data = Patch(Update());
+    Data[0] ^= 1;
+    MapSource();
+    ASSERT_TRUE(Patcher.Begin(&Partition, Write, this));
+    EXPECT_FALSE(Patcher.Feed(Data.data(), Data.size()));
+    EXPECT_FALSE(Patcher.Feed(Data.data(), 1));
+    EXPECT_FALSE(Patcher.Finish());
+    EXPECT_STREQ(Patcher.GetError(), "Not a delta patch");
+}
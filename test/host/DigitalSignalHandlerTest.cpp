@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <DigitalSignalHandler.h>
+
+// Times are microseconds, filter times are set in milliseconds
+class DigitalSignalHandlerTest : public ::testing::Test {
+    protected:
+        static constexpr uint8_t Pin = 4;
+
+        struct Edge {
+            bool Rising;
+            uint64_t Timestamp;
+        };
+
+        DigitalSignalHandler Signal;
+        std::vector<Edge> Edges;
+
+        void SetUp() override {
+            Host::SetPinLevel(Pin, LOW);
+            Signal.SetName("input");
+            Signal.OnRisingEdge(Record, this);
+            Signal.OnFallingEdge(Record, this);
+            Signal.Enable();
+        }
+
+        static void Record(void* Context, DigitalSignalHandler* Signal, uint64_t Timestamp) {
+            DigitalSignalHandlerTest* Test = reinterpret_cast<DigitalSignalHandlerTest*>(Context);
+            Test->Edges.push_back({Signal->GetFilteredSignal(), Timestamp});
+        }
+
+        // Startup reports the first sampled level as an edge at that time
+        void Start(bool Level, uint64_t Timestamp = 0) {
+            Signal.Update(Level, Timestamp);
+            ASSERT_EQ(Edges.size(), 1u);
+            Edges.clear();
+        }
+
+        static int64_t Now() {
+            return esp_timer_get_time();
+        }
+};
+
+TEST_F(DigitalSignalHandlerTest, StartupReportsSampledLevel) {
+    Signal.Update(true, 500);
+
+    ASSERT_EQ(Edges.size(), 1u);
+    EXPECT_TRUE(Edges[0].Rising);
+    EXPECT_EQ(Edges[0].Timestamp, 500u);
+    EXPECT_TRUE(Signal.GetFilteredSignal());
+}
+
+TEST_F(DigitalSignalHandlerTest, GlitchShorterThanFilterIsRejected) {
+    Signal.SetRisingEdgeFilterTime(10);
+    Start(false);
+
+    Signal.Update(true, 1000);
+    Signal.Update(true, 9000);
+    Signal.Update(false, 10500);
+    Signal.Update(false, 40000);
+
+    EXPECT_TRUE(Edges.empty());
+    EXPECT_FALSE(Signal.GetFilteredSignal());
+    EXPECT_EQ(Signal.GetRawEdgeCount(), 2u);
+}
+
+TEST_F(DigitalSignalHandlerTest, EdgeIsTimestampedAtFilterDeadline) {
+    Signal.SetRisingEdgeFilterTime(10);
+    Start(false);
+
+    // The level changed somewhere after the last low sample at 900 us
+    Signal.Update(false, 900);
+    Signal.Update(true, 1000);
+    Signal.Update(true, 50000);
+
+    ASSERT_EQ(Edges.size(), 1u);
+    EXPECT_TRUE(Edges[0].Rising);
+    EXPECT_EQ(Edges[0].Timestamp, 900u + 10000u);
+}
+
+TEST_F(DigitalSignalHandlerTest, RisingAndFallingFiltersAreSeparate) {
+    Signal.SetRisingEdgeFilterTime(0);
+    Signal.SetFallingEdgeFilterTime(20);
+    Start(false);
+
+    Signal.Update(false, 1000);
+    Signal.Update(true, 1000);
+    ASSERT_EQ(Edges.size(), 1u);
+    EXPECT_EQ(Edges[0].Timestamp, 1000u);
+
+    Signal.Update(false, 2000);
+    Signal.Update(false, 15000);
+    EXPECT_EQ(Edges.size(), 1u);
+
+    Signal.Update(false, 21000);
+    ASSERT_EQ(Edges.size(), 2u);
+    EXPECT_FALSE(Edges[1].Rising);
+    EXPECT_EQ(Edges[1].Timestamp, 1000u + 20000u);
+    EXPECT_EQ(Signal.GetFilteredEdgeCount(), 3u);
+}
+
+TEST_F(DigitalSignalHandlerTest, DisabledSignalIgnoresSamples) {
+    Signal.Disable();
+    Signal.Update(true, 1000);
+
+    EXPECT_TRUE(Edges.empty());
+    EXPECT_FALSE(Signal.GetSignal());
+}
+
+TEST_F(DigitalSignalHandlerTest, InterruptEdgesKeepTheirTimestamps) {
+    Signal.SetRisingEdgeFilterTime(10);
+    ASSERT_TRUE(Signal.AttachInterrupt(Pin));
+    Signal.Process();
+    ASSERT_EQ(Edges.size(), 1u);
+    Edges.clear();
+
+    Host::RunFor(1000);
+    int64_t RisingTime = Now();
+    Host::SetPinLevel(Pin, HIGH);
+
+    // Processed long after the edge, the filtered edge is still on time
+    Host::RunFor(100000);
+    Signal.Process();
+
+    ASSERT_EQ(Edges.size(), 1u);
+    EXPECT_TRUE(Edges[0].Rising);
+    EXPECT_EQ(Edges[0].Timestamp, static_cast<uint64_t>(RisingTime + 10000));
+}
+
+TEST_F(DigitalSignalHandlerTest, InterruptGlitchIsRejected) {
+    Signal.SetRisingEdgeFilterTime(10);
+    ASSERT_TRUE(Signal.AttachInterrupt(Pin));
+    Signal.Process();
+    Edges.clear();
+
+    Host::RunFor(1000);
+    Host::SetPinLevel(Pin, HIGH);
+    Host::RunFor(2000);
+    Host::SetPinLevel(Pin, LOW);
+    Host::RunFor(50000);
+    Signal.Process();
+
+    EXPECT_TRUE(Edges.empty());
+    EXPECT_EQ(Signal.GetRawEdgeCount(), 2u);
+    EXPECT_EQ(Signal.GetDroppedEdgeCount(), 0u);
+}
+
+TEST_F(DigitalSignalHandlerTest, ProcessLetsFilterTimeElapseWithoutEdges) {
+    Signal.SetRisingEdgeFilterTime(10);
+    ASSERT_TRUE(Signal.AttachInterrupt(Pin));
+    Signal.Process();
+    Edges.clear();
+
+    Host::SetPinLevel(Pin, HIGH);
+    Host::RunFor(5000);
+    Signal.Process();
+    EXPECT_TRUE(Edges.empty());
+
+    Host::RunFor(5000);
+    Signal.Process();
+    EXPECT_EQ(Edges.size(), 1u);
+    EXPECT_TRUE(Signal.GetFilteredSignal());
+}
+
+TEST_F(DigitalSignalHandlerTest, EdgeQueueOverflowIsCounted) {
+    ASSERT_TRUE(Signal.AttachInterrupt(Pin));
+    Signal.Process();
+
+    for (int i = 0; i < DIGITAL_SIGNAL_EDGE_QUEUE_SIZE + 8; i++) {
+        Host::RunFor(100);
+        Host::SetPinLevel(Pin, (i % 2 == 0) ? HIGH : LOW);
+    }
+    EXPECT_EQ(Signal.GetDroppedEdgeCount(), 8u);
+
+    Signal.Process();
+    EXPECT_EQ(Signal.GetRawEdgeCount(), static_cast<uint32_t>(DIGITAL_SIGNAL_EDGE_QUEUE_SIZE));
+}
+
+TEST_F(DigitalSignalHandlerTest, OverflowResyncsToThePinLevel) {
+    Signal.SetRisingEdgeFilterTime(10);
+    ASSERT_TRUE(Signal.AttachInterrupt(Pin));
+    Signal.Process();
+    Edges.clear();
+
+    // The queued edges end low, the dropped ones leave the input high
+    for (int i = 0; i < DIGITAL_SIGNAL_EDGE_QUEUE_SIZE + 9; i++) {
+        Host::RunFor(100);
+        Host::SetPinLevel(Pin, (i % 2 == 0) ? HIGH : LOW);
+    }
+    ASSERT_EQ(Signal.GetDroppedEdgeCount(), 9u);
+
+    Host::RunFor(1000);
+    int64_t ResyncTime = Now();
+    Signal.Process();
+    Host::RunFor(20000);
+    Signal.Process();
+
+    ASSERT_EQ(Edges.size(), 1u);
+    EXPECT_TRUE(Edges[0].Rising);
+    EXPECT_EQ(Edges[0].Timestamp, static_cast<uint64_t>(ResyncTime + 10000));
+    EXPECT_TRUE(Signal.GetFilteredSignal());
+}
+
+TEST_F(DigitalSignalHandlerTest, DispatchRunsCallbacksInTask) {
+    ASSERT_TRUE(Signal.EnableDispatch());
+    Signal.Update(false, 0);
+    EXPECT_TRUE(Edges.empty());
+
+    Host::RunFor(1000);
+    ASSERT_EQ(Edges.size(), 1u);
+    EXPECT_FALSE(Edges[0].Rising);
+
+    Signal.Update(false, 1000);
+    Signal.Update(true, 1000);
+    EXPECT_EQ(Edges.size(), 1u);
+
+    Host::RunFor(1000);
+    ASSERT_EQ(Edges.size(), 2u);
+    EXPECT_TRUE(Edges[1].Rising);
+    EXPECT_EQ(Edges[1].Timestamp, 1000u);
+    Signal.DisableDispatch();
+}
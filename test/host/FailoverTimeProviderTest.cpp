@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <FailoverTimeProvider.h>
+
+// The provider task runs once a second: at creation, then every RunFor()
+// second. NTP time is the reference, the RTC is set a few seconds off it
+class FailoverTimeProviderTest : public ::testing::Test {
+    protected:
+        static constexpr int64_t Second = 1000000;
+        static constexpr int64_t Reference = 1750000000LL * Second + 300000;   // mid-2025, not on a second
+
+        NtpHandler Ntp;
+        DS3231_RtcHandler Rtc;
+        FailoverTimeProvider* Provider = nullptr;
+
+        void SetUp() override {
+            Ntp.Synchronize(Reference);
+            Rtc.SetTime(Reference - 5 * Second);
+            Provider = FailoverTimeProvider::GetInstance();
+            Provider->SetSources(&Ntp, &Rtc);
+            Provider->Enable();
+        }
+
+        void TearDown() override {
+            FailoverTimeProvider::Destroy();
+        }
+
+        void ConnectNtp() {
+            Ntp.Connected = true;
+            Host::RunFor(3 * Second);
+            ASSERT_TRUE(Provider->IsSynchronizedToNtp());
+        }
+
+        int64_t Error() {
+            return Provider->GetEpochMicroseconds() - Ntp.GetEpochMicroseconds();
+        }
+};
+
+TEST_F(FailoverTimeProviderTest, StartsFromRtcWithoutNtp) {
+    Host::RunFor(Second / 2);
+
+    ASSERT_TRUE(Provider->IsTimeValid());
+    EXPECT_FALSE(Provider->IsSynchronizedToNtp());
+    EXPECT_EQ(Provider->GetRtcReadCount(), 1u);
+    EXPECT_NEAR(Provider->GetEpochMicroseconds(), Rtc.GetTime(), Second);
+
+    // Once running on the RTC it is not read again
+    Host::RunFor(10 * Second);
+    EXPECT_EQ(Provider->GetRtcReadCount(), 1u);
+}
+
+TEST_F(FailoverTimeProviderTest, InvalidRtcIsRetriedAfterPeriod) {
+    Rtc.Valid = false;
+
+    Host::RunFor(Second / 2);
+    EXPECT_FALSE(Provider->IsTimeValid());
+    EXPECT_EQ(Provider->GetRtcReadCount(), 1u);
+    EXPECT_TRUE(Host::Logged("RTC time not valid"));
+
+    Host::RunFor(58 * Second);
+    EXPECT_EQ(Provider->GetRtcReadCount(), 1u);
+
+    Rtc.Valid = true;
+    Host::RunFor(2 * Second);
+    EXPECT_EQ(Provider->GetRtcReadCount(), 2u);
+    EXPECT_TRUE(Provider->IsTimeValid());
+}
+
+TEST_F(FailoverTimeProviderTest, ImplausibleRtcTimeIsRejected) {
+    Rtc.SetTime(1000000000LL * Second);   // 2001, a reset DS3231
+
+    Host::RunFor(Second / 2);
+    EXPECT_FALSE(Provider->IsTimeValid());
+    EXPECT_EQ(Provider->GetRtcReadCount(), 1u);
+}
+
+TEST_F(FailoverTimeProviderTest, FollowsNtpAndWritesRtcOnSecondBoundary) {
+    ConnectNtp();
+
+    EXPECT_EQ(Error(), 0);
+    EXPECT_EQ(Provider->GetRtcReadCount(), 0u);
+    ASSERT_EQ(Rtc.Writes.size(), 1u);
+    EXPECT_NEAR(Rtc.GetTime(), Ntp.GetEpochMicroseconds(), 1000);
+}
+
+TEST_F(FailoverTimeProviderTest, NtpFrequencyErrorIsFollowed) {
+    Ntp.FrequencyError = 40;
+    Ntp.Synchronize(Reference);
+    ConnectNtp();
+
+    Ntp.Connected = false;
+    Host::RunFor(100 * Second);
+    EXPECT_NEAR(Error(), 0, 1);
+}
+
+TEST_F(FailoverTimeProviderTest, FailoverToAgreeingRtcKeepsRunningClock) {
+    ConnectNtp();
+
+    Ntp.Connected = false;
+    Host::RunFor(2 * Second);
+
+    EXPECT_EQ(Provider->GetFailoverCount(), 1u);
+    EXPECT_EQ(Provider->GetRtcReadCount(), 1u);
+    EXPECT_FALSE(Provider->IsSynchronizedToNtp());
+    EXPECT_EQ(Error(), 0);   // not rounded to the RTC second
+}
+
+TEST_F(FailoverTimeProviderTest, FailoverToInvalidRtcKeepsNtpTimeBase) {
+    ConnectNtp();
+    Rtc.Valid = false;
+
+    Ntp.Connected = false;
+    Host::RunFor(2 * Second);
+
+    EXPECT_EQ(Provider->GetFailoverCount(), 1u);
+    EXPECT_FALSE(Provider->IsSynchronizedToNtp());
+    EXPECT_TRUE(Provider->IsTimeValid());
+    EXPECT_EQ(Error(), 0);
+
+    // Retried after the period, without touching the clock while it fails
+    Host::RunFor(30 * Second);
+    EXPECT_EQ(Provider->GetRtcReadCount(), 1u);
+    Host::RunFor(31 * Second);
+    EXPECT_EQ(Provider->GetRtcReadCount(), 2u);
+    EXPECT_EQ(Error(), 0);
+
+    Ntp.Connected = true;
+    Host::RunFor(2 * Second);
+    EXPECT_TRUE(Provider->IsSynchronizedToNtp());
+    EXPECT_EQ(Provider->GetFailoverCount(), 1u);
+}
+
+TEST_F(FailoverTimeProviderTest, FailoverToImplausibleRtcKeepsNtpTimeBase) {
+    ConnectNtp();
+    Rtc.SetTime(1000000000LL * Second);
+
+    Ntp.Connected = false;
+    Host::RunFor(2 * Second);
+
+    EXPECT_TRUE(Provider->IsTimeValid());
+    EXPECT_EQ(Error(), 0);
+}
+
+TEST_F(FailoverTimeProviderTest, FailoverToDriftedRtcLoadsIt) {
+    ConnectNtp();
+    Rtc.SetTime(Ntp.GetEpochMicroseconds() + 10 * Second);
+
+    Ntp.Connected = false;
+    Host::RunFor(2 * Second);
+
+    EXPECT_NEAR(Error(), 10 * Second, Second);
+}
+
+TEST_F(FailoverTimeProviderTest, NtpReplacesRtcTime) {
+    Host::RunFor(Second / 2);
+    ASSERT_FALSE(Provider->IsSynchronizedToNtp());
+    EXPECT_NEAR(Error(), -5 * Second, Second);
+
+    ConnectNtp();
+    EXPECT_EQ(Error(), 0);
+    EXPECT_EQ(Rtc.Writes.size(), 1u);
+}
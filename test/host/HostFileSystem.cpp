@@ -0,0 +1,277 @@
+#include "HostRuntime.h"
+
+#include <LittleFS.h>
+
+namespace Host {
+    std::map<std::string, std::vector<uint8_t>> Files;
+    std::vector<std::string> Directories;
+    long WriteBudget = -1;
+    long PowerCutAfter = -1;
+}
+
+struct HostFile;
+
+namespace {
+    std::vector<std::weak_ptr<HostFile>> OpenFiles;
+
+    void LoseOpenFiles();
+
+    // Called before every operation that changes the flash
+    void Operation() {
+        if (Host::PowerCutAfter < 0) {
+            return;
+        }
+        if (Host::PowerCutAfter-- == 0) {
+            LoseOpenFiles();
+            throw Host::PowerLoss();
+        }
+    }
+}
+
+namespace Host {
+    void ResetFileSystem() {
+        LoseOpenFiles();
+        Files.clear();
+        Directories.clear();
+        WriteBudget = -1;
+        PowerCutAfter = -1;
+    }
+}
+
+namespace {
+    bool IsDirectory(const std::string& Path) {
+        return (Path == "/") || (std::find(Host::Directories.begin(), Host::Directories.end(), Path) != Host::Directories.end());
+    }
+
+    std::string Parent(const std::string& Path) {
+        size_t Slash = Path.rfind('/');
+        return (Slash == 0) ? "/" : Path.substr(0, Slash);
+    }
+}
+
+struct HostFile {
+    std::string Path;
+    std::string Name;
+    bool Directory;
+    bool Writable;
+    bool Open = true;
+    size_t Position = 0;
+    std::vector<uint8_t> Content;             // as read, or as written and not yet committed
+    std::vector<std::string> Entries;         // children of a directory
+    size_t NextEntry = 0;
+
+    void Commit() {
+        if (Open && Writable) {
+            Operation();
+            Host::Files[Path] = Content;
+        }
+    }
+};
+
+namespace {
+    void LoseOpenFiles() {
+        for (std::weak_ptr<HostFile>& Entry : OpenFiles) {
+            if (std::shared_ptr<HostFile> Handle = Entry.lock()) {
+                Handle->Open = false;
+            }
+        }
+        OpenFiles.clear();
+    }
+}
+
+File::operator bool() const {
+    return Handle && Handle->Open;
+}
+
+size_t File::write(const uint8_t* Buffer, size_t Size) {
+    if (!*this || !Handle->Writable) {
+        return 0;
+    }
+    Operation();
+    if (Host::WriteBudget >= 0) {
+        Size = std::min(Size, static_cast<size_t>(Host::WriteBudget));
+        Host::WriteBudget -= Size;
+    }
+    std::vector<uint8_t>& Content = Handle->Content;
+    Content.insert(Content.end(), Buffer, Buffer + Size);
+    Handle->Position = Content.size();
+    return Size;
+}
+
+size_t File::read(uint8_t* Buffer, size_t Size) {
+    if (!*this || Handle->Directory) {
+        return 0;
+    }
+    std::vector<uint8_t>& Content = Handle->Content;
+    size_t Count = std::min(Size, Content.size() - std::min(Handle->Position, Content.size()));
+    memcpy(Buffer, Content.data() + Handle->Position, Count);
+    Handle->Position += Count;
+    return Count;
+}
+
+int File::read() {
+    uint8_t Byte;
+    return (read(&Byte, 1) == 1) ? Byte : -1;
+}
+
+int File::available() {
+    return *this ? static_cast<int>(size() - std::min(Handle->Position, size())) : 0;
+}
+
+bool File::seek(uint32_t Position) {
+    if (!*this || (Position > size())) {
+        return false;
+    }
+    Handle->Position = Position;
+    return true;
+}
+
+size_t File::position() const {
+    return *this ? Handle->Position : 0;
+}
+
+size_t File::size() const {
+    return (*this && !Handle->Directory) ? Handle->Content.size() : 0;
+}
+
+void File::flush() {
+    if (Handle) {
+        Handle->Commit();
+    }
+}
+
+void File::close() {
+    if (Handle) {
+        Handle->Commit();
+        Handle->Open = false;
+    }
+}
+
+bool File::isDirectory() const {
+    return *this && Handle->Directory;
+}
+
+File File::openNextFile() {
+    if (!isDirectory() || (Handle->NextEntry >= Handle->Entries.size())) {
+        return File();
+    }
+    return LittleFS.open(Handle->Entries[Handle->NextEntry++].c_str(), "r");
+}
+
+const char* File::path() const {
+    return Handle ? Handle->Path.c_str() : "";
+}
+
+const char* File::name() const {
+    return Handle ? Handle->Name.c_str() : "";
+}
+
+LittleFSFS LittleFS;
+
+bool LittleFSFS::begin(bool, const char*, uint8_t, const char*) {
+    return true;
+}
+
+bool LittleFSFS::format() {
+    Host::Files.clear();
+    Host::Directories.clear();
+    return true;
+}
+
+File LittleFSFS::open(const char* Path, const char* Mode) {
+    std::string Name = Path;
+    bool Write = (Mode[0] == 'w') || (Mode[0] == 'a');
+    if (!IsDirectory(Parent(Name))) {
+        return File();
+    }
+
+    std::shared_ptr<HostFile> Handle = std::make_shared<HostFile>();
+    Handle->Path = Name;
+    Handle->Name = Name.substr(Name.rfind('/') + 1);
+    Handle->Directory = IsDirectory(Name);
+    Handle->Writable = Write;
+
+    if (Handle->Directory) {
+        if (Write) {
+            return File();
+        }
+        for (const std::string& Directory : Host::Directories) {
+            if (Parent(Directory) == Name) {
+                Handle->Entries.push_back(Directory);
+            }
+        }
+        for (const auto& Entry : Host::Files) {
+            if (Parent(Entry.first) == Name) {
+                Handle->Entries.push_back(Entry.first);
+            }
+        }
+    } else if (Write) {
+        // Creating the file is committed at once, truncating it on the next commit
+        Operation();
+        std::vector<uint8_t>& Committed = Host::Files[Name];
+        if (Mode[0] == 'a') {
+            Handle->Content = Committed;
+        }
+        Handle->Position = Handle->Content.size();
+        OpenFiles.push_back(Handle);
+    } else {
+        auto Entry = Host::Files.find(Name);
+        if (Entry == Host::Files.end()) {
+            return File();
+        }
+        Handle->Content = Entry->second;
+    }
+    return File(Handle);
+}
+
+bool LittleFSFS::exists(const char* Path) {
+    return (Host::Files.count(Path) > 0) || IsDirectory(Path);
+}
+
+bool LittleFSFS::remove(const char* Path) {
+    Operation();
+    return Host::Files.erase(Path) > 0;
+}
+
+bool LittleFSFS::rename(const char* From, const char* To) {
+    auto Entry = Host::Files.find(From);
+    if ((Entry == Host::Files.end()) || !IsDirectory(Parent(To))) {
+        return false;
+    }
+    Operation();
+    std::vector<uint8_t> Content = std::move(Entry->second);
+    Host::Files.erase(Entry);
+    Host::Files[To] = std::move(Content);
+    return true;
+}
+
+bool LittleFSFS::mkdir(const char* Path) {
+    if (exists(Path) || !IsDirectory(Parent(Path))) {
+        return false;
+    }
+    Operation();
+    Host::Directories.push_back(Path);
+    return true;
+}
+
+bool LittleFSFS::rmdir(const char* Path) {
+    auto Entry = std::find(Host::Directories.begin(), Host::Directories.end(), std::string(Path));
+    if (Entry == Host::Directories.end()) {
+        return false;
+    }
+    Operation();
+    Host::Directories.erase(Entry);
+    return true;
+}
+
+size_t LittleFSFS::totalBytes() {
+    return 1441792;
+}
+
+size_t LittleFSFS::usedBytes() {
+    size_t Used = 0;
+    for (const auto& Entry : Host::Files) {
+        Used += Entry.second.size();
+    }
+    return Used;
+}
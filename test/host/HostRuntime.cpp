@@ -0,0 +1,511 @@
+#include "HostRuntime.h"
+
+#include <gtest/gtest.h>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <esp_netif.h>
+#include <lwip/dhcp.h>
+
+// ----------------------------
+//    Scheduler
+// ----------------------------
+
+struct HostTask {
+    std::string Name;
+    TaskFunction_t Function;
+    void* Parameter;
+    uint64_t Order;
+    int64_t WakeTime;       // LLONG_MAX while blocked on a queue
+    bool Deleted = false;
+    bool Go = false;
+    std::condition_variable Wake;
+};
+
+struct HostQueue {
+    size_t Length;
+    size_t ItemSize;
+    std::deque<std::vector<uint8_t>> Items;
+    std::vector<HostTask*> Waiting;
+};
+
+namespace {
+    // Leaked on purpose: deleted tasks keep a thread parked on these until exit
+    struct Scheduler {
+        std::mutex Mutex;
+        std::condition_variable Idle;
+        std::vector<HostTask*> Tasks;
+        HostTask* Running = nullptr;
+        int64_t Now = 0;
+        uint64_t NextOrder = 0;
+    };
+    Scheduler& State = *new Scheduler();
+
+    // Thrown by vTaskDelete(nullptr) to unwind the task function
+    struct TaskExit {};
+
+    thread_local HostTask* Self = nullptr;
+
+    // Called with the lock held, on the task thread
+    void Yield(std::unique_lock<std::mutex>& Lock) {
+        Self->Go = false;
+        State.Running = nullptr;
+        State.Idle.notify_all();
+        Self->Wake.wait(Lock, [] { return Self->Go; });
+        if (Self->Deleted) {
+            throw TaskExit();
+        }
+    }
+
+    // Called with the lock held, on the test thread
+    void Resume(std::unique_lock<std::mutex>& Lock, HostTask* Task) {
+        State.Running = Task;
+        Task->Go = true;
+        Task->Wake.notify_all();
+        State.Idle.wait(Lock, [] { return State.Running == nullptr; });
+    }
+
+    void TaskMain(HostTask* Task) {
+        Self = Task;
+        {
+            std::unique_lock<std::mutex> Lock(State.Mutex);
+            Task->Wake.wait(Lock, [Task] { return Task->Go; });
+        }
+        try {
+            Task->Function(Task->Parameter);
+        } catch (const TaskExit&) {
+        }
+        std::unique_lock<std::mutex> Lock(State.Mutex);
+        Task->Deleted = true;
+        State.Running = nullptr;
+        State.Idle.notify_all();
+    }
+
+    void BlockOn(HostQueue* Queue, TickType_t Wait, std::unique_lock<std::mutex>& Lock) {
+        Self->WakeTime = (Wait == portMAX_DELAY) ? LLONG_MAX : State.Now + static_cast<int64_t>(Wait) * 1000;
+        Queue->Waiting.push_back(Self);
+        Yield(Lock);
+        Queue->Waiting.erase(std::remove(Queue->Waiting.begin(), Queue->Waiting.end(), Self), Queue->Waiting.end());
+    }
+}
+
+namespace Host {
+    void RunFor(int64_t Microseconds) {
+        std::unique_lock<std::mutex> Lock(State.Mutex);
+        int64_t End = State.Now + Microseconds;
+        while (true) {
+            HostTask* Next = nullptr;
+            for (HostTask* Task : State.Tasks) {
+                if (!Task->Deleted && (Task->WakeTime <= End) && ((Next == nullptr) || (Task->WakeTime < Next->WakeTime) || ((Task->WakeTime == Next->WakeTime) && (Task->Order < Next->Order)))) {
+                    Next = Task;
+                }
+            }
+            if (Next == nullptr) {
+                break;
+            }
+            State.Now = std::max(State.Now, Next->WakeTime);
+            Resume(Lock, Next);
+        }
+        State.Now = End;
+    }
+
+    void DeleteAllTasks() {
+        std::unique_lock<std::mutex> Lock(State.Mutex);
+        for (HostTask* Task : State.Tasks) {
+            Task->Deleted = true;
+        }
+    }
+
+    size_t GetTaskCount() {
+        std::unique_lock<std::mutex> Lock(State.Mutex);
+        return std::count_if(State.Tasks.begin(), State.Tasks.end(), [](HostTask* Task) { return !Task->Deleted; });
+    }
+}
+
+int64_t esp_timer_get_time() {
+    return State.Now;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t Function, const char* Name, uint32_t, void* Parameter, UBaseType_t, TaskHandle_t* Handle, BaseType_t) {
+    HostTask* Task = new HostTask();
+    Task->Name = Name;
+    Task->Function = Function;
+    Task->Parameter = Parameter;
+    {
+        std::unique_lock<std::mutex> Lock(State.Mutex);
+        Task->Order = State.NextOrder++;
+        Task->WakeTime = State.Now;
+        State.Tasks.push_back(Task);
+    }
+    std::thread(TaskMain, Task).detach();
+    if (Handle != nullptr) {
+        *Handle = Task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t Function, const char* Name, uint32_t StackDepth, void* Parameter, UBaseType_t Priority, TaskHandle_t* Handle) {
+    return xTaskCreatePinnedToCore(Function, Name, StackDepth, Parameter, Priority, Handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t Task) {
+    if ((Task == nullptr) || (Task == Self)) {
+        throw TaskExit();
+    }
+    std::unique_lock<std::mutex> Lock(State.Mutex);
+    Task->Deleted = true;
+}
+
+void vTaskDelay(TickType_t Ticks) {
+    if (Self == nullptr) {
+        Host::RunFor(static_cast<int64_t>(std::max<TickType_t>(Ticks, 1)) * 1000);
+        return;
+    }
+    std::unique_lock<std::mutex> Lock(State.Mutex);
+    Self->WakeTime = State.Now + static_cast<int64_t>(std::max<TickType_t>(Ticks, 1)) * 1000;
+    Yield(Lock);
+}
+
+void vTaskSuspend(TaskHandle_t) {
+}
+
+void vTaskResume(TaskHandle_t) {
+}
+
+void vTaskPrioritySet(TaskHandle_t, UBaseType_t) {
+}
+
+TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(State.Now / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return Self;
+}
+
+// On the device the TCB of a deleted task is freed
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t Task) {
+    if ((Task != nullptr) && Task->Deleted) {
+        ADD_FAILURE() << "Stack of the deleted task " << Task->Name << " read";
+    }
+    return 1024;
+}
+
+// ----------------------------
+//    Queues and semaphores
+// ----------------------------
+
+QueueHandle_t xQueueCreate(UBaseType_t Length, UBaseType_t ItemSize) {
+    HostQueue* Queue = new HostQueue();
+    Queue->Length = Length;
+    Queue->ItemSize = ItemSize;
+    return Queue;
+}
+
+void vQueueDelete(QueueHandle_t Queue) {
+    delete Queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t Queue, const void* Item, TickType_t) {
+    std::unique_lock<std::mutex> Lock(State.Mutex);
+    if (Queue->Items.size() >= Queue->Length) {
+        return pdFALSE;
+    }
+    const uint8_t* Bytes = static_cast<const uint8_t*>(Item);
+    Queue->Items.emplace_back(Bytes, Bytes + Queue->ItemSize);
+    for (HostTask* Task : Queue->Waiting) {
+        Task->WakeTime = State.Now;
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t Queue, const void* Item, BaseType_t* Woken) {
+    if (Woken != nullptr) {
+        *Woken = pdFALSE;
+    }
+    return xQueueSend(Queue, Item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t Queue, void* Item, TickType_t Wait) {
+    std::unique_lock<std::mutex> Lock(State.Mutex);
+    if (Queue->Items.empty() && (Wait > 0) && (Self != nullptr)) {
+        BlockOn(Queue, Wait, Lock);
+    }
+    if (Queue->Items.empty()) {
+        return pdFALSE;
+    }
+    if (Queue->ItemSize > 0) {
+        memcpy(Item, Queue->Items.front().data(), Queue->ItemSize);
+    }
+    Queue->Items.pop_front();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t Queue) {
+    std::unique_lock<std::mutex> Lock(State.Mutex);
+    Queue->Items.clear();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t Queue) {
+    std::unique_lock<std::mutex> Lock(State.Mutex);
+    return Queue->Items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t Semaphore = xQueueCreate(1, 0);
+    xSemaphoreGive(Semaphore);
+    return Semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t Semaphore, TickType_t Wait) {
+    return xQueueReceive(Semaphore, nullptr, Wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t Semaphore) {
+    return xQueueSend(Semaphore, nullptr, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t Semaphore) {
+    vQueueDelete(Semaphore);
+}
+
+// ----------------------------
+//    Arduino
+// ----------------------------
+
+HardwareSerial Serial;
+EspClass ESP;
+
+unsigned long millis() {
+    return static_cast<unsigned long>(State.Now / 1000);
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(State.Now);
+}
+
+void delay(uint32_t Milliseconds) {
+    vTaskDelay(Milliseconds);
+}
+
+void yield() {
+}
+
+namespace {
+    struct PinState {
+        int Level = LOW;
+        void (*Handler)(void*) = nullptr;
+        void* Argument = nullptr;
+        int Mode = 0;
+    };
+    std::map<uint8_t, PinState> Pins;
+}
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+int digitalRead(uint8_t Pin) {
+    return Pins[Pin].Level;
+}
+
+void digitalWrite(uint8_t Pin, uint8_t Value) {
+    Pins[Pin].Level = Value;
+}
+
+void attachInterruptArg(uint8_t Pin, void (*Handler)(void*), void* Argument, int Mode) {
+    Pins[Pin].Handler = Handler;
+    Pins[Pin].Argument = Argument;
+    Pins[Pin].Mode = Mode;
+}
+
+void detachInterrupt(uint8_t Pin) {
+    Pins[Pin].Handler = nullptr;
+}
+
+namespace Host {
+    void SetPinLevel(uint8_t Pin, int Level) {
+        PinState& State = Pins[Pin];
+        bool Rising = (State.Level == LOW) && (Level != LOW);
+        bool Falling = (State.Level != LOW) && (Level == LOW);
+        State.Level = Level;
+        if ((State.Handler != nullptr) && ((Rising && (State.Mode & RISING)) || (Falling && (State.Mode & FALLING)))) {
+            State.Handler(State.Argument);
+        }
+    }
+
+    int GetPinLevel(uint8_t Pin) {
+        return Pins[Pin].Level;
+    }
+}
+
+// ----------------------------
+//    Logger
+// ----------------------------
+
+namespace Host {
+    std::vector<std::string> LogLines;
+
+    bool Logged(const std::string& Text) {
+        return std::any_of(LogLines.begin(), LogLines.end(), [&Text](const std::string& Line) { return Line.find(Text) != std::string::npos; });
+    }
+}
+
+void HostLog(LogType Type, const String& FunctionName, const String& Message) {
+    std::string Line = std::string(FunctionName.c_str()) + ": " + Message.c_str();
+    if ((Type == LogType::Warning) || (Type == LogType::Error) || (Type == LogType::FatalError)) {
+        std::cerr << "[" << State.Now / 1000 << " ms] " << Line << std::endl;
+    }
+    Host::LogLines.push_back(Line);
+}
+
+// ----------------------------
+//    Network
+// ----------------------------
+
+namespace Host {
+    std::map<std::string, IPAddress> DnsTable;
+    int DnsLookups = 0;
+    UdpServerFunction UdpServer;
+
+    struct PendingDatagram {
+        int64_t ArrivalTime;
+        std::vector<uint8_t> Data;
+    };
+    std::deque<PendingDatagram> Datagrams;
+
+    void ResetNetwork() {
+        DnsTable.clear();
+        DnsLookups = 0;
+        UdpServer = nullptr;
+        Datagrams.clear();
+    }
+}
+
+WiFiClass WiFi;
+
+int WiFiClass::hostByName(const char* Name, IPAddress& Address) {
+    Host::DnsLookups++;
+    auto Entry = Host::DnsTable.find(Name);
+    if (Entry == Host::DnsTable.end()) {
+        return 0;
+    }
+    Address = Entry->second;
+    return 1;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb Callback) {
+    Handlers.push_back({NextEventId, Callback});
+    return NextEventId++;
+}
+
+void WiFiClass::removeEvent(wifi_event_id_t Id) {
+    Handlers.erase(std::remove_if(Handlers.begin(), Handlers.end(), [Id](const std::pair<wifi_event_id_t, WiFiEventFuncCb>& Entry) { return Entry.first == Id; }), Handlers.end());
+}
+
+// Runs the handlers on the caller, as the event task of the core would
+void WiFiClass::RaiseEvent(arduino_event_id_t Event, uint8_t Reason) {
+    arduino_event_info_t Info = {};
+    Info.wifi_sta_disconnected.reason = Reason;
+    if (Event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        Status = WL_CONNECTED;
+    } else if ((Event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) || (Event == ARDUINO_EVENT_WIFI_STA_LOST_IP)) {
+        Status = WL_DISCONNECTED;
+    }
+    std::vector<std::pair<wifi_event_id_t, WiFiEventFuncCb>> Current = Handlers;
+    for (auto& Entry : Current) {
+        Entry.second(Event, Info);
+    }
+}
+
+void WiFiClass::Reset() {
+    Status = WL_DISCONNECTED;
+    LocalIP = Gateway = Subnet = Dns = IPAddress();
+    LeaseTime = 0;
+    Configs.clear();
+    Begins.clear();
+}
+
+struct esp_netif_obj {
+    struct dhcp Dhcp;
+    struct netif Netif;
+};
+static esp_netif_obj StationInterface;
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* Key) {
+    return (strcmp(Key, "WIFI_STA_DEF") == 0) ? &StationInterface : nullptr;
+}
+
+void* esp_netif_get_netif_impl(esp_netif_t* Interface) {
+    Interface->Dhcp = {WiFi.LeaseTime, 0};
+    Interface->Netif.dhcp = (WiFi.LeaseTime > 0) ? &Interface->Dhcp : nullptr;
+    return &Interface->Netif;
+}
+
+uint8_t WiFiUDP::begin(uint16_t) {
+    Open = true;
+    return 1;
+}
+
+void WiFiUDP::stop() {
+    Open = false;
+    Host::Datagrams.clear();
+}
+
+int WiFiUDP::beginPacket(IPAddress Address, uint16_t Port) {
+    Destination = Address;
+    DestinationPort = Port;
+    Outgoing.clear();
+    return Open ? 1 : 0;
+}
+
+size_t WiFiUDP::write(const uint8_t* Buffer, size_t Size) {
+    Outgoing.insert(Outgoing.end(), Buffer, Buffer + Size);
+    return Size;
+}
+
+int WiFiUDP::endPacket() {
+    if (!Open) {
+        return 0;
+    }
+    if (Host::UdpServer) {
+        for (Host::UdpReply& Reply : Host::UdpServer(Destination, DestinationPort, Outgoing)) {
+            Host::PendingDatagram Datagram = {State.Now + Reply.Delay, Reply.Data};
+            auto Position = std::upper_bound(Host::Datagrams.begin(), Host::Datagrams.end(), Datagram.ArrivalTime,
+                [](int64_t Time, const Host::PendingDatagram& Other) { return Time < Other.ArrivalTime; });
+            Host::Datagrams.insert(Position, Datagram);
+        }
+    }
+    return 1;
+}
+
+int WiFiUDP::parsePacket() {
+    Incoming.clear();
+    ReadPosition = 0;
+    if (!Open || Host::Datagrams.empty() || (Host::Datagrams.front().ArrivalTime > State.Now)) {
+        return 0;
+    }
+    Incoming = Host::Datagrams.front().Data;
+    Host::Datagrams.pop_front();
+    return Incoming.size();
+}
+
+int WiFiUDP::read(uint8_t* Buffer, size_t Size) {
+    size_t Count = std::min(Size, Incoming.size() - ReadPosition);
+    memcpy(Buffer, Incoming.data() + ReadPosition, Count);
+    ReadPosition += Count;
+    return Count;
+}
+
+void WiFiUDP::flush() {
+    ReadPosition = Incoming.size();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "LoggerHandler.h"
+
+// Control side of the host build. Tasks are threads run one at a time by a
+// deterministic scheduler: the clock starts at 0 and only moves in RunFor(),
+// which wakes every task whose delay ends within the interval, in time order.
+// A vTaskDelay() from the test itself is a RunFor() of the same length.
+namespace Host {
+    void RunFor(int64_t Microseconds);
+    void DeleteAllTasks();
+    size_t GetTaskCount();        // tasks created and not deleted
+
+    // Log lines as "<function>: <message>", warnings and errors also on stderr
+    extern std::vector<std::string> LogLines;
+    bool Logged(const std::string& Text);
+
+    // Network: a lookup succeeds when the name is in DnsTable. A datagram sent
+    // to UdpServer is answered with the datagrams it returns, each delivered
+    // after its delay in microseconds
+    struct UdpReply {
+        std::vector<uint8_t> Data;
+        int64_t Delay;
+    };
+    typedef std::function<std::vector<UdpReply>(const IPAddress& Address, uint16_t Port, const std::vector<uint8_t>& Request)> UdpServerFunction;
+
+    extern std::map<std::string, IPAddress> DnsTable;
+    extern int DnsLookups;
+    extern UdpServerFunction UdpServer;
+    void ResetNetwork();
+
+    // File system: LittleFS keeps files and directories here by full path.
+    // Once WriteBudget bytes were written (when not negative) writes come up
+    // short, as on a full partition or when power is lost during a write
+    extern std::map<std::string, std::vector<uint8_t>> Files;
+    extern std::vector<std::string> Directories;
+    extern long WriteBudget;
+    void ResetFileSystem();
+
+    // Power loss. As in littlefs, Files holds what is committed: an open file
+    // is committed by flush() and close(), and a create, rename or remove is
+    // atomic. After PowerCutAfter more file system operations (when not
+    // negative) the next one throws PowerLoss. Open files are then lost
+    // without committing, and the file system is as the next boot finds it
+    struct PowerLoss {};
+    extern long PowerCutAfter;
+
+    // GPIO: setting a level calls the interrupt handler attached to the pin
+    void SetPinLevel(uint8_t Pin, int Level);
+    int GetPinLevel(uint8_t Pin);
+}
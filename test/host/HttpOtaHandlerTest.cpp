@@ -0,0 +1,17 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <HttpOtaHandler.h>
+
+// The host has no update partition, only the checks before the download run
+TEST(HttpOtaHandlerTest, InvalidDigestFailsBeforeDownloading) {
+    HttpOtaHandler Ota;
+    EXPECT_FALSE(Ota.Update("http://updates.local/firmware.bin", "1234"));
+    EXPECT_EQ(Ota.GetState(), HttpOtaHandler::FAILED);
+    EXPECT_TRUE(Host::Logged("Invalid SHA-256 digest"));
+}
+
+TEST(HttpOtaHandlerTest, MissingPartitionFails) {
+    HttpOtaHandler Ota;
+    EXPECT_FALSE(Ota.Update("http://updates.local/firmware.bin", std::string(64, 'a')));
+    EXPECT_TRUE(Host::Logged("No OTA partition available"));
+}
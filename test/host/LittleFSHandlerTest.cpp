@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <LittleFSHandler.h>
+
+class LittleFSHandlerTest : public ::testing::Test {
+    protected:
+        LittleFSHandler& FileSystem = LittleFSHandler::GetInstance();
+
+        void SetUp() override {
+            Host::ResetFileSystem();
+            ASSERT_TRUE(FileSystem.Init());
+        }
+
+        uint32_t FooterWord(const std::string& Path, size_t Word) {
+            const std::vector<uint8_t>& Content = Host::Files[Path];
+            uint32_t Value;
+            memcpy(&Value, Content.data() + Content.size() - 8 + 4 * Word, sizeof(Value));
+            return Value;
+        }
+};
+
+TEST_F(LittleFSHandlerTest, ChecksumRoundTrip) {
+    ASSERT_TRUE(FileSystem.WriteFile("/config.json", String("hello"), true));
+
+    ASSERT_EQ(Host::Files["/config.json"].size(), 5u + 8u);
+    EXPECT_EQ(FooterWord("/config.json", 0), 0x3610a686u);   // zlib crc32("hello")
+    EXPECT_EQ(FooterWord("/config.json", 1), static_cast<uint32_t>(LITTLE_FS_CHECKSUM_MAGIC));
+    EXPECT_FALSE(FileSystem.FileExists("/config.json.tmp"));
+
+    String Content;
+    ASSERT_TRUE(FileSystem.ReadFile("/config.json", Content, true));
+    EXPECT_STREQ(Content.c_str(), "hello");
+}
+
+TEST_F(LittleFSHandlerTest, BinaryContentOverSeveralChunks) {
+    std::vector<uint8_t> Data(3 * LITTLE_FS_CHUNK_SIZE + 123);
+    for (size_t i = 0; i < Data.size(); i++) {
+        Data[i] = static_cast<uint8_t>((i * 7) % 251);   // includes zero bytes
+    }
+    ASSERT_TRUE(FileSystem.WriteFile("/data.bin", Data.data(), Data.size(), true));
+
+    String Content;
+    ASSERT_TRUE(FileSystem.ReadFile("/data.bin", Content, true));
+    ASSERT_EQ(Content.length(), Data.size());
+    EXPECT_EQ(memcmp(Content.c_str(), Data.data(), Data.size()), 0);
+}
+
+TEST_F(LittleFSHandlerTest, CorruptedContentIsDetected) {
+    ASSERT_TRUE(FileSystem.WriteFile("/config.json", String("{\"interval\":60}"), true));
+    Host::Files["/config.json"][3] ^= 0x04;
+
+    String Content;
+    EXPECT_FALSE(FileSystem.ReadFile("/config.json", Content, true));
+    EXPECT_TRUE(Host::Logged("Checksum mismatch in file /config.json"));
+}
+
+TEST_F(LittleFSHandlerTest, CorruptedFooterIsDetected) {
+    ASSERT_TRUE(FileSystem.WriteFile("/config.json", String("{\"interval\":60}"), true));
+    Host::Files["/config.json"].back() ^= 0x80;
+
+    String Content;
+    EXPECT_FALSE(FileSystem.ReadFile("/config.json", Content, true));
+}
+
+TEST_F(LittleFSHandlerTest, TruncatedFileIsDetected) {
+    ASSERT_TRUE(FileSystem.WriteFile("/config.json", String("{\"interval\":60}"), true));
+    Host::Files["/config.json"].pop_back();
+
+    String Content;
+    EXPECT_FALSE(FileSystem.ReadFile("/config.json", Content, true));
+}
+
+TEST_F(LittleFSHandlerTest, FileWithoutFooterIsRejected) {
+    ASSERT_TRUE(FileSystem.WriteFile("/plain.txt", String("no footer in this file")));
+    ASSERT_TRUE(FileSystem.WriteFile("/short.txt", String("abc")));
+
+    String Content;
+    EXPECT_FALSE(FileSystem.ReadFile("/plain.txt", Content, true));
+    EXPECT_FALSE(FileSystem.ReadFile("/short.txt", Content, true));
+    EXPECT_TRUE(Host::Logged("Missing checksum in file /short.txt"));
+
+    // Without the option the file is read as written
+    ASSERT_TRUE(FileSystem.ReadFile("/plain.txt", Content));
+    EXPECT_STREQ(Content.c_str(), "no footer in this file");
+}
+
+TEST_F(LittleFSHandlerTest, FailedWriteKeepsPreviousFile) {
+    ASSERT_TRUE(FileSystem.WriteFile("/config.json", String("version 1"), true));
+
+    Host::WriteBudget = 4;
+    EXPECT_FALSE(FileSystem.WriteFile("/config.json", String("version 2, longer"), true));
+    Host::WriteBudget = -1;
+
+    String Content;
+    ASSERT_TRUE(FileSystem.ReadFile("/config.json", Content, true));
+    EXPECT_STREQ(Content.c_str(), "version 1");
+    EXPECT_FALSE(FileSystem.FileExists("/config.json.tmp"));
+}
+
+TEST_F(LittleFSHandlerTest, FailedFooterWriteKeepsPreviousFile) {
+    ASSERT_TRUE(FileSystem.WriteFile("/config.json", String("version 1"), true));
+
+    Host::WriteBudget = strlen("version 2");
+    EXPECT_FALSE(FileSystem.WriteFile("/config.json", String("version 2"), true));
+    Host::WriteBudget = -1;
+
+    String Content;
+    ASSERT_TRUE(FileSystem.ReadFile("/config.json", Content, true));
+    EXPECT_STREQ(Content.c_str(), "version 1");
+}
+
+TEST_F(LittleFSHandlerTest, StaleTemporaryFileIsReplaced) {
+    // Left by a reset between the write and the rename
+    Host::Files["/config.json.tmp"] = {'j', 'u', 'n', 'k'};
+
+    ASSERT_TRUE(FileSystem.WriteFile("/config.json", String("fresh"), true));
+
+    String Content;
+    ASSERT_TRUE(FileSystem.ReadFile("/config.json", Content, true));
+    EXPECT_STREQ(Content.c_str(), "fresh");
+    EXPECT_FALSE(FileSystem.FileExists("/config.json.tmp"));
+}
+
+// Power is cut before each file system operation of the write in turn
+TEST_F(LittleFSHandlerTest, PowerLossLeavesTheOldOrTheNewFile) {
+    std::string Old(LITTLE_FS_CHUNK_SIZE + 10, 'o');
+    std::string New(2 * LITTLE_FS_CHUNK_SIZE + 20, 'n');
+    bool SawOld = false;
+    bool SawNew = false;
+
+    for (long Cut = 0; ; Cut++) {
+        Host::ResetFileSystem();
+        ASSERT_TRUE(FileSystem.Init());
+        ASSERT_TRUE(FileSystem.WriteFile("/config.json", String(Old.c_str()), true));
+
+        bool Lost = false;
+        Host::PowerCutAfter = Cut;
+        try {
+            FileSystem.WriteFile("/config.json", String(New.c_str()), true);
+        } catch (const Host::PowerLoss&) {
+            Lost = true;
+        }
+        Host::PowerCutAfter = -1;
+
+        String Content;
+        ASSERT_TRUE(FileSystem.ReadFile("/config.json", Content, true)) << "cut before operation " << Cut;
+        ASSERT_TRUE((Content == Old.c_str()) || (Content == New.c_str())) << "cut before operation " << Cut;
+        SawOld |= (Content == Old.c_str());
+        SawNew |= (Content == New.c_str());
+        if (!Lost) {
+            EXPECT_STREQ(Content.c_str(), New.c_str());
+        }
+
+        // The next boot writes over whatever temporary file was left
+        ASSERT_TRUE(FileSystem.WriteFile("/config.json", String("after"), true));
+        ASSERT_TRUE(FileSystem.ReadFile("/config.json", Content, true));
+        EXPECT_STREQ(Content.c_str(), "after");
+
+        if (!Lost) {
+            break;
+        }
+    }
+    EXPECT_TRUE(SawOld);
+    EXPECT_TRUE(SawNew);
+}
+
+TEST_F(LittleFSHandlerTest, PowerLossOnFirstWriteLeavesNoFileOrTheNewOne) {
+    for (long Cut = 0; Cut < 8; Cut++) {
+        Host::ResetFileSystem();
+        ASSERT_TRUE(FileSystem.Init());
+
+        Host::PowerCutAfter = Cut;
+        try {
+            FileSystem.WriteFile("/config.json", String("first"), true);
+        } catch (const Host::PowerLoss&) {
+        }
+        Host::PowerCutAfter = -1;
+
+        String Content;
+        if (FileSystem.FileExists("/config.json")) {
+            ASSERT_TRUE(FileSystem.ReadFile("/config.json", Content, true)) << "cut before operation " << Cut;
+            EXPECT_STREQ(Content.c_str(), "first");
+        }
+    }
+}
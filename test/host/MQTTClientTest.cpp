@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <WiFi.h>
+#include <MQTTClient.h>
+
+static std::string Scrape() {
+    MetricsCursor Cursor;
+    uint8_t Buffer[4096];
+    std::string Text;
+    size_t Length;
+    while ((Length = MetricsRegistry::GetInstance().Render(Cursor, Buffer, sizeof(Buffer))) > 0) {
+        Text.append(reinterpret_cast<char*>(Buffer), Length);
+    }
+    return Text;
+}
+
+// There is no broker on the host: the client keeps trying to connect
+TEST(MQTTClientTest, RetriesWhileTheBrokerIsUnreachable) {
+    MQTTClient* Client = new MQTTClient();
+    Client->SetServer("broker.local", 1883);
+    Client->Enable();
+
+    Host::RunFor(12000000);
+    EXPECT_GE(std::count_if(Host::LogLines.begin(), Host::LogLines.end(), [](const std::string& Line) { return Line.find("Connection timeout") != std::string::npos; }), 2);
+    EXPECT_FALSE(Client->PublishString("plant/state", "on"));
+    delete Client;
+}
+
+TEST(MQTTClientTest, DeleteUnregistersTask) {
+    MQTTClient* Client = new MQTTClient();
+    Host::RunFor(1000);
+    delete Client;
+
+    EXPECT_NE(Scrape().find("task=\"MQTT_HandlerTask\""), std::string::npos);
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <MetricsRegistry.h>
+
+// Chunked responses hand out buffers of any size, down to a few bytes
+static std::string Scrape(size_t ChunkSize) {
+    MetricsCursor Cursor;
+    std::vector<uint8_t> Buffer(ChunkSize);
+    std::string Text;
+    size_t Length;
+    while ((Length = MetricsRegistry::GetInstance().Render(Cursor, Buffer.data(), Buffer.size())) > 0) {
+        EXPECT_LE(Length, ChunkSize);
+        Text.append(reinterpret_cast<char*>(Buffer.data()), Length);
+    }
+    return Text;
+}
+
+TEST(MetricsRegistryTest, SmallChunksRenderTheWholeRegistry) {
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    Metrics.AddCounter("test_events_total", "Events seen by the test", "source=\"a\"")->Increment();
+    Metrics.AddCounter("test_events_total", "Events seen by the test", "source=\"b\"");
+    Metrics.AddGauge("test_level", "Level seen by the test")->Set(12);
+
+    std::string Reference = Scrape(4096);
+    ASSERT_NE(Reference.find("test_events_total{source=\"a\"} 1\n"), std::string::npos);
+    ASSERT_NE(Reference.find("test_level 12\n"), std::string::npos);
+
+    for (size_t ChunkSize : {1, 7, 64, 319}) {
+        EXPECT_EQ(Scrape(ChunkSize), Reference) << "chunk of " << ChunkSize << " bytes";
+    }
+}
+
+TEST(MetricsRegistryTest, MetricsAddedDuringAScrapeWaitForTheNextOne) {
+    MetricsRegistry& Metrics = MetricsRegistry::GetInstance();
+    MetricsCursor Cursor;
+    uint8_t Buffer[16];
+    ASSERT_GT(Metrics.Render(Cursor, Buffer, sizeof(Buffer)), 0u);
+
+    Metrics.AddGauge("test_late", "Registered while a scrape is streamed");
+    std::string Text;
+    size_t Length;
+    while ((Length = Metrics.Render(Cursor, Buffer, sizeof(Buffer))) > 0) {
+        Text.append(reinterpret_cast<char*>(Buffer), Length);
+    }
+    EXPECT_EQ(Text.find("test_late"), std::string::npos);
+    EXPECT_NE(Scrape(4096).find("test_late 0\n"), std::string::npos);
+}
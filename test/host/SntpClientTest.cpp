@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <SntpClient.h>
+
+// The server clock is ServerOffset + Monotonic * (1 + ServerRate), replies
+// travel with whole millisecond delays so that the 1 ms polling of the
+// client reads them the moment they arrive and the math is exact
+class SntpClientTest : public ::testing::Test {
+    protected:
+        struct PathDelay {
+            int64_t Outbound;   // microseconds
+            int64_t Return;     // microseconds
+        };
+
+        SntpClient Client;
+        int64_t ServerOffset = 1700000000LL * 1000000;
+        double ServerRate = 0;                            // ppm
+        std::vector<PathDelay> Delays = {{5000, 5000}};   // per request, the last one repeats
+        bool EchoOriginate = true;
+        int Requests = 0;
+
+        void SetUp() override {
+            Host::ResetNetwork();
+            Host::DnsTable["pool.ntp.org"] = IPAddress(192, 0, 2, 1);
+            Host::UdpServer = [this](const IPAddress&, uint16_t, const std::vector<uint8_t>& Request) { return Serve(Request); };
+            Client.Begin();
+        }
+
+        void TearDown() override {
+            Client.End();
+            Host::ResetNetwork();
+        }
+
+        int64_t ServerTime(int64_t Monotonic) const {
+            return ServerOffset + Monotonic + static_cast<int64_t>(Monotonic * ServerRate / 1000000);
+        }
+
+        int64_t ClockError() {
+            return Client.GetEpochMicroseconds() - ServerTime(esp_timer_get_time());
+        }
+
+        static void WriteStamp(int64_t Microseconds, uint8_t* Stamp) {
+            uint32_t Seconds = static_cast<uint32_t>(Microseconds / 1000000 + NTP_UNIX_EPOCH_OFFSET);
+            uint32_t Fraction = static_cast<uint32_t>(((static_cast<uint64_t>(Microseconds % 1000000)) << 32) / 1000000);
+            for (int i = 0; i < 4; i++) {
+                Stamp[i] = (Seconds >> (24 - 8 * i)) & 0xFF;
+                Stamp[4 + i] = (Fraction >> (24 - 8 * i)) & 0xFF;
+            }
+        }
+
+        std::vector<Host::UdpReply> Serve(const std::vector<uint8_t>& Request) {
+            PathDelay Path = Delays[std::min<size_t>(Requests, Delays.size() - 1)];
+            Requests++;
+
+            std::vector<uint8_t> Reply(NTP_PACKET_SIZE, 0);
+            Reply[0] = 0x24;    // LI = 0, VN = 4, Mode = 4 (server)
+            Reply[1] = 2;       // stratum
+            memcpy(&Reply[24], &Request[40], 8);
+            if (!EchoOriginate) {
+                Reply[31] ^= 0x01;
+            }
+            int64_t Stamp = ServerTime(esp_timer_get_time() + Path.Outbound);
+            WriteStamp(Stamp, &Reply[32]);
+            WriteStamp(Stamp, &Reply[40]);
+            return {{Reply, Path.Outbound + Path.Return}};
+        }
+
+        bool RunBurst() {
+            Client.StartBurst();
+            for (int Step = 0; Step < 20000; Step++) {
+                if (Client.Process()) {
+                    return true;
+                }
+                if (!Client.IsBurstActive()) {
+                    return false;
+                }
+                Host::RunFor(1000);
+            }
+            return false;
+        }
+};
+
+TEST_F(SntpClientTest, FirstBurstStepsToServerTime) {
+    ASSERT_TRUE(RunBurst());
+
+    EXPECT_TRUE(Client.IsSynchronized());
+    EXPECT_EQ(Requests, 4);
+    EXPECT_EQ(Client.GetLastDelay(), 10000);
+    EXPECT_NEAR(ClockError(), 0, 1);
+}
+
+TEST_F(SntpClientTest, ShortestRoundTripSampleIsUsed) {
+    // Asymmetric paths bias the offset by half the asymmetry, only the second
+    // sample is both symmetric and the fastest
+    Delays = {{30000, 10000}, {5000, 5000}, {40000, 2000}, {20000, 20000}};
+
+    ASSERT_TRUE(RunBurst());
+
+    EXPECT_EQ(Client.GetLastDelay(), 10000);
+    EXPECT_NEAR(ClockError(), 0, 1);
+}
+
+TEST_F(SntpClientTest, SmallOffsetIsSlewed) {
+    ASSERT_TRUE(RunBurst());
+    ServerOffset += 20000;
+
+    ASSERT_TRUE(RunBurst());
+    EXPECT_NEAR(Client.GetLastOffset(), 20000, 1);
+    EXPECT_NEAR(ClockError(), -20000, 1);
+
+    // 500 ppm: 10 ms per 20 s, then the slew is over
+    Host::RunFor(20 * 1000000LL);
+    EXPECT_NEAR(ClockError(), -10000, 1);
+    Host::RunFor(30 * 1000000LL);
+    EXPECT_NEAR(ClockError(), 0, 1);
+}
+
+TEST_F(SntpClientTest, LargeOffsetIsStepped) {
+    ASSERT_TRUE(RunBurst());
+    ServerOffset -= 1000000;
+
+    ASSERT_TRUE(RunBurst());
+    EXPECT_NEAR(Client.GetLastOffset(), -1000000, 1);
+    EXPECT_NEAR(ClockError(), 0, 1);
+}
+
+TEST_F(SntpClientTest, FrequencyErrorIsLearned) {
+    ServerRate = 100;
+    ASSERT_TRUE(RunBurst());
+
+    for (int Burst = 0; Burst < 30; Burst++) {
+        Host::RunFor(64 * 1000000LL);
+        ASSERT_TRUE(RunBurst());
+    }
+    EXPECT_NEAR(Client.GetFrequencyError(), 100, 2);
+
+    // Between bursts the clock now keeps the server rate
+    Host::RunFor(64 * 1000000LL);
+    EXPECT_NEAR(ClockError(), 0, 200);
+}
+
+TEST_F(SntpClientTest, SeededFrequencyErrorAppliesFromNow) {
+    ASSERT_TRUE(RunBurst());
+    int64_t Before = ClockError();
+
+    Client.SetFrequencyError(50);
+    EXPECT_FLOAT_EQ(Client.GetFrequencyError(), 50);
+    Host::RunFor(10 * 1000000LL);
+    EXPECT_NEAR(ClockError() - Before, 500, 1);
+
+    Client.SetFrequencyError(10000);
+    EXPECT_FLOAT_EQ(Client.GetFrequencyError(), 500);
+}
+
+TEST_F(SntpClientTest, SeedingDuringSlewKeepsTheRemainingSlew) {
+    ASSERT_TRUE(RunBurst());
+    ServerOffset += 20000;
+    ASSERT_TRUE(RunBurst());
+
+    Host::RunFor(10 * 1000000LL);
+    EXPECT_NEAR(ClockError(), -15000, 1);
+
+    // Only the 15 ms left are slewed after the rebase, not the full 20 ms again
+    Client.SetFrequencyError(0);
+    Host::RunFor(60 * 1000000LL);
+    EXPECT_NEAR(ClockError(), 0, 1);
+}
+
+TEST_F(SntpClientTest, ReplyToAnotherRequestIsIgnored) {
+    EchoOriginate = false;
+
+    EXPECT_FALSE(RunBurst());
+    EXPECT_FALSE(Client.IsSynchronized());
+    EXPECT_EQ(Requests, SNTP_MAX_BURST_SAMPLES);
+}
+
+TEST_F(SntpClientTest, AddressIsKeptBetweenBursts) {
+    ASSERT_TRUE(RunBurst());
+    ASSERT_TRUE(RunBurst());
+
+    EXPECT_EQ(Host::DnsLookups, 1);
+}
+
+TEST_F(SntpClientTest, BurstWithoutReplyResolvesAgain) {
+    ASSERT_TRUE(RunBurst());
+    EchoOriginate = false;
+    EXPECT_FALSE(RunBurst());
+    EchoOriginate = true;
+
+    ASSERT_TRUE(RunBurst());
+    EXPECT_EQ(Host::DnsLookups, 2);
+}
+
+TEST_F(SntpClientTest, FailedLookupIsRetriedAfterInterval) {
+    Host::DnsTable.clear();
+    Client.SetResolveRetryInterval(60000);
+
+    EXPECT_FALSE(RunBurst());
+    EXPECT_EQ(Host::DnsLookups, 1);
+
+    for (int Second = 1; Second < 60; Second++) {
+        Host::RunFor(1000000);
+        EXPECT_FALSE(RunBurst());
+    }
+    EXPECT_EQ(Host::DnsLookups, 1);
+    EXPECT_EQ(Requests, 0);
+
+    Host::DnsTable["pool.ntp.org"] = IPAddress(192, 0, 2, 1);
+    Host::RunFor(1000000);
+    EXPECT_TRUE(RunBurst());
+    EXPECT_EQ(Host::DnsLookups, 2);
+}
+
+TEST_F(SntpClientTest, NumericServerNeedsNoLookup) {
+    Client.SetServer("192.0.2.1");
+
+    ASSERT_TRUE(RunBurst());
+    EXPECT_EQ(Host::DnsLookups, 0);
+}
@@ -0,0 +1,31 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <WarmBootStore.h>
+
+static void CountSave(void* Context) {
+    (*reinterpret_cast<int*>(Context))++;
+}
+
+TEST(WarmBootStoreTest, RemovedCallbackIsNotCalledAndFreesItsEntry) {
+    WarmBootStore& Store = WarmBootStore::GetInstance();
+    int Saves[WARM_BOOT_MAX_CALLBACKS + 1] = {};
+
+    for (int i = 0; i < WARM_BOOT_MAX_CALLBACKS; i++) {
+        ASSERT_TRUE(Store.AddSaveCallback(CountSave, &Saves[i]));
+    }
+    EXPECT_FALSE(Store.AddSaveCallback(CountSave, &Saves[WARM_BOOT_MAX_CALLBACKS]));
+
+    Store.RemoveSaveCallback(CountSave, &Saves[3]);
+    EXPECT_TRUE(Store.AddSaveCallback(CountSave, &Saves[WARM_BOOT_MAX_CALLBACKS]));
+
+    Store.PrepareSleep();
+    for (int i = 0; i <= WARM_BOOT_MAX_CALLBACKS; i++) {
+        EXPECT_EQ(Saves[i], (i == 3) ? 0 : 1) << "callback " << i;
+    }
+
+    for (int i = 0; i <= WARM_BOOT_MAX_CALLBACKS; i++) {
+        Store.RemoveSaveCallback(CountSave, &Saves[i]);
+    }
+    Store.PrepareSleep();
+    EXPECT_EQ(Saves[0], 1);
+}
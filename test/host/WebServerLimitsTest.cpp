@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <WebServerHandler.h>
+
+// Requests are handed to the server by hand and stay in flight until the
+// test calls their disconnect handler, as the library does on release
+class WebServerLimitsTest : public ::testing::Test {
+    protected:
+        WebServerHandler* Server = nullptr;
+        std::vector<AsyncWebServerRequest*> Requests;
+        int UserDisconnects = 0;
+
+        void SetUp() override {
+            Server = new WebServerHandler();
+            Server->SetMaxConcurrentRequests(2);
+            Server->GetServer()->on("/slow", HTTP_GET, [](AsyncWebServerRequest* Request) {
+                Request->send(200, "text/plain", "ok");
+            });
+            // Overwrites the disconnect callback, as third-party handlers do
+            Server->GetServer()->on("/own", HTTP_GET, [this](AsyncWebServerRequest* Request) {
+                Request->onDisconnect([this]() { UserDisconnects++; });
+                Request->send(200, "text/plain", "ok");
+            });
+            Server->GetServer()->on("/chained", HTTP_GET, [this](AsyncWebServerRequest* Request) {
+                Server->OnRequestDisconnect(Request, [this]() { UserDisconnects++; });
+                Request->send(200, "text/plain", "ok");
+            });
+            Server->Start();
+        }
+
+        void TearDown() override {
+            for (AsyncWebServerRequest* Request : Requests) {
+                delete Request;
+            }
+            delete Server;
+        }
+
+        AsyncWebServerRequest* Get(const char* Url) {
+            AsyncWebServerRequest* Request = new AsyncWebServerRequest(HTTP_GET, Url);
+            Requests.push_back(Request);
+            Server->GetServer()->Handle(Request);
+            return Request;
+        }
+
+        static int Code(AsyncWebServerRequest* Request) {
+            return Request->Response ? Request->Response->Code : 0;
+        }
+
+        static void Release(AsyncWebServerRequest* Request) {
+            if (Request->DisconnectHandler) {
+                Request->DisconnectHandler();
+            }
+        }
+};
+
+TEST_F(WebServerLimitsTest, BusyServerAnswers503UntilASlotIsReleased) {
+    AsyncWebServerRequest* First = Get("/slow");
+    Get("/slow");
+    EXPECT_EQ(Code(Get("/slow")), 503);
+    EXPECT_EQ(Server->GetInFlightRequests(), 2u);
+
+    Release(First);
+    EXPECT_EQ(Server->GetInFlightRequests(), 1u);
+    EXPECT_EQ(Code(Get("/slow")), 200);
+}
+
+TEST_F(WebServerLimitsTest, ChainedCallbackRunsAfterTheRelease) {
+    AsyncWebServerRequest* Request = Get("/chained");
+    EXPECT_EQ(Code(Request), 200);
+
+    Release(Request);
+    EXPECT_EQ(UserDisconnects, 1);
+    EXPECT_EQ(Server->GetInFlightRequests(), 0u);
+}
+
+TEST_F(WebServerLimitsTest, ReplacedCallbackSlotIsReclaimedAfterTheTimeout) {
+    Server->SetRequestSlotTimeout(1000);
+    for (int i = 0; i < 2; i++) {
+        Release(Get("/own"));
+    }
+    EXPECT_EQ(UserDisconnects, 2);
+    EXPECT_EQ(Server->GetInFlightRequests(), 2u);
+    EXPECT_EQ(Code(Get("/slow")), 503);
+
+    Host::RunFor(1000000);
+    EXPECT_EQ(Code(Get("/slow")), 200);
+    EXPECT_EQ(Server->GetInFlightRequests(), 1u);
+    EXPECT_TRUE(Host::Logged("Request slot of * reclaimed"));
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <WebServerHandler.h>
+
+// The live task publishes every 250 ms of fake time. Signals have no filter
+// time, so Update() sets their filtered value at once
+class WebServerLiveDataTest : public ::testing::Test {
+    protected:
+        static constexpr int64_t Period = 250000;   // microseconds
+
+        WebServerHandler* Server = nullptr;
+        AsyncEventSource* Events = nullptr;
+        DigitalSignalHandler Door;
+        DigitalSignalHandler Pump;
+        AsyncEventSourceClient First;
+        AsyncEventSourceClient Second;
+
+        void SetUp() override {
+            for (DigitalSignalHandler* Signal : {&Door, &Pump}) {
+                Signal->SetName(Signal == &Door ? "door" : "pump");
+                Signal->Enable();
+                Signal->Update(false);
+            }
+
+            Server = new WebServerHandler();
+            Server->EnableLiveData("/live", 250);
+            Server->AddLiveSource(&Door);
+            Server->AddLiveSource(&Pump);
+            Server->Start();
+            Events = static_cast<AsyncEventSource*>(Server->GetServer()->Handlers.back());
+        }
+
+        void TearDown() override {
+            delete Server;
+        }
+
+        void Connect(AsyncEventSourceClient& Client) {
+            Events->ConnectHandler(&Client);
+        }
+
+        static std::vector<AsyncEventSourceClient::Message> Digital(const AsyncEventSourceClient& Client) {
+            std::vector<AsyncEventSourceClient::Message> Result;
+            for (const auto& Message : Client.Messages) {
+                if (Message.Event == "digital") {
+                    Result.push_back(Message);
+                }
+            }
+            return Result;
+        }
+
+        static bool Contains(const AsyncEventSourceClient::Message& Message, const char* Name, int Value) {
+            String Entry = String("{\"name\":\"") + Name + "\",\"value\":" + String(Value) + "}";
+            return Message.Data.indexOf(Entry) >= 0;
+        }
+
+        static bool Mentions(const AsyncEventSourceClient::Message& Message, const char* Name) {
+            return Message.Data.indexOf(String("\"name\":\"") + Name + "\"") >= 0;
+        }
+};
+
+TEST_F(WebServerLiveDataTest, NothingIsSentWithoutClients) {
+    Host::RunFor(10 * Period);
+
+    EXPECT_EQ(Server->GetLiveEventCount(), 0u);
+}
+
+TEST_F(WebServerLiveDataTest, NewClientGetsFullSnapshot) {
+    Connect(First);
+    Host::RunFor(Period);
+
+    auto Events = Digital(First);
+    ASSERT_EQ(Events.size(), 1u);
+    EXPECT_TRUE(Contains(Events[0], "door", 0));
+    EXPECT_TRUE(Contains(Events[0], "pump", 0));
+}
+
+TEST_F(WebServerLiveDataTest, UnchangedSignalsAreNotSentAgain) {
+    Connect(First);
+    Host::RunFor(Period);
+
+    Host::RunFor(8 * Period);
+    EXPECT_EQ(Digital(First).size(), 1u);
+}
+
+TEST_F(WebServerLiveDataTest, OnlyChangedSignalsAreSent) {
+    Connect(First);
+    Host::RunFor(Period);
+
+    Door.Update(true);
+    Host::RunFor(Period);
+
+    auto Events = Digital(First);
+    ASSERT_EQ(Events.size(), 2u);
+    EXPECT_TRUE(Contains(Events[1], "door", 1));
+    EXPECT_FALSE(Mentions(Events[1], "pump"));
+}
+
+TEST_F(WebServerLiveDataTest, ChangesWithinPeriodAreCoalesced) {
+    Connect(First);
+    Host::RunFor(Period);
+
+    // Several edges in one period make one event with the last value
+    Door.Update(true);
+    Door.Update(false);
+    Door.Update(true);
+    Pump.Update(true);
+    Pump.Update(false);
+    Host::RunFor(Period);
+
+    auto Events = Digital(First);
+    ASSERT_EQ(Events.size(), 2u);
+    EXPECT_TRUE(Contains(Events[1], "door", 1));
+    EXPECT_FALSE(Mentions(Events[1], "pump"));   // back to the value already sent
+}
+
+TEST_F(WebServerLiveDataTest, BackedUpClientIsSkippedThenResynchronized) {
+    Connect(First);
+    Connect(Second);
+    Host::RunFor(Period);
+    ASSERT_EQ(Digital(Second).size(), 1u);
+
+    Second.Waiting = 4;
+    Door.Update(true);
+    Host::RunFor(Period);
+
+    EXPECT_EQ(Digital(First).size(), 2u);
+    EXPECT_EQ(Digital(Second).size(), 1u);
+    EXPECT_EQ(Server->GetLiveSkippedCount(), 1u);
+
+    // The change it missed comes with the full snapshot of the next period
+    Second.Waiting = 0;
+    Host::RunFor(Period);
+
+    auto Events = Digital(Second);
+    ASSERT_EQ(Events.size(), 2u);
+    EXPECT_TRUE(Contains(Events[1], "door", 1));
+    EXPECT_TRUE(Contains(Events[1], "pump", 0));
+}
+
+TEST_F(WebServerLiveDataTest, LateClientTriggersSnapshot) {
+    Connect(First);
+    Host::RunFor(Period);
+    Door.Update(true);
+    Host::RunFor(Period);
+
+    Connect(Second);
+    Host::RunFor(Period);
+
+    auto Events = Digital(Second);
+    ASSERT_EQ(Events.size(), 1u);
+    EXPECT_TRUE(Contains(Events[0], "door", 1));
+    EXPECT_TRUE(Contains(Events[0], "pump", 0));
+}
+
+TEST_F(WebServerLiveDataTest, DisconnectedClientIsNotSent) {
+    Connect(First);
+    Connect(Second);
+    Host::RunFor(Period);
+
+    Events->DisconnectHandler(&Second);
+    EXPECT_EQ(Server->GetLiveClientCount(), 1u);
+    Door.Update(true);
+    Host::RunFor(Period);
+
+    EXPECT_EQ(Digital(First).size(), 2u);
+    EXPECT_EQ(Digital(Second).size(), 1u);
+}
+
+TEST_F(WebServerLiveDataTest, EventIdsIncrease) {
+    Connect(First);
+    Host::RunFor(Period);
+    Door.Update(true);
+    Host::RunFor(Period);
+
+    auto Events = Digital(First);
+    ASSERT_EQ(Events.size(), 2u);
+    EXPECT_LT(Events[0].Id, Events[1].Id);
+}
+
+// The task is not deleted from outside while it may hold the client list
+TEST_F(WebServerLiveDataTest, DeleteWaitsForTheLiveTaskToStop) {
+    Connect(First);
+    Host::RunFor(Period + Period / 2);
+    size_t Tasks = Host::GetTaskCount();
+    int64_t Before = esp_timer_get_time();
+
+    delete Server;
+    Server = nullptr;
+
+    EXPECT_EQ(Host::GetTaskCount(), Tasks - 1);
+    EXPECT_EQ(esp_timer_get_time(), Before + Period / 2);
+}
@@ -0,0 +1,207 @@
+// WebServerHandler on a real socket, for tools/load_test.py --loopback. The
+// requests go through the same limits middleware, route timing and metrics
+// as on the device; only the transport is replaced: a single-threaded poll()
+// loop, like the async_tcp task, that keeps every accepted request in flight
+// for the service time before writing its response and releasing it.
+//
+//   WebServerLoopback [--port N] [--max-concurrent N] [--service-time ms]
+
+#include "HostRuntime.h"
+#include <WebServerHandler.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <string>
+
+struct LoopbackConnection {
+    int Socket;
+    std::string Input;
+    std::string Output;
+    AsyncWebServerRequest* Request = nullptr;
+    int64_t ReadyTime = 0;            // fake clock, microseconds
+    bool Close = false;
+};
+
+static int64_t MonotonicMicroseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const char* Reason(int Code) {
+    switch (Code) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 503: return "Service Unavailable";
+        default:  return "Unknown";
+    }
+}
+
+// Parses the request head, returns false while it is incomplete
+static bool Dispatch(WebServerHandler& Server, LoopbackConnection& Connection, int64_t ServiceTime) {
+    size_t End = Connection.Input.find("\r\n\r\n");
+    if (End == std::string::npos) {
+        return false;
+    }
+    std::string Head = Connection.Input.substr(0, End);
+    Connection.Input.erase(0, End + 4);
+
+    size_t LineEnd = Head.find("\r\n");
+    std::string RequestLine = Head.substr(0, LineEnd);
+    size_t PathStart = RequestLine.find(' ') + 1;
+    std::string Path = RequestLine.substr(PathStart, RequestLine.find(' ', PathStart) - PathStart);
+
+    AsyncWebServerRequest* Request = new AsyncWebServerRequest(HTTP_GET, Path.c_str());
+    for (size_t Start = LineEnd; Start != std::string::npos && Start + 2 < Head.size(); ) {
+        size_t Next = Head.find("\r\n", Start + 2);
+        std::string Line = Head.substr(Start + 2, (Next == std::string::npos ? Head.size() : Next) - Start - 2);
+        size_t Colon = Line.find(':');
+        if (Colon != std::string::npos) {
+            std::string Name = Line.substr(0, Colon);
+            std::string Value = Line.substr(Line.find_first_not_of(' ', Colon + 1));
+            Request->Headers[Name] = Value.c_str();
+            if ((strcasecmp(Name.c_str(), "Connection") == 0) && (strcasecmp(Value.c_str(), "close") == 0)) {
+                Connection.Close = true;
+            }
+        }
+        Start = Next;
+    }
+
+    Server.GetServer()->Handle(Request);
+
+    AsyncWebServerResponse* Response = Request->Response;
+    int Code = Response ? Response->Code : 500;
+    std::string Body = Response ? std::string(Response->Content.c_str(), Response->Content.length()) : std::string();
+    std::string Output = "HTTP/1.1 " + std::to_string(Code) + " " + Reason(Code) + "\r\n";
+    if (Response) {
+        if (Response->ContentType.length() > 0) {
+            Output += "Content-Type: " + std::string(Response->ContentType.c_str()) + "\r\n";
+        }
+        for (const auto& Header : Response->Headers) {
+            Output += Header.first + ": " + Header.second.c_str() + "\r\n";
+        }
+    }
+    Output += "Content-Length: " + std::to_string(Body.size()) + "\r\n";
+    Output += Connection.Close ? "Connection: close\r\n\r\n" : "\r\n";
+    Connection.Output = Output + Body;
+
+    // A rejected request is answered at once, an accepted one holds its slot
+    Connection.Request = Request;
+    Connection.ReadyTime = esp_timer_get_time() + ((Code == 503) ? 0 : ServiceTime);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int Port = 0;
+    size_t MaxConcurrent = 6;
+    int64_t ServiceTime = 5000;       // microseconds
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--port") == 0) Port = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--max-concurrent") == 0) MaxConcurrent = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--service-time") == 0) ServiceTime = static_cast<int64_t>(atof(argv[i + 1]) * 1000);
+    }
+
+    WebServerHandler Server;
+    Server.SetMaxConcurrentRequests(MaxConcurrent);
+    Server.GetServer()->on("/", HTTP_GET, [](AsyncWebServerRequest* Request) {
+        Request->send(200, "text/plain", "ok\n");
+    });
+    Server.AddRoutePattern("/");
+    Server.EnableMetrics("/metrics");
+    Server.Start();
+
+    int Listener = socket(AF_INET, SOCK_STREAM, 0);
+    int Reuse = 1;
+    setsockopt(Listener, SOL_SOCKET, SO_REUSEADDR, &Reuse, sizeof(Reuse));
+    sockaddr_in Address = {};
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port = htons(Port);
+    socklen_t AddressLength = sizeof(Address);
+    if ((bind(Listener, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) < 0) || (listen(Listener, 64) < 0)) {
+        perror("WebServerLoopback");
+        return 1;
+    }
+    getsockname(Listener, reinterpret_cast<sockaddr*>(&Address), &AddressLength);
+    printf("Listening on 127.0.0.1:%d\n", ntohs(Address.sin_port));
+    fflush(stdout);
+
+    // The fake clock follows the wall clock, so latency and slot timeouts are real
+    std::list<LoopbackConnection> Connections;
+    int64_t LastTime = MonotonicMicroseconds();
+    while (true) {
+        std::vector<pollfd> Descriptors = {{Listener, POLLIN, 0}};
+        for (LoopbackConnection& Connection : Connections) {
+            bool Writing = (Connection.Request != nullptr) && (esp_timer_get_time() >= Connection.ReadyTime);
+            Descriptors.push_back({Connection.Socket, static_cast<short>(Writing ? POLLOUT : (Connection.Request ? 0 : POLLIN)), 0});
+        }
+        poll(Descriptors.data(), Descriptors.size(), 1);
+
+        int64_t Now = MonotonicMicroseconds();
+        Host::RunFor(Now - LastTime);
+        LastTime = Now;
+
+        if (Descriptors[0].revents & POLLIN) {
+            int Socket = accept(Listener, nullptr, nullptr);
+            if (Socket >= 0) {
+                Connections.push_back({Socket});
+            }
+        }
+
+        size_t Index = 1;
+        for (auto Iterator = Connections.begin(); Iterator != Connections.end(); Index++) {
+            LoopbackConnection& Connection = *Iterator;
+            short Events = (Index < Descriptors.size()) ? Descriptors[Index].revents : 0;
+            bool Closed = false;
+
+            if (Events & (POLLIN | POLLHUP | POLLERR)) {
+                char Buffer[2048];
+                ssize_t Length = read(Connection.Socket, Buffer, sizeof(Buffer));
+                if (Length <= 0) {
+                    Closed = true;
+                } else {
+                    Connection.Input.append(Buffer, Length);
+                }
+            }
+            if (!Closed && (Connection.Request == nullptr)) {
+                Dispatch(Server, Connection, ServiceTime);
+            }
+            if (!Closed && (Events & POLLOUT)) {
+                ssize_t Length = write(Connection.Socket, Connection.Output.data(), Connection.Output.size());
+                if (Length < 0) {
+                    Closed = true;
+                } else {
+                    Connection.Output.erase(0, Length);
+                }
+                // The library frees the request, and calls its disconnect
+                // handler, once the response is sent
+                if (!Closed && Connection.Output.empty()) {
+                    if (Connection.Request->DisconnectHandler) {
+                        Connection.Request->DisconnectHandler();
+                    }
+                    delete Connection.Request;
+                    Connection.Request = nullptr;
+                    Closed = Connection.Close;
+                }
+            }
+
+            if (Closed) {
+                if ((Connection.Request != nullptr) && Connection.Request->DisconnectHandler) {
+                    Connection.Request->DisconnectHandler();
+                }
+                delete Connection.Request;
+                close(Connection.Socket);
+                Iterator = Connections.erase(Iterator);
+            } else {
+                ++Iterator;
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <WebServerHandler.h>
+
+class WebServerStaticAssetsTest : public ::testing::Test {
+    protected:
+        WebServerHandler* Server = nullptr;
+        std::vector<AsyncWebServerRequest*> Requests;
+
+        void SetUp() override {
+            Host::ResetFileSystem();
+            ASSERT_TRUE(LittleFSHandler::GetInstance().Init());
+            Host::Directories.push_back("/www");
+            Write("/www/index.html", "<html></html>");
+            Write("/www/app.js", "plain();");
+            Write("/www/app.3f2a9c1b.js", "hashed();");
+            Write("/www/index-BxT5aK3d.css", "body {}");
+            Write("/www/bootstrap.css", "body {}");
+
+            Server = new WebServerHandler();
+            Server->ServeStaticAssets("/", "/www");
+            Server->Start();
+        }
+
+        void TearDown() override {
+            for (AsyncWebServerRequest* Request : Requests) {
+                delete Request;
+            }
+            delete Server;
+        }
+
+        static void Write(const char* Path, const char* Content) {
+            Host::Files[Path] = std::vector<uint8_t>(Content, Content + strlen(Content));
+        }
+
+        AsyncWebServerRequest* Get(const char* Url, const String& IfNoneMatch = "") {
+            AsyncWebServerRequest* Request = new AsyncWebServerRequest(HTTP_GET, Url);
+            if (IfNoneMatch.length() > 0) {
+                Request->Headers["If-None-Match"] = IfNoneMatch;
+            }
+            Requests.push_back(Request);
+            Server->GetServer()->Handle(Request);
+            return Request;
+        }
+
+        static String Header(AsyncWebServerRequest* Request, const char* Name) {
+            return Request->Response ? Request->Response->Headers[Name] : String();
+        }
+};
+
+TEST_F(WebServerStaticAssetsTest, OnlyHashedNamesAreCachedForAYear) {
+    EXPECT_STREQ(Header(Get("/"), "Cache-Control").c_str(), "no-cache");
+    EXPECT_STREQ(Header(Get("/app.js"), "Cache-Control").c_str(), "public, max-age=300");
+    EXPECT_STREQ(Header(Get("/bootstrap.css"), "Cache-Control").c_str(), "public, max-age=300");
+    EXPECT_STREQ(Header(Get("/app.3f2a9c1b.js"), "Cache-Control").c_str(), "public, max-age=31536000, immutable");
+    EXPECT_STREQ(Header(Get("/index-BxT5aK3d.css"), "Cache-Control").c_str(), "public, max-age=31536000, immutable");
+}
+
+TEST_F(WebServerStaticAssetsTest, UnhashedAssetIsRevalidatedWithItsETag) {
+    AsyncWebServerRequest* First = Get("/app.js");
+    ASSERT_EQ(First->Response->Code, 200);
+    String ETag = Header(First, "ETag");
+    ASSERT_GT(ETag.length(), 0u);
+
+    AsyncWebServerRequest* Again = Get("/app.js", ETag);
+    EXPECT_EQ(Again->Response->Code, 304);
+    EXPECT_STREQ(Header(Again, "Cache-Control").c_str(), "public, max-age=300");
+    EXPECT_EQ(Server->GetStaticAssets()->GetNotModifiedCount(), 1u);
+}
@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include "HostRuntime.h"
+#include <WifiHandler.h>
+
+static std::string Scrape() {
+    MetricsCursor Cursor;
+    uint8_t Buffer[4096];
+    std::string Text;
+    size_t Length;
+    while ((Length = MetricsRegistry::GetInstance().Render(Cursor, Buffer, sizeof(Buffer))) > 0) {
+        Text.append(reinterpret_cast<char*>(Buffer), Length);
+    }
+    return Text;
+}
+
+// The link is driven by hand: the test sets the address the access point
+// hands out and raises the events the core would
+class WifiHandlerTest : public ::testing::Test {
+    protected:
+        WifiHandler* Wifi = nullptr;
+
+        void SetUp() override {
+            WiFi.Reset();
+            Preferences::Storage().clear();
+            WarmBootStore::GetInstance().Clear();
+
+            Wifi = new WifiHandler();
+            Wifi->SetSSIDAndPassword("plant", "secret");
+            Wifi->SetPostConnectionDelay(100);
+        }
+
+        void TearDown() override {
+            delete Wifi;
+        }
+
+        void GrantAddress() {
+            WiFi.LocalIP = IPAddress(192, 168, 1, 50);
+            WiFi.Gateway = IPAddress(192, 168, 1, 1);
+            WiFi.Subnet = IPAddress(255, 255, 255, 0);
+            WiFi.Dns = IPAddress(192, 168, 1, 1);
+            WiFi.RaiseEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+        }
+};
+
+TEST_F(WifiHandlerTest, ConnectsOnceTheAddressIsAssigned) {
+    Wifi->Enable();
+    Host::RunFor(10000);
+    ASSERT_EQ(WiFi.Begins.size(), 1u);
+    EXPECT_STREQ(WiFi.Begins[0].Ssid.c_str(), "plant");
+    EXPECT_FALSE(WiFi.Begins[0].Directed);
+    EXPECT_FALSE(Wifi->IsConnected());
+
+    GrantAddress();
+    Host::RunFor(200000);
+    EXPECT_TRUE(Wifi->IsConnected());
+    EXPECT_EQ(Wifi->GetConnectionAttemptCount(), 1u);
+}
+
+TEST_F(WifiHandlerTest, LostLinkIsCountedAndRetried) {
+    Wifi->Enable();
+    Host::RunFor(10000);
+    GrantAddress();
+    Host::RunFor(200000);
+    ASSERT_TRUE(Wifi->IsConnected());
+
+    WiFi.RaiseEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, 200);
+    Host::RunFor(10000);
+    EXPECT_FALSE(Wifi->IsConnected());
+    EXPECT_EQ(Wifi->GetDisconnectionCount(), 1u);
+    EXPECT_EQ(Wifi->GetLastDisconnectionReason(), 200);
+    EXPECT_EQ(WiFi.Begins.size(), 2u);
+}
+
+// A scrape after the delete must neither read the task nor call the collector
+TEST_F(WifiHandlerTest, DeleteUnregistersTaskAndCollector) {
+    Wifi->Enable();
+    Host::RunFor(10000);
+    delete Wifi;
+    Wifi = nullptr;
+
+    MetricsRegistry::GetInstance().AddGauge("wifi_connected", "")->Set(7);
+    EXPECT_NE(Scrape().find("wifi_connected 7\n"), std::string::npos);
+}
+
+// A warm boot reuses the leased address for the association, then the DHCP
+// client takes over and the renewed lease updates the cache
+TEST_F(WifiHandlerTest, CachedLeaseBridgesTheAssociationOnly) {
+    Wifi->SetFastReconnect(true);
+    Wifi->Enable();
+    Host::RunFor(10000);
+    WiFi.LeaseTime = 3600;
+    GrantAddress();
+    Host::RunFor(200000);
+    ASSERT_TRUE(Wifi->IsConnected());
+
+    delete Wifi;
+    WiFi.Reset();
+    Wifi = new WifiHandler();
+    Wifi->SetSSIDAndPassword("plant", "secret");
+    Wifi->SetPostConnectionDelay(100);
+    Wifi->SetFastReconnect(true);
+    Wifi->Enable();
+    Host::RunFor(10000);
+
+    ASSERT_EQ(WiFi.Begins.size(), 1u);
+    EXPECT_TRUE(WiFi.Begins[0].Directed);
+    ASSERT_EQ(WiFi.Configs.size(), 1u);
+    EXPECT_EQ(WiFi.Configs[0].LocalIP, IPAddress(192, 168, 1, 50));
+
+    WiFi.LeaseTime = 0;
+    GrantAddress();
+    Host::RunFor(10000);
+    ASSERT_EQ(WiFi.Configs.size(), 2u);
+    EXPECT_EQ(WiFi.Configs[1].LocalIP, INADDR_NONE);
+
+    WiFi.LeaseTime = 7200;
+    GrantAddress();
+    Host::RunFor(200000);
+    EXPECT_TRUE(Wifi->IsConnected());
+    EXPECT_EQ(WiFi.Configs.size(), 2u);
+}
+
+// Without a running lease the directed association still skips the scan, but asks DHCP
+TEST_F(WifiHandlerTest, CachedAddressIsNotReusedWithoutALease) {
+    Wifi->SetFastReconnect(true);
+    Wifi->Enable();
+    Host::RunFor(10000);
+    WiFi.LeaseTime = 3600;
+    GrantAddress();
+    Host::RunFor(200000);
+    ASSERT_TRUE(Wifi->IsConnected());
+
+    // A cold boot finds only the NVS copy, which stores no expiry
+    delete Wifi;
+    WiFi.Reset();
+    WarmBootStore::GetInstance().Clear();
+    Wifi = new WifiHandler();
+    Wifi->SetSSIDAndPassword("plant", "secret");
+    Wifi->SetFastReconnect(true);
+    Wifi->Enable();
+    Host::RunFor(10000);
+
+    ASSERT_EQ(WiFi.Begins.size(), 1u);
+    EXPECT_TRUE(WiFi.Begins[0].Directed);
+    ASSERT_EQ(WiFi.Configs.size(), 1u);
+    EXPECT_EQ(WiFi.Configs[0].LocalIP, INADDR_NONE);
+
+    GrantAddress();
+    Host::RunFor(10000);
+    EXPECT_EQ(WiFi.Configs.size(), 1u);
+}
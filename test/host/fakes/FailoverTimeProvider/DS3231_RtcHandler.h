@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// A DS3231 counting whole seconds from the fake clock. Valid = false stands
+// for a failed read or a stopped oscillator, both make ReadEpochTime() fail
+class DS3231_RtcHandler {
+    public:
+        bool Enabled = true;
+        bool Valid = true;
+        std::vector<uint32_t> Writes;
+
+        void SetTime(int64_t EpochMicroseconds) {
+            Offset = EpochMicroseconds - esp_timer_get_time();
+        }
+        int64_t GetTime() const {
+            return Offset + esp_timer_get_time();
+        }
+
+        bool IsEnabled() const { return Enabled; }
+
+        bool ReadEpochTime(uint32_t& epoch) {
+            if (!Valid) {
+                return false;
+            }
+            epoch = static_cast<uint32_t>(GetTime() / 1000000);
+            return true;
+        }
+
+        void SetEpochTime(uint32_t epoch) {
+            Writes.push_back(epoch);
+            SetTime(static_cast<int64_t>(epoch) * 1000000);
+            Valid = true;
+        }
+
+    private:
+        int64_t Offset = 0;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Arduino.h>
+#include "DateTimeProvider.h"
+
+// What FailoverTimeProvider reads from NtpHandler, set by the test
+class NtpHandler : public DateTimeProvider {
+    public:
+        bool Connected = false;
+        float FrequencyError = 0;   // ppm
+
+        void Synchronize(int64_t EpochMicroseconds) {
+            SetTimeBase(EpochMicroseconds, esp_timer_get_time(), static_cast<int32_t>(FrequencyError * 1000));
+        }
+
+        bool IsConnected() { return Connected; }
+        float GetFrequencyError() { return FrequencyError; }
+        String GetFormattedTime(const String&) override { return ""; }
+};
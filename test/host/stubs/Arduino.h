@@ -0,0 +1,179 @@
+#pragma once
+
+// Host build of the Arduino-ESP32 core: the types and calls the libraries
+// use, on top of the cooperative scheduler and fake clock of HostRuntime.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <ctime>
+#include <type_traits>
+#include "WString.h"
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+#define constrain(Value, Low, High) ((Value) < (Low) ? (Low) : ((Value) > (High) ? (High) : (Value)))
+
+// From newlib on the device, older glibc lacks it
+inline size_t HostStrlcpy(char* Destination, const char* Source, size_t Size) {
+    size_t Length = strlen(Source);
+    if (Size > 0) {
+        size_t Copied = (Length < Size - 1) ? Length : Size - 1;
+        memcpy(Destination, Source, Copied);
+        Destination[Copied] = '\0';
+    }
+    return Length;
+}
+#define strlcpy HostStrlcpy
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+// ----------------------------
+//    FreeRTOS
+// ----------------------------
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void (*TaskFunction_t)(void*);
+typedef struct HostTask* TaskHandle_t;
+typedef struct HostQueue* QueueHandle_t;
+typedef struct HostQueue* SemaphoreHandle_t;
+
+#define pdTRUE                1
+#define pdFALSE               0
+#define pdPASS                pdTRUE
+#define pdFAIL                pdFALSE
+#define portMAX_DELAY         0xFFFFFFFFUL
+#define portTICK_PERIOD_MS    1
+#define pdMS_TO_TICKS(Ms)     (static_cast<TickType_t>(Ms))
+#define configMAX_PRIORITIES  25
+#define tskNO_AFFINITY        0x7FFFFFFF
+
+// Tasks run one at a time, critical sections have nothing to exclude
+typedef struct { int Unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED  {0}
+#define portENTER_CRITICAL(Mux)       ((void)(Mux))
+#define portEXIT_CRITICAL(Mux)        ((void)(Mux))
+#define portENTER_CRITICAL_ISR(Mux)   ((void)(Mux))
+#define portEXIT_CRITICAL_ISR(Mux)    ((void)(Mux))
+#define portENTER_CRITICAL_SAFE(Mux)  ((void)(Mux))
+#define portEXIT_CRITICAL_SAFE(Mux)   ((void)(Mux))
+#define portYIELD_FROM_ISR(...)       ((void)0)
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t Function, const char* Name, uint32_t StackDepth, void* Parameter, UBaseType_t Priority, TaskHandle_t* Handle, BaseType_t Core);
+BaseType_t xTaskCreate(TaskFunction_t Function, const char* Name, uint32_t StackDepth, void* Parameter, UBaseType_t Priority, TaskHandle_t* Handle);
+void vTaskDelete(TaskHandle_t Task);
+void vTaskDelay(TickType_t Ticks);
+void vTaskSuspend(TaskHandle_t Task);
+void vTaskResume(TaskHandle_t Task);
+void vTaskPrioritySet(TaskHandle_t Task, UBaseType_t Priority);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t Task);
+
+QueueHandle_t xQueueCreate(UBaseType_t Length, UBaseType_t ItemSize);
+void vQueueDelete(QueueHandle_t Queue);
+BaseType_t xQueueSend(QueueHandle_t Queue, const void* Item, TickType_t Wait);
+BaseType_t xQueueSendFromISR(QueueHandle_t Queue, const void* Item, BaseType_t* Woken);
+BaseType_t xQueueReceive(QueueHandle_t Queue, void* Item, TickType_t Wait);
+BaseType_t xQueueReset(QueueHandle_t Queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t Queue);
+#define xQueueSendToBack xQueueSend
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t Semaphore, TickType_t Wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t Semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t Semaphore);
+
+// ----------------------------
+//    Arduino
+// ----------------------------
+
+#define LOW           0
+#define HIGH          1
+#define INPUT         0x01
+#define OUTPUT        0x03
+#define INPUT_PULLUP  0x05
+#define RISING        0x01
+#define FALLING       0x02
+#define CHANGE        0x03
+
+#define digitalPinToInterrupt(Pin)  (Pin)
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t Milliseconds);
+void yield();
+
+void pinMode(uint8_t Pin, uint8_t Mode);
+int digitalRead(uint8_t Pin);
+void digitalWrite(uint8_t Pin, uint8_t Value);
+void attachInterruptArg(uint8_t Pin, void (*Handler)(void*), void* Argument, int Mode);
+void detachInterrupt(uint8_t Pin);
+
+class IPAddress {
+    public:
+        IPAddress() {}
+        IPAddress(uint8_t A, uint8_t B, uint8_t C, uint8_t D) : Bytes{A, B, C, D} {}
+        IPAddress(uint32_t Address) { memcpy(Bytes, &Address, sizeof(Bytes)); }
+        operator uint32_t() const {
+            uint32_t Address;
+            memcpy(&Address, Bytes, sizeof(Address));
+            return Address;
+        }
+
+        bool fromString(const String& Text) {
+            unsigned int A, B, C, D;
+            char Tail;
+            if ((sscanf(Text.c_str(), "%u.%u.%u.%u%c", &A, &B, &C, &D, &Tail) != 4) || (A > 255) || (B > 255) || (C > 255) || (D > 255)) {
+                return false;
+            }
+            *this = IPAddress(A, B, C, D);
+            return true;
+        }
+        String toString() const {
+            return String(Bytes[0]) + "." + String(Bytes[1]) + "." + String(Bytes[2]) + "." + String(Bytes[3]);
+        }
+        bool operator==(const IPAddress& Other) const { return memcmp(Bytes, Other.Bytes, sizeof(Bytes)) == 0; }
+        bool operator!=(const IPAddress& Other) const { return !(*this == Other); }
+        uint8_t operator[](int Index) const { return Bytes[Index]; }
+
+    private:
+        uint8_t Bytes[4] = {0, 0, 0, 0};
+};
+
+class HardwareSerial {
+    public:
+        void begin(unsigned long) {}
+        size_t print(const String& Text) { return fputs(Text.c_str(), stdout) >= 0 ? Text.length() : 0; }
+        size_t println(const String& Text = "") { return print(Text + "\n"); }
+        int printf(const char* Format, ...) {
+            va_list Arguments;
+            va_start(Arguments, Format);
+            int Written = vprintf(Format, Arguments);
+            va_end(Arguments);
+            return Written;
+        }
+};
+
+extern HardwareSerial Serial;
+
+// The host has nothing to restart into
+class EspClass {
+    public:
+        void restart() {}
+};
+
+extern EspClass ESP;
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include <Arduino.h>
+
+#define U_FLASH   0
+#define U_SPIFFS  100
+
+typedef enum {
+    OTA_AUTH_ERROR,
+    OTA_BEGIN_ERROR,
+    OTA_CONNECT_ERROR,
+    OTA_RECEIVE_ERROR,
+    OTA_END_ERROR
+} ota_error_t;
+
+// No uploads reach the host, the callbacks are only stored
+class ArduinoOTAClass {
+    public:
+        typedef std::function<void()> THandlerFunction;
+        typedef std::function<void(ota_error_t)> THandlerFunction_Error;
+        typedef std::function<void(unsigned int, unsigned int)> THandlerFunction_Progress;
+
+        ArduinoOTAClass& setHostname(const char*) { return *this; }
+        ArduinoOTAClass& setPassword(const char*) { return *this; }
+        ArduinoOTAClass& setPort(uint16_t) { return *this; }
+        ArduinoOTAClass& onStart(THandlerFunction Function) { Start = Function; return *this; }
+        ArduinoOTAClass& onEnd(THandlerFunction Function) { End = Function; return *this; }
+        ArduinoOTAClass& onError(THandlerFunction_Error Function) { Error = Function; return *this; }
+        ArduinoOTAClass& onProgress(THandlerFunction_Progress Function) { Progress = Function; return *this; }
+        void begin() {}
+        void handle() {}
+        int getCommand() { return U_FLASH; }
+
+        // Test side
+        THandlerFunction Start;
+        THandlerFunction End;
+        THandlerFunction_Error Error;
+        THandlerFunction_Progress Progress;
+};
+
+inline ArduinoOTAClass ArduinoOTA;
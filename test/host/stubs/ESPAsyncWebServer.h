@@ -0,0 +1,191 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <vector>
+#include <Arduino.h>
+#include <LittleFS.h>
+
+// The parts of ESPAsyncWebServer v3 the libraries use. Nothing goes on the
+// network: requests are objects the test builds and hands to the handlers,
+// responses and events are recorded for the test to inspect
+
+typedef enum {
+    HTTP_GET     = 0b00000001,
+    HTTP_POST    = 0b00000010,
+    HTTP_DELETE  = 0b00000100,
+    HTTP_PUT     = 0b00001000,
+    HTTP_PATCH   = 0b00010000,
+    HTTP_HEAD    = 0b00100000,
+    HTTP_OPTIONS = 0b01000000,
+    HTTP_ANY     = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServerResponse {
+    public:
+        AsyncWebServerResponse(int Code, const String& ContentType = "", const String& Content = "")
+            : Code(Code), ContentType(ContentType), Content(Content) {}
+        virtual ~AsyncWebServerResponse() {}
+
+        void addHeader(const String& Name, const String& Value) { Headers[Name.c_str()] = Value; }
+
+        int Code;
+        String ContentType;
+        String Content;
+        String FilePath;
+        std::map<std::string, String> Headers;
+};
+
+typedef std::function<size_t(uint8_t* Buffer, size_t MaxLength, size_t Index)> AwsResponseFiller;
+
+class AsyncWebServerRequest {
+    public:
+        AsyncWebServerRequest(WebRequestMethodComposite Method, const String& Url) : Method(Method), Url(Url) {}
+        ~AsyncWebServerRequest() { delete Response; }
+
+        WebRequestMethodComposite method() const { return Method; }
+        const String& url() const { return Url; }
+        size_t contentLength() const { return ContentLength; }
+        bool hasHeader(const char* Name) const { return Headers.count(Name) > 0; }
+        String header(const char* Name) const { return hasHeader(Name) ? Headers.at(Name) : String(); }
+
+        AsyncWebServerResponse* beginResponse(int Code, const String& ContentType = "", const String& Content = "") {
+            return new AsyncWebServerResponse(Code, ContentType, Content);
+        }
+        AsyncWebServerResponse* beginResponse(LittleFSFS&, const String& Path, const String& ContentType) {
+            AsyncWebServerResponse* Result = new AsyncWebServerResponse(200, ContentType);
+            Result->FilePath = Path;
+            return Result;
+        }
+        AsyncWebServerResponse* beginChunkedResponse(const String& ContentType, AwsResponseFiller Filler) {
+            AsyncWebServerResponse* Result = new AsyncWebServerResponse(200, ContentType);
+            uint8_t Buffer[1024];
+            size_t Length;
+            for (size_t Index = 0; (Length = Filler(Buffer, sizeof(Buffer), Index)) > 0; Index += Length) {
+                Result->Content.concat(reinterpret_cast<const char*>(Buffer), Length);
+            }
+            return Result;
+        }
+
+        void send(AsyncWebServerResponse* Sent) { delete Response; Response = Sent; }
+        void send(int Code, const String& ContentType = "", const String& Content = "") { send(beginResponse(Code, ContentType, Content)); }
+
+        void onDisconnect(std::function<void()> Handler) { DisconnectHandler = Handler; }
+
+        // Test side
+        WebRequestMethodComposite Method;
+        String Url;
+        size_t ContentLength = 0;
+        std::map<std::string, String> Headers;
+        AsyncWebServerResponse* Response = nullptr;
+        std::function<void()> DisconnectHandler;
+};
+
+typedef std::function<void(AsyncWebServerRequest* Request)> ArRequestHandlerFunction;
+typedef std::function<void()> ArMiddlewareNext;
+
+class AsyncWebHandler {
+    public:
+        virtual ~AsyncWebHandler() {}
+        virtual bool canHandle(AsyncWebServerRequest* Request) const { return false; }
+        virtual void handleRequest(AsyncWebServerRequest* Request) {}
+};
+
+class AsyncMiddleware {
+    public:
+        virtual ~AsyncMiddleware() {}
+        virtual void run(AsyncWebServerRequest* Request, ArMiddlewareNext Next) = 0;
+};
+
+class AsyncMiddlewareFunction : public AsyncMiddleware {
+    public:
+        AsyncMiddlewareFunction(std::function<void(AsyncWebServerRequest*, ArMiddlewareNext)> Function) : Function(Function) {}
+        void run(AsyncWebServerRequest* Request, ArMiddlewareNext Next) override { Function(Request, Next); }
+
+    private:
+        std::function<void(AsyncWebServerRequest*, ArMiddlewareNext)> Function;
+};
+
+class AsyncEventSourceClient {
+    public:
+        struct Message {
+            String Data;
+            String Event;
+            uint32_t Id;
+        };
+
+        size_t packetsWaiting() const { return Waiting; }
+        void send(const char* Data, const char* Event = nullptr, uint32_t Id = 0) { Messages.push_back({Data, Event ? Event : "", Id}); }
+
+        // Test side
+        size_t Waiting = 0;
+        std::vector<Message> Messages;
+};
+
+typedef std::function<void(AsyncEventSourceClient* Client)> ArEventHandlerFunction;
+
+class AsyncEventSource : public AsyncWebHandler {
+    public:
+        AsyncEventSource(const String& Url) : Url(Url) {}
+
+        void onConnect(ArEventHandlerFunction Handler) { ConnectHandler = Handler; }
+        void onDisconnect(ArEventHandlerFunction Handler) { DisconnectHandler = Handler; }
+
+        // Test side
+        String Url;
+        ArEventHandlerFunction ConnectHandler;
+        ArEventHandlerFunction DisconnectHandler;
+};
+
+// Requests go through the middlewares, then to the first handler that takes
+// them, then to the routes registered with on()
+class AsyncWebServer {
+    public:
+        AsyncWebServer(uint16_t Port) : Port(Port) {}
+        ~AsyncWebServer() {
+            for (AsyncWebHandler* Handler : Handlers) {
+                delete Handler;
+            }
+        }
+
+        void begin() { Running = true; }
+        void end() { Running = false; }
+
+        AsyncWebHandler& addHandler(AsyncWebHandler* Handler) { Handlers.push_back(Handler); return *Handler; }
+        void addMiddleware(AsyncMiddleware* Middleware) { Middlewares.push_back(Middleware); }
+        void on(const char* Uri, WebRequestMethodComposite Method, ArRequestHandlerFunction Handler) { Routes.push_back({Uri, Method, Handler}); }
+
+        // Test side
+        void Handle(AsyncWebServerRequest* Request, size_t Middleware = 0) {
+            if (Middleware < Middlewares.size()) {
+                Middlewares[Middleware]->run(Request, [this, Request, Middleware]() { Handle(Request, Middleware + 1); });
+                return;
+            }
+            for (AsyncWebHandler* Handler : Handlers) {
+                if (Handler->canHandle(Request)) {
+                    Handler->handleRequest(Request);
+                    return;
+                }
+            }
+            for (Route& Entry : Routes) {
+                if ((Entry.Uri == Request->url()) && (Entry.Method & Request->method())) {
+                    Entry.Handler(Request);
+                    return;
+                }
+            }
+            Request->send(404);
+        }
+
+        struct Route {
+            String Uri;
+            WebRequestMethodComposite Method;
+            ArRequestHandlerFunction Handler;
+        };
+
+        uint16_t Port;
+        bool Running = false;
+        std::vector<AsyncWebHandler*> Handlers;
+        std::vector<AsyncMiddleware*> Middlewares;
+        std::vector<Route> Routes;
+};
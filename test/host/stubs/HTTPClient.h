@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED  (-1)
+
+typedef enum {
+    HTTP_CODE_OK                 = 200,
+    HTTP_CODE_PARTIAL_CONTENT    = 206,
+    HTTP_CODE_NOT_FOUND          = 404,
+    HTTP_CODE_REQUEST_TIMEOUT    = 408,
+} t_http_codes;
+
+// No server: every request fails to connect
+class HTTPClient {
+    public:
+        bool begin(const String& Url) { return Url.startsWith("http://") || Url.startsWith("https://"); }
+        void end() {}
+        void setTimeout(uint16_t) {}
+        void setReuse(bool) {}
+        void addHeader(const String&, const String&) {}
+        int GET() { return HTTPC_ERROR_CONNECTION_REFUSED; }
+        int getSize() { return -1; }
+        WiFiClient* getStreamPtr() { return &Stream; }
+        static String errorToString(int Error) { return (Error == HTTPC_ERROR_CONNECTION_REFUSED) ? "connection refused" : String(); }
+
+    private:
+        WiFiClient Stream;
+};
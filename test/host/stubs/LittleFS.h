@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+
+// In-memory LittleFS over Host::Files and Host::Directories, see
+// HostRuntime.h. Writes reach the file on flush() or close(), a rename
+// replaces the target
+struct HostFile;
+
+class File {
+    public:
+        File() {}
+        explicit File(std::shared_ptr<HostFile> Handle) : Handle(Handle) {}
+
+        explicit operator bool() const;
+        size_t write(const uint8_t* Buffer, size_t Size);
+        size_t write(uint8_t Byte) { return write(&Byte, 1); }
+        size_t read(uint8_t* Buffer, size_t Size);
+        int read();
+        int available();
+        bool seek(uint32_t Position);
+        size_t position() const;
+        size_t size() const;
+        void flush();
+        void close();
+
+        bool isDirectory() const;
+        File openNextFile();
+        const char* path() const;
+        const char* name() const;
+
+    private:
+        std::shared_ptr<HostFile> Handle;
+};
+
+class LittleFSFS {
+    public:
+        bool begin(bool FormatOnFail = false, const char* BasePath = "/littlefs", uint8_t MaxOpenFiles = 10, const char* Label = "spiffs");
+        void end() {}
+        bool format();
+
+        File open(const String& Path, const char* Mode = "r") { return open(Path.c_str(), Mode); }
+        File open(const char* Path, const char* Mode = "r");
+        bool exists(const String& Path) { return exists(Path.c_str()); }
+        bool exists(const char* Path);
+        bool remove(const String& Path) { return remove(Path.c_str()); }
+        bool remove(const char* Path);
+        bool rename(const String& From, const String& To) { return rename(From.c_str(), To.c_str()); }
+        bool rename(const char* From, const char* To);
+        bool mkdir(const String& Path) { return mkdir(Path.c_str()); }
+        bool mkdir(const char* Path);
+        bool rmdir(const String& Path) { return rmdir(Path.c_str()); }
+        bool rmdir(const char* Path);
+
+        size_t totalBytes();
+        size_t usedBytes();
+};
+
+extern LittleFSFS LittleFS;
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Arduino.h>
+
+// The real logger needs the web server, the host build records the lines
+// in Host::LogLines instead, see HostRuntime.h
+
+enum class LogType { Debug, Info, Warning, Error, FatalError };
+
+#define DEBUG         LogType::Debug
+#define INFO          LogType::Info
+#define WARNING       LogType::Warning
+#define ERROR         LogType::Error
+#define FATAL_ERROR   LogType::FatalError
+
+void HostLog(LogType Type, const String& FunctionName, const String& Message);
+
+#define LOG(Type, FunctionName, Message) HostLog(Type, FunctionName, Message)
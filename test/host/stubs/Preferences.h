@@ -0,0 +1,45 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+
+// NVS namespaces kept in memory for the whole test run
+class Preferences {
+    public:
+        bool begin(const char* Name, bool ReadOnly = false) {
+            Namespace = &Storage()[Name];
+            this->ReadOnly = ReadOnly;
+            return true;
+        }
+        void end() { Namespace = nullptr; }
+
+        size_t putBytes(const char* Key, const void* Value, size_t Length) {
+            if ((Namespace == nullptr) || ReadOnly) return 0;
+            const uint8_t* Bytes = static_cast<const uint8_t*>(Value);
+            (*Namespace)[Key].assign(Bytes, Bytes + Length);
+            return Length;
+        }
+        size_t getBytes(const char* Key, void* Buffer, size_t MaxLength) {
+            if (Namespace == nullptr) return 0;
+            auto Entry = Namespace->find(Key);
+            if ((Entry == Namespace->end()) || (Entry->second.size() > MaxLength)) return 0;
+            memcpy(Buffer, Entry->second.data(), Entry->second.size());
+            return Entry->second.size();
+        }
+        bool remove(const char* Key) {
+            return (Namespace != nullptr) && !ReadOnly && (Namespace->erase(Key) > 0);
+        }
+
+        // Test side
+        typedef std::map<std::string, std::vector<uint8_t>> Entries;
+        static std::map<std::string, Entries>& Storage() {
+            static std::map<std::string, Entries> Namespaces;
+            return Namespaces;
+        }
+
+    private:
+        Entries* Namespace = nullptr;
+        bool ReadOnly = false;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+#include <Arduino.h>
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+// No broker: connect() fails and every call reports a lost connection
+class PubSubClient {
+    public:
+        template <typename Client>
+        PubSubClient(Client&) {}
+
+        PubSubClient& setServer(const char*, uint16_t) { return *this; }
+        PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { Callback = callback; return *this; }
+        PubSubClient& setKeepAlive(uint16_t) { return *this; }
+        PubSubClient& setSocketTimeout(uint16_t) { return *this; }
+        bool setBufferSize(uint16_t) { return true; }
+
+        bool connect(const char*, const char*, const char*) { return false; }
+        void disconnect() {}
+        bool connected() { return false; }
+        int state() { return -2; }   // MQTT_CONNECT_FAILED
+        bool loop() { return false; }
+
+        bool publish(const char*, const char*, bool = false) { return false; }
+        bool subscribe(const char*, uint8_t = 0) { return false; }
+        bool unsubscribe(const char*) { return false; }
+
+    private:
+        std::function<void(char*, uint8_t*, unsigned int)> Callback;
+};
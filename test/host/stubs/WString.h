@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Arduino String over std::string, with the members the libraries use
+class String {
+    public:
+        String() {}
+        String(const char* Text) : Value(Text ? Text : "") {}
+        String(const std::string& Text) : Value(Text) {}
+        String(const String& Other) = default;
+        String(String&& Other) = default;
+        explicit String(char Character) : Value(1, Character) {}
+        explicit String(unsigned char Number, unsigned char Base = 10) : String(static_cast<unsigned long long>(Number), Base) {}
+        explicit String(int Number, unsigned char Base = 10) : String(static_cast<long long>(Number), Base) {}
+        explicit String(unsigned int Number, unsigned char Base = 10) : String(static_cast<unsigned long long>(Number), Base) {}
+        explicit String(long Number, unsigned char Base = 10) : String(static_cast<long long>(Number), Base) {}
+        explicit String(unsigned long Number, unsigned char Base = 10) : String(static_cast<unsigned long long>(Number), Base) {}
+        explicit String(long long Number, unsigned char Base = 10) {
+            if (Number < 0) {
+                Value = "-" + String(static_cast<unsigned long long>(-Number), Base).Value;
+            } else {
+                Value = String(static_cast<unsigned long long>(Number), Base).Value;
+            }
+        }
+        explicit String(unsigned long long Number, unsigned char Base = 10) {
+            do {
+                Value.insert(Value.begin(), "0123456789abcdefghijklmnopqrstuvwxyz"[Number % Base]);
+                Number /= Base;
+            } while (Number > 0);
+        }
+        explicit String(float Number, unsigned int Decimals = 2) : String(static_cast<double>(Number), Decimals) {}
+        explicit String(double Number, unsigned int Decimals = 2) {
+            char Buffer[64];
+            snprintf(Buffer, sizeof(Buffer), "%.*f", static_cast<int>(Decimals), Number);
+            Value = Buffer;
+        }
+
+        String& operator=(const String& Other) = default;
+        String& operator=(String&& Other) = default;
+        String& operator=(const char* Text) { Value = Text ? Text : ""; return *this; }
+
+        const char* c_str() const { return Value.c_str(); }
+        unsigned int length() const { return Value.length(); }
+        bool isEmpty() const { return Value.empty(); }
+        bool reserve(unsigned int Size) { Value.reserve(Size); return true; }
+
+        bool concat(const String& Other) { Value += Other.Value; return true; }
+        bool concat(const char* Text) { if (Text) Value += Text; return Text != nullptr; }
+        bool concat(const char* Text, unsigned int Length) { Value.append(Text, Length); return true; }
+        bool concat(char Character) { Value += Character; return true; }
+
+        String& operator+=(const String& Other) { Value += Other.Value; return *this; }
+        String& operator+=(const char* Text) { concat(Text); return *this; }
+        String& operator+=(char Character) { Value += Character; return *this; }
+        template <typename Number, typename = typename std::enable_if<std::is_arithmetic<Number>::value>::type>
+        String& operator+=(Number Value) { return *this += String(Value); }
+
+        char operator[](unsigned int Index) const { return (Index < Value.length()) ? Value[Index] : 0; }
+        char& operator[](unsigned int Index) { return Value[Index]; }
+        char charAt(unsigned int Index) const { return (*this)[Index]; }
+
+        bool equals(const String& Other) const { return Value == Other.Value; }
+        bool equalsIgnoreCase(const String& Other) const { return strcasecmp(Value.c_str(), Other.Value.c_str()) == 0; }
+        bool operator==(const String& Other) const { return Value == Other.Value; }
+        bool operator==(const char* Text) const { return Value == (Text ? Text : ""); }
+        bool operator!=(const String& Other) const { return Value != Other.Value; }
+        bool operator!=(const char* Text) const { return !(*this == Text); }
+        bool operator<(const String& Other) const { return Value < Other.Value; }
+
+        bool startsWith(const String& Prefix) const { return Value.compare(0, Prefix.Value.length(), Prefix.Value) == 0; }
+        bool startsWith(const String& Prefix, unsigned int Offset) const { return (Offset <= Value.length()) && (Value.compare(Offset, Prefix.Value.length(), Prefix.Value) == 0); }
+        bool endsWith(const String& Suffix) const { return (Value.length() >= Suffix.Value.length()) && (Value.compare(Value.length() - Suffix.Value.length(), Suffix.Value.length(), Suffix.Value) == 0); }
+
+        int indexOf(char Character, unsigned int From = 0) const { return Found(Value.find(Character, From)); }
+        int indexOf(const String& Text, unsigned int From = 0) const { return Found(Value.find(Text.Value, From)); }
+        int lastIndexOf(char Character) const { return Found(Value.rfind(Character)); }
+        int lastIndexOf(const String& Text) const { return Found(Value.rfind(Text.Value)); }
+
+        String substring(unsigned int From) const { return (From < Value.length()) ? String(Value.substr(From)) : String(); }
+        String substring(unsigned int From, unsigned int To) const {
+            if (From > To) std::swap(From, To);
+            return (From < Value.length()) ? String(Value.substr(From, To - From)) : String();
+        }
+        void remove(unsigned int Index) { if (Index < Value.length()) Value.erase(Index); }
+        void remove(unsigned int Index, unsigned int Count) { if (Index < Value.length()) Value.erase(Index, Count); }
+        void replace(const String& Find, const String& Replace) {
+            if (Find.Value.empty()) return;
+            for (size_t Position = 0; (Position = Value.find(Find.Value, Position)) != std::string::npos; Position += Replace.Value.length()) {
+                Value.replace(Position, Find.Value.length(), Replace.Value);
+            }
+        }
+        void trim() {
+            size_t First = Value.find_first_not_of(" \t\r\n");
+            size_t Last = Value.find_last_not_of(" \t\r\n");
+            Value = (First == std::string::npos) ? "" : Value.substr(First, Last - First + 1);
+        }
+        void toLowerCase() { for (char& Character : Value) Character = tolower(Character); }
+        void toUpperCase() { for (char& Character : Value) Character = toupper(Character); }
+
+        long toInt() const { return strtol(Value.c_str(), nullptr, 10); }
+        float toFloat() const { return strtof(Value.c_str(), nullptr); }
+        double toDouble() const { return strtod(Value.c_str(), nullptr); }
+
+        friend String operator+(const String& Left, const String& Right) { return String(Left.Value + Right.Value); }
+        friend String operator+(const String& Left, const char* Right) { return String(Left.Value + (Right ? Right : "")); }
+        friend String operator+(const char* Left, const String& Right) { return String((Left ? Left : "") + Right.Value); }
+        friend String operator+(const String& Left, char Right) { return String(Left.Value + Right); }
+        template <typename Number, typename = typename std::enable_if<std::is_arithmetic<Number>::value>::type>
+        friend String operator+(const String& Left, Number Right) { return Left + String(Right); }
+
+    private:
+        std::string Value;
+
+        static int Found(size_t Position) { return (Position == std::string::npos) ? -1 : static_cast<int>(Position); }
+};
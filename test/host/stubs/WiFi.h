@@ -0,0 +1,123 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <Arduino.h>
+#include "WiFiClient.h"
+
+// Station interface of the Arduino-ESP32 core. Nothing associates by itself:
+// the test sets the link fields and raises the events, see HostRuntime.h.
+// Name lookups are answered from Host::DnsTable
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_READY,
+    ARDUINO_EVENT_WIFI_SCAN_DONE,
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_STOP,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP,
+} arduino_event_id_t;
+
+typedef struct {
+    uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef union {
+    wifi_event_sta_disconnected_t wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef size_t wifi_event_id_t;
+typedef std::function<void(arduino_event_id_t Event, arduino_event_info_t Info)> WiFiEventFuncCb;
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+
+typedef enum {
+    WL_IDLE_STATUS     = 0,
+    WL_NO_SSID_AVAIL   = 1,
+    WL_SCAN_COMPLETED  = 2,
+    WL_CONNECTED       = 3,
+    WL_CONNECT_FAILED  = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED    = 6,
+} wl_status_t;
+
+#define INADDR_NONE  IPAddress(0, 0, 0, 0)
+
+class WiFiClass {
+    public:
+        int hostByName(const char* Name, IPAddress& Address);
+
+        wifi_event_id_t onEvent(WiFiEventFuncCb Callback);
+        void removeEvent(wifi_event_id_t Id);
+
+        bool mode(wifi_mode_t) { return true; }
+        bool setHostname(const char*) { return true; }
+        bool setSleep(wifi_ps_type_t) { return true; }
+        void useStaticBuffers(bool) {}
+
+        bool config(IPAddress LocalIP, IPAddress Gateway, IPAddress Subnet, IPAddress Dns = IPAddress()) {
+            Configs.push_back({LocalIP, Gateway, Subnet, Dns});
+            return true;
+        }
+        wl_status_t begin(const char* Ssid, const char* Password, int32_t Channel = 0, const uint8_t* Bssid = nullptr) {
+            Begins.push_back({Ssid, Channel, Bssid != nullptr});
+            return WL_DISCONNECTED;
+        }
+        bool disconnect() { Status = WL_DISCONNECTED; return true; }
+        wl_status_t status() { return Status; }
+
+        IPAddress localIP() { return LocalIP; }
+        IPAddress gatewayIP() { return Gateway; }
+        IPAddress subnetMask() { return Subnet; }
+        IPAddress dnsIP() { return Dns; }
+        int8_t RSSI() { return Rssi; }
+        uint8_t* BSSID() { return Bssid; }
+        String BSSIDstr() { return "00:00:00:00:00:00"; }
+        int32_t channel() { return Channel; }
+
+        int16_t scanNetworks(bool = false, bool = false, bool = false, uint32_t = 300, uint8_t = 0, const char* = nullptr) { return -1; }
+        int16_t scanComplete() { return 0; }
+        void scanDelete() {}
+        String SSID(uint8_t) { return ""; }
+        int32_t RSSI(uint8_t) { return 0; }
+        uint8_t* BSSID(uint8_t) { return Bssid; }
+        String BSSIDstr(uint8_t) { return BSSIDstr(); }
+        int32_t channel(uint8_t) { return 0; }
+
+        // Test side
+        struct ConfigCall {
+            IPAddress LocalIP;
+            IPAddress Gateway;
+            IPAddress Subnet;
+            IPAddress Dns;
+        };
+        struct BeginCall {
+            String Ssid;
+            int32_t Channel;
+            bool Directed;   // with a BSSID
+        };
+
+        void RaiseEvent(arduino_event_id_t Event, uint8_t Reason = 0);
+        void Reset();
+
+        wl_status_t Status = WL_DISCONNECTED;
+        IPAddress LocalIP;
+        IPAddress Gateway;
+        IPAddress Subnet;
+        IPAddress Dns;
+        int8_t Rssi = -60;
+        uint8_t Bssid[6] = {0};
+        int32_t Channel = 1;
+        uint32_t LeaseTime = 0;     // seconds left on the DHCP lease, 0 for a static address
+        std::vector<ConfigCall> Configs;
+        std::vector<BeginCall> Begins;
+
+    private:
+        std::vector<std::pair<wifi_event_id_t, WiFiEventFuncCb>> Handlers;
+        wifi_event_id_t NextEventId = 1;
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <deque>
+#include <Arduino.h>
+
+// A connection whose received bytes the test queues in Incoming
+class WiFiClient {
+    public:
+        int connect(const char*, uint16_t) { return Connected ? 1 : 0; }
+        int connect(IPAddress, uint16_t) { return Connected ? 1 : 0; }
+        void stop() { Connected = false; }
+        uint8_t connected() { return Connected || !Incoming.empty(); }
+        explicit operator bool() { return connected(); }
+
+        int available() { return Incoming.size(); }
+        int read() {
+            if (Incoming.empty()) return -1;
+            uint8_t Byte = Incoming.front();
+            Incoming.pop_front();
+            return Byte;
+        }
+        size_t readBytes(uint8_t* Buffer, size_t Length) {
+            size_t Read = 0;
+            while ((Read < Length) && !Incoming.empty()) {
+                Buffer[Read++] = read();
+            }
+            return Read;
+        }
+        size_t write(const uint8_t*, size_t Size) { return Connected ? Size : 0; }
+        void setTimeout(uint32_t) {}
+
+        // Test side
+        bool Connected = false;
+        std::deque<uint8_t> Incoming;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <Arduino.h>
+
+// Datagrams sent go to Host::UdpServer, its replies come back once the fake
+// clock reaches their arrival time, see HostRuntime.h
+class WiFiUDP {
+    public:
+        uint8_t begin(uint16_t Port);
+        void stop();
+
+        int beginPacket(IPAddress Address, uint16_t Port);
+        size_t write(const uint8_t* Buffer, size_t Size);
+        int endPacket();
+
+        int parsePacket();
+        int read(uint8_t* Buffer, size_t Size);
+        void flush();
+
+    private:
+        bool Open = false;
+        IPAddress Destination;
+        uint16_t DestinationPort = 0;
+        std::vector<uint8_t> Outgoing;
+        std::vector<uint8_t> Incoming;
+        size_t ReadPosition = 0;
+};
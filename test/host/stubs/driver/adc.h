@@ -0,0 +1,21 @@
+#pragma once
+
+#include "esp_err.h"
+
+// Every channel reads 0, the host tests do not sample analog inputs
+typedef enum { ADC_WIDTH_BIT_9, ADC_WIDTH_BIT_10, ADC_WIDTH_BIT_11, ADC_WIDTH_BIT_12 } adc_bits_width_t;
+typedef enum { ADC_ATTEN_DB_0, ADC_ATTEN_DB_2_5, ADC_ATTEN_DB_6, ADC_ATTEN_DB_12 } adc_atten_t;
+typedef enum {
+    ADC1_CHANNEL_0, ADC1_CHANNEL_1, ADC1_CHANNEL_2, ADC1_CHANNEL_3,
+    ADC1_CHANNEL_4, ADC1_CHANNEL_5, ADC1_CHANNEL_6, ADC1_CHANNEL_7,
+} adc1_channel_t;
+typedef enum {
+    ADC2_CHANNEL_0, ADC2_CHANNEL_1, ADC2_CHANNEL_2, ADC2_CHANNEL_3, ADC2_CHANNEL_4,
+    ADC2_CHANNEL_5, ADC2_CHANNEL_6, ADC2_CHANNEL_7, ADC2_CHANNEL_8, ADC2_CHANNEL_9,
+} adc2_channel_t;
+
+inline esp_err_t adc1_config_width(adc_bits_width_t) { return ESP_OK; }
+inline esp_err_t adc1_config_channel_atten(adc1_channel_t, adc_atten_t) { return ESP_OK; }
+inline int adc1_get_raw(adc1_channel_t) { return 0; }
+inline esp_err_t adc2_config_channel_atten(adc2_channel_t, adc_atten_t) { return ESP_OK; }
+inline esp_err_t adc2_get_raw(adc2_channel_t, adc_bits_width_t, int* Raw) { *Raw = 0; return ESP_OK; }
@@ -0,0 +1,22 @@
+#pragma once
+
+typedef int esp_err_t;
+
+#define ESP_OK                 0
+#define ESP_FAIL               -1
+#define ESP_ERR_NO_MEM         0x101
+#define ESP_ERR_INVALID_ARG    0x102
+#define ESP_ERR_INVALID_SIZE   0x104
+#define ESP_ERR_TIMEOUT        0x107
+
+inline const char* esp_err_to_name(esp_err_t Code) {
+    switch (Code) {
+        case ESP_OK:               return "ESP_OK";
+        case ESP_FAIL:             return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:       return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:  return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_TIMEOUT:      return "ESP_ERR_TIMEOUT";
+        default:                   return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+
+inline size_t heap_caps_get_free_size(uint32_t) { return 200000; }
+inline size_t heap_caps_get_minimum_free_size(uint32_t) { return 150000; }
+inline size_t heap_caps_get_largest_free_block(uint32_t) { return 100000; }
@@ -0,0 +1,8 @@
+#pragma once
+
+// The station interface only, its lwIP side carries the DHCP lease the test
+// sets in WiFi.LeaseTime, see lwip/dhcp.h
+typedef struct esp_netif_obj esp_netif_t;
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* Key);
+void* esp_netif_get_netif_impl(esp_netif_t* Interface);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "esp_partition.h"
+
+typedef uint32_t esp_ota_handle_t;
+
+// There is no second application slot on the host
+inline const esp_partition_t* esp_ota_get_running_partition() { return nullptr; }
+inline const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t*) { return nullptr; }
+inline esp_err_t esp_ota_begin(const esp_partition_t*, size_t, esp_ota_handle_t*) { return ESP_FAIL; }
+inline esp_err_t esp_ota_write(esp_ota_handle_t, const void*, size_t) { return ESP_FAIL; }
+inline esp_err_t esp_ota_end(esp_ota_handle_t) { return ESP_FAIL; }
+inline esp_err_t esp_ota_abort(esp_ota_handle_t) { return ESP_OK; }
+inline esp_err_t esp_ota_set_boot_partition(const esp_partition_t*) { return ESP_FAIL; }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "esp_err.h"
+
+// The host partition keeps its bytes in HostContent, the test owns them
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+    const uint8_t* HostContent;
+} esp_partition_t;
+
+inline esp_err_t esp_partition_read(const esp_partition_t* Partition, size_t Offset, void* Destination, size_t Size) {
+    if ((Partition == nullptr) || (Partition->HostContent == nullptr) || (Offset + Size > Partition->size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(Destination, Partition->HostContent + Offset, Size);
+    return ESP_OK;
+}
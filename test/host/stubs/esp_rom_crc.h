@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+// Same result as the ROM function: the zlib CRC32, chainable through Crc
+inline uint32_t esp_rom_crc32_le(uint32_t Crc, const uint8_t* Buffer, uint32_t Length) {
+    Crc = ~Crc;
+    for (uint32_t i = 0; i < Length; i++) {
+        Crc ^= Buffer[i];
+        for (int Bit = 0; Bit < 8; Bit++) {
+            Crc = (Crc >> 1) ^ (0xEDB88320 & (0 - (Crc & 1)));
+        }
+    }
+    return ~Crc;
+}
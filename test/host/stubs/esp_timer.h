@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+// Fake clock of HostRuntime.cpp, microseconds, only moves with Host::RunFor()
+int64_t esp_timer_get_time();
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Levels come from Host::SetPinLevel(), see HostRuntime.h
+typedef int gpio_num_t;
+struct gpio_dev_t {};
+inline gpio_dev_t GPIO;
+
+inline int gpio_ll_get_level(gpio_dev_t*, gpio_num_t Pin) {
+    return digitalRead(Pin);
+}
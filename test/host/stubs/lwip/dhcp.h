@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+#define DHCP_COARSE_TIMER_SECS 1
+
+struct dhcp {
+    uint32_t t0_timeout;     // lease time, coarse timer ticks
+    uint32_t lease_used;     // coarse timer ticks since the lease was granted
+};
+
+struct netif {
+    struct dhcp* dhcp;
+};
+
+#define netif_dhcp_data(netif) ((netif)->dhcp)
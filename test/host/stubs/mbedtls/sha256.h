@@ -0,0 +1,29 @@
+#pragma once
+
+#include <openssl/evp.h>
+
+// mbedTLS SHA-256 on top of the OpenSSL of the build machine
+typedef struct {
+    EVP_MD_CTX* Context;
+} mbedtls_sha256_context;
+
+inline void mbedtls_sha256_init(mbedtls_sha256_context* Context) {
+    Context->Context = EVP_MD_CTX_new();
+}
+
+inline void mbedtls_sha256_free(mbedtls_sha256_context* Context) {
+    EVP_MD_CTX_free(Context->Context);
+    Context->Context = nullptr;
+}
+
+inline int mbedtls_sha256_starts(mbedtls_sha256_context* Context, int Is224) {
+    return (EVP_DigestInit_ex(Context->Context, Is224 ? EVP_sha224() : EVP_sha256(), nullptr) == 1) ? 0 : -1;
+}
+
+inline int mbedtls_sha256_update(mbedtls_sha256_context* Context, const unsigned char* Input, size_t Length) {
+    return (EVP_DigestUpdate(Context->Context, Input, Length) == 1) ? 0 : -1;
+}
+
+inline int mbedtls_sha256_finish(mbedtls_sha256_context* Context, unsigned char Output[32]) {
+    return (EVP_DigestFinal_ex(Context->Context, Output, nullptr) == 1) ? 0 : -1;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <zlib.h>
+
+// The tinfl part of the ROM miniz, on top of the zlib of the build machine.
+// zlib keeps its own history, so the shim checks instead that the caller
+// honours the circular buffer contract of tinfl: every call continues at the
+// offset where the previous output ended, modulo the window size, and never
+// asks for output past the end of the window. Any other call would make the
+// real tinfl resolve back references against the wrong bytes.
+
+#define TINFL_LZ_DICT_SIZE  32768
+
+enum {
+    TINFL_FLAG_PARSE_ZLIB_HEADER             = 1,
+    TINFL_FLAG_HAS_MORE_INPUT                = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32               = 8
+};
+
+typedef enum {
+    TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS = -4,
+    TINFL_STATUS_BAD_PARAM                   = -3,
+    TINFL_STATUS_ADLER32_MISMATCH            = -2,
+    TINFL_STATUS_FAILED                      = -1,
+    TINFL_STATUS_DONE                        = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT            = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT             = 2
+} tinfl_status;
+
+// Plain data like the real one: allocated with malloc(), released with
+// free(), so zlib allocates from the arena inside it
+struct tinfl_decompressor {
+    z_stream Stream;
+    bool Started;
+    bool Ended;
+    uint64_t TotalOut;
+    size_t ArenaUsed;
+    alignas(16) uint8_t Arena[48 * 1024];
+};
+
+inline voidpf TinflArenaAlloc(voidpf Opaque, uInt Items, uInt Size) {
+    tinfl_decompressor* Decompressor = static_cast<tinfl_decompressor*>(Opaque);
+    size_t Length = (static_cast<size_t>(Items) * Size + 15) & ~static_cast<size_t>(15);
+    if (Decompressor->ArenaUsed + Length > sizeof(Decompressor->Arena)) {
+        return Z_NULL;
+    }
+    voidpf Block = Decompressor->Arena + Decompressor->ArenaUsed;
+    Decompressor->ArenaUsed += Length;
+    return Block;
+}
+
+inline void TinflArenaFree(voidpf, voidpf) {
+}
+
+#define tinfl_init(Decompressor)  do { (Decompressor)->Started = false; (Decompressor)->Ended = false; (Decompressor)->TotalOut = 0; (Decompressor)->ArenaUsed = 0; } while (0)
+
+inline tinfl_status tinfl_decompress(tinfl_decompressor* Decompressor, const uint8_t* InNext, size_t* InSize,
+                                     uint8_t* OutStart, uint8_t* OutNext, size_t* OutSize, uint32_t Flags) {
+    size_t InAvailable = *InSize;
+    size_t OutAvailable = *OutSize;
+    *InSize = 0;
+    *OutSize = 0;
+
+    if (!(Flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)) {
+        size_t Offset = OutNext - OutStart;
+        if ((OutNext < OutStart) || (Offset != (Decompressor->TotalOut & (TINFL_LZ_DICT_SIZE - 1))) ||
+            (Offset + OutAvailable > TINFL_LZ_DICT_SIZE)) {
+            return TINFL_STATUS_BAD_PARAM;
+        }
+    }
+    if (Decompressor->Ended) {
+        return TINFL_STATUS_DONE;
+    }
+
+    z_stream& Stream = Decompressor->Stream;
+    if (!Decompressor->Started) {
+        Stream = z_stream();
+        Stream.zalloc = TinflArenaAlloc;
+        Stream.zfree = TinflArenaFree;
+        Stream.opaque = Decompressor;
+        if (inflateInit2(&Stream, (Flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? MAX_WBITS : -MAX_WBITS) != Z_OK) {
+            return TINFL_STATUS_FAILED;
+        }
+        Decompressor->Started = true;
+    }
+
+    Stream.next_in = const_cast<Bytef*>(InNext);
+    Stream.avail_in = InAvailable;
+    Stream.next_out = OutNext;
+    Stream.avail_out = OutAvailable;
+    int Result = inflate(&Stream, Z_NO_FLUSH);
+    *InSize = InAvailable - Stream.avail_in;
+    *OutSize = OutAvailable - Stream.avail_out;
+    Decompressor->TotalOut += *OutSize;
+
+    if (Result == Z_STREAM_END) {
+        Decompressor->Ended = true;
+        return TINFL_STATUS_DONE;
+    }
+    if ((Result != Z_OK) && (Result != Z_BUF_ERROR)) {
+        return TINFL_STATUS_FAILED;
+    }
+    if (Stream.avail_out == 0) {
+        return TINFL_STATUS_HAS_MORE_OUTPUT;
+    }
+    return (Flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS;
+}